@@ -0,0 +1,30 @@
+#pragma once
+#include <array>
+
+#include "PICA/dynapica/vertex_loader_layout.hpp"
+#include "helpers.hpp"
+
+namespace PICA {
+	// Everything a renderer needs in order to fetch vertex attributes and run the vertex shader on the host GPU
+	// Filled by the GPU when hardware vertex shading is enabled and the renderer accepted the current vertex shader
+	struct DrawAcceleration {
+		struct VertexBuffer {
+			const u8* data;  // Host pointer to the first vertex used by the draw
+			u32 size;        // Number of bytes to upload, starting from data
+		};
+
+		// Attribute formats, offsets and the input register each attribute goes to. Offsets are relative to the start of each vertex
+		VertexLoader::Layout layout;
+		std::array<VertexBuffer, VertexLoader::maxAttribCount> vertexBuffers;
+		// Values of the fixed attributes, indexed by the attribute's fixedIndex
+		const VertexLoader::vec4f* fixedAttributes;
+
+		// For indexed draws, indices are rebased to minimumIndex since vertex buffers are only uploaded starting from that vertex
+		const u8* indexBuffer;
+		bool indexed;
+		bool shortIndices;
+		u32 minimumIndex;
+		u32 maximumIndex;
+		u32 vertexCount;
+	};
+}  // namespace PICA
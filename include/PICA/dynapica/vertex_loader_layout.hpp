@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+
+#include "PICA/float_types.hpp"
+#include "helpers.hpp"
+
+// Description of a vertex format as consumed by the vertex loader JIT, decoded from the PICA attribute configuration registers
+namespace VertexLoader {
+	using vec4f = std::array<Floats::f24, 4>;
+	static constexpr u32 maxAttribCount = 12;  // Up to 12 vertex buffers
+	static constexpr u32 maxInputCount = 16;   // Up to 16 attributes sent to the vertex shader
+
+	// Attribute component types, as encoded in GPUREG_ATTRIBBUFFERS_FORMAT
+	enum class AttribType : u32 { S8 = 0, U8 = 1, S16 = 2, Float = 3 };
+	// Size of each component in bytes, indexed by AttribType
+	static constexpr std::array<u32, 4> attribTypeSizes = {1, 1, 2, 4};
+
+	// A single attribute fetched by the loader. All fields are u32 so that the layout can be hashed without any padding bytes
+	struct Attribute {
+		u32 fixed;           // If non-zero, the attribute is copied from fixedAttributes[fixedIndex] instead of being fetched
+		u32 fixedIndex;      // Index of the fixed attribute
+		u32 buffer;          // Vertex buffer the attribute is fetched from
+		u32 offset;          // Offset of the attribute inside its vertex, in bytes
+		u32 type;            // AttribType of each component
+		u32 componentCount;  // Number of components fetched (1-4). The rest are filled with (0, 0, 0, 1)
+		u32 inputRegister;   // Shader input register the attribute is written to
+	};
+
+	// Everything the emitted code depends on. Buffer offsets are not part of it, so the same loader is reused for all VBOs with the same format
+	struct Layout {
+		std::array<Attribute, maxInputCount> attributes;
+		std::array<u32, maxAttribCount> strides;  // Bytes per vertex for each buffer
+		u32 attributeCount;
+		u32 bufferCount;
+	};
+
+	// Loads vertex #vertexIndex into "inputs". bufferPointers[i] points to the first vertex of vertex buffer #i
+	using Callback = void (*)(vec4f* inputs, const u8* const* bufferPointers, u32 vertexIndex, const vec4f* fixedAttributes);
+
+	// Decode the attribute configuration registers into "layout". Returns false for configurations that need the interpreted vertex fetch
+	// bufferAlignment[i] is (vertex base + offset of buffer #i) & 3, which padding components depend on
+	bool buildLayout(Layout& layout, const std::array<u32, 0x300>& regs, const std::array<u32, maxAttribCount>& bufferAlignment);
+}  // namespace VertexLoader
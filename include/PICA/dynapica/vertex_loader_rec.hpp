@@ -1,28 +1,63 @@
 #pragma once
+#include <array>
+
+#include "PICA/dynapica/vertex_loader_layout.hpp"
+#include "PICA/pica_hash.hpp"
 #include "helpers.hpp"
-#include "renderer_gl/renderer_gl.hpp"
-#include "x64_regs.hpp"
 
-// Recompiler that takes the current vertex attribute configuration, ie the format of vertices (VAO in OpenGL) and emits optimized
-// code in our CPU's native architecture for loading vertices. Unimplemented at the moment, we've only got a skeleton of it here for later
+// Recompiler that takes the current vertex attribute configuration, ie the format of vertices (VAO in OpenGL) and emits straight-line code
+// in our CPU's native architecture that fetches a single vertex, converts its attributes to floats and writes them to the vertex shader
+// input registers, already permuted according to the SH_ATTRIBUTES_PERMUTATION registers.
+
+#if defined(PANDA3DS_DYNAPICA_SUPPORTED) && (defined(PANDA3DS_X64_HOST) || defined(PANDA3DS_ARM64_HOST))
+#define PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
+#include <memory>
+#include <unordered_map>
+
+#ifdef PANDA3DS_X64_HOST
+#include "vertex_loader_rec_emitter_x64.hpp"
+#elif defined(PANDA3DS_ARM64_HOST)
+#include "vertex_loader_rec_emitter_arm64.hpp"
+#endif
+#endif
 
 class VertexLoaderJIT {
 	using PICARegs = const std::array<u32, 0x300>&;
-	using Callback = void(*)(Vertex* output, size_t count);  // A function pointer to JIT-emitted code
-	Callback compileConfig(PICARegs regs);
 
-public:
-#if defined(PANDA3DS_DYNAPICA_SUPPORTED) && defined(PANDA3DS_X64_HOST)
-	#define PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
+	VertexLoader::Layout layout;
+	VertexLoader::Callback callback = nullptr;
 
-	void loadVertices(Vertex* output, size_t count, PICARegs regs);
-	static constexpr bool isAvailable() { return true; }
+#ifdef PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
+	using Hash = PICAHash::HashType;
+	using LoaderCache = std::unordered_map<Hash, std::unique_ptr<VertexLoaderEmitter>>;
+
+	LoaderCache cache;
+	bool hostSupported = VertexLoaderEmitter::isHostSupported();
+#endif
+
+  public:
+	const VertexLoader::Layout& getLayout() const { return layout; }
 
+#ifdef PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
+	// Call this before processing a batch of vertices. Decodes the vertex format from the PICA registers and looks up the matching loader
+	// in the cache, compiling it if it's not there. Returns false if the configuration can't be JIT'd, in which case the caller should
+	// fall back to the interpreted vertex fetch
+	bool prepare(PICARegs regs, const std::array<u32, VertexLoader::maxAttribCount>& bufferAlignment);
+	void reset() { cache.clear(); }
+
+	void loadVertex(VertexLoader::vec4f* inputs, const u8* const* bufferPointers, u32 vertexIndex, const VertexLoader::vec4f* fixedAttributes) {
+		callback(inputs, bufferPointers, vertexIndex, fixedAttributes);
+	}
+
+	static constexpr bool isAvailable() { return true; }
 #else
-	void loadVertices(Vertex* output, size_t count, PICARegs regs) {
+	bool prepare(PICARegs regs, const std::array<u32, VertexLoader::maxAttribCount>& bufferAlignment) { return false; }
+	void reset() {}
+
+	void loadVertex(VertexLoader::vec4f* inputs, const u8* const* bufferPointers, u32 vertexIndex, const VertexLoader::vec4f* fixedAttributes) {
 		Helpers::panic("Vertex Loader JIT: Tried to load vertices with JIT on platform that does not support vertex loader jit");
 	}
 
 	static constexpr bool isAvailable() { return false; }
 #endif
-};
\ No newline at end of file
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+// Only do anything if we're on an arm64 target with JIT support enabled
+#if defined(PANDA3DS_DYNAPICA_SUPPORTED) && defined(PANDA3DS_ARM64_HOST)
+#include <oaknut/code_block.hpp>
+#include <oaknut/oaknut.hpp>
+
+#include "PICA/dynapica/vertex_loader_layout.hpp"
+#include "helpers.hpp"
+
+class VertexLoaderEmitter : private oaknut::CodeBlock, public oaknut::CodeGenerator {
+	// A loader is at most ~40 instructions per attribute plus a few per buffer, so this leaves plenty of room
+	static constexpr size_t allocSize = 0x1000;
+
+	VertexLoader::Callback callback = nullptr;
+
+	// Load "attr" from the buffer pointed to by X9, converted to float, into Q0
+	void loadAttribute(const VertexLoader::Attribute& attr);
+
+  public:
+	// Initialize our emitter with "allocSize" bytes of memory allocated for the code buffer
+	VertexLoaderEmitter() : oaknut::CodeBlock(allocSize), oaknut::CodeGenerator(oaknut::CodeBlock::ptr()) {}
+
+	// Everything the loader needs is part of base AArch64 SIMD
+	static constexpr bool isHostSupported() { return true; }
+
+	void compile(const VertexLoader::Layout& layout);
+	VertexLoader::Callback getCallback() { return callback; }
+};
+
+#endif  // arm64 recompiler check
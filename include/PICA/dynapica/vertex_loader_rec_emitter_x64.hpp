@@ -0,0 +1,29 @@
+#pragma once
+
+// Only do anything if we're on an x64 target with JIT support enabled
+#if defined(PANDA3DS_DYNAPICA_SUPPORTED) && defined(PANDA3DS_X64_HOST)
+#include "PICA/dynapica/vertex_loader_layout.hpp"
+#include "helpers.hpp"
+#include "x64_regs.hpp"
+
+class VertexLoaderEmitter : public Xbyak::CodeGenerator {
+	// A loader is at most ~64 bytes per attribute plus ~16 per buffer, so this leaves plenty of room
+	static constexpr size_t allocSize = 0x1000;
+
+	Xbyak::Label defaultAttribute;  // (0.0, 0.0, 0.0, 1.0), used for filling the components an attribute doesn't provide
+	VertexLoader::Callback callback = nullptr;
+
+	// Load "attr" from the buffer pointed to by r10, converted to float, into xmm0
+	void loadAttribute(const VertexLoader::Attribute& attr);
+
+  public:
+	VertexLoaderEmitter() : Xbyak::CodeGenerator(allocSize) {}
+
+	// The loader uses SSE4.1 for sign/zero extension and blending. We fall back to the interpreted vertex fetch on CPUs without it
+	static bool isHostSupported() { return Xbyak::util::Cpu().has(Xbyak::util::Cpu::tSSE41); }
+
+	void compile(const VertexLoader::Layout& layout);
+	VertexLoader::Callback getCallback() { return callback; }
+};
+
+#endif  // x64 recompiler check
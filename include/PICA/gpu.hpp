@@ -1,11 +1,17 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "PICA/dynapica/shader_rec.hpp"
+#include "PICA/dynapica/vertex_loader_rec.hpp"
 #include "PICA/float_types.hpp"
 #include "PICA/pica_vertex.hpp"
 #include "PICA/regs.hpp"
 #include "PICA/shader_unit.hpp"
+#include "PICA/shader_worker_pool.hpp"
 #include "compiler_builtins.hpp"
 #include "config.hpp"
 #include "helpers.hpp"
@@ -24,33 +30,87 @@ class GPU {
 	Memory& mem;
 	EmulatorConfig& config;
 	ShaderUnit shaderUnit;
-	ShaderJIT shaderJIT;  // Doesn't do anything if JIT is disabled or not supported
+	ShaderJIT shaderJIT;              // Doesn't do anything if JIT is disabled or not supported
+	VertexLoaderJIT vertexLoaderJIT;  // Same here
 
 	u8* vram = nullptr;
 	MAKE_LOG_FUNCTION(log, gpuLogger)
 
 	static constexpr u32 maxAttribCount = 12;  // Up to 12 vertex attributes
 	static constexpr u32 vramSize = u32(6_MB);
-	Registers regs;                           // GPU internal registers
-	std::array<vec4f, 16> currentAttributes;  // Vertex attributes before being passed to the shader
+	Registers regs;  // GPU internal registers
+
+	// PICA::DirtyRegs groups of each internal register
+	static constexpr std::array<u8, regNum> dirtyGroups = []() {
+		std::array<u8, regNum> groups{};
+		for (u32 i = 0; i < regNum; i++) {
+			groups[i] = u8(PICA::DirtyRegs::getGroups(i));
+		}
+		return groups;
+	}();
 
 	std::array<vec4f, 16> immediateModeAttributes;  // Vertex attributes uploaded via immediate mode submission
 	std::array<PICA::Vertex, 3> immediateModeVertices;
 
-	// Pointers for the output registers as arranged after GPUREG_VSH_OUTMAP_MASK is applied
-	std::array<Floats::f24*, 16> vsOutputRegisters;
+	// Indices of the output registers as arranged after GPUREG_VSH_OUTMAP_MASK is applied
+	// These are indices rather than pointers so that they work with any copy of the vertex shader unit
+	std::array<u8, 16> vsOutputRegisters;
 	// Previous value for GPUREG_VSH_OUTMAP_MASK
 	u32 oldVsOutputMask;
 
 	uint immediateModeVertIndex;
 	uint immediateModeAttrIndex;  // Index of the immediate mode attribute we're uploading
 
+	// Everything needed for fetching the attributes of a vertex. Computed once per draw and shared between the vertex shading threads
+	struct VertexFetchState {
+		u32 vertexBase;
+		u64 vertexCfg;
+		u64 inputAttrCfg;
+		bool useVertexLoaderJIT;
+		std::array<const u8*, VertexLoader::maxAttribCount> bufferPointers;
+	};
+
+	// Large draws get their vertices shaded by several threads, each running its own copy of the vertex shader unit
+	ShaderWorkerPool shaderWorkers;
+	std::vector<std::unique_ptr<PICAShader>> shaderClones;  // Shader units for the worker threads. The calling thread uses shaderUnit.vs
+
+	// Indexed draws are shaded once per unique index and drawn with a host index buffer. indexSlots acts as a transform cache covering
+	// every possible 16-bit index: it maps each index to the position of its shaded vertex, or 0 if the index hasn't been seen yet
+	std::vector<u32> indexSlots;     // Index -> position of the index in uniqueIndices + 1. Reset to all zeroes after every draw
+	std::vector<u32> uniqueIndices;  // Unique indices in order of first appearance. Vertex i of the draw's vertex buffer uses uniqueIndices[i]
+	std::vector<u16> hostIndices;    // Index buffer passed to the renderer, pointing into the unique vertices
+
 	template <bool indexed, bool useShaderJIT>
 	void drawArrays();
 
+	// Fetch the attributes of the vertex at vertexIndex, run the vertex shader on them and write the mapped outputs to "out"
+	template <bool useShaderJIT>
+	void shadeVertex(PICAShader& shader, const VertexFetchState& fetch, u32 vertexIndex, PICA::Vertex& out);
+
+	// Shade "count" vertices into the vertex buffer, splitting them between workerCount threads
+	template <bool indexed, bool useShaderJIT>
+	void shadeVertices(const VertexFetchState& fetch, u32 count, u32 workerCount);
+
+	// Gather the unique indices of an indexed draw and build the matching host index buffer. Returns the number of unique vertices
+	u32 buildIndexBuffer(const u8* indexBuffer, u32 indexCount, bool shortIndex);
+
+	// Vertex and index buffers are read straight from FCRAM/VRAM, so anything the GPU rendered to them has to be written back first.
+	// This writes back the part of every attribute buffer that vertices minimumIndex to maximumIndex are fetched from
+	void writeBackVertexBuffers(u32 vertexBase, u32 minimumIndex, u32 maximumIndex);
+
+	// Returns how many threads to shade a draw with, starting the worker threads if needed
+	u32 getShaderWorkerCount(u32 vertexCount);
+
 	// Silly method of avoiding linking problems. TODO: Change to something less silly
 	void drawArrays(bool indexed);
 
+	// Draw with the vertex shader running on the host GPU. Returns false if the draw needs to go through the CPU path instead
+	bool drawArraysAccelerated(bool indexed);
+
+	// Prepare the vertex loader JIT for the current vertex format and fill bufferPointers with the host address of each vertex buffer
+	// Returns false if the vertices need to be fetched by the interpreter instead
+	bool prepareVertexLoader(u32 vertexBase, std::array<const u8*, VertexLoader::maxAttribCount>& bufferPointers);
+
 	struct AttribInfo {
 		u32 offset = 0;  // Offset from base vertex array
 		int size = 0;    // Bytes per vertex
@@ -78,6 +138,12 @@ class GPU {
 	u32* cmdBuffEnd = nullptr;
 	u32* cmdBuffCurr = nullptr;
 
+	// Texture units whose address was written without a type write after it. The type register is the last one a texture update writes, so
+	// units are normally prefetched then, once their format and size are known. Units that only got a new address are prefetched on the
+	// next draw instead
+	u32 pendingTexturePrefetches = 0;
+	void prefetchPendingTextures();
+
 	std::unique_ptr<Renderer> renderer;
 	PICA::Vertex getImmediateModeVertex();
 
@@ -95,10 +161,15 @@ class GPU {
 	bool fogLUTDirty = false;
 	std::array<uint32_t, 128> fogLUT;
 
+	// PICA::DirtyRegs groups with a register that changed value since the renderer last called takeDirtyRegs
+	u32 dirtyRegs = PICA::DirtyRegs::All;
+	u32 takeDirtyRegs() { return std::exchange(dirtyRegs, 0); }
+
 	GPU(Memory& mem, EmulatorConfig& config);
 	void display() { renderer->display(); }
 	void screenshot(const std::string& name) { renderer->screenshot(name); }
 	void deinitGraphicsContext() { renderer->deinitGraphicsContext(); }
+	void loadShaderCache(const std::filesystem::path& directory) { renderer->loadShaderCache(directory); }
 
 #if defined(PANDA3DS_FRONTEND_SDL)
 	void initGraphicsContext(SDL_Window* window) { renderer->initGraphicsContext(window); }
@@ -129,15 +200,26 @@ class GPU {
 
 	// TODO: Emulate the transfer engine & its registers
 	// Then this can be emulated by just writing the appropriate values there
-	void clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) { renderer->clearBuffer(startAddress, endAddress, value, control); }
+	void clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) {
+		if (endAddress > startAddress) {
+			mem.markPhysicalWrite(startAddress, endAddress - startAddress);
+		}
+		renderer->clearBuffer(startAddress, endAddress, value, control);
+	}
 
 	// TODO: Emulate the transfer engine & its registers
 	// Then this can be emulated by just writing the appropriate values there
 	void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) {
+		// The transfer engine writes to guest memory, so let caches of the output know. We don't bother computing the exact output format
+		// and assume 4 bytes per pixel, since a range that's too large only costs a texture re-hash
+		const u32 outputWidth = outputSize & 0xffff;
+		const u32 outputHeight = outputSize >> 16;
+		mem.markPhysicalWrite(outputAddr, u32(std::min<u64>(u64(outputWidth) * outputHeight * 4, Memory::FCRAM_SIZE)));
 		renderer->displayTransfer(inputAddr, outputAddr, inputSize, outputSize, flags);
 	}
 
 	void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {
+		mem.markPhysicalWrite(outputAddr, totalBytes);
 		renderer->textureCopy(inputAddr, outputAddr, totalBytes, inputSize, outputSize, flags);
 	}
 
@@ -173,6 +255,7 @@ class GPU {
 	}
 
 	Renderer* getRenderer() { return renderer.get(); }
+	Memory& getMemory() { return mem; }
   private:
 	// GPU external registers
 	// We have them in the end of the struct for cache locality reasons. Tl;dr we want the more commonly used things to be packed in the start
@@ -190,7 +273,7 @@ class GPU {
 			// See which registers are actually enabled and ignore the disabled ones
 			for (int i = 0; i < 16; i++) {
 				if (val & 1) {
-					vsOutputRegisters[count++] = &shaderUnit.vs.outputs[i][0];
+					vsOutputRegisters[count++] = i;
 				}
 
 				val >>= 1;
@@ -198,7 +281,7 @@ class GPU {
 
 			// For the others, map the index to a vs output directly (TODO: What does hw actually do?)
 			for (; count < 16; count++) {
-				vsOutputRegisters[count] = &shaderUnit.vs.outputs[count][0];
+				vsOutputRegisters[count] = count;
 			}
 		}
 	}
@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstring>
+#include <type_traits>
+
+#include "PICA/pica_hash.hpp"
+#include "PICA/regs.hpp"
+#include "PICA/shader.hpp"
+#include "helpers.hpp"
+
+namespace PICA {
+	// Config used for identifying unique hardware vertex shaders. Two draws with the same config can use the same host vertex shader
+	struct VertexConfig {
+		PICAHash::HashType shaderHash;  // Combined hash of the shader code and operand descriptors
+		u32 entrypoint;
+		u32 outputMask;   // GPUREG_VSH_OUTMAP_MASK, which maps the enabled output registers to the outmap registers
+		u32 outputCount;  // Number of outputs mapped to fixed-function attributes
+		std::array<u32, 7> outmaps;
+		u32 accurateMul;  // Whether to emulate the PICA's 0 * inf = 0 behaviour
+		u32 padding = 0;  // Explicit padding, so that the config can be hashed and compared with memcmp
+
+		bool operator==(const VertexConfig& config) const {
+			// Hash function and equality operator required by std::unordered_map
+			return std::memcmp(this, &config, sizeof(VertexConfig)) == 0;
+		}
+
+		VertexConfig(const std::array<u32, 0x300>& regs, PICAShader& shader, bool accurateMul) : accurateMul(accurateMul ? 1 : 0) {
+			// Same as ShaderJIT::prepare
+			shaderHash = std::rotl(shader.getCodeHash(), 1) ^ shader.getOpdescHash();
+			entrypoint = shader.entrypoint;
+			outputMask = regs[InternalRegs::VertexShaderOutputMask] & 0xffff;
+			outputCount = regs[InternalRegs::ShaderOutputCount] & 7;
+
+			for (int i = 0; i < 7; i++) {
+				outmaps[i] = (u32(i) < outputCount) ? regs[InternalRegs::ShaderOutmap0 + i] : 0;
+			}
+		}
+	};
+
+	static_assert(std::has_unique_object_representations<VertexConfig>());
+}  // namespace PICA
+
+// Override std::hash for our vertex config class
+template <>
+struct std::hash<PICA::VertexConfig> {
+	std::size_t operator()(const PICA::VertexConfig& config) const noexcept { return PICAHash::computeHash((const char*)&config, sizeof(config)); }
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <array>
+
+#include "PICA/regs.hpp"
+#include "colour.hpp"
+#include "helpers.hpp"
+
+// Pixel layout and format helpers for colour buffers in emulated memory, shared by the renderers
+namespace PICA {
+	// Index of pixel (x, y) of a surface stored in 8x8 tiles with its texels in Morton order, where y counts rows in memory order
+	inline u32 tiledPixelIndex(u32 x, u32 y, u32 width) {
+		static constexpr std::array<u32, 8> xOffsets = {0, 1, 4, 5, 16, 17, 20, 21};
+		static constexpr std::array<u32, 8> yOffsets = {0, 2, 8, 10, 32, 34, 40, 42};
+
+		return (y & ~7u) * width + (x & ~7u) * 8 + xOffsets[x & 7] + yOffsets[y & 7];
+	}
+
+	// Convert a pixel between a colour buffer format and RGBA8
+	inline std::array<u8, 4> decodeColour(ColorFmt format, const u8* pixel) {
+		using Helpers::getBit;
+		using Helpers::getBits;
+
+		switch (format) {
+			case ColorFmt::RGBA8: return {pixel[3], pixel[2], pixel[1], pixel[0]};
+			case ColorFmt::RGB8: return {pixel[2], pixel[1], pixel[0], 0xff};
+
+			case ColorFmt::RGBA5551: {
+				const u16 value = u16(pixel[0]) | (u16(pixel[1]) << 8);
+				return {
+					Colour::convert5To8Bit(getBits<11, 5, u8>(value)), Colour::convert5To8Bit(getBits<6, 5, u8>(value)),
+					Colour::convert5To8Bit(getBits<1, 5, u8>(value)), u8(getBit<0>(value) ? 0xff : 0),
+				};
+			}
+
+			case ColorFmt::RGB565: {
+				const u16 value = u16(pixel[0]) | (u16(pixel[1]) << 8);
+				return {
+					Colour::convert5To8Bit(getBits<11, 5, u8>(value)), Colour::convert6To8Bit(getBits<5, 6, u8>(value)),
+					Colour::convert5To8Bit(getBits<0, 5, u8>(value)), 0xff,
+				};
+			}
+
+			case ColorFmt::RGBA4: {
+				const u16 value = u16(pixel[0]) | (u16(pixel[1]) << 8);
+				return {
+					Colour::convert4To8Bit(getBits<12, 4, u8>(value)), Colour::convert4To8Bit(getBits<8, 4, u8>(value)),
+					Colour::convert4To8Bit(getBits<4, 4, u8>(value)), Colour::convert4To8Bit(getBits<0, 4, u8>(value)),
+				};
+			}
+
+			default: return {0, 0, 0, 0};
+		}
+	}
+
+	inline void encodeColour(ColorFmt format, u8* pixel, const std::array<u8, 4>& colour) {
+		const auto [r, g, b, a] = colour;
+		u16 value;
+
+		switch (format) {
+			case ColorFmt::RGBA8:
+				pixel[0] = a;
+				pixel[1] = b;
+				pixel[2] = g;
+				pixel[3] = r;
+				return;
+
+			case ColorFmt::RGB8:
+				pixel[0] = b;
+				pixel[1] = g;
+				pixel[2] = r;
+				return;
+
+			case ColorFmt::RGBA5551: value = u16((r >> 3) << 11 | (g >> 3) << 6 | (b >> 3) << 1 | (a >> 7)); break;
+			case ColorFmt::RGB565: value = u16((r >> 3) << 11 | (g >> 2) << 5 | (b >> 3)); break;
+			case ColorFmt::RGBA4: value = u16((r >> 4) << 12 | (g >> 4) << 8 | (b >> 4) << 4 | (a >> 4)); break;
+			default: return;
+		}
+
+		pixel[0] = u8(value);
+		pixel[1] = u8(value >> 8);
+	}
+}  // namespace PICA
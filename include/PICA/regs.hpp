@@ -28,8 +28,14 @@ namespace PICA {
 			// Texture registers
 			TexUnitCfg = 0x80,
 			Tex0BorderColor = 0x81,
+			Tex0Addr = 0x85,
+			Tex0Type = 0x8E,
 			Tex1BorderColor = 0x91,
+			Tex1Addr = 0x95,
+			Tex1Type = 0x96,
 			Tex2BorderColor = 0x99,
+			Tex2Addr = 0x9D,
+			Tex2Type = 0x9E,
 			TexEnvUpdateBuffer = 0xE0,
 			TexEnvBufferColor = 0xFD,
 
@@ -214,6 +220,47 @@ namespace PICA {
 		};
 	}
 
+	// Groups of internal registers whose changes are tracked by the GPU, so that renderers only re-upload the state that changed
+	namespace DirtyRegs {
+		enum : u32 {
+			Rasterizer = 1 << 0,     // 0x40-0x7F: Viewport, clipping, depth mapping
+			TexUnitConfig = 1 << 1,  // Which texture units are enabled and how texture coordinates are routed to them
+			TexUnits = 1 << 2,       // Addresses, sizes, formats and parameters of the textures
+			TexEnv = 1 << 3,         // TEV stages and the TEV buffer
+			Fog = 1 << 4,            // Fog mode and colour. The fog LUT is tracked by GPU::fogLUTDirty instead
+			FragmentOps = 1 << 5,    // 0x100-0x10F: Alpha test, blending, logic ops, stencil test, depth test and write masks
+			Framebuffer = 1 << 6,    // 0x110-0x13F: Colour and depth buffer addresses, formats and sizes
+			Lighting = 1 << 7,       // Fragment lighting. The lighting LUT is tracked by GPU::lightingLUTDirty instead
+
+			All = (1 << 8) - 1,
+		};
+
+		// Returns the groups that a write to the given register can affect
+		constexpr u32 getGroups(u32 index) {
+			using namespace InternalRegs;
+
+			// These only feed the LUTs, which have their own dirty flags
+			if ((index >= FogLUTIndex && index <= FogLUTData7) || (index >= LightingLUTIndex && index <= LightingLUTData7)) {
+				return 0;
+			}
+
+			// The TEV buffer config register also holds the fog mode
+			if (index == TexEnvUpdateBuffer) return TexEnv | Fog;
+			if (index == LightingEnable) return Lighting;
+			if (index == TexUnitCfg) return TexUnitConfig;
+
+			if (index >= 0x40 && index < 0x80) return Rasterizer;
+			if (index >= 0x80 && index < 0xC0) return TexUnits;
+			if (index >= 0xE0 && index < 0xE8) return Fog;
+			if (index >= 0xC0 && index < 0x100) return TexEnv;
+			if (index >= 0x100 && index < 0x110) return FragmentOps;
+			if (index >= 0x110 && index < 0x140) return Framebuffer;
+			if (index >= 0x140 && index < 0x200) return Lighting;
+
+			return 0;
+		}
+	}  // namespace DirtyRegs
+
 	namespace ExternalRegs {
 		enum : u32 {
 			MemFill1BufferStartPaddr = 0x3,
@@ -90,6 +90,8 @@ namespace PICA::ShaderGen {
 		std::string decompiledShader;
 
 		u32 entrypoint;
+		// Set when we hit an instruction the decompiler doesn't support, in which case the shader needs to run on the CPU instead
+		bool compilationError = false;
 
 		API api;
 		Language language;
@@ -3,6 +3,7 @@
 
 #include "PICA/gpu.hpp"
 #include "PICA/pica_frag_config.hpp"
+#include "PICA/pica_vert_config.hpp"
 #include "PICA/regs.hpp"
 #include "PICA/shader_gen_types.hpp"
 #include "helpers.hpp"
@@ -30,6 +31,8 @@ namespace PICA::ShaderGen {
 		FragmentGenerator(API api, Language language) : api(api), language(language) {}
 		std::string generate(const PICA::FragmentConfig& config);
 		std::string getDefaultVertexShader();
+		// Wrap a vertex shader decompiled by ShaderDecompiler into a host vertex shader that outputs the same varyings as the default one
+		std::string getVertexShaderAccelerated(const std::string& picaSource, const PICA::VertexConfig& vertConfig);
 
 		void setTarget(API api, Language language) {
 			this->api = api;
@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "helpers.hpp"
+
+// A small pool of threads for splitting CPU vertex shading of large draws. The thread that calls run() works on a range of its own,
+// so a pool of N workers only spawns N - 1 threads
+class ShaderWorkerPool {
+  public:
+	// Called once per worker with the worker index and the [begin, end) range it's responsible for
+	using Job = std::function<void(u32 worker, u32 begin, u32 end)>;
+	static constexpr u32 maxWorkerCount = 16;
+
+	ShaderWorkerPool() = default;
+	~ShaderWorkerPool() { stop(); }
+
+	// Spawn workerCount - 1 threads. Restarts the pool if it's already running with a different worker count
+	void start(u32 workerCount);
+	void stop();
+
+	u32 getWorkerCount() const { return u32(threads.size()) + 1; }
+	bool isRunning() const { return !threads.empty(); }
+
+	// Split [0, count) into one contiguous range per worker, run the job on every range and wait for all of them to finish
+	void run(u32 count, const Job& job);
+
+  private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable startCondition;  // Signalled when a new job is submitted or when the pool is stopping
+	std::condition_variable doneCondition;   // Signalled when the last worker finishes its range
+
+	const Job* currentJob = nullptr;
+	u32 jobSize = 0;
+	u64 jobGeneration = 0;  // Incremented for every job, so that workers can tell a new job from a spurious wakeup
+	u32 pendingWorkers = 0;
+	bool stopping = false;
+
+	// lastGeneration is the generation of the last job submitted before the thread was spawned, which the thread must not run
+	void workerLoop(u32 worker, u64 lastGeneration);
+	void runRange(const Job& job, u32 worker, u32 count);
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "PICA/pica_hash.hpp"
+#include "PICA/regs.hpp"
+#include "helpers.hpp"
+
+// Decodes textures on background threads. Renderers queue a texture as soon as its registers are written during command list processing,
+// and only wait for the decoded result when a draw actually binds the texture, overlapping the decode with vertex processing
+class TextureDecodeQueue {
+  public:
+	struct Job {
+		u32 location;
+		PICA::TextureFmt format;
+		u32 width;
+		u32 height;
+		// Memory write stamp at the time the texture data was copied. The owner of the queue is responsible for checking that the data
+		// wasn't overwritten after that before using the result
+		u64 writeStamp;
+
+		std::vector<u8> data;  // Copy of the texture data, so that the guest can't modify it while we're decoding it
+		std::vector<u32> decoded;
+		PICAHash::HashType hash = 0;  // Hash of the texture data, computed along with the decode
+		bool done = false;
+	};
+	using JobPtr = std::shared_ptr<Job>;
+
+	TextureDecodeQueue() = default;
+	~TextureDecodeQueue() { stop(); }
+
+	void start(u32 threadCount);
+	// Stop the worker threads. Jobs that are still in the queue are dropped without being decoded
+	void stop();
+	bool isRunning() const { return !threads.empty(); }
+
+	// Returns whether a job for the given texture is in the queue
+	bool contains(u32 location, PICA::TextureFmt format, u32 width, u32 height);
+	// Copy the texture data and queue it for decoding. Does nothing if a job for the same texture is already queued
+	void submit(u32 location, PICA::TextureFmt format, u32 width, u32 height, u64 writeStamp, std::span<const u8> data);
+	// Remove the job for the given texture from the queue and wait for it to finish. Returns nullptr if there's no such job
+	// If no worker has picked up the job yet, it's decoded on the calling thread instead of waiting
+	JobPtr take(u32 location, PICA::TextureFmt format, u32 width, u32 height);
+	// Remove every job from the queue without waiting for them to finish, eg when they weren't used by any draw in a frame
+	std::vector<JobPtr> takeAll();
+
+  private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;  // Signalled when a job is queued or when the queue is stopping
+	std::condition_variable jobDone;
+
+	std::deque<JobPtr> pendingJobs;        // Jobs that no worker has picked up yet
+	std::unordered_map<u64, JobPtr> jobs;  // All jobs in the queue, whether they're pending, running or done
+	bool stopping = false;
+
+	static u64 getKey(u32 location, PICA::TextureFmt format, u32 width, u32 height) {
+		// Texture dimensions are 11 bits each and the format is 4 bits, so all of them fit in the top half of the key
+		return u64(location) | (u64(format) << 32) | (u64(width) << 36) | (u64(height) << 47);
+	}
+
+	static void decode(Job& job);
+	void workerLoop();
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include <span>
+
+#include "PICA/regs.hpp"
+#include "helpers.hpp"
+
+// Renderer-agnostic decoder for PICA textures
+// PICA textures are split into 8x8 tiles stored in row order, with the texels of each tile stored in Morton (Z-curve) order
+// Instead of computing the swizzled address of every texel, we convert the 64 contiguous texels of a tile at once with SIMD kernels
+// and then write the tile out to its 8 rows. ETC1(A4) blocks are decoded once per 4x4 block
+namespace PICA::TextureDecoder {
+	// Decode a texture to RGBA8, stored as one u32 per texel with red in the lowest byte. Row v of the texture starts at output[v * width]
+	// "input" must hold the whole texture and "output" must hold at least width * height texels
+	// PICA textures are always a multiple of 8 texels wide and tall. Partial tiles are left untouched
+	void decode(TextureFmt format, u32 width, u32 height, std::span<const u8> input, std::span<u32> output);
+
+	// Size in bytes of an 8x8 tile of the given format
+	u32 tileSize(TextureFmt format);
+}  // namespace PICA::TextureDecoder
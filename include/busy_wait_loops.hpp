@@ -0,0 +1,97 @@
+#pragma once
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "arm_defs.hpp"
+#include "helpers.hpp"
+
+// Busy-wait loops found while compiling guest code, keyed by the address of their first instruction.
+// The block that ends in a loop's closing branch makes the JIT exit once it has run, whether the branch was taken or not. This tells apart
+// the two cases from the guest state at that point: if the branch was taken, PC is back at the head of the loop and the flags still pass the
+// branch's condition. If it fell through, PC is right after the branch and the loop is over, so there's nothing to skip
+class BusyWaitLoops {
+	struct Loop {
+		u32 condition;  // Condition code of the closing branch, 0xE if it's unconditional
+		u32 exit;
+	};
+
+	std::unordered_map<u32, Loop> loops;
+	std::unordered_set<u32> exits;  // Addresses right after the closing branch of each loop
+
+	static bool conditionPassed(u32 condition, u32 cpsr) {
+		const bool n = (cpsr & CPSR::Sign) != 0;
+		const bool z = (cpsr & CPSR::Zero) != 0;
+		const bool c = (cpsr & CPSR::Carry) != 0;
+		const bool v = (cpsr & CPSR::Overflow) != 0;
+
+		switch (condition) {
+			case 0x0: return z;
+			case 0x1: return !z;
+			case 0x2: return c;
+			case 0x3: return !c;
+			case 0x4: return n;
+			case 0x5: return !n;
+			case 0x6: return v;
+			case 0x7: return !v;
+			case 0x8: return c && !z;
+			case 0x9: return !c || z;
+			case 0xA: return n == v;
+			case 0xB: return n != v;
+			case 0xC: return !z && n == v;
+			case 0xD: return z || n != v;
+			default: return true;
+		}
+	}
+
+  public:
+	// Register usage of one instruction in a candidate loop. Registers are stored as bitmasks, with bit N representing rN
+	struct InstructionInfo {
+		u32 reads = 0;
+		u32 writes = 0;
+		bool isLoad = false;
+		bool valid = false;
+	};
+
+	// Returns a host pointer to the guest code at an address, or nullptr if it can't be read directly
+	using CodeReader = std::function<const void*(u32)>;
+
+	static InstructionInfo decodeARM(u32 instruction);
+	static InstructionInfo decodeThumb(u16 instruction);
+
+	// Returns whether the instruction at vaddr is a backward branch closing a short loop that only reads memory and compares values,
+	// and adds the loop if so
+	bool detect(bool isThumb, u32 vaddr, u32 instruction, const CodeReader& readCode);
+
+	void add(u32 head, u32 exit, u32 condition) {
+		loops[head] = Loop{.condition = condition, .exit = exit};
+		exits.insert(exit);
+	}
+
+	void clear() {
+		loops.clear();
+		exits.clear();
+	}
+
+	// Forget the loops with code in [start, start + size), for when the JIT recompiles that range. Their code may have changed
+	void invalidate(u32 start, u32 size) {
+		const u64 end = u64(start) + size;
+		std::erase_if(loops, [&](const auto& entry) { return entry.first < end && entry.second.exit > start; });
+
+		exits.clear();
+		for (const auto& [head, loop] : loops) {
+			exits.insert(loop.exit);
+		}
+	}
+
+	// Returns whether the block that just ran took the back-edge of a busy-wait loop, given the guest PC and CPSR after it.
+	// If a loop ends right where another one starts, we can't tell which of the two ran from the PC alone, so we don't skip there
+	bool backEdgeTaken(u32 pc, u32 cpsr) const {
+		auto it = loops.find(pc);
+		if (it == loops.end() || exits.contains(pc)) {
+			return false;
+		}
+
+		return conditionPassed(it->second.condition, cpsr);
+	}
+};
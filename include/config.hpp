@@ -1,5 +1,7 @@
 #pragma once
 #include <filesystem>
+#include <optional>
+#include <unordered_map>
 
 #include "audio/dsp_core.hpp"
 #include "renderer.hpp"
@@ -22,9 +24,22 @@ struct EmulatorConfig {
 #endif
 
 	bool shaderJitEnabled = shaderJitDefault;
+	// Fetch vertices with the vertex loader JIT instead of the interpreter. Experimental, only used together with the shader JIT
+	bool vertexLoaderJitEnabled = false;
 	bool discordRpcEnabled = false;
 	bool useUbershaders = ubershaderDefault;
 	bool accurateShaderMul = false;
+	// Run vertex shaders on the host GPU when the renderer supports it and the shader can be decompiled. Experimental
+	bool accelerateShaders = false;
+
+	// Number of threads used for running vertex shaders on the CPU, including the emulator thread. 0 picks a count based on the host's cores
+	// and 1 disables multithreaded vertex shading. Draws with fewer vertices than the threshold are always shaded on a single thread
+	int vertexShaderThreads = 0;
+	int multithreadedShadingThreshold = 2048;
+	// Decode new textures on background threads as soon as their registers are written, instead of when a draw binds them
+	bool asyncTextureDecode = false;
+	// Host memory the GL renderer may use for cached textures and render targets, in bytes. The least recently used ones are evicted past it
+	u64 surfaceCacheBudget = 512ull * 1024 * 1024;
 
 	// Toggles whether to force shadergen when there's more than N lights active and we're using the ubershader, for better performance
 	bool forceShadergenForLights = true;
@@ -44,6 +59,12 @@ struct EmulatorConfig {
 	bool printAppVersion = true;
 	bool appVersionOnWindow = false;
 
+	// Fast-forward to the next scheduler event when the guest spins in a loop that only polls memory
+	// Off by default, as it can change timing in ways some titles don't expect. Titles it's known to work for are enabled with overrides
+	bool busyWaitSkip = false;
+	// Per-title overrides for busyWaitSkip, keyed by title ID
+	std::unordered_map<u64, bool> busyWaitSkipOverrides;
+
 	bool chargerPlugged = true;
 	// Default to 3% battery to make users suffer
 	int batteryPercentage = 3;
@@ -55,4 +76,14 @@ struct EmulatorConfig {
 	EmulatorConfig(const std::filesystem::path& path);
 	void load();
 	void save();
+
+	bool isBusyWaitSkipEnabled(std::optional<u64> titleID) const {
+		if (titleID.has_value()) {
+			if (auto it = busyWaitSkipOverrides.find(titleID.value()); it != busyWaitSkipOverrides.end()) {
+				return it->second;
+			}
+		}
+
+		return busyWaitSkip;
+	}
 };
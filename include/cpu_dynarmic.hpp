@@ -2,6 +2,8 @@
 
 #include <span>
 
+#include "busy_wait_loops.hpp"
+#include "dynarmic/frontend/A32/a32_ir_emitter.h"
 #include "dynarmic/interface/A32/a32.h"
 #include "dynarmic/interface/A32/config.h"
 #include "dynarmic/interface/exclusive_monitor.h"
@@ -17,11 +19,26 @@ class CPU;
 class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
   public:
 	u64 ticksLeft = 0;
+	u64 skippedCycles = 0;  // Number of cycles skipped thanks to busy-wait loop detection
+	bool skipBusyWaits = false;
+	BusyWaitLoops busyWaitLoops;
+	Dynarmic::A32::Jit* jit = nullptr;  // Used to check where the guest ended up after running a busy-wait loop
 	Memory& mem;
 	Kernel& kernel;
 	Scheduler& scheduler;
 
+	// Backward branches that close a busy-wait loop are charged this many extra cycles, which makes the JIT exit after the block ending in
+	// them. AddTicks recognizes it, and if the branch was taken it skips straight to the next scheduler event instead of spinning through the
+	// loop until then. If the branch fell through, the loop is over and only the regular cycles are counted.
+	static constexpr u64 busyWaitCycles = 1ull << 40;
+
     u64 getCyclesForInstruction(bool isThumb, u32 instruction);
+	// Returns whether the instruction at vaddr is a backward branch closing a short loop that only reads memory and compares values.
+	// Nothing such a loop polls can change until the next scheduler event, as guest threads are only switched on SVCs. Loops that are found
+	// get added to busyWaitLoops
+	bool isBusyWaitLoop(bool isThumb, u32 vaddr, u32 instruction) {
+		return busyWaitLoops.detect(isThumb, vaddr, instruction, [this](u32 address) -> const void* { return mem.getReadPointer(address); });
+	}
 
     u8 MemoryRead8(u32 vaddr) override {
         return mem.read8(vaddr);
@@ -57,13 +74,7 @@ class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
 
     #define makeExclusiveWriteHandler(size) \
     bool MemoryWriteExclusive##size(u32 vaddr, u##size value, u##size expected) override { \
-        u##size current = mem.read##size(vaddr); /* Get current value */                   \
-        if (current == expected) {   /* Perform the write if current == expected */        \
-            mem.write##size(vaddr, value);                                                 \
-            return true; /* Exclusive write succeeded */                                   \
-        }                                                                                  \
-                                                                                           \
-        return false; /* Exclusive write failed */                                         \
+        return mem.exclusiveWrite<u##size>(vaddr, value, expected);                        \
     }
 
     makeExclusiveWriteHandler(8)
@@ -93,6 +104,16 @@ class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
 	}
 
 	void AddTicks(u64 ticks) override {
+		if (ticks >= busyWaitCycles) [[unlikely]] {
+			ticks %= busyWaitCycles;
+
+			// We ran a busy-wait loop. If it's going for another iteration, fast-forward to the next scheduler event
+			if (ticksLeft > ticks && busyWaitLoops.backEdgeTaken(jit->Regs()[15], jit->Cpsr())) {
+				skippedCycles += ticksLeft - ticks;
+				ticks = ticksLeft;
+			}
+		}
+
 		scheduler.currentTimestamp += ticks;
 
 		if (ticks > ticksLeft) {
@@ -107,7 +128,39 @@ class MyEnvironment final : public Dynarmic::A32::UserCallbacks {
 	}
 
 	u64 GetTicksForCode(bool isThumb, u32 vaddr, u32 instruction) override {
-		return getCyclesForInstruction(isThumb, instruction);
+		const u64 cycles = getCyclesForInstruction(isThumb, instruction);
+		if (skipBusyWaits && isBusyWaitLoop(isThumb, vaddr, instruction)) [[unlikely]] {
+			return cycles + busyWaitCycles;
+		}
+
+		return cycles;
+	}
+
+	// Emit a write to CP15's VFP-used flag before every VFP instruction, so that the kernel knows whether a thread's VFP registers need
+	// saving when it's switched out
+	void PreCodeTranslationHook(bool isThumb, u32 vaddr, Dynarmic::A32::IREmitter& ir) override {
+		const void* pointer = mem.getReadPointer(vaddr);
+		if (pointer == nullptr) {
+			return;
+		}
+
+		u32 instruction;
+		if (isThumb) {
+			instruction = *static_cast<const u16*>(pointer);
+			// 32-bit Thumb instructions start with 0b11101, 0b11110 or 0b11111
+			if (instruction >= 0xE800) {
+				const void* second = mem.getReadPointer(vaddr + 2);
+				instruction = (instruction << 16) | (second != nullptr ? *static_cast<const u16*>(second) : 0);
+			}
+		} else {
+			instruction = *static_cast<const u32*>(pointer);
+		}
+
+		if (VFPContext::isVFPInstruction(isThumb, instruction)) {
+			using Dynarmic::A32::CoprocReg;
+			const auto [opc1, opc2] = CP15::vfpUsedEncoding;
+			ir.CoprocSendOneWord(15, false, opc1, CoprocReg::C15, CoprocReg::C15, opc2, ir.Imm32(1));
+		}
 	}
 
 	MyEnvironment(Memory& mem, Kernel& kernel, Scheduler& scheduler) : mem(mem), kernel(kernel), scheduler(scheduler) {}
@@ -144,6 +197,11 @@ class CPU {
 	// Hence why its base type is u32
 	std::span<u32, 32> fprs() { return std::span(jit->ExtRegs()).first<32>(); }
 
+	// Whether the guest ran a VFP instruction since the flag was last cleared. The kernel uses this to skip saving the FPRs of threads that
+	// didn't touch them on context switches
+	bool vfpUsed() { return cp15->getVFPUsed(); }
+	void clearVFPUsed() { cp15->clearVFPUsed(); }
+
     void setCPSR(u32 value) {
         jit->SetCpsr(value);
     }
@@ -180,6 +238,27 @@ class CPU {
 
     void addTicks(u64 ticks) { env.AddTicks(ticks); }
 
-    void clearCache() { jit->ClearCache(); }
+	// Total number of cycles skipped by fast-forwarding through busy-wait loops
+	u64 getSkippedBusyWaitCycles() { return env.skippedCycles; }
+
+	// Toggle busy-wait loop skipping. This affects code generation, so the JIT cache is flushed if the setting changes
+	void setBusyWaitSkip(bool enable) {
+		if (env.skipBusyWaits != enable) {
+			env.skipBusyWaits = enable;
+			jit->ClearCache();
+			env.busyWaitLoops.clear();
+		}
+	}
+
+	void clearCache() {
+		jit->ClearCache();
+		env.busyWaitLoops.clear();
+	}
+
+	// Recompile the code in [start, start + size) next time it runs, eg after patching it
+	void invalidateCacheRange(u32 start, u32 size) {
+		jit->InvalidateCacheRange(start, size);
+		env.busyWaitLoops.invalidate(start, size);
+	}
     void runFrame();
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 
 #include "dynarmic/interface/A32/a32.h"
 #include "dynarmic/interface/A32/config.h"
@@ -14,6 +15,7 @@ class CP15 final : public Dynarmic::A32::Coprocessor {
 
     u32 threadStoragePointer; // Pointer to thread-local storage
     u32 dummy; // MCR writes here for registers whose values are ignored
+    u32 vfpUsed = 0; // Set by the JIT before every VFP instruction, see MyEnvironment::PreCodeTranslationHook
 
     std::optional<Callback> CompileInternalOperation(bool two, unsigned opc1,
         CoprocReg CRd, CoprocReg CRn,
@@ -30,6 +32,10 @@ class CP15 final : public Dynarmic::A32::Coprocessor {
         if (!two && opc1 == 0 && CRn == CoprocReg::C7 && CRm == CoprocReg::C10 && opc2 == 5) {
             return &dummy; // Normally inserts a "Data Memory Barrier"
         }
+
+        if (!two && opc1 == vfpUsedEncoding[0] && CRn == CoprocReg::C15 && CRm == CoprocReg::C15 && opc2 == vfpUsedEncoding[1]) {
+            return &vfpUsed; // Not a real register, only the JIT emits writes to it
+        }
         Helpers::panic("CP15: CompileSendOneWord\nopc1: %d CRn: %d CRm: %d opc2: %d\n", opc1, (int)CRn, (int)CRm, opc2);
     }
 
@@ -62,10 +68,16 @@ class CP15 final : public Dynarmic::A32::Coprocessor {
     }
 
 public:
+    // opc1 and opc2 of the MCR that sets vfpUsed. CRn and CRm are both c15, which the ARM11 doesn't use with these values
+    static constexpr std::array<unsigned, 2> vfpUsedEncoding = {7, 7};
+
     void setTLSBase(u32 value) {
         threadStoragePointer = value;
     }
 
-    // Currently does nothing but may be needed in the future
-    void reset() {}
+    // Whether the running thread executed a VFP instruction since the flag was last cleared
+    bool getVFPUsed() { return vfpUsed != 0; }
+    void clearVFPUsed() { vfpUsed = 0; }
+
+    void reset() { vfpUsed = 0; }
 };
\ No newline at end of file
@@ -68,6 +68,7 @@ class Emulator {
 #endif
 	void setAudioEnabled(bool enable);
 	void updateDiscord();
+	void registerSchedulerCallbacks();
 
 	// Keep the handle for the ROM here to reload when necessary and to prevent deleting it
 	// This is currently only used for ELFs, NCSDs use the IOFile API instead
@@ -13,7 +13,7 @@
 
 #include "helpers.hpp"
 
-enum class HttpActionType { None, Screenshot, Key, TogglePause, Reset, LoadRom, Step };
+enum class HttpActionType { None, Screenshot, Key, TogglePause, Reset, LoadRom, Step, Status };
 
 class Emulator;
 namespace httplib {
@@ -47,6 +47,7 @@ class HttpAction {
 	static std::unique_ptr<HttpAction> createTogglePauseAction();
 	static std::unique_ptr<HttpAction> createResetAction();
 	static std::unique_ptr<HttpAction> createStepAction(DeferredResponseWrapper& response, int frames);
+	static std::unique_ptr<HttpAction> createStatusAction(DeferredResponseWrapper& response);
 };
 
 struct HttpServer {
@@ -71,6 +72,7 @@ struct HttpServer {
 
 	void startHttpServer();
 	void pushAction(std::unique_ptr<HttpAction> action);
+	// Reads emulator state, so it must only be called from the emulator thread, ie from processActions
 	std::string status();
 	u32 stringToKey(const std::string& key_name);
 
@@ -4,6 +4,7 @@
 #include <limits>
 #include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "config.hpp"
@@ -13,6 +14,8 @@
 #include "memory.hpp"
 #include "resource_limits.hpp"
 #include "services/service_manager.hpp"
+#include "thread_queues.hpp"
+#include "vfp_context.hpp"
 
 class CPU;
 struct Scheduler;
@@ -39,10 +42,11 @@ class Kernel {
 	std::vector<KernelObject> objects;
 	std::vector<Handle> portHandles;
 	std::vector<Handle> mutexHandles;
-	std::vector<Handle> timerHandles;
 
-	// Thread indices, sorted by priority
-	std::vector<int> threadIndices;
+	// Threads that are ready to run, bucketed by priority. The running thread and the idle thread are never in here
+	ReadyQueue<appResourceLimits.maxThreads> readyThreads;
+	// Threads that are waiting with a timeout, sorted by the tick they wake up on
+	SleepQueue<appResourceLimits.maxThreads> sleepingThreads;
 
 	Handle currentProcess;
 	Handle mainThread;
@@ -60,6 +64,12 @@ class Kernel {
 
 	// Shows whether a reschedule will be need
 	bool needReschedule = false;
+	// How many times we fast-forwarded time instead of running the idle thread. Used for profiling
+	u64 idleSkipCount = 0;
+	// Context switches in the current frame, and in the last full frame. Used for profiling
+	u64 contextSwitches = 0;
+	u64 contextSwitchesLastFrame = 0;
+	VFPContext::BankSwitcher fprSwitcher;
 
 	Handle makeArbiter();
 	Handle makeProcess(u32 id);
@@ -76,7 +86,7 @@ public:
 	// Needs to be public to be accessible to the service manager port
 	Handle makeSemaphore(u32 initialCount, u32 maximumCount);
 	Handle makeTimer(ResetType resetType);
-	void pollTimers();
+	void fireTimer(Handle timerHandle);
 
 	// Signals an event, returns true on success or false if the event does not exist
 	bool signalEvent(Handle e);
@@ -95,14 +105,16 @@ public:
 	void sleepThread(s64 ns);
 	void sleepThreadOnArbiter(u32 waitingAddress);
 	void switchThread(int newThreadIndex);
-	void sortThreads();
+	void setThreadReady(int index);
+	void setWakeupTick(Thread& t, s64 ns);
+	void wakeupTimedOutThreads();
 	std::optional<int> getNextThread();
 	void rescheduleThreads();
-	bool canThreadRun(const Thread& t);
 	bool shouldWaitOnObject(KernelObject* object);
 	void releaseMutex(Mutex* moo);
 	void cancelTimer(Timer* timer);
 	void signalTimer(Handle timerHandle, Timer* timer);
+	void scheduleTimer(Handle timerHandle, Timer* timer);
 	u64 getWakeupTick(s64 ns);
 
 	// Wake up the thread with the highest priority out of all threads in the waitlist
@@ -205,6 +217,15 @@ public:
 
 	void requireReschedule() { needReschedule = true; }
 
+	// If no thread other than the idle thread can run, advance the scheduler to the next event or thread wakeup instead of executing the
+	// idle thread. Returns true if we skipped ahead, in which case the caller should poll the scheduler instead of running the CPU
+	bool skipIdleTime();
+	u64 getIdleSkipCount() const { return idleSkipCount; }
+
+	u64 getContextSwitchesPerFrame() const { return contextSwitchesLastFrame; }
+	// Latch the per-frame context switch counter. Called by the CPU at the end of every frame
+	void endFrame() { contextSwitchesLastFrame = std::exchange(contextSwitches, 0); }
+
 	void evalReschedule() {
 		if (needReschedule) {
 			needReschedule = false;
@@ -250,4 +271,5 @@ public:
 
 	void sendGPUInterrupt(GPUInterrupt type) { serviceManager.sendGPUInterrupt(type); }
 	void clearInstructionCache();
+	void invalidateInstructionCacheRange(u32 start, u32 size);
 };
\ No newline at end of file
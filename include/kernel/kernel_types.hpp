@@ -5,6 +5,7 @@
 #include "handles.hpp"
 #include "helpers.hpp"
 #include "result/result.hpp"
+#include "scheduler.hpp"
 
 enum class KernelObjectType : u8 {
     AddressArbiter, Archive, Directory, File, MemoryBlock, Process, ResourceLimit, Session, Dummy,
@@ -136,6 +137,7 @@ struct Thread {
 	// Thread context used for switching between threads
 	std::array<u32, 16> gprs;
 	std::array<u32, 32> fprs;  // Stored as u32 because dynarmic does it
+	u64 fprVersion;            // Identifies the contents of "fprs", see VFPContext::BankSwitcher
 	u32 cpsr;
 	u32 fpscr;
 	u32 tlsBase;  // Base pointer for thread-local storage
@@ -192,6 +194,8 @@ struct Timer {
 	u64 interval;      // Number of ns until the timer fires for the second and future times
 	bool fired;        // Has this timer been signalled?
 	bool running;      // Is this timer running or stopped?
+	// Handle of the scheduler event that fires this timer, if it's running
+	Scheduler::EventHandle event = Scheduler::invalidHandle;
 
 	Timer(ResetType type) : resetType(type), fireTick(0), interval(0), waitlist(0), fired(false), running(false) {}
 };
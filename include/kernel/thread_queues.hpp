@@ -0,0 +1,209 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <limits>
+#include <optional>
+
+#include "helpers.hpp"
+
+// Queue of threads that are ready to run, bucketed by priority.
+// Every one of the 64 priority levels has its own FIFO list of threads, and a bitmap tells us which levels are non-empty,
+// so finding the highest priority ready thread is a single count-trailing-zeros (Low priority value = high priority)
+template <usize threadCount>
+class ReadyQueue {
+	static constexpr usize priorityLevels = 64;
+	static constexpr int none = -1;
+
+	u64 nonEmptyLevels = 0;
+	std::array<int, priorityLevels> heads;
+	std::array<int, priorityLevels> tails;
+
+	// Intrusive doubly linked list per priority level, indexed by thread index
+	std::array<int, threadCount> next;
+	std::array<int, threadCount> prev;
+	std::array<u8, threadCount> levels;
+	std::array<bool, threadCount> queued;
+
+	void link(int index, u32 priority, bool atFront) {
+		if (priority >= priorityLevels) [[unlikely]] {
+			Helpers::panic("ReadyQueue: Invalid thread priority %X", priority);
+		}
+
+		if (queued[index]) {
+			remove(index);
+		}
+
+		const int head = heads[priority];
+		const int tail = tails[priority];
+
+		if (head == none) {
+			next[index] = prev[index] = none;
+			heads[priority] = tails[priority] = index;
+		} else if (atFront) {
+			next[index] = head;
+			prev[index] = none;
+			prev[head] = index;
+			heads[priority] = index;
+		} else {
+			next[index] = none;
+			prev[index] = tail;
+			next[tail] = index;
+			tails[priority] = index;
+		}
+
+		levels[index] = u8(priority);
+		queued[index] = true;
+		nonEmptyLevels |= 1ull << priority;
+	}
+
+  public:
+	ReadyQueue() { clear(); }
+
+	void clear() {
+		nonEmptyLevels = 0;
+		heads.fill(none);
+		tails.fill(none);
+		queued.fill(false);
+	}
+
+	// Threads that became ready go to the back of their priority level
+	void pushBack(int index, u32 priority) { link(index, priority, false); }
+	// Threads that got preempted keep their place at the front of their priority level
+	void pushFront(int index, u32 priority) { link(index, priority, true); }
+
+	bool contains(int index) const { return queued[index]; }
+
+	void remove(int index) {
+		if (!queued[index]) {
+			return;
+		}
+
+		const u32 priority = levels[index];
+		if (prev[index] != none) {
+			next[prev[index]] = next[index];
+		} else {
+			heads[priority] = next[index];
+		}
+
+		if (next[index] != none) {
+			prev[next[index]] = prev[index];
+		} else {
+			tails[priority] = prev[index];
+		}
+
+		if (heads[priority] == none) {
+			nonEmptyLevels &= ~(1ull << priority);
+		}
+		queued[index] = false;
+	}
+
+	// Returns the index of the highest priority ready thread, without removing it from the queue
+	std::optional<int> front() const {
+		if (nonEmptyLevels == 0) {
+			return std::nullopt;
+		}
+
+		return heads[std::countr_zero(nonEmptyLevels)];
+	}
+};
+
+// Threads sleeping with a timeout, in a binary min-heap keyed by the tick they wake up on
+template <usize threadCount>
+class SleepQueue {
+	static constexpr int none = -1;
+
+	struct Entry {
+		u64 wakeupTick;
+		int index;
+	};
+
+	std::array<Entry, threadCount> heap;
+	std::array<int, threadCount> positions;  // Position of each thread in the heap, or none if it's not sleeping
+	usize size = 0;
+
+	void place(usize position, const Entry& entry) {
+		heap[position] = entry;
+		positions[entry.index] = int(position);
+	}
+
+	void siftUp(usize position) {
+		const Entry entry = heap[position];
+		while (position > 0) {
+			const usize parent = (position - 1) / 2;
+			if (heap[parent].wakeupTick <= entry.wakeupTick) {
+				break;
+			}
+
+			place(position, heap[parent]);
+			position = parent;
+		}
+
+		place(position, entry);
+	}
+
+	void siftDown(usize position) {
+		const Entry entry = heap[position];
+		while (true) {
+			usize child = position * 2 + 1;
+			if (child >= size) {
+				break;
+			}
+
+			if (child + 1 < size && heap[child + 1].wakeupTick < heap[child].wakeupTick) {
+				child++;
+			}
+
+			if (entry.wakeupTick <= heap[child].wakeupTick) {
+				break;
+			}
+
+			place(position, heap[child]);
+			position = child;
+		}
+
+		place(position, entry);
+	}
+
+  public:
+	SleepQueue() { clear(); }
+
+	void clear() {
+		size = 0;
+		positions.fill(none);
+	}
+
+	bool empty() const { return size == 0; }
+	bool contains(int index) const { return positions[index] != none; }
+
+	// Tick the first sleeping thread wakes up on, or UINT64_MAX if no thread is sleeping
+	u64 nextWakeupTick() const { return empty() ? std::numeric_limits<u64>::max() : heap[0].wakeupTick; }
+	// Index of the first thread to wake up. Must not be called on an empty queue
+	int front() const { return heap[0].index; }
+
+	void push(int index, u64 wakeupTick) {
+		remove(index);
+		size++;
+		place(size - 1, Entry{.wakeupTick = wakeupTick, .index = index});
+		siftUp(size - 1);
+	}
+
+	void remove(int index) {
+		if (positions[index] == none) {
+			return;
+		}
+
+		const usize position = usize(positions[index]);
+		positions[index] = none;
+		size--;
+
+		if (position != size) {
+			// Move the last entry into the hole, then restore the heap property in whichever direction it's broken
+			place(position, heap[size]);
+			if (position > 0 && heap[position].wakeupTick < heap[(position - 1) / 2].wakeupTick) {
+				siftUp(position);
+			} else {
+				siftDown(position);
+			}
+		}
+	}
+};
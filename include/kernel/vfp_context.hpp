@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstring>
+#include <span>
+
+#include "helpers.hpp"
+
+// Lazy switching of the VFP register bank between threads
+// Most threads never touch the VFP, so copying all 32 registers in and out of the CPU on every context switch is mostly wasted work.
+// Dynarmic can't trap VFP accesses, so instead the JIT sets a flag before every VFP instruction it runs (see isVFPInstruction), which tells
+// us whether the thread being switched out may have changed the live registers. Every bank that gets saved is given a new version number,
+// and a bank is only loaded if the live registers hold a different version
+namespace VFPContext {
+	// Returns whether an instruction is in the coprocessor space of the VFP (coprocessors 10 and 11). For Thumb, "instruction" is a 32-bit
+	// instruction with its first halfword in the top 16 bits. This includes VFP instructions that don't write any VFP register, such as VSTR
+	inline bool isVFPInstruction(bool isThumb, u32 instruction) {
+		const bool vfpCoprocessor = ((instruction >> 9) & 7) == 5;
+
+		if (isThumb) {
+			// Coprocessor instructions start with 111x11
+			return (instruction & 0xEC000000) == 0xEC000000 && vfpCoprocessor;
+		}
+
+		// Coprocessor loads and stores, data processing and register transfers
+		const bool coprocessorSpace = ((instruction >> 25) & 7) == 6 || ((instruction >> 24) & 0xF) == 0xE;
+		return coprocessorSpace && vfpCoprocessor;
+	}
+
+	// Version of an all-zero bank, which is what every thread starts with
+	static constexpr u64 zeroVersion = 0;
+
+	class BankSwitcher {
+		static constexpr u64 unknownVersion = ~0ull;
+
+		// Version of the bank the live registers hold. Unless the running thread used the VFP, it's the version of that thread's bank
+		u64 liveVersion = unknownVersion;
+		u64 lastVersion = zeroVersion;
+
+	  public:
+		// The live registers may hold anything after a reset, so the next switch loads them
+		void reset() {
+			liveVersion = unknownVersion;
+			lastVersion = zeroVersion;
+		}
+
+		// Switch the live registers from the bank of one thread to the bank of another. "used" tells whether the old thread ran a VFP
+		// instruction since it was switched in. Returns whether the new thread's bank had to be loaded
+		bool switchBanks(
+			std::span<u32, 32> live, bool used, std::array<u32, 32>& oldBank, u64& oldVersion, const std::array<u32, 32>& newBank, u64 newVersion
+		) {
+			if (used) {
+				std::memcpy(oldBank.data(), live.data(), live.size_bytes());
+				oldVersion = ++lastVersion;
+				liveVersion = oldVersion;
+			}
+
+			if (newVersion == liveVersion) {
+				return false;
+			}
+
+			std::memcpy(live.data(), newBank.data(), live.size_bytes());
+			liveVersion = newVersion;
+			return true;
+		}
+	};
+}  // namespace VFPContext
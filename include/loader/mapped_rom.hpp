@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+#include "helpers.hpp"
+#include "loader/ncch.hpp"
+#include "memory_mapped_file.hpp"
+
+class Memory;
+
+// Read-only memory mapping of the loaded CCI/CXI, used to serve RomFS reads straight from the page cache of the host OS.
+// Unencrypted sections are copied from the mapping to guest memory directly, without an intermediate buffer or a syscall per read.
+// Encrypted sections are decrypted into a page-granular cache the first time each page is read, and served from there afterwards.
+// The cache holds up to maxCachedPages pages, evicting the least recently used page when it's full.
+class MappedROM {
+	static constexpr u64 cachePageSize = 0x1000;
+	static constexpr usize maxCachedPages = 4096;  // 16MB of decrypted data
+
+	struct DecryptedPage {
+		u64 fileOffset;
+		std::unique_ptr<u8[]> data;
+	};
+
+	MemoryMappedFile file;
+	// Decrypted pages from the most to the least recently used, and an index of them keyed by the file offset they start on.
+	// Pages are aligned relative to the start of their section, so a page never straddles 2 sections with different keys
+	std::list<DecryptedPage> decryptedPages;
+	std::unordered_map<u64, std::list<DecryptedPage>::iterator> pageIndex;
+
+	// AES-CTR decryptor, kept around so that the key is only set up again when we switch to a section with a different key
+	struct Decryptor;
+	std::unique_ptr<Decryptor> decryptor;
+
+	const u8* getDecryptedPage(const NCCH::FSInfo& info, u64 page);
+
+  public:
+	MappedROM();
+	~MappedROM();
+
+	bool open(const std::filesystem::path& path);
+	void close();
+	bool isOpen() const { return file.exists(); }
+
+	// Read "size" bytes from "offset" into the section described by "info" to guest memory at "vaddr", clamped to the section size
+	// Returns the number of bytes read, or nullopt if the ROM isn't mapped or the read lies outside the file, in which case the caller
+	// should fall back to NCCH::readFromFile
+	std::optional<u64> readToGuest(Memory& mem, u32 vaddr, const NCCH::FSInfo& info, u64 offset, u64 size);
+};
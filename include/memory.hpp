@@ -1,8 +1,11 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -10,6 +13,7 @@
 #include "crypto/aes_engine.hpp"
 #include "handles.hpp"
 #include "helpers.hpp"
+#include "loader/mapped_rom.hpp"
 #include "loader/ncsd.hpp"
 #include "loader/3dsx.hpp"
 #include "services/region_codes.hpp"
@@ -140,11 +144,118 @@ public:
 	static constexpr u32 DSP_CODE_MEMORY_OFFSET = u32(0_KB);
 	static constexpr u32 DSP_DATA_MEMORY_OFFSET = u32(256_KB);
 
+	// Page table handed to the CPU JIT so that it can access guest memory directly instead of going through our memory callbacks
+	// Only pages that are mapped as both readable and writable point to host memory. Everything else (read-only pages, config memory, VRAM)
+	// is null, which makes the JIT fall back to the callbacks
+	using PageTable = std::array<u8*, totalPageCount>;
+
 private:
+	std::unique_ptr<PageTable> fastmemTable;
 	std::bitset<FCRAM_PAGE_COUNT> usedFCRAMPages;
 	std::optional<u32> findPaddr(u32 size);
 	u64 timeSince3DSEpoch();
 
+	// Tracking of guest writes to the physical memory the GPU caches resources (eg textures) from, at page granularity
+	// Tracked pages are numbered with the VRAM pages first, followed by the FCRAM pages
+	static constexpr u32 VRAM_PAGE_COUNT = VirtualAddrs::VramSize / pageSize;
+	static constexpr u32 TRACKED_PAGE_COUNT = VRAM_PAGE_COUNT + FCRAM_PAGE_COUNT;
+
+	u64 writeStamp = 0;                // Incremented on every write to a watched page
+	std::vector<u64> pageWriteStamps;  // Value of writeStamp at the last write to each tracked page
+	std::vector<u16> pageWatchCounts;  // Number of cached GPU resources backed by each tracked page
+	// Virtual pages that map each FCRAM page, so that we can take watched pages out of the fastmem table
+	std::vector<std::vector<u32>> fcramPageMappings;
+
+	// Pages whose latest contents are in a GPU surface (eg a render target) instead of memory. They're left out of the fastmem table, and the
+	// first access to one of them through the Memory class has the GPU write its data back before the access goes ahead
+	std::vector<u8> pageGPUOwned;
+	u32 gpuOwnedPageCount = 0;
+	std::function<void(u32 paddr, u32 size)> gpuWriteBack;
+
+	// Index of the tracked page containing physical address paddr, or nullopt if it's neither in VRAM nor FCRAM
+	static std::optional<u32> getTrackedPage(u32 paddr) {
+		if (paddr >= PhysicalAddrs::VRAM && paddr <= PhysicalAddrs::VRAMEnd) {
+			return (paddr - PhysicalAddrs::VRAM) >> pageShift;
+		} else if (paddr >= PhysicalAddrs::FCRAM && paddr <= PhysicalAddrs::FCRAMEnd) {
+			return VRAM_PAGE_COUNT + ((paddr - PhysicalAddrs::FCRAM) >> pageShift);
+		}
+
+		return std::nullopt;
+	}
+
+	// Stamp a tracked page as written. Stamps are only compared for pages backing a cached GPU resource, which watches them from the moment
+	// it's created, so pages nobody watches are left alone. This keeps the many stores to them from touching the stamp array
+	void stampPage(u32 page) {
+		if (pageWatchCounts[page] != 0) [[unlikely]] {
+			pageWriteStamps[page] = ++writeStamp;
+		}
+	}
+
+	// Stamp the FCRAM page starting at host address "pointer" as written. Pointers outside of FCRAM are ignored
+	void stampHostPage(uintptr_t pointer) {
+		const uintptr_t offset = pointer - uintptr_t(fcram);
+		if (offset < FCRAM_SIZE) {
+			stampPage(VRAM_PAGE_COUNT + u32(offset >> pageShift));
+		}
+	}
+
+	bool isHostPageWatched(uintptr_t pointer) const {
+		const uintptr_t offset = pointer - uintptr_t(fcram);
+		if (offset >= FCRAM_SIZE) {
+			return false;
+		}
+
+		const u32 page = VRAM_PAGE_COUNT + u32(offset >> pageShift);
+		return pageWatchCounts[page] != 0 || pageGPUOwned[page] != 0;
+	}
+
+	// Hand a tracked page back from the GPU to the CPU, writing back the GPU's data for it if the GPU owns it
+	void writeBackTrackedPage(u32 page);
+
+	// Same as above, for the FCRAM page starting at host address "pointer". Pointers outside of FCRAM are ignored
+	void writeBackHostPage(uintptr_t pointer) {
+		if (gpuOwnedPageCount == 0) [[likely]] {
+			return;
+		}
+
+		const uintptr_t offset = pointer - uintptr_t(fcram);
+		if (offset < FCRAM_SIZE) {
+			writeBackTrackedPage(VRAM_PAGE_COUNT + u32(offset >> pageShift));
+		}
+	}
+
+	void writeBackVRAMPage(u32 vaddr) {
+		if (gpuOwnedPageCount != 0) [[unlikely]] {
+			writeBackTrackedPage((vaddr - VirtualAddrs::VramStart) >> pageShift);
+		}
+	}
+
+	// Remember that virtual page "page" maps the host page "pointer", if that's an FCRAM page
+	void addFCRAMMapping(u32 page, uintptr_t pointer);
+
+	// Refresh the fastmem entry of a page after its read or write table entry has changed
+	// Watched pages are left out of the fastmem table, so that CPU writes to them go through our write callbacks and get tracked
+	void updateFastmemPage(u32 page) {
+		const uintptr_t pointer = readTable[page];
+		const bool direct = pointer == writeTable[page] && !isHostPageWatched(pointer);
+		(*fastmemTable)[page] = direct ? reinterpret_cast<u8*>(pointer) : nullptr;
+	}
+
+	// Call "func" with the index of every tracked page overlapping [paddr, paddr + size)
+	template <typename Func>
+	void forEachTrackedPage(u32 paddr, u32 size, Func func) {
+		if (size == 0) {
+			return;
+		}
+
+		const u64 end = u64(paddr) + size;
+		for (u64 address = paddr & ~pageMask; address < end; address += pageSize) {
+			if (auto page = getTrackedPage(u32(address)); page.has_value()) {
+				func(page.value());
+			}
+		}
+	}
+
 	// https://www.3dbrew.org/wiki/Configuration_Memory#ENVINFO
 	// Report a retail unit without JTAG
 	static constexpr u32 envInfo = 1;
@@ -176,6 +287,12 @@ private:
 	void reset();
 	void* getReadPointer(u32 address);
 	void* getWritePointer(u32 address);
+	// Writes through a pointer from getWritePointer bypass the write tracking, so they have to be reported with this
+	void markPointerWrite(u32 address) {
+		if (const uintptr_t pointer = writeTable[address >> pageShift]; pointer != 0) {
+			stampHostPage(pointer);
+		}
+	}
 	std::optional<u32> loadELF(std::ifstream& file);
 	std::optional<u32> load3DSX(const std::filesystem::path& path);
 	std::optional<NCSD> loadNCSD(Crypto::AESEngine& aesEngine, const std::filesystem::path& path);
@@ -195,8 +312,68 @@ private:
 	void write32(u32 vaddr, u32 value);
 	void write64(u32 vaddr, u64 value);
 
+	// Guest exclusive writes (STREX & co). Performed as a host compare-exchange directly on the memory backing the address.
+	// We only fall back to a read-compare-write through the memory handlers for addresses that aren't directly mapped
+	template <typename T>
+	bool exclusiveWrite(u32 vaddr, T value, T expected) {
+		T* pointer = static_cast<T*>(getWritePointer(vaddr));
+
+		// Exclusive accesses must be naturally aligned, so this should always be the case in practice
+		if (pointer != nullptr && (vaddr & (sizeof(T) - 1)) == 0) [[likely]] {
+			const bool success = std::atomic_ref<T>(*pointer).compare_exchange_strong(expected, value);
+			// Stamp the page so that the GPU's caches see stores to watched memory, like they do for regular writes
+			if (success) {
+				markPointerWrite(vaddr);
+			}
+			return success;
+		}
+
+		T current;
+		if constexpr (sizeof(T) == 1) current = read8(vaddr);
+		else if constexpr (sizeof(T) == 2) current = read16(vaddr);
+		else if constexpr (sizeof(T) == 4) current = read32(vaddr);
+		else current = read64(vaddr);
+
+		if (current != expected) {
+			return false;  // Exclusive write failed
+		}
+
+		if constexpr (sizeof(T) == 1) write8(vaddr, value);
+		else if constexpr (sizeof(T) == 2) write16(vaddr, value);
+		else if constexpr (sizeof(T) == 4) write32(vaddr, value);
+		else write64(vaddr, value);
+		return true;
+	}
+
+	// Bulk transfers between host and guest memory. These walk the page table a page at a time and memcpy each chunk,
+	// falling back to the 8-bit accessors for pages that aren't directly mapped (eg VRAM or config memory)
+	void copyToGuest(u32 vaddr, const void* data, usize size);
+	void copyFromGuest(void* data, u32 vaddr, usize size);
+	void fillGuest(u32 vaddr, u8 value, usize size);
+
+	// Write tracking for the GPU's caches, using physical addresses. While a range is watched, every write to it through the
+	// Memory class, including CPU writes, advances the write stamp of its pages. Hardware writes (eg DMA) are reported via markPhysicalWrite
+	// Writes that bypass the Memory class entirely (eg raw FCRAM pointers handed to the DSP) are not tracked
+	void watchPhysicalRange(u32 paddr, u32 size);
+	void unwatchPhysicalRange(u32 paddr, u32 size);
+	void markPhysicalWrite(u32 paddr, u32 size);
+	u64 getWriteStamp() const { return writeStamp; }
+	// Returns whether any page overlapping [paddr, paddr + size) was written to after getWriteStamp() returned "stamp". Writes to the range
+	// are only seen while it's watched, so it has to be watched from before "stamp" was taken
+	bool writtenSince(u32 paddr, u32 size, u64 stamp);
+
+	// Lazy write-back of GPU surfaces. The GPU marks the memory backing a surface it renders to as GPU-owned instead of copying the surface
+	// back after every draw. The first access to a GPU-owned page through the Memory class calls the write-back callback with the physical
+	// address and size of that page, which must copy the GPU's data for it to memory. Only the pages that are accessed are written back
+	void setGPUWriteBackCallback(std::function<void(u32 paddr, u32 size)> callback) { gpuWriteBack = std::move(callback); }
+	void markGPUOwned(u32 paddr, u32 size);
+	// Write back the GPU-owned pages overlapping [paddr, paddr + size), for accesses that don't go through the Memory class (eg DMA)
+	void writeBackGPUOwned(u32 paddr, u32 size);
+	bool hasGPUOwnedPages() const { return gpuOwnedPageCount != 0; }
+
 	u32 getLinearHeapVaddr();
 	u8* getFCRAM() { return fcram; }
+	PageTable* getFastmemTable() { return fastmemTable.get(); }
 
 	// Total amount of OS-only FCRAM available (Can vary depending on how much FCRAM the app requests via the cart exheader)
 	u32 totalSysFCRAM() {
@@ -285,6 +462,8 @@ private:
 	std::optional<HB3DSX> loaded3DSX = std::nullopt;
 	// File handle for reading the loaded ncch
 	IOFile CXIFile;
+	// Read-only memory mapping of the loaded ncch, used for fast RomFS reads. Reads go through CXIFile if mapping the file failed
+	MappedROM CXIMapping;
 
 	std::optional<u64> getProgramID();
 
@@ -11,13 +11,18 @@
 class MemoryMappedFile {
 	std::filesystem::path filePath = "";  // path of our file
 	mio::mmap_sink map;                   // mmap sink for our file
+	mio::mmap_source readOnlyMap;         // mmap source for files opened in read-only mode
 
 	u8* pointer = nullptr;  // Pointer to the contents of the memory mapped file
+	usize fileSize = 0;
 	bool opened = false;
+	bool readOnly = false;
 
   public:
 	bool exists() const { return opened; }
+	// For files opened in read-only mode, the data must not be written to
 	u8* data() const { return pointer; }
+	usize size() const { return fileSize; }
 
 	std::error_code flush();
 	MemoryMappedFile();
@@ -26,6 +31,7 @@ class MemoryMappedFile {
 	~MemoryMappedFile();
 	// Returns true on success
 	bool open(const std::filesystem::path& path);
+	bool openReadOnly(const std::filesystem::path& path);
 	void close();
 
 	// TODO: For memory-mapped output files we'll need some more stuff such as a constructor that takes path/size/shouldCreate as parameters
@@ -1,9 +1,11 @@
 #pragma once
 #include <array>
+#include <filesystem>
 #include <span>
 #include <string>
 #include <optional>
 
+#include "PICA/draw_acceleration.hpp"
 #include "PICA/pica_vertex.hpp"
 #include "PICA/regs.hpp"
 #include "helpers.hpp"
@@ -22,6 +24,7 @@ enum class RendererType : s8 {
 
 struct EmulatorConfig;
 class GPU;
+class ShaderUnit;
 struct SDL_Window;
 
 class Renderer {
@@ -64,6 +67,23 @@ class Renderer {
 	virtual void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) = 0;  // Perform display transfer
 	virtual void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) = 0;
 	virtual void drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) = 0;  // Draw the given vertices
+	// Draw an indexed primitive made of unique post-transform vertices. By default, this expands the indices and calls drawVertices
+	virtual void drawVerticesIndexed(PICA::PrimType primType, std::span<const PICA::Vertex> vertices, std::span<const u16> indices);
+
+	// Hardware vertex shading. prepareForDraw is called before each draw when it's enabled, and returns whether the renderer can run the
+	// current vertex shader itself. If so, the GPU gathers the raw vertex data and calls drawVerticesAccelerated instead of running the
+	// shader on the CPU. If the vertex data can't be gathered, it falls back to drawVertices
+	virtual bool prepareForDraw(ShaderUnit& shaderUnit) { return false; }
+	virtual void drawVerticesAccelerated(PICA::PrimType primType, const PICA::DrawAcceleration& accel) {}
+
+	// Called when the address or format of a texture unit is written to, so that the renderer can start decoding the texture in the
+	// background before a draw binds it
+	virtual void prefetchTexture(u32 unit) {}
+	// Called after a ROM is loaded with a directory for that title, where the renderer can persist compiled shaders and pipelines
+	virtual void loadShaderCache(const std::filesystem::path& directory) {}
+	// Copy what the renderer's surfaces hold for [paddr, paddr + size) back to emulated memory. Called on the first access to memory that
+	// the renderer marked with Memory::markGPUOwned
+	virtual void writeBackSurfaces(u32 paddr, u32 size) {}
 
 	virtual void screenshot(const std::string& name) = 0;
 	// Some frontends and platforms may require that we delete our GL or misc context and obtain a new one for things like exclusive fullscreen
@@ -3,19 +3,24 @@
 #include <array>
 #include <cstring>
 #include <functional>
+#include <optional>
 #include <span>
 #include <unordered_map>
 
 #include "PICA/float_types.hpp"
 #include "PICA/pica_frag_config.hpp"
 #include "PICA/pica_hash.hpp"
+#include "PICA/pica_vert_config.hpp"
 #include "PICA/pica_vertex.hpp"
 #include "PICA/regs.hpp"
 #include "PICA/shader_gen.hpp"
+#include "PICA/texture_decode_queue.hpp"
 #include "gl_state.hpp"
 #include "helpers.hpp"
 #include "logger.hpp"
 #include "renderer.hpp"
+#include "renderer_gl/shader_disk_cache.hpp"
+#include "renderer_gl/stream_buffer.hpp"
 #include "surface_cache.hpp"
 #include "textures.hpp"
 
@@ -29,9 +34,29 @@ class RendererGL final : public Renderer {
 	OpenGL::Program displayProgram;
 
 	OpenGL::VertexArray vao;
-	OpenGL::VertexBuffer vbo;
+	// Ring buffers that the vertices and indices of draws with CPU-shaded vertices are streamed to. Both are bound to vao
+	// Indices are rebased to where their vertices were written in the vertex stream, so they're stored as 32-bit
+	StreamBuffer vertexStream;
+	StreamBuffer indexStream;
+	static constexpr usize vertexStreamSize = 2 * vertexBufferSize * sizeof(PICA::Vertex);
+	static constexpr usize indexStreamSize = 4 * vertexBufferSize * sizeof(u32);
 	bool enableUbershader = true;
 
+	// Consecutive draws of CPU-shaded triangle lists with the same state are merged into one host draw. The vertices or indices of the
+	// draws in a batch are next to each other in their stream, and the draw is issued by flushDraws before anything else touches GL state
+	struct DrawBatch {
+		bool indexed;
+		usize first;       // First vertex in the vertex stream, or for indexed batches the first index in the index stream
+		GLsizei count;     // Number of vertices, or indices for indexed batches
+		GLuint minVertex;  // Range of vertices that the indices of an indexed batch point to
+		GLuint maxVertex;
+		u64 writeStamp;    // Memory::getWriteStamp() when the batch was started, so that writes to textures it samples end it
+	};
+	std::optional<DrawBatch> pendingBatch;
+	bool renderTargetFeedback = false;  // Set if the current draw samples the colour buffer it renders to
+	u64 picaDraws = 0;                  // Draws of CPU-shaded vertices, counting each merged draw
+	u64 hostDraws = 0;                  // GL draws those were issued as
+
 	// Data 
 	struct {
 		// TEV configuration uniform locations
@@ -50,13 +75,24 @@ class RendererGL final : public Renderer {
 		GLint depthmapEnableLoc = -1;
 	} ubershaderData;
 
+	// PICA::DirtyRegs groups that changed since the state derived from them was last updated. The groups taken from the GPU before each
+	// draw are added to all of these, and each piece of state clears its own mask once it's up to date
+	u32 ubershaderRegsDirty = PICA::DirtyRegs::All;
+	u32 fragmentUniformsDirty = PICA::DirtyRegs::All;
+	u32 fragmentConfigDirty = PICA::DirtyRegs::All;
+	// Fragment config of the current draw, only rebuilt when the registers it's made of change
+	std::optional<PICA::FragmentConfig> fragmentConfig;
+
 	float oldDepthScale = -1.0;
 	float oldDepthOffset = 0.0;
 	bool oldDepthmapEnable = false;
 
-	SurfaceCache<DepthBuffer, 16, true> depthBufferCache;
-	SurfaceCache<ColourBuffer, 16, true> colourBufferCache;
-	SurfaceCache<Texture, 256, true> textureCache;
+	SurfaceCache<DepthBuffer> depthBufferCache;
+	SurfaceCache<ColourBuffer> colourBufferCache;
+	SurfaceCache<Texture> textureCache;
+	// Background texture decoding (EmulatorConfig::asyncTextureDecode). Textures are queued when their registers are written, and the
+	// memory of a queued texture is watched until its job is claimed, so that we can tell whether the decoded data is still valid
+	TextureDecodeQueue textureDecodeQueue;
 
 	// Dummy VAO/VBO for blitting the final output
 	OpenGL::VertexArray dummyVAO;
@@ -66,6 +102,11 @@ class RendererGL final : public Renderer {
 	OpenGL::Texture LUTTexture;
 	OpenGL::Framebuffer screenFramebuffer;
 	OpenGL::Texture blankTexture;
+
+	// Render targets that are sampled as textures are copied to the texture on the GPU, through this framebuffer
+	OpenGL::Framebuffer textureCopyFramebuffer;
+	u64 renderTargetWrites = 0;       // Source of ColourBuffer::renderStamp
+	std::vector<u32> writeBackPixels;  // Pixels read back from a surface that's being written back to memory
 	// The "default" vertex shader to use when using specialized shaders but not PICA vertex shader -> GLSL recompilation
 	// We can compile this once and then link it with all other generated fragment shaders
 	OpenGL::Shader defaultShadergenVs;
@@ -74,12 +115,63 @@ class RendererGL final : public Renderer {
 	// Cached recompiled fragment shader
 	struct CachedProgram {
 		OpenGL::Program program;
+		// Set while the driver is compiling and linking the program in the background. The program can't be used until it's done
+		bool compiling = false;
+		std::string source;  // Fragment shader source of a program being compiled, to save it to the disk cache once it's linked
 	};
 	std::unordered_map<PICA::FragmentConfig, CachedProgram> shaderCache;
+	static constexpr uint shadergenFragmentUBOBinding = 2;
+
+	// Programs of the current title saved by previous runs. Entries read from disk are linked a few per frame, or as soon as a draw needs them
+	ShaderDiskCache shaderDiskCache;
+	std::unordered_map<PICA::FragmentConfig, ShaderDiskCache::Entry> preloadedShaders;
+	bool programBinarySupported = false;
+
+	// With GL_KHR_parallel_shader_compile, programs that forceShadergenForLights needs are compiled by the driver's threads, and draws use
+	// the ubershader until they're ready instead of stalling on the compile
+	bool parallelShaderCompileSupported = false;
+	u64 ubershaderFallbackDraws = 0;  // Draws that used the ubershader because their specialized program was still compiling
+
+	// Hardware vertex shading (EmulatorConfig::accelerateShaders). Vertex data and indices are streamed to these buffers for every draw
+	// The uniform buffer holds the float, integer and boolean uniforms of the PICA vertex shader (96 vec4s + 1 uvec4 + 1 uint in std140)
+	static constexpr GLsizeiptr hwShaderUniformSize = 96 * 16 + 16 + 16;
+	static constexpr uint hwShaderUniformBinding = 1;
+	OpenGL::VertexArray hwShaderVAO;
+	GLuint hwVertexBuffer = 0;
+	GLuint hwIndexBuffer = 0;
+	GLuint hwShaderUniformUBO = 0;
+
+	// Decompiled PICA vertex shaders. Shaders that can't be decompiled are cached as empty shaders, so we don't retry them on every draw
+	std::unordered_map<PICA::VertexConfig, OpenGL::Shader> vertexShaderCache;
+	// Programs linking a decompiled vertex shader with a shadergen fragment shader, keyed by the hashes of both configs
+	std::unordered_map<PICAHash::HashType, CachedProgram> hwShaderProgramCache;
+	// Vertex shader for the current draw and the hash of its config, set by prepareForDraw
+	OpenGL::Shader* hwVertexShader = nullptr;
+	PICAHash::HashType hwVertexShaderHash = 0;
 
 	OpenGL::Framebuffer getColourFBO();
 	OpenGL::Texture getTexture(Texture& tex);
-	OpenGL::Program& getSpecializedShader();
+	// Texture bound to a texture unit as configured by the PICA registers, or nullopt if the unit has no texture or an invalid format
+	std::optional<Texture> getUnitTexture(u32 unit);
+	// Claim the background decode job of a texture. Returns nullptr if there is none, or if the texture was written to after it was queued
+	TextureDecodeQueue::JobPtr takeDecodeJob(Texture& tex);
+	void discardDecodeJobs();
+	// Split EmulatorConfig::surfaceCacheBudget between the texture, colour buffer and depth buffer caches
+	void setSurfaceCacheBudget();
+	// Returns the specialized program for the current draw. If allowAsync is set, programs that aren't ready yet are compiled in the
+	// background and nullptr is returned until they're linked, so that the caller can fall back to the ubershader
+	OpenGL::Program* getSpecializedShader(bool hwVertexShading, bool allowAsync);
+	void updateDirtyRegs();
+	const PICA::FragmentConfig& getFragmentConfig();
+	void uploadFragmentUniforms(const PICA::FragmentConfig& fsConfig);
+	void startAsyncLink(CachedProgram& programEntry, std::string source);
+	// Returns whether the program of an entry that's being compiled in the background is done, finishing its setup if so
+	bool pollAsyncLink(CachedProgram& programEntry, const PICA::FragmentConfig& config);
+	// Set up the sampler and uniform block bindings of a newly linked shadergen program
+	void initShadergenProgram(OpenGL::Program& program, bool hwVertexShading);
+	void preloadShaders();
+	void linkCachedProgram(OpenGL::Program& program, const PICA::FragmentConfig& config, const ShaderDiskCache::Entry& entry);
+	void saveProgramToDiskCache(OpenGL::Program& program, const PICA::FragmentConfig& config, const std::string& source);
 
 	PICA::ShaderGen::FragmentGenerator fragShaderGen;
 
@@ -87,15 +179,42 @@ class RendererGL final : public Renderer {
 	void setupBlending();
 	void setupStencilTest(bool stencilEnable);
 	void bindDepthBuffer();
+	// Record that the GPU wrote to a surface. Its memory is marked as GPU-owned, so that it's written back if the CPU accesses it
+	// Returns the colour buffer, which stays valid until the next surface is added to the cache
+	ColourBuffer* markColourBufferWritten(u32 addr);
+	void markDepthBufferWritten(DepthBuffer& buffer);
+	// Start reading back a colour buffer that was the output of a transfer, if the CPU has accessed it before
+	void prefetchColourBuffer(ColourBuffer& buffer);
+	// Get the texture for a render target with the same location, width and format as "tex", copying the render target to it if needed
+	OpenGL::Texture getTextureFromColourBuffer(Texture& tex, ColourBuffer& buffer);
+	void writeBackColourBuffer(ColourBuffer& buffer, u32 paddr, u32 size);
+	void writeBackDepthBuffer(DepthBuffer& buffer, u32 paddr, u32 size);
+	// Add a surface to its cache, loading its contents from memory
+	ColourBuffer& addColourBuffer(ColourBuffer sampleBuffer);
+	DepthBuffer& addDepthBuffer(DepthBuffer sampleBuffer);
+	// Load whatever was written to a cached surface's memory since its writeStamp into its texture
+	void syncColourBuffer(ColourBuffer& buffer);
+	void syncDepthBuffer(DepthBuffer& buffer);
+	// Returns the rows of a surface that hold the pages written since "stamp", after writing back the GPU's data for the rest of them
+	std::pair<u32, u32> getRowsToLoad(u32 location, u32 width, u32 height, u32 bytesPerPixel, bool linear, u64 stamp);
+	void loadColourBufferRows(ColourBuffer& buffer, u32 firstRow, u32 rowCount);
+	void loadDepthBufferRows(DepthBuffer& buffer, u32 firstRow, u32 rowCount);
 	void setupUbershaderTexEnv();
 	void bindTexturesToSlots();
 	void updateLightingLUT();
 	void updateFogLUT();
 	void initGraphicsContextInternal();
 
+	bool usingUbershader();
+	// Whether a draw can be added to the pending batch instead of setting up the draw state again
+	bool canMergeDraw(PICA::PrimType primType, usize vertexBytes, usize indexBytes, bool indexed);
+	// Issue the pending batch. Anything that changes GL state or reads surfaces must call this first
+	void flushDraws();
+	// Bind the GL program and set up the pipeline state for a draw. Shared between CPU and hardware vertex shading
+	void setupDrawState(bool hwVertexShading);
+
   public:
-	RendererGL(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
-		: Renderer(gpu, internalRegs, externalRegs), fragShaderGen(PICA::ShaderGen::API::GL, PICA::ShaderGen::Language::GLSL) {}
+	RendererGL(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs);
 	~RendererGL() override;
 
 	void reset() override;
@@ -105,6 +224,12 @@ class RendererGL final : public Renderer {
 	void displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) override;  // Perform display transfer
 	void textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) override;
 	void drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) override;             // Draw the given vertices
+	void drawVerticesIndexed(PICA::PrimType primType, std::span<const PICA::Vertex> vertices, std::span<const u16> indices) override;
+	bool prepareForDraw(ShaderUnit& shaderUnit) override;
+	void drawVerticesAccelerated(PICA::PrimType primType, const PICA::DrawAcceleration& accel) override;
+	void prefetchTexture(u32 unit) override;
+	void loadShaderCache(const std::filesystem::path& directory) override;
+	void writeBackSurfaces(u32 paddr, u32 size) override;
 	void deinitGraphicsContext() override;
 
 	virtual bool supportsShaderReload() override { return true; }
@@ -120,6 +245,14 @@ class RendererGL final : public Renderer {
 	void resetStateManager() { gl.reset(); }
 	void clearShaderCache();
 	void initUbershader(OpenGL::Program& program);
+	u64 getUbershaderFallbackDraws() const { return ubershaderFallbackDraws; }
+	// Draws of CPU-shaded vertices and the number of host draws they were merged into. Their ratio is the average batch size
+	u64 getPicaDraws() const { return picaDraws; }
+	u64 getHostDraws() const { return hostDraws; }
+
+	const SurfaceCache<Texture>& getTextureCache() const { return textureCache; }
+	const SurfaceCache<ColourBuffer>& getColourBufferCache() const { return colourBufferCache; }
+	const SurfaceCache<DepthBuffer>& getDepthBufferCache() const { return depthBufferCache; }
 
 #ifdef PANDA3DS_FRONTEND_QT
 	virtual void initGraphicsContext([[maybe_unused]] GL::Context* context) override { initGraphicsContextInternal(); }
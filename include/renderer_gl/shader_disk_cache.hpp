@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <filesystem>
+#include <future>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "PICA/pica_frag_config.hpp"
+#include "helpers.hpp"
+#include "io_file.hpp"
+
+// On-disk cache of the shadergen programs of a title, so that we don't need to compile every fragment shader again on the next boot
+// The file starts with a header identifying the driver and emulator version the programs were built with, followed by one record per
+// program holding its fragment config, its GLSL source and, if the driver supports program binaries, its binary
+// Records are appended as new programs get compiled, so the cache survives the emulator being closed at any point
+class ShaderDiskCache {
+  public:
+	struct Entry {
+		std::array<u8, sizeof(PICA::FragmentConfig)> config;
+		std::string source;
+		u32 binaryFormat = 0;
+		std::vector<u8> binary;  // Empty if program binaries aren't supported
+
+		PICA::FragmentConfig getConfig() const;
+	};
+
+	~ShaderDiskCache() { close(); }
+
+	// Start reading the cache file at "path" on a background thread. Files written with a different driver ID are discarded
+	// driverID should identify everything that makes program binaries incompatible, such as the GL vendor, renderer and version strings
+	void open(const std::filesystem::path& path, const std::string& driverID);
+	void close();
+	bool isOpen() const { return opened; }
+
+	// Returns the entries read from disk once the background load is done. Returns an empty vector while loading, and on later calls
+	std::vector<Entry> takeLoadedEntries();
+	// Add a program to the cache. Programs added while the file is still being loaded are written once loading is done
+	void append(const PICA::FragmentConfig& config, const std::string& source, u32 binaryFormat, std::span<const u8> binary);
+
+  private:
+	static constexpr u32 magic = 0x43534E50;  // "PNSC"
+	static constexpr u32 formatVersion = 1;
+
+	std::filesystem::path path;
+	IOFile file;  // Opened for appending once loading is done
+	bool opened = false;
+
+	std::future<std::vector<Entry>> loader;
+	std::vector<Entry> pendingWrites;
+
+	// Read every valid entry in the file. If the header doesn't match, the file is recreated with a new header, and if the file ends with a
+	// truncated record (eg because the emulator was killed while writing it), the record is cut off so we can keep appending after it
+	static std::vector<Entry> load(const std::filesystem::path& path, const std::string& driverID);
+	void write(const Entry& entry);
+	void finishLoading();
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <vector>
+
+#include "helpers.hpp"
+#include "opengl.hpp"
+
+// Ring buffer for data that's uploaded to the GPU for every draw, such as CPU-shaded vertices
+// If the driver supports buffer storage (GL 4.4, ARB_buffer_storage or EXT_buffer_storage on GLES), the buffer is mapped once with
+// GL_MAP_PERSISTENT_BIT and written to directly. The ring is split into segments, and each segment gets a fence once the draws reading it are
+// issued, which we wait on before writing to the segment again on the next lap. Otherwise, data is uploaded with glBufferSubData, and the
+// buffer is orphaned whenever it wraps around
+class StreamBuffer {
+	static constexpr usize segmentCount = 8;
+
+	GLenum target = GL_ARRAY_BUFFER;
+	GLuint m_handle = 0;
+	usize size = 0;
+	usize segmentSize = 0;
+	usize position = 0;  // Offset right after the last committed data
+
+	u8* mappedPointer = nullptr;  // Persistent mapping of the whole buffer, or nullptr if buffer storage isn't supported
+	std::vector<u8> staging;      // Space handed out by map() when the buffer isn't persistently mapped
+
+	// Persistent mode only. Segments [0, enteredSegments) were written to on this lap of the ring, and the bits of "unfencedSegments" are the
+	// segments written to since they last got a fence. A fence may be shared by several segments
+	usize enteredSegments = 0;
+	u32 unfencedSegments = 0;
+	std::array<GLsync, segmentCount> fences = {};
+
+	static usize alignUp(usize value, usize alignment) { return (value + alignment - 1) / alignment * alignment; }
+	void releaseFence(usize segment);
+	void fenceSegments(u32 mask);
+
+  public:
+	struct Allocation {
+		u8* pointer;
+		usize offset;  // Offset of the allocation in the GL buffer
+	};
+
+	// Create the buffer and bind it to "target". Element array buffers should be created while the VAO they're for is bound
+	// Any previous buffer is forgotten rather than deleted, as it belongs to a context that may be gone by now
+	void create(GLenum target, usize size);
+	void free();
+
+	GLuint handle() const { return m_handle; }
+	bool exists() const { return m_handle != 0; }
+	bool isPersistent() const { return mappedPointer != nullptr; }
+
+	// Returns whether "bytes" bytes aligned to "alignment" fit after the data committed so far. If they don't, the next map() call wraps
+	// around to the start of the buffer, so every draw reading from the buffer must be issued before calling it
+	bool fits(usize bytes, usize alignment) const { return alignUp(position, alignment) + bytes <= size; }
+
+	// Returns space for "bytes" bytes at an offset aligned to "alignment". The data has to be written to the returned pointer, and then
+	// committed before the next map() call. The buffer must be bound to its target
+	Allocation map(usize bytes, usize alignment);
+	void commit(const Allocation& allocation, usize bytes);
+
+	// Call once the draws reading the data committed so far have been issued, so that the segments they read from aren't overwritten before
+	// the GPU is done with them
+	void fence();
+};
@@ -1,13 +1,21 @@
 #pragma once
+#include <algorithm>
 #include <functional>
+#include <list>
 #include <optional>
+#include <set>
+#include <vector>
+
+#include "boost/icl/interval_map.hpp"
 #include "surfaces.hpp"
 #include "textures.hpp"
 
-// Surface cache class that can fit "capacity" instances of the "SurfaceType" class of surfaces
+// Surface cache class for the "SurfaceType" class of surfaces
+// Surfaces are indexed by the range of 3DS memory they occupy, so finding the surfaces at an address is a logarithmic lookup instead of a scan
+// When adding a surface would take the host memory used by the cache over its budget, the least recently used surfaces are evicted
+// The owner can set a callback that sees every surface before the cache drops it, eg to write back what the GPU rendered to it
 // SurfaceType *must* have all of the following.
-// - An "allocate" function that allocates GL resources for the surfaces. On overflow it will panic
-//   if evictOnOverflow is false, or kick out the oldest item if it is true (like a ring buffer)
+// - An "allocate" function that allocates GL resources for the surfaces
 // - A "free" function that frees up all resources the surface is taking up
 // - A "matches" function that, when provided with a SurfaceType object reference
 // Will tell us if the 2 surfaces match (Only as far as location in VRAM, format, dimensions, etc)
@@ -15,95 +23,197 @@
 // Including equality of the allocated OpenGL resources, which we don't want
 // - A "valid" member that tells us whether the function is still valid or not
 // - A "location" member which tells us which location in 3DS memory this surface occupies
-template <typename SurfaceType, size_t capacity, bool evictOnOverflow = false>
+// - A "range" member with the interval of 3DS memory the surface occupies, and a "size" member with its dimensions
+template <typename SurfaceType>
 class SurfaceCache {
-    // Vanilla std::optional can't hold actual references
-    using OptionalRef = std::optional<std::reference_wrapper<SurfaceType>>;
-    static_assert(std::is_same<SurfaceType, ColourBuffer>() || std::is_same<SurfaceType, DepthBuffer>()  ||
-        std::is_same<SurfaceType, Texture>(), "Invalid surface type");
-
-    size_t size;
-    size_t evictionIndex;
-    std::array<SurfaceType, capacity> buffer;
-
-public:
-    void reset() {
-        size = 0;
-        evictionIndex = 0;
-        for (auto& e : buffer) { // Free the VRAM of all surfaces
-            e.free();
-        }
-    }
-
-    OptionalRef find(SurfaceType& other) {
-        for (auto& e : buffer) {
-            if (e.matches(other) && e.valid)
-                return e;
-        }
-
-        return std::nullopt;
-    }
-
-    OptionalRef findFromAddress(u32 address) {
-        for (auto& e : buffer) {
-            if (e.location <= address && e.location + e.sizeInBytes() > address && e.valid)
-                return e;
-        }
-
-        return std::nullopt;
-    }
-
-    // Adds a surface object to the cache and returns it
-	SurfaceType& add(const SurfaceType& surface) {
-		if (size >= capacity) {
-			if constexpr (evictOnOverflow) {  // Do a ring buffer if evictOnOverflow is true
-				if constexpr (std::is_same<SurfaceType, ColourBuffer>() || std::is_same<SurfaceType, DepthBuffer>()) {
-					Helpers::panicDev("Colour/Depth buffer cache overflowed, currently stubbed to do a ring-buffer. This might snap in half");
-				}
-
-				auto& e = buffer[evictionIndex];
-				evictionIndex = (evictionIndex + 1) % capacity;
-
-				e.valid = false;
-				e.free();
-				e = surface;
-				e.allocate();
-				return e;
-			} else {
-				Helpers::panic("Surface cache full! Add emptying!");
+	// Vanilla std::optional can't hold actual references
+	using OptionalRef = std::optional<std::reference_wrapper<SurfaceType>>;
+	struct Entry;
+	using EntryList = std::list<Entry>;
+
+	struct Entry {
+		SurfaceType surface;
+		typename EntryList::iterator self;  // Position of the entry in the LRU list, so that we can move it to the front on a hit
+		u64 lastUse;                        // Picks the most recently used surface when several of them cover an address
+	};
+
+	// Entries sorted from most to least recently used. A list keeps references to surfaces stable when other surfaces are added or evicted
+	EntryList entries;
+	// Maps ranges of 3DS memory to the entries that overlap them
+	using Index = boost::icl::interval_map<
+		u32, std::set<Entry*>, boost::icl::partial_absorber, std::less, boost::icl::inplace_plus, boost::icl::inter_section, Interval<u32>>;
+	Index index;
+
+	usize budget = 0;  // In bytes. 0 means there's no limit
+	usize usedBytes = 0;
+	u64 useCounter = 0;
+
+	u64 hits = 0;
+	u64 misses = 0;
+	u64 evictions = 0;
+
+	std::function<void(SurfaceType&)> removeCallback;
+
+	// Host memory taken up by a surface. Every surface type is backed by a texture with 32 bits per pixel
+	static usize hostSize(const SurfaceType& surface) { return usize(surface.size[0]) * usize(surface.size[1]) * 4; }
+
+	// The range a surface is indexed by. Empty ranges are widened to 1 byte, as the index drops empty intervals
+	static Interval<u32> indexRange(const SurfaceType& surface) {
+		const u32 lower = surface.range.lower();
+		return Interval<u32>(lower, std::max(surface.range.upper(), lower + 1));
+	}
+
+	SurfaceType& touch(Entry& entry) {
+		entry.lastUse = ++useCounter;
+		entries.splice(entries.begin(), entries, entry.self);
+		return entry.surface;
+	}
+
+	void remove(Entry& entry) {
+		// Called while the surface is still in the cache, so that it can be found by the callback
+		if (removeCallback) {
+			removeCallback(entry.surface);
+		}
+
+		index -= std::make_pair(indexRange(entry.surface), std::set<Entry*>{&entry});
+		usedBytes -= hostSize(entry.surface);
+
+		entry.surface.valid = false;
+		entry.surface.free();
+		entries.erase(entry.self);
+	}
+
+	// Returns the most recently used valid entry overlapping the address that satisfies the predicate, or nullptr if there's none
+	template <typename Pred>
+	Entry* lookup(u32 address, Pred pred) {
+		auto it = index.find(address);
+		if (it == index.end()) {
+			return nullptr;
+		}
+
+		Entry* result = nullptr;
+		for (Entry* e : it->second) {
+			if (e->surface.valid && pred(e->surface) && (result == nullptr || e->lastUse > result->lastUse)) {
+				result = e;
 			}
 		}
 
-		size++;
+		return result;
+	}
+
+	// Returns every entry overlapping the range, once each
+	std::vector<Entry*> overlapping(const Interval<u32>& range) {
+		std::vector<Entry*> result;
+		auto [begin, end] = index.equal_range(range);
+		for (auto it = begin; it != end; ++it) {
+			result.insert(result.end(), it->second.begin(), it->second.end());
+		}
+
+		std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+		return result;
+	}
+
+  public:
+	SurfaceCache() = default;
+	SurfaceCache(const SurfaceCache&) = delete;
+	SurfaceCache& operator=(const SurfaceCache&) = delete;
+
+	void reset() {
+		for (auto& e : entries) {  // Free the VRAM of all surfaces
+			e.surface.free();
+		}
+
+		entries.clear();
+		index.clear();
+		usedBytes = 0;
+		useCounter = 0;
+		hits = misses = evictions = 0;
+	}
+
+	// Set the most host memory the cache's surfaces may take up, in bytes. Surfaces over the budget are evicted when the next one is added
+	void setBudget(usize bytes) { budget = bytes; }
+	usize getBudget() const { return budget; }
+	// Set a function to call with every surface the cache evicts or replaces with a new one, before the surface is freed. It isn't called on reset
+	void setRemoveCallback(std::function<void(SurfaceType&)> callback) { removeCallback = std::move(callback); }
+	usize getUsedBytes() const { return usedBytes; }
+	usize getSurfaceCount() const { return entries.size(); }
+
+	u64 getHits() const { return hits; }
+	u64 getMisses() const { return misses; }
+	u64 getEvictions() const { return evictions; }
+
+	OptionalRef find(SurfaceType& other) {
+		Entry* entry = lookup(other.location, [&](SurfaceType& surface) { return surface.matches(other); });
+		if (entry == nullptr) {
+			misses++;
+			return std::nullopt;
+		}
+
+		hits++;
+		return touch(*entry);
+	}
 
-		// Find an existing surface we completely invalidate and overwrite it with the new surface
-		for (auto& e : buffer) {
-			if (e.valid && e.range.lower() >= surface.range.lower() && e.range.upper() <= surface.range.upper()) {
-				e.free();
-				e = surface;
-				e.allocate();
-				return e;
+	OptionalRef findFromAddress(u32 address) {
+		Entry* entry = lookup(address, [](SurfaceType&) { return true; });
+		if (entry == nullptr) {
+			misses++;
+			return std::nullopt;
+		}
+
+		hits++;
+		return touch(*entry);
+	}
+
+	// Lookups for internal bookkeeping, eg checking whether a texture is a render target. Unlike find/findFromAddress, these don't count towards
+	// the hit and miss statistics and don't mark the surface as used
+	OptionalRef probe(SurfaceType& other) {
+		Entry* entry = lookup(other.location, [&](SurfaceType& surface) { return surface.matches(other); });
+		return entry != nullptr ? OptionalRef(entry->surface) : std::nullopt;
+	}
+
+	OptionalRef probeAddress(u32 address) {
+		Entry* entry = lookup(address, [](SurfaceType&) { return true; });
+		return entry != nullptr ? OptionalRef(entry->surface) : std::nullopt;
+	}
+
+	// Call "func" with every valid surface overlapping [address, address + size), from the least to the most recently used one
+	template <typename Func>
+	void forEachOverlapping(u32 address, u32 size, Func func) {
+		std::vector<Entry*> surfaces = overlapping(Interval<u32>(address, address + std::max<u32>(size, 1)));
+		std::sort(surfaces.begin(), surfaces.end(), [](const Entry* a, const Entry* b) { return a->lastUse < b->lastUse; });
+
+		for (Entry* e : surfaces) {
+			if (e->surface.valid) {
+				func(e->surface);
 			}
 		}
+	}
 
-		// Find an invalid entry in the cache and overwrite it with the new surface
-		for (auto& e : buffer) {
-			if (!e.valid) {
-				e = surface;
-				e.allocate();
-				return e;
+	// Adds a surface object to the cache and returns it
+	SurfaceType& add(const SurfaceType& surface) {
+		const Interval<u32> range = indexRange(surface);
+
+		// Existing surfaces that the new surface completely covers are overwritten by it, so drop them
+		for (Entry* e : overlapping(range)) {
+			if (e->surface.range.lower() >= surface.range.lower() && e->surface.range.upper() <= surface.range.upper()) {
+				remove(*e);
 			}
 		}
 
-		// This should be unreachable but helps to panic anyways
-		Helpers::panic("Couldn't add surface to cache\n");
-	}
+		// Make room for the new surface by evicting the least recently used ones
+		const usize size = hostSize(surface);
+		while (budget != 0 && !entries.empty() && usedBytes + size > budget) {
+			remove(entries.back());
+			evictions++;
+		}
 
-    SurfaceType& operator[](size_t i) {
-        return buffer[i];
-    }
+		Entry& entry = entries.emplace_front(Entry{.surface = surface, .lastUse = ++useCounter});
+		entry.self = entries.begin();
+		entry.surface.allocate();
 
-    const SurfaceType& operator[](size_t i) const {
-        return buffer[i];
-    }
+		index += std::make_pair(range, std::set<Entry*>{&entry});
+		usedBytes += size;
+		return entry.surface;
+	}
 };
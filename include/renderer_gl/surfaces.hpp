@@ -3,6 +3,7 @@
 #include "boost/icl/interval.hpp"
 #include "helpers.hpp"
 #include "math_util.hpp"
+#include "memory.hpp"
 #include "opengl.hpp"
 
 template <typename T>
@@ -19,6 +20,22 @@ struct ColourBuffer {
 	// OpenGL resources allocated to buffer
 	OpenGL::Texture texture;
 	OpenGL::Framebuffer fbo;
+	// Bumped every time the GPU writes to the buffer, so that textures copied from it know when they're out of date. 0 if it never has
+	u64 renderStamp = 0;
+	bool linear = false;  // Stored in memory as rows of pixels instead of 8x8 tiles, like the output of most display transfers
+
+	// Memory::getWriteStamp() when the texture last held everything written to the buffer's memory. The memory is watched while the buffer
+	// is cached, and what was written to it since then is loaded into the texture before the GPU uses the buffer again
+	u64 writeStamp = 0;
+	Memory* watchedMemory = nullptr;
+
+	// Once the CPU has accessed the buffer's memory, transfers to the buffer start reading it back to readbackBuffer in the background, so
+	// that the next access doesn't have to wait for the GPU. readbackStamp is the renderStamp of the data being read back
+	bool cpuAccessed = false;
+	bool readbackUsed = false;
+	GLuint readbackBuffer = 0;
+	GLsync readbackFence = nullptr;
+	u64 readbackStamp = 0;
 
 	ColourBuffer() : valid(false) {}
 
@@ -51,7 +68,7 @@ struct ColourBuffer {
 			Helpers::warn("ColourBuffer: Incomplete framebuffer");
 		}
 
-		// TODO: This should not clear the framebuffer contents. It should load them from VRAM.
+		// Start from a known state, the renderer loads the buffer's contents from memory once it's in the cache
 		GLint oldViewport[4];
 		GLfloat oldClearColour[4];
 
@@ -68,10 +85,25 @@ struct ColourBuffer {
 	void free() {
 		valid = false;
 
+		if (watchedMemory != nullptr) {
+			watchedMemory->unwatchPhysicalRange(location, u32(sizeInBytes()));
+			watchedMemory = nullptr;
+		}
+
 		if (texture.exists() || fbo.exists()) {
 			texture.free();
 			fbo.free();
 		}
+
+		if (readbackFence != nullptr) {
+			glDeleteSync(readbackFence);
+			readbackFence = nullptr;
+		}
+
+		if (readbackBuffer != 0) {
+			glDeleteBuffers(1, &readbackBuffer);
+			readbackBuffer = 0;
+		}
 	}
 
 	Math::Rect<u32> getSubRect(u32 inputAddress, u32 width, u32 height) {
@@ -103,6 +135,9 @@ struct DepthBuffer {
 	// OpenGL texture used for storing depth/stencil
 	OpenGL::Texture texture;
 	OpenGL::Framebuffer fbo;
+	bool gpuWritten = false;  // Whether the GPU has written to the buffer, ie whether it has anything worth writing back to memory
+	u64 writeStamp = 0;       // Same as ColourBuffer::writeStamp
+	Memory* watchedMemory = nullptr;
 
 	DepthBuffer() : valid(false) {}
 
@@ -160,6 +195,11 @@ struct DepthBuffer {
 
 	void free() {
 		valid = false;
+		if (watchedMemory != nullptr) {
+			watchedMemory->unwatchPhysicalRange(location, u32(sizeInBytes()));
+			watchedMemory = nullptr;
+		}
+
 		if (texture.exists()) {
 			texture.free();
 		}
@@ -1,6 +1,7 @@
 #pragma once
 #include <array>
 #include <string>
+#include "PICA/pica_hash.hpp"
 #include "PICA/regs.hpp"
 #include "boost/icl/interval.hpp"
 #include "helpers.hpp"
@@ -10,6 +11,8 @@
 template <typename T>
 using Interval = boost::icl::right_open_interval<T>;
 
+class Memory;
+
 struct Texture {
     u32 location;
     u32 config; // Magnification/minification filter, wrapping configs, etc
@@ -22,6 +25,14 @@ struct Texture {
     // OpenGL resources allocated to buffer
     OpenGL::Texture texture;
 
+    // Hash of the texture data we last decoded, and the memory write stamp at the time we last verified it
+    // If the texture's pages are written to after that, we re-hash the data and only re-decode if the hash changed
+    PICAHash::HashType hash = 0;
+    u64 writeStamp = 0;
+    Memory* watchedMemory = nullptr;  // Memory that tracks writes to the texture for us, if any
+    // renderStamp of the colour buffer the texture was last copied from, or 0 if it was decoded from memory
+    u64 renderStamp = 0;
+
     Texture() : valid(false) {}
 
     Texture(u32 loc, PICA::TextureFmt format, u32 x, u32 y, u32 config, bool valid = true)
@@ -42,24 +53,16 @@ struct Texture {
     void allocate();
     void setNewConfig(u32 newConfig);
     void decodeTexture(std::span<const u8> data);
+    // Upload already decoded RGBA8 texels to the texture
+    void upload(std::span<const u32> texels);
     void free();
     u64 sizeInBytes();
 
-    u32 decodeTexel(u32 u, u32 v, PICA::TextureFmt fmt, std::span<const u8> data);
-
-    // Get the morton interleave offset of a texel based on its U and V values
-    static u32 mortonInterleave(u32 u, u32 v);
-    // Get the byte offset of texel (u, v) in the texture
-    static u32 getSwizzledOffset(u32 u, u32 v, u32 width, u32 bytesPerPixel);
-    static u32 getSwizzledOffset_4bpp(u32 u, u32 v, u32 width);
+    // Start tracking guest writes to the texture's memory. Tracking stops when the texture is freed
+    void watch(Memory& mem);
 
     // Returns the format of this texture as a string
     std::string_view formatToString() {
         return PICA::textureFormatToString(format);
     }
-
-    // Returns the texel at coordinates (u, v) of an ETC1(A4) texture
-    // TODO: Make hasAlpha a template parameter
-    u32 getTexelETC(bool hasAlpha, u32 u, u32 v, u32 width, std::span<const u8> data);
-    u32 decodeETC(u32 alpha, u32 u, u32 v, u64 colourData);
 };
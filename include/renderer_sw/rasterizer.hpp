@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "PICA/pica_vertex.hpp"
+#include "PICA/regs.hpp"
+#include "PICA/shader_worker_pool.hpp"
+#include "helpers.hpp"
+
+// Tile-binned software rasterizer for the PICA fragment pipeline
+// Triangles are clipped and set up as soon as they're submitted, then sorted into bins of binSize x binSize pixels. Nothing is drawn until
+// flush(), which rasterizes the bins in parallel. Each bin draws its triangles in submission order and bins are made of whole 8x8
+// framebuffer tiles, so no two bins touch the same memory and the result is the same as drawing every triangle in order on one thread
+// Fragment lighting and fog aren't implemented yet: the lighting TEV sources read as 0 and fog is skipped
+class SoftwareRasterizer {
+  public:
+	static constexpr u32 binShift = 5;
+	static constexpr u32 binSize = 1 << binShift;
+	// Flush automatically once this many triangles are pending, to keep the memory used by the bins bounded
+	static constexpr usize maxPendingTriangles = 64 * 1024;
+
+	// A colour buffer and its depth buffer in emulated memory, stored in 8x8 tiles with the top row of the image first
+	struct Framebuffer {
+		u8* colour = nullptr;
+		PICA::ColorFmt colourFormat = PICA::ColorFmt::RGBA8;
+		u8* depth = nullptr;  // Null if the draw has no depth buffer
+		PICA::DepthFmt depthFormat = PICA::DepthFmt::Depth16;
+		u32 width = 0;
+		u32 height = 0;
+
+		bool operator==(const Framebuffer& other) const = default;
+	};
+
+	// A decoded texture, shared by every draw that samples it
+	struct Texture {
+		u32 width = 0;
+		u32 height = 0;
+		std::vector<u32> texels;  // RGBA8 with red in the lowest byte, laid out the way PICA::TextureDecoder outputs it
+	};
+	using TexturePtr = std::shared_ptr<const Texture>;
+
+	// Fixed-function state of a draw, captured from the PICA registers when the draw is submitted
+	struct DrawState {
+		// Source, operand, combiner, constant colour and scale registers of each TEV stage
+		std::array<std::array<u32, 5>, 6> texEnv;
+		u32 texEnvBufferColour;
+		u32 texEnvUpdateBuffer;
+		u32 texUnitConfig;
+
+		std::array<TexturePtr, 3> textures;  // Filled in by the owner of the rasterizer. Null for disabled units
+		std::array<u32, 3> textureParams;    // Filtering and wrapping modes
+		std::array<u32, 3> textureBorderColours;
+
+		u32 colourOperation;
+		u32 blendFunc;
+		u32 logicOp;
+		u32 blendColour;
+		u32 alphaTest;
+		u32 stencilTest;
+		u32 stencilOp;
+		u32 depthColourMask;
+		bool depthStencilWrite;
+
+		float depthScale;
+		float depthOffset;
+		bool wBuffer;
+
+		float viewportX, viewportY;
+		float viewportHalfWidth, viewportHalfHeight;
+		bool clipEnable;
+		std::array<float, 4> clipPlane;
+
+		static DrawState fromRegs(const std::array<u32, 0x300>& regs);
+	};
+
+	SoftwareRasterizer() = default;
+
+	void start(u32 workerCount) { workers.start(workerCount); }
+	void stop() { workers.stop(); }
+
+	// Set the framebuffer that the following draws render to. Pending draws are flushed first if it's different from the current one
+	void setFramebuffer(const Framebuffer& fb);
+	const Framebuffer& getFramebuffer() const { return framebuffer; }
+
+	void submitTriangles(const DrawState& state, PICA::PrimType primType, std::span<const PICA::Vertex> vertices);
+	// Rasterize every pending triangle. Must be called before anything else reads or writes the framebuffer's memory
+	void flush();
+	// Drop pending triangles without drawing them, eg when the emulator is reset
+	void discard();
+	bool hasPendingDraws() const { return !triangles.empty(); }
+
+  private:
+	// Colour followed by the 3 texture coordinates
+	static constexpr usize attributeCount = 10;
+
+	struct ClipVertex {
+		std::array<float, 4> position;
+		std::array<float, attributeCount> attributes;
+	};
+
+	struct Triangle {
+		u32 drawIndex;
+		// Bounding box in pixels, inclusive and clamped to the framebuffer
+		s32 minX, minY, maxX, maxY;
+
+		// Edge functions E(x, y) = A * x + B * y + C in 28.4 fixed point, for the edges opposite to each vertex
+		// A pixel is covered when E - bias >= 0 for every edge, where the bias implements the top-left fill rule
+		std::array<s32, 3> edgeA, edgeB, edgeBias;
+		std::array<s64, 3> edgeC;
+		float invDoubleArea;
+
+		std::array<float, 3> invW;  // 1 / w of each vertex
+		std::array<float, 3> zOverW;
+		std::array<std::array<float, attributeCount>, 3> attributes;
+	};
+
+	Framebuffer framebuffer;
+	std::vector<DrawState> draws;
+	std::vector<ClipVertex> convertedVertices;  // Scratch buffer for the vertices of the draw being submitted
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<u32>> bins;  // Indices of the triangles that overlap each bin, in submission order
+	u32 binCountX = 0;
+	u32 binCountY = 0;
+
+	ShaderWorkerPool workers;
+	std::atomic<u32> nextBin;
+
+	void submitTriangle(u32 drawIndex, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+	void setupTriangle(u32 drawIndex, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+	void rasterizeBin(u32 bin);
+	void shadePixel(const Triangle& tri, s32 x, s32 y, float zOverW, float w, float weight1, float weight2);
+};
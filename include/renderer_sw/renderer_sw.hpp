@@ -1,8 +1,52 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+#include "PICA/pica_hash.hpp"
 #include "renderer.hpp"
+#include "renderer_sw/rasterizer.hpp"
 
 class GPU;
 
 class RendererSw final : public Renderer {
+	// Decoded textures, keyed by location, format and size. Their memory is watched, so that we only rehash them after it's written to
+	struct CachedTexture {
+		u32 location;
+		u32 size;
+		u64 writeStamp;
+		PICAHash::HashType hash;
+		SoftwareRasterizer::TexturePtr texture;
+	};
+	static constexpr usize maxCachedTextures = 512;
+
+	// The image shown on the window: The top screen above the bottom screen, in RGBA8 with red in the lowest byte and the top row first
+	static constexpr u32 screenWidth = 400;
+	static constexpr u32 screenHeight = 480;
+
+	SoftwareRasterizer rasterizer;
+	std::unordered_map<u64, CachedTexture> textureCache;
+	std::vector<u32> screenPixels;
+
+	// Physical address ranges of the colour and depth buffer the pending draws render to
+	u32 pendingColourLoc = 0;
+	u32 pendingColourSize = 0;
+	u32 pendingDepthLoc = 0;
+	u32 pendingDepthSize = 0;
+
+	// GL objects for presenting the image, if the frontend gave us a window with a GL context
+	bool hasWindow = false;
+	u32 screenTexture = 0;
+	u32 screenFramebuffer = 0;
+
+	// Rasterize the pending draws and let the memory write tracking know about the buffers they wrote to
+	void flushDraws();
+	SoftwareRasterizer::TexturePtr getTexture(u32 unit);
+	void clearTextureCache();
+
+	// Convert the framebuffer the LCD scans out for the top or bottom screen and copy it to screenPixels
+	void composeScreen(bool bottomScreen);
+	void composeScreens();
+
   public:
 	RendererSw(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs);
 	~RendererSw() override;
@@ -0,0 +1,32 @@
+#pragma once
+#include "PICA/regs.hpp"
+#include "helpers.hpp"
+
+// Memory fills and display transfers for the software renderer
+// They work on host pointers instead of physical addresses, so they don't depend on the GPU or on emulated memory
+namespace TransferEngine {
+	// The LCD and transfer engine formats have RGB5551 and RGB565 swapped compared to the PICA's colour buffer formats
+	PICA::ColorFmt toColorFmt(u32 format);
+
+	// Fill "size" bytes with "value". Bits 8 and 9 of "control" select 24-bit and 32-bit fills, otherwise the buffer is filled with 16-bit values
+	void fill(u8* data, u32 size, u32 value, u32 control);
+
+	// A display transfer, decoded from its size and flag registers
+	struct DisplayTransfer {
+		u32 inputWidth, inputHeight;
+		u32 outputWidth, outputHeight;  // Size of the output after downscaling
+		PICA::ColorFmt inputFormat, outputFormat;
+		PICA::Scaling scaling;
+		bool verticalFlip;
+		bool inputLinear;
+		bool dontSwizzle;
+
+		static DisplayTransfer fromRegs(u32 inputSize, u32 outputSize, u32 flags);
+
+		u32 inputBytes() const { return inputWidth * inputHeight * u32(PICA::sizePerPixel(inputFormat)); }
+		u32 outputBytes() const { return outputWidth * outputHeight * u32(PICA::sizePerPixel(outputFormat)); }
+
+		// Convert the input surface and write it to "output". The buffers must hold inputBytes() and outputBytes() bytes
+		void run(const u8* input, u8* output) const;
+	};
+}  // namespace TransferEngine
@@ -1,3 +1,4 @@
+#include <filesystem>
 #include <map>
 #include <optional>
 
@@ -23,6 +24,10 @@ class RendererVK final : public Renderer {
 
 	vk::UniqueDevice device = {};
 
+	// Every pipeline is created through this cache. It's saved to pipelineCachePath, in the shader cache directory of the current title
+	vk::UniquePipelineCache pipelineCache = {};
+	std::filesystem::path pipelineCachePath;
+
 	vk::Queue presentQueue = {};
 	u32 presentQueueFamily = ~0u;
 	vk::Queue graphicsQueue = {};
@@ -102,6 +107,9 @@ class RendererVK final : public Renderer {
 	std::vector<vk::DescriptorSet> topDisplayPipelineDescriptorSet;
 	std::vector<vk::DescriptorSet> bottomDisplayPipelineDescriptorSet;
 
+	// Write the pipeline cache to disk if a title is loaded. The driver only gives us back data it's able to load again
+	void savePipelineCache();
+
 	// Recreate the swapchain, possibly re-using the old one in the case of a resize
 	vk::Result recreateSwapchain(vk::SurfaceKHR surface, vk::Extent2D swapchainExtent);
 
@@ -120,4 +128,5 @@ class RendererVK final : public Renderer {
 	void drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) override;
 	void screenshot(const std::string& name) override;
 	void deinitGraphicsContext() override;
+	void loadShaderCache(const std::filesystem::path& directory) override;
 };
@@ -1,15 +1,19 @@
 #pragma once
-#include <boost/container/flat_map.hpp>
-#include <boost/container/static_vector.hpp>
+#include <array>
+#include <functional>
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "helpers.hpp"
 #include "logger.hpp"
 
+// Event scheduler, implemented as an indexed binary min-heap of events sorted by timestamp
+// Every event gets a handle on creation which can be used to cancel or reschedule it in O(log n)
 struct Scheduler {
 	enum class EventType {
 		VBlank = 0,          // End of frame event
-		UpdateTimers = 1,    // Update kernel timer objects
+		UpdateTimers = 1,    // Fire a kernel timer object. The event data is the handle of the timer
 		RunDSP = 2,          // Make the emulated DSP run for one audio frame
 		SignalY2R = 3,       // Signal that a Y2R conversion has finished
 		Panic = 4,           // Dummy event that is always pending and should never be triggered (Timestamp = UINT64_MAX)
@@ -18,38 +22,226 @@ struct Scheduler {
 	static constexpr usize totalNumberOfEvents = static_cast<usize>(EventType::TotalNumberOfEvents);
 	static constexpr u64 arm11Clock = 268111856;
 
-	template <typename Key, typename Val, usize size>
-	using EventMap = boost::container::flat_multimap<Key, Val, std::less<Key>, boost::container::static_vector<std::pair<Key, Val>, size>>;
+	// Handles are made of a slot index (bottom 32 bits) and the generation of the slot (top 32 bits).
+	// The generation is bumped every time a slot is released, so stale handles to events that already fired are harmlessly ignored
+	using EventHandle = u64;
+	static constexpr EventHandle invalidHandle = std::numeric_limits<u64>::max();
+
+	// Event callbacks receive the timestamp the event was scheduled for (which can be earlier than currentTimestamp)
+	// and the user data the event was created with
+	using Callback = std::function<void(u64 timestamp, u64 data)>;
 
-	EventMap<u64, EventType, totalNumberOfEvents> events;
 	u64 currentTimestamp = 0;
 	u64 nextTimestamp = 0;
 
+  private:
+	struct Event {
+		u64 timestamp;
+		u64 sequence;  // Insertion order, so that events with the same timestamp fire in the order they were added
+		u64 data;
+		EventType type;
+		u32 slot;
+	};
+
+	struct Slot {
+		u32 heapIndex;
+		u32 generation;
+	};
+
+	static constexpr u32 notInHeap = std::numeric_limits<u32>::max();
+
+	std::vector<Event> heap;
+	std::vector<Slot> slots;
+	std::vector<u32> freeSlots;
+	std::array<Callback, totalNumberOfEvents> callbacks;
+	u64 sequenceCounter = 0;
+
+	static bool firesBefore(const Event& a, const Event& b) {
+		return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.sequence < b.sequence);
+	}
+
+	void place(u32 index, const Event& event) {
+		heap[index] = event;
+		slots[event.slot].heapIndex = index;
+	}
+
+	void siftUp(u32 index) {
+		const Event event = heap[index];
+		while (index > 0) {
+			const u32 parent = (index - 1) / 2;
+			if (!firesBefore(event, heap[parent])) {
+				break;
+			}
+
+			place(index, heap[parent]);
+			index = parent;
+		}
+
+		place(index, event);
+	}
+
+	void siftDown(u32 index) {
+		const Event event = heap[index];
+		const u32 size = u32(heap.size());
+
+		while (true) {
+			u32 child = index * 2 + 1;
+			if (child >= size) {
+				break;
+			}
+
+			if (child + 1 < size && firesBefore(heap[child + 1], heap[child])) {
+				child++;
+			}
+
+			if (!firesBefore(heap[child], event)) {
+				break;
+			}
+
+			place(index, heap[child]);
+			index = child;
+		}
+
+		place(index, event);
+	}
+
+	// Restore the heap property for an element whose timestamp was changed
+	void fixup(u32 index) {
+		if (index > 0 && firesBefore(heap[index], heap[(index - 1) / 2])) {
+			siftUp(index);
+		} else {
+			siftDown(index);
+		}
+	}
+
+	u32 allocateSlot() {
+		if (!freeSlots.empty()) {
+			const u32 slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+
+		slots.push_back(Slot{.heapIndex = notInHeap, .generation = 0});
+		return u32(slots.size() - 1);
+	}
+
+	void releaseSlot(u32 slot) {
+		slots[slot].heapIndex = notInHeap;
+		slots[slot].generation++;
+		freeSlots.push_back(slot);
+	}
+
+	// Remove the event at the specified heap index
+	void removeAt(u32 index) {
+		releaseSlot(heap[index].slot);
+
+		const u32 last = u32(heap.size() - 1);
+		if (index != last) {
+			place(index, heap[last]);
+			heap.pop_back();
+			fixup(index);
+		} else {
+			heap.pop_back();
+		}
+	}
+
+	// Returns the heap index of the event a handle refers to, or notInHeap if the handle is stale or invalid
+	u32 findEvent(EventHandle handle) const {
+		const u32 slot = u32(handle);
+		const u32 generation = u32(handle >> 32);
+
+		if (slot >= slots.size() || slots[slot].generation != generation) {
+			return notInHeap;
+		}
+
+		return slots[slot].heapIndex;
+	}
+
+  public:
 	// Set nextTimestamp to the timestamp of the next event
-	void updateNextTimestamp() { nextTimestamp = events.cbegin()->first; }
+	void updateNextTimestamp() { nextTimestamp = heap.empty() ? std::numeric_limits<u64>::max() : heap[0].timestamp; }
+
+	// Register the function to run when events of a specific type fire
+	void setCallback(EventType type, Callback callback) { callbacks[static_cast<usize>(type)] = std::move(callback); }
+
+	EventHandle addEvent(EventType type, u64 timestamp, u64 data = 0) {
+		const u32 slot = allocateSlot();
+		heap.push_back(Event{.timestamp = timestamp, .sequence = sequenceCounter++, .data = data, .type = type, .slot = slot});
+		siftUp(u32(heap.size() - 1));
+		updateNextTimestamp();
+
+		return (u64(slots[slot].generation) << 32) | slot;
+	}
+
+	// Cancel a pending event. Returns false if the event has already fired or been cancelled
+	bool removeEvent(EventHandle handle) {
+		const u32 index = findEvent(handle);
+		if (index == notInHeap) {
+			return false;
+		}
 
-	void addEvent(EventType type, u64 timestamp) {
-		events.emplace(timestamp, type);
+		removeAt(index);
 		updateNextTimestamp();
+		return true;
 	}
 
+	// Change the timestamp of a pending event. Returns false if the event has already fired or been cancelled
+	bool rescheduleEvent(EventHandle handle, u64 timestamp) {
+		const u32 index = findEvent(handle);
+		if (index == notInHeap) {
+			return false;
+		}
+
+		heap[index].timestamp = timestamp;
+		heap[index].sequence = sequenceCounter++;
+		fixup(index);
+		updateNextTimestamp();
+		return true;
+	}
+
+	bool isPending(EventHandle handle) const { return findEvent(handle) != notInHeap; }
+
+	// Cancel every pending event of a specific type. This is O(n), so prefer cancelling by handle on hot paths
 	void removeEvent(EventType type) {
-		for (auto it = events.begin(); it != events.end(); it++) {
-			// Find first event of type "type" and remove it.
-			// Our scheduler shouldn't have duplicate events, so it's safe to exit when an event is found
-			if (it->second == type) {
-				events.erase(it);
-				updateNextTimestamp();
-				break;
+		// Removing an event moves others around the heap, so find the slots of all matching events first
+		std::vector<u32> matchingSlots;
+		for (const Event& event : heap) {
+			if (event.type == type) {
+				matchingSlots.push_back(event.slot);
 			}
 		}
-	};
+
+		for (u32 slot : matchingSlots) {
+			removeAt(slots[slot].heapIndex);
+		}
+
+		updateNextTimestamp();
+	}
+
+	// Pop the earliest event from the heap and run its callback
+	void runNextEvent() {
+		const Event event = heap[0];
+		removeAt(0);
+		updateNextTimestamp();
+
+		const Callback& callback = callbacks[static_cast<usize>(event.type)];
+		if (!callback) [[unlikely]] {
+			Helpers::panic("Scheduler: Unimplemented event type received: %d\n", static_cast<int>(event.type));
+		}
+
+		callback(event.timestamp, event.data);
+	}
+
+	usize pendingEventCount() const { return heap.size(); }
 
 	void reset() {
 		currentTimestamp = 0;
 
-		// Clear any pending events
-		events.clear();
+		// Clear any pending events. Handles to them become stale, as their slots are released
+		while (!heap.empty()) {
+			removeAt(u32(heap.size() - 1));
+		}
+		sequenceCounter = 0;
 		addEvent(Scheduler::EventType::VBlank, arm11Clock / 60);
 
 		// Add a dummy event to always keep the scheduler non-empty
@@ -88,4 +280,4 @@ struct Scheduler {
 
 		return (arm11Clock * s64(ns)) / 1000000000;
 	}
-};
\ No newline at end of file
+};
@@ -6,6 +6,7 @@
 #include "kernel_types.hpp"
 #include "logger.hpp"
 #include "memory.hpp"
+#include "scheduler.hpp"
 
 // Circular dependencies go br
 class Kernel;
@@ -117,6 +118,8 @@ class Y2RService {
 	void stopConversion(u32 messagePointer);
 
 	bool isBusy;
+	// Scheduler event that signals the end of the current conversion
+	Scheduler::EventHandle conversionEvent = Scheduler::invalidHandle;
 
   public:
 	Y2RService(Memory& mem, Kernel& kernel) : mem(mem), kernel(kernel) {}
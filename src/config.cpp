@@ -1,6 +1,8 @@
 #include "config.hpp"
 
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <map>
 #include <string>
@@ -64,9 +66,15 @@ void EmulatorConfig::load() {
 			}
 
 			shaderJitEnabled = toml::find_or<toml::boolean>(gpu, "EnableShaderJIT", shaderJitDefault);
+			vertexLoaderJitEnabled = toml::find_or<toml::boolean>(gpu, "EnableVertexLoaderJIT", false);
 			vsyncEnabled = toml::find_or<toml::boolean>(gpu, "EnableVSync", true);
 			useUbershaders = toml::find_or<toml::boolean>(gpu, "UseUbershaders", ubershaderDefault);
 			accurateShaderMul = toml::find_or<toml::boolean>(gpu, "AccurateShaderMultiplication", false);
+			accelerateShaders = toml::find_or<toml::boolean>(gpu, "AccelerateShaders", false);
+			vertexShaderThreads = toml::find_or<toml::integer>(gpu, "VertexShaderThreads", 0);
+			multithreadedShadingThreshold = toml::find_or<toml::integer>(gpu, "MultithreadedShadingThreshold", 2048);
+			asyncTextureDecode = toml::find_or<toml::boolean>(gpu, "AsyncTextureDecode", false);
+			surfaceCacheBudget = toml::find_or<toml::integer>(gpu, "SurfaceCacheBudget", 512ll * 1024 * 1024);
 
 			forceShadergenForLights = toml::find_or<toml::boolean>(gpu, "ForceShadergenForLighting", true);
 			lightShadergenThreshold = toml::find_or<toml::integer>(gpu, "ShadergenLightThreshold", 1);
@@ -74,6 +82,28 @@ void EmulatorConfig::load() {
 		}
 	}
 
+	if (data.contains("CPU")) {
+		auto cpuResult = toml::expect<toml::value>(data.at("CPU"));
+		if (cpuResult.is_ok()) {
+			auto cpu = cpuResult.unwrap();
+
+			busyWaitSkip = toml::find_or<toml::boolean>(cpu, "EnableBusyWaitSkip", false);
+
+			// Overrides are a table of hex title IDs to booleans, eg "0004000000055D00" = false
+			busyWaitSkipOverrides.clear();
+			if (cpu.contains("BusyWaitSkipOverrides")) {
+				auto overridesResult = toml::expect<toml::table>(cpu.at("BusyWaitSkipOverrides"));
+				if (overridesResult.is_ok()) {
+					for (const auto& [titleID, enabled] : overridesResult.unwrap()) {
+						if (enabled.is_boolean()) {
+							busyWaitSkipOverrides[std::strtoull(titleID.c_str(), nullptr, 16)] = enabled.as_boolean();
+						}
+					}
+				}
+			}
+		}
+	}
+
 	if (data.contains("Audio")) {
 		auto audioResult = toml::expect<toml::value>(data.at("Audio"));
 		if (audioResult.is_ok()) {
@@ -135,14 +165,27 @@ void EmulatorConfig::save() {
 	data["General"]["AppVersionOnWindow"] = appVersionOnWindow;
 	
 	data["GPU"]["EnableShaderJIT"] = shaderJitEnabled;
+	data["GPU"]["EnableVertexLoaderJIT"] = vertexLoaderJitEnabled;
 	data["GPU"]["Renderer"] = std::string(Renderer::typeToString(rendererType));
 	data["GPU"]["EnableVSync"] = vsyncEnabled;
 	data["GPU"]["AccurateShaderMultiplication"] = accurateShaderMul;
+	data["GPU"]["AccelerateShaders"] = accelerateShaders;
+	data["GPU"]["VertexShaderThreads"] = vertexShaderThreads;
+	data["GPU"]["MultithreadedShadingThreshold"] = multithreadedShadingThreshold;
+	data["GPU"]["AsyncTextureDecode"] = asyncTextureDecode;
+	data["GPU"]["SurfaceCacheBudget"] = surfaceCacheBudget;
 	data["GPU"]["UseUbershaders"] = useUbershaders;
 	data["GPU"]["ForceShadergenForLighting"] = forceShadergenForLights;
 	data["GPU"]["ShadergenLightThreshold"] = lightShadergenThreshold;
 	data["GPU"]["EnableRenderdoc"] = enableRenderdoc;
 
+	data["CPU"]["EnableBusyWaitSkip"] = busyWaitSkip;
+	for (const auto& [titleID, enabled] : busyWaitSkipOverrides) {
+		char key[17];
+		std::snprintf(key, sizeof(key), "%016llX", (unsigned long long)titleID);
+		data["CPU"]["BusyWaitSkipOverrides"][key] = enabled;
+	}
+
 	data["Audio"]["DSPEmulation"] = std::string(Audio::DSPCore::typeToString(dspType));
 	data["Audio"]["EnableAudio"] = audioEnabled;
 
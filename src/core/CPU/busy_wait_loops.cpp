@@ -0,0 +1,257 @@
+#include "busy_wait_loops.hpp"
+
+#include <array>
+
+// Detection of guest busy-wait loops, such as games spinning on a GSP/HID shared memory flag or a DSP semaphore.
+// A loop qualifies if it's short, only consists of loads, compares and register ALU ops, and every iteration computes the exact same thing
+// given the same memory contents. That is, any register it reads is either never written inside the loop, or written earlier in the same
+// iteration. Since we only switch guest threads on SVCs and HLE services only touch memory on SVCs and scheduler events, nothing such a loop
+// can observe changes until the next scheduler event. We only skip once an iteration has taken the back-edge (see BusyWaitLoops), so a loop
+// that finds what it's polling for already set exits normally.
+
+namespace {
+	static constexpr u32 maxLoopInstructions = 8;
+	static constexpr u32 pcMask = 1u << 15;
+}  // namespace
+
+using InstructionInfo = BusyWaitLoops::InstructionInfo;
+
+InstructionInfo BusyWaitLoops::decodeARM(u32 instruction) {
+	InstructionInfo info;
+	// Conditionally executed instructions make it impossible to tell which registers are written, so don't bother with them
+	if ((instruction >> 28) != 0xE) {
+		return info;
+	}
+
+	const u32 rn = (instruction >> 16) & 0xF;
+	const u32 rd = (instruction >> 12) & 0xF;
+	const u32 rs = (instruction >> 8) & 0xF;
+	const u32 rm = instruction & 0xF;
+	const bool preIndexed = (instruction & (1 << 24)) != 0;
+	const bool writeback = (instruction & (1 << 21)) != 0;
+	const bool isLoad = (instruction & (1 << 20)) != 0;
+
+	// LDR/LDRB with offset addressing (no writeback)
+	if ((instruction & 0x0C000000) == 0x04000000) {
+		const bool registerOffset = (instruction & (1 << 25)) != 0;
+		if (!isLoad || !preIndexed || writeback || rd == 15 || (registerOffset && (instruction & (1 << 4)))) {
+			return info;
+		}
+
+		info.reads = (1u << rn) | (registerOffset ? (1u << rm) : 0);
+		info.writes = 1u << rd;
+		info.isLoad = true;
+		info.valid = true;
+		return info;
+	}
+
+	// LDRH/LDRSB/LDRSH with offset addressing (no writeback)
+	if ((instruction & 0x0E000090) == 0x00000090 && (instruction & 0x60) != 0) {
+		const bool immediateOffset = (instruction & (1 << 22)) != 0;
+		if (!isLoad || !preIndexed || writeback || rd == 15) {
+			return info;
+		}
+
+		info.reads = (1u << rn) | (immediateOffset ? 0 : (1u << rm));
+		info.writes = 1u << rd;
+		info.isLoad = true;
+		info.valid = true;
+		return info;
+	}
+
+	// Data processing
+	if ((instruction & 0x0C000000) == 0) {
+		const bool immediate = (instruction & (1 << 25)) != 0;
+		const bool setFlags = (instruction & (1 << 20)) != 0;
+		const u32 opcode = (instruction >> 21) & 0xF;
+
+		// Multiplies and extra loads/stores live in this encoding space too
+		if (!immediate && (instruction & 0x90) == 0x90) {
+			return info;
+		}
+
+		// ADC/SBC/RSC read the carry flag, and TST/TEQ/CMP/CMN without the S bit are actually MRS/MSR/BX & co
+		const bool isCompare = opcode >= 0x8 && opcode <= 0xB;
+		if ((opcode >= 0x5 && opcode <= 0x7) || (isCompare && !setFlags) || (!isCompare && rd == 15)) {
+			return info;
+		}
+
+		if (!immediate) {
+			info.reads |= 1u << rm;
+
+			if (instruction & (1 << 4)) {
+				info.reads |= 1u << rs;  // Register-specified shift
+			} else if ((instruction & 0xFE0) == 0x060) {
+				return info;  // RRX reads the carry flag
+			}
+		}
+
+		// MOV and MVN don't have a first operand
+		if (opcode != 0xD && opcode != 0xF) {
+			info.reads |= 1u << rn;
+		}
+
+		info.writes = isCompare ? 0 : (1u << rd);
+		info.valid = true;
+		return info;
+	}
+
+	return info;
+}
+
+InstructionInfo BusyWaitLoops::decodeThumb(u16 instruction) {
+	InstructionInfo info;
+	const u32 low = instruction & 7;         // Rd or Rdn
+	const u32 mid = (instruction >> 3) & 7;  // Rn or Rm
+	const u32 high = (instruction >> 6) & 7;
+	const u32 rdHigh = (instruction >> 8) & 7;
+
+	// LDR/LDRB/LDRH with immediate offset
+	if ((instruction & 0xF800) == 0x6800 || (instruction & 0xF800) == 0x7800 || (instruction & 0xF800) == 0x8800) {
+		info.reads = 1u << mid;
+		info.writes = 1u << low;
+		info.isLoad = true;
+	}
+
+	// LDR relative to SP or PC
+	else if ((instruction & 0xF800) == 0x9800 || (instruction & 0xF800) == 0x4800) {
+		info.reads = (instruction & 0x8000) ? (1u << 13) : 0;
+		info.writes = 1u << rdHigh;
+		info.isLoad = true;
+	}
+
+	// Loads with register offset. Opcodes 0-2 are stores
+	else if ((instruction & 0xF000) == 0x5000) {
+		if (((instruction >> 9) & 7) < 3) {
+			return info;
+		}
+
+		info.reads = (1u << mid) | (1u << high);
+		info.writes = 1u << low;
+		info.isLoad = true;
+	}
+
+	// ADD/SUB with a register or 3-bit immediate
+	else if ((instruction & 0xF800) == 0x1800) {
+		info.reads = (1u << mid) | ((instruction & (1 << 10)) ? 0 : (1u << high));
+		info.writes = 1u << low;
+	}
+
+	// Shifts by immediate
+	else if ((instruction & 0xE000) == 0) {
+		info.reads = 1u << mid;
+		info.writes = 1u << low;
+	}
+
+	// MOV/CMP/ADD/SUB with an 8-bit immediate
+	else if ((instruction & 0xE000) == 0x2000) {
+		const u32 opcode = (instruction >> 11) & 3;
+		info.reads = (opcode == 0) ? 0 : (1u << rdHigh);
+		info.writes = (opcode == 1) ? 0 : (1u << rdHigh);
+	}
+
+	// ALU operations
+	else if ((instruction & 0xFC00) == 0x4000) {
+		const u32 opcode = (instruction >> 6) & 0xF;
+		// ADC and SBC read the carry flag
+		if (opcode == 0x5 || opcode == 0x6) {
+			return info;
+		}
+
+		const bool isCompare = opcode == 0x8 || opcode == 0xA || opcode == 0xB;  // TST, CMP, CMN
+		const bool readsRdn = opcode != 0x9 && opcode != 0xF;                    // NEG and MVN only read Rm
+
+		info.reads = (1u << mid) | (readsRdn ? (1u << low) : 0);
+		info.writes = isCompare ? 0 : (1u << low);
+	}
+
+	// ADD/CMP/MOV with high registers. Opcode 3 is BX/BLX
+	else if ((instruction & 0xFC00) == 0x4400) {
+		const u32 opcode = (instruction >> 8) & 3;
+		const u32 rd = low | ((instruction >> 4) & 8);
+		const u32 rm = (instruction >> 3) & 0xF;
+		if (opcode == 3 || (opcode != 1 && rd == 15)) {
+			return info;
+		}
+
+		info.reads = (1u << rm) | (opcode == 2 ? 0 : (1u << rd));
+		info.writes = (opcode == 1) ? 0 : (1u << rd);
+	}
+
+	else {
+		return info;
+	}
+
+	info.valid = true;
+	return info;
+}
+
+bool BusyWaitLoops::detect(bool isThumb, u32 vaddr, u32 instruction, const CodeReader& readCode) {
+	u32 target;
+	u32 condition;
+
+	if (isThumb) {
+		// Conditional branch (B<cond>) or unconditional branch (B)
+		if ((instruction & 0xF000) == 0xD000 && ((instruction >> 8) & 0xF) < 0xE) {
+			target = vaddr + 4 + (u32(s32(s8(instruction & 0xFF))) << 1);
+			condition = (instruction >> 8) & 0xF;
+		} else if ((instruction & 0xF800) == 0xE000) {
+			target = vaddr + 4 + (u32(s32(instruction << 21) >> 21) << 1);
+			condition = 0xE;
+		} else {
+			return false;
+		}
+	} else {
+		// B, not BL
+		if ((instruction & 0x0F000000) != 0x0A000000 || (instruction >> 28) == 0xF) {
+			return false;
+		}
+
+		target = vaddr + 8 + (u32(s32(instruction << 8) >> 8) << 2);
+		condition = instruction >> 28;
+	}
+
+	const u32 instructionSize = isThumb ? 2 : 4;
+	if (target > vaddr || (vaddr - target) / instructionSize > maxLoopInstructions) {
+		return false;
+	}
+
+	// Decode the loop body. The branch itself only reads the flags, which every instruction we accept may set freely
+	std::array<InstructionInfo, maxLoopInstructions> body;
+	const u32 count = (vaddr - target) / instructionSize;
+	u32 loopWrites = 0;
+	bool hasLoad = false;
+
+	for (u32 i = 0; i < count; i++) {
+		const void* pointer = readCode(target + i * instructionSize);
+		if (pointer == nullptr) {
+			return false;
+		}
+
+		body[i] = isThumb ? decodeThumb(*static_cast<const u16*>(pointer)) : decodeARM(*static_cast<const u32*>(pointer));
+		if (!body[i].valid) {
+			return false;
+		}
+
+		loopWrites |= body[i].writes;
+		hasLoad |= body[i].isLoad;
+	}
+
+	if (!hasLoad) {
+		return false;
+	}
+
+	// Every register the loop both reads and writes must be written before it's read in each iteration.
+	// Otherwise values carry over between iterations (eg a counter) and the loop could make progress on its own.
+	u32 defined = 0;
+	for (u32 i = 0; i < count; i++) {
+		if ((body[i].reads & ~pcMask) & loopWrites & ~defined) {
+			return false;
+		}
+
+		defined |= body[i].writes;
+	}
+
+	add(target, vaddr + instructionSize, condition);
+	return true;
+}
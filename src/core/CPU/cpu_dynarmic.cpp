@@ -15,7 +15,16 @@ CPU::CPU(Memory& mem, Kernel& kernel, Emulator& emu) : mem(mem), emu(emu), sched
 	config.global_monitor = &exclusiveMonitor;
 	config.processor_id = 0;
 
+	// Let the JIT access guest memory directly through our page table. Our memory callbacks are then only used for pages that aren't
+	// in the table (config memory, VRAM, read-only mappings, pages the GPU tracks writes to) and for accesses that straddle a page boundary
+	static_assert(Memory::totalPageCount == Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES, "Page table size mismatch with Dynarmic");
+	config.page_table = mem.getFastmemTable();
+	config.absolute_offset_page_table = false;
+	config.detect_misaligned_access_via_page_table = 16 | 32 | 64;
+	config.only_detect_misalignment_via_page_table_on_page_boundary = true;
+
 	jit = std::make_unique<Dynarmic::A32::Jit>(config);
+	env.jit = jit.get();
 }
 
 void CPU::reset() {
@@ -26,14 +35,22 @@ void CPU::reset() {
 	cp15->setTLSBase(VirtualAddrs::TLSBase);  // Set cp15 TLS pointer to the main thread's thread-local storage
 	jit->Reset();
 	jit->ClearCache();
+	env.busyWaitLoops.clear();
 	jit->Regs().fill(0);
 	jit->ExtRegs().fill(0);
+	env.skippedCycles = 0;
 }
 
 void CPU::runFrame() {
 	emu.frameDone = false;
 
 	while (!emu.frameDone) {
+		// If every thread is blocked, jump straight to the next scheduler event or thread wakeup instead of spinning in the idle thread
+		if (env.kernel.skipIdleTime()) {
+			emu.pollScheduler();
+			continue;
+		}
+
 		// Run CPU until the next scheduler event
 		env.ticksLeft = scheduler.nextTimestamp - scheduler.currentTimestamp;
 
@@ -53,6 +70,8 @@ void CPU::runFrame() {
 			}
 		}
 	}
+
+	env.kernel.endFrame();
 }
 
 #endif  // CPU_DYNARMIC
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "PICA/dynapica/vertex_loader_rec.hpp"
+
+#include "PICA/regs.hpp"
+
+using namespace VertexLoader;
+
+bool VertexLoader::buildLayout(Layout& layout, const std::array<u32, 0x300>& regs, const std::array<u32, maxAttribCount>& bufferAlignment) {
+	using namespace PICA::InternalRegs;
+	layout = {};
+
+	const u32 formatHigh = regs[AttribFormatHigh];
+	const u64 vertexCfg = u64(regs[AttribFormatLow]) | (u64(formatHigh) << 32);
+	const u64 inputAttrCfg = u64(regs[VertexShaderInputCfgLow]) | (u64(regs[VertexShaderInputCfgHigh]) << 32);
+	const u32 totalAttribCount = (formatHigh >> 28) + 1;
+	const u32 fixedAttribMask = Helpers::getBits<16, 12>(formatHigh);
+
+	auto addAttribute = [&](u32 attrCount) -> Attribute& {
+		Attribute& attr = layout.attributes[layout.attributeCount++];
+		attr.inputRegister = (inputAttrCfg >> (attrCount * 4)) & 0xf;
+		return attr;
+	};
+
+	// Walk the attributes the same way GPU::drawArrays does, so the loader matches the interpreted vertex fetch exactly
+	u32 attrCount = 0;
+	u32 buffer = 0;
+
+	while (attrCount < totalAttribCount) {
+		if (fixedAttribMask & (1 << attrCount)) {
+			Attribute& attr = addAttribute(attrCount);
+			attr.fixed = 1;
+			attr.fixedIndex = attrCount;
+			attrCount++;
+			continue;
+		}
+
+		if (buffer >= maxAttribCount) [[unlikely]] {
+			return false;
+		}
+
+		const u32 config1 = regs[Attrib0Offset + buffer * 3 + 1];
+		const u32 config2 = regs[Attrib0Offset + buffer * 3 + 2];
+		const u64 attrCfg = u64(config1) | (u64(config2) << 32);
+		const u32 componentCount = config2 >> 28;
+		const u32 stride = Helpers::getBits<16, 8>(config2);
+		u32 offset = 0;
+
+		for (u32 j = 0; j < componentCount; j++) {
+			const u32 index = (attrCfg >> (j * 4)) & 0xf;
+
+			// Padding components align the attribute address up to a 4 byte boundary. The alignment of the address is only known when
+			// compiling if the stride is a multiple of 4, so leave weirder configurations to the interpreter
+			if (index >= 12) {
+				if (stride & 3) {
+					return false;
+				}
+
+				const u32 alignment = bufferAlignment[buffer];
+				offset = ((alignment + offset + 3) & ~3u) - alignment;
+				offset += (index - 11) << 2;
+				continue;
+			}
+
+			const u32 attribInfo = (vertexCfg >> (index * 4)) & 0xf;
+			const u32 type = attribInfo & 0x3;
+			const u32 size = (attribInfo >> 2) + 1;
+
+			// Attributes past the attribute count are fetched but never make it to the shader, so don't bother loading them
+			if (attrCount < totalAttribCount) {
+				Attribute& attr = addAttribute(attrCount);
+				attr.buffer = buffer;
+				attr.offset = offset;
+				attr.type = type;
+				attr.componentCount = size;
+			}
+
+			offset += size * attribTypeSizes[type];
+			attrCount++;
+		}
+
+		layout.strides[buffer] = stride;
+		buffer++;
+	}
+
+	layout.bufferCount = buffer;
+	return true;
+}
+
+#ifdef PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
+bool VertexLoaderJIT::prepare(PICARegs regs, const std::array<u32, maxAttribCount>& bufferAlignment) {
+	if (!hostSupported || !buildLayout(layout, regs, bufferAlignment)) {
+		return false;
+	}
+
+	// The layout has no padding bytes, so we can hash it directly
+	const Hash hash = PICAHash::computeHash(reinterpret_cast<const char*>(&layout), sizeof(layout));
+	auto it = cache.find(hash);
+
+	if (it == cache.end()) {  // Loader has not been compiled yet
+		auto emitter = std::make_unique<VertexLoaderEmitter>();
+		emitter->compile(layout);
+		callback = emitter->getCallback();
+
+		cache.emplace_hint(it, hash, std::move(emitter));
+	} else {  // Loader has been compiled and found, use it
+		callback = it->second->getCallback();
+	}
+
+	return true;
+}
+#endif  // PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
@@ -0,0 +1,137 @@
+#if defined(PANDA3DS_DYNAPICA_SUPPORTED) && defined(PANDA3DS_ARM64_HOST)
+#include "PICA/dynapica/vertex_loader_rec_emitter_arm64.hpp"
+
+using namespace oaknut;
+using namespace oaknut::util;
+using namespace VertexLoader;
+
+// Loader ABI: X0 = shader input registers, X1 = vertex buffer pointers, W2 = vertex index, X3 = fixed attributes
+// We only touch volatile registers, so there is no prologue or epilogue to speak of
+static constexpr XReg inputs = X0;
+static constexpr XReg bufferPointers = X1;
+static constexpr WReg vertexIndex = W2;
+static constexpr XReg fixedAttributes = X3;
+
+static constexpr XReg bufferPointer = X9;  // Address of the vertex we're fetching in the current buffer
+static constexpr XReg attribPointer = X10;
+static constexpr QReg attribute = Q0;
+static constexpr QReg onesVector = Q31;
+
+void VertexLoaderEmitter::compile(const Layout& layout) {
+	oaknut::CodeBlock::unprotect();  // Unprotect the memory before writing to it
+
+	oaknut::Label entrypoint;
+	align(16);
+	l(entrypoint);
+
+	// Generate a vector of all 1.0s, used for filling the w component of attributes that don't provide it
+	FMOV(onesVector.S4(), FImm8(0x70));
+
+	// Attributes are grouped by buffer, so we only need to compute each vertex address once
+	u32 currentBuffer = ~0u;
+	for (u32 i = 0; i < layout.attributeCount; i++) {
+		const Attribute& attr = layout.attributes[i];
+		const u32 dest = attr.inputRegister * sizeof(vec4f);
+
+		if (attr.fixed) {
+			LDR(attribute, fixedAttributes, attr.fixedIndex * sizeof(vec4f));
+		} else {
+			if (attr.buffer != currentBuffer) {
+				currentBuffer = attr.buffer;
+				// bufferPointer = bufferPointers[buffer] + vertexIndex * stride
+				LDR(bufferPointer, bufferPointers, currentBuffer * sizeof(u8*));
+				MOV(W11, layout.strides[currentBuffer]);
+				UMADDL(bufferPointer, vertexIndex, W11, bufferPointer);
+			}
+
+			loadAttribute(attr);
+		}
+
+		STR(attribute, inputs, dest);
+	}
+
+	RET();
+
+	callback = reinterpret_cast<Callback>(reinterpret_cast<u8*>(oaknut::CodeBlock::ptr()) + entrypoint.offset());
+
+	// Protect the memory and invalidate icache before executing the code
+	oaknut::CodeBlock::protect();
+	oaknut::CodeBlock::invalidate_all();
+}
+
+void VertexLoaderEmitter::loadAttribute(const Attribute& attr) {
+	const u32 count = attr.componentCount;
+	// Attribute offsets have no alignment guarantees, so compute the address instead of using scaled immediate offsets
+	ADD(attribPointer, bufferPointer, attr.offset);
+
+	// Load exactly the bytes the attribute occupies into the low part of the register, leaving the rest zeroed, so that we never
+	// read past the end of the vertex buffer
+	switch (static_cast<AttribType>(attr.type)) {
+		case AttribType::S8:
+		case AttribType::U8:
+			switch (count) {
+				case 1: LDRB(W12, attribPointer); break;
+				case 2: LDRH(W12, attribPointer); break;
+				case 3:
+					LDRH(W12, attribPointer);
+					LDRB(W13, attribPointer, 2);
+					LSL(W13, W13, 16);
+					ORR(W12, W12, W13);
+					break;
+				default: LDR(W12, attribPointer); break;
+			}
+
+			FMOV(S0, W12);
+			if (attr.type == u32(AttribType::S8)) {
+				SXTL(attribute.H8(), attribute.B8());
+				SXTL(attribute.S4(), attribute.H4());
+				SCVTF(attribute.S4(), attribute.S4());
+			} else {
+				UXTL(attribute.H8(), attribute.B8());
+				UXTL(attribute.S4(), attribute.H4());
+				UCVTF(attribute.S4(), attribute.S4());
+			}
+			break;
+
+		case AttribType::S16:
+			switch (count) {
+				case 1:
+					LDRH(W12, attribPointer);
+					FMOV(S0, W12);
+					break;
+				case 2: LDR(S0, attribPointer); break;
+				case 3:
+					LDR(W12, attribPointer);
+					LDRH(W13, attribPointer, 4);
+					LSL(X13, X13, 32);
+					ORR(X12, X12, X13);
+					FMOV(D0, X12);
+					break;
+				default: LDR(D0, attribPointer); break;
+			}
+
+			SXTL(attribute.S4(), attribute.H4());
+			SCVTF(attribute.S4(), attribute.S4());
+			break;
+
+		case AttribType::Float:
+			switch (count) {
+				case 1: LDR(S0, attribPointer); break;
+				case 2: LDR(D0, attribPointer); break;
+				case 3:
+					LDR(D0, attribPointer);
+					LDR(S1, attribPointer, 8);
+					MOV(attribute.Selem()[2], Q1.Selem()[0]);
+					break;
+				default: LDR(attribute, attribPointer); break;
+			}
+			break;
+	}
+
+	// The components the attribute doesn't provide are already 0.0, but w needs to be 1.0
+	if (count < 4) {
+		MOV(attribute.Selem()[3], onesVector.Selem()[3]);
+	}
+}
+
+#endif  // PANDA3DS_DYNAPICA_SUPPORTED && PANDA3DS_ARM64_HOST
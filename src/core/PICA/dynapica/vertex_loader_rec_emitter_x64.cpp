@@ -0,0 +1,125 @@
+#if defined(PANDA3DS_DYNAPICA_SUPPORTED) && defined(PANDA3DS_X64_HOST)
+#include "PICA/dynapica/vertex_loader_rec_emitter_x64.hpp"
+
+using namespace Xbyak;
+using namespace Xbyak::util;
+using namespace VertexLoader;
+
+// Loader ABI: arg1 = shader input registers, arg2 = vertex buffer pointers, arg3 = vertex index, arg4 = fixed attributes
+// We only touch volatile registers, so there is no prologue or epilogue to speak of
+static constexpr Reg64 bufferPointer = r10;  // Address of the vertex we're fetching in the current buffer
+static constexpr Reg64 scratch = r11;
+static constexpr Xmm attribute = xmm0;
+static constexpr Xmm defaults = xmm5;
+
+void VertexLoaderEmitter::compile(const Layout& layout) {
+	// Constants
+	align(16);
+	L(defaultAttribute);
+	dd(0); dd(0); dd(0); dd(0x3f800000);  // (0.0, 0.0, 0.0, 1.0)
+
+	align(16);
+	callback = getCurr<Callback>();
+
+	const Reg64 inputs = arg1.cvt64();
+	const Reg64 bufferPointers = arg2.cvt64();
+	const Reg32 vertexIndex = arg3;
+	const Reg64 fixedAttributes = arg4.cvt64();
+
+	movaps(defaults, xword[rip + defaultAttribute]);
+
+	// Attributes are grouped by buffer, so we only need to compute each vertex address once
+	u32 currentBuffer = ~0u;
+	for (u32 i = 0; i < layout.attributeCount; i++) {
+		const Attribute& attr = layout.attributes[i];
+		const u32 dest = attr.inputRegister * sizeof(vec4f);
+
+		if (attr.fixed) {
+			movaps(attribute, xword[fixedAttributes + attr.fixedIndex * sizeof(vec4f)]);
+		} else {
+			if (attr.buffer != currentBuffer) {
+				currentBuffer = attr.buffer;
+				// bufferPointer = bufferPointers[buffer] + vertexIndex * stride. The product fits in 32 bits, and 32-bit ops zero-extend
+				mov(bufferPointer, qword[bufferPointers + currentBuffer * sizeof(u8*)]);
+				imul(scratch.cvt32(), vertexIndex, layout.strides[currentBuffer]);
+				add(bufferPointer, scratch);
+			}
+
+			loadAttribute(attr);
+		}
+
+		movaps(xword[inputs + dest], attribute);
+	}
+
+	ret();
+}
+
+void VertexLoaderEmitter::loadAttribute(const Attribute& attr) {
+	const u32 offset = attr.offset;
+	const u32 count = attr.componentCount;
+
+	// Load exactly the bytes the attribute occupies into the low part of the register, leaving the rest zeroed, so that we never
+	// read past the end of the vertex buffer
+	switch (static_cast<AttribType>(attr.type)) {
+		case AttribType::S8:
+		case AttribType::U8:
+			switch (count) {
+				case 1: movzx(eax, byte[bufferPointer + offset]); break;
+				case 2: movzx(eax, word[bufferPointer + offset]); break;
+				case 3:
+					movzx(eax, word[bufferPointer + offset]);
+					movzx(scratch.cvt32(), byte[bufferPointer + offset + 2]);
+					shl(scratch.cvt32(), 16);
+					or_(eax, scratch.cvt32());
+					break;
+				default: mov(eax, dword[bufferPointer + offset]); break;
+			}
+
+			movd(attribute, eax);
+			if (attr.type == u32(AttribType::S8)) {
+				pmovsxbd(attribute, attribute);
+			} else {
+				pmovzxbd(attribute, attribute);
+			}
+			cvtdq2ps(attribute, attribute);
+			break;
+
+		case AttribType::S16:
+			switch (count) {
+				case 1:
+					movzx(eax, word[bufferPointer + offset]);
+					movd(attribute, eax);
+					break;
+				case 2: movd(attribute, dword[bufferPointer + offset]); break;
+				case 3:
+					movd(attribute, dword[bufferPointer + offset]);
+					pinsrw(attribute, word[bufferPointer + offset + 4], 2);
+					break;
+				default: movq(attribute, qword[bufferPointer + offset]); break;
+			}
+
+			pmovsxwd(attribute, attribute);
+			cvtdq2ps(attribute, attribute);
+			break;
+
+		case AttribType::Float:
+			switch (count) {
+				case 1: movss(attribute, dword[bufferPointer + offset]); break;
+				case 2: movsd(attribute, qword[bufferPointer + offset]); break;
+				case 3:
+					movsd(attribute, qword[bufferPointer + offset]);
+					insertps(attribute, dword[bufferPointer + offset + 8], 0x20);  // Insert into the z component
+					break;
+				default: movups(attribute, xword[bufferPointer + offset]); break;
+			}
+			break;
+	}
+
+	// Fill the components the attribute doesn't provide from (0.0, 0.0, 0.0, 1.0)
+	if (count < 4) {
+		const u8 mask = 0xf & ~((1 << count) - 1);
+		blendps(attribute, defaults, mask);
+	}
+}
+
+#endif  // PANDA3DS_DYNAPICA_SUPPORTED && PANDA3DS_X64_HOST
@@ -1,9 +1,11 @@
 #include "PICA/gpu.hpp"
 
+#include <algorithm>
 #include <array>
-#include <bitset>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
+#include <thread>
 
 #include "PICA/float_types.hpp"
 #include "PICA/regs.hpp"
@@ -61,6 +63,7 @@ GPU::GPU(Memory& mem, EmulatorConfig& config) : mem(mem), config(config) {
 
 	if (renderer != nullptr) {
 		renderer->setConfig(&config);
+		mem.setGPUWriteBackCallback([this](u32 paddr, u32 size) { renderer->writeBackSurfaces(paddr, size); });
 	}
 }
 
@@ -69,6 +72,7 @@ void GPU::reset() {
 	shaderUnit.reset();
 	shaderJIT.reset();
 	shaderJIT.setAccurateMul(config.accurateShaderMul);
+	vertexLoaderJIT.reset();
 
 	std::memset(vram, 0, vramSize);
 	lightingLUT.fill(0);
@@ -76,6 +80,8 @@ void GPU::reset() {
 
 	fogLUT.fill(0);
 	fogLUTDirty = true;
+	dirtyRegs = PICA::DirtyRegs::All;
+	pendingTexturePrefetches = 0;
 
 	totalAttribCount = 0;
 	fixedAttribMask = 0;
@@ -121,9 +127,27 @@ void GPU::reset() {
 	renderer->reset();
 }
 
+void GPU::prefetchPendingTextures() {
+	for (u32 unit = 0; unit < 3; unit++) {
+		if (pendingTexturePrefetches & (1 << unit)) {
+			renderer->prefetchTexture(unit);
+		}
+	}
+
+	pendingTexturePrefetches = 0;
+}
+
 // Call the correct version of drawArrays based on whether this is an indexed draw (first template parameter)
 // And whether we are going to use the shader JIT (second template parameter)
 void GPU::drawArrays(bool indexed) {
+	// Prefetched textures are decoded while the vertices are processed
+	prefetchPendingTextures();
+
+	// Try running the vertex shader on the host GPU first, and fall back to running it on the CPU if the renderer can't
+	if (config.accelerateShaders && drawArraysAccelerated(indexed)) {
+		return;
+	}
+
 	const bool shaderJITEnabled = ShaderJIT::isAvailable() && config.shaderJitEnabled;
 
 	if (indexed) {
@@ -172,9 +196,13 @@ void GPU::drawArrays() {
 	u32 indexBufferPointer = vertexBase + (indexBufferConfig & 0xfffffff);
 	bool shortIndex = Helpers::getBit<31>(indexBufferConfig);  // Indicates whether vert indices are 16-bit or 8-bit
 
+	VertexFetchState fetch;
+	fetch.vertexBase = vertexBase;
 	// Stuff the global attribute config registers in one u64 to make attr parsing easier
 	// TODO: Cache this when the vertex attribute format registers are written to
-	u64 vertexCfg = u64(regs[PICA::InternalRegs::AttribFormatLow]) | (u64(regs[PICA::InternalRegs::AttribFormatHigh]) << 32);
+	fetch.vertexCfg = u64(regs[PICA::InternalRegs::AttribFormatLow]) | (u64(regs[PICA::InternalRegs::AttribFormatHigh]) << 32);
+	fetch.inputAttrCfg = getVertexShaderInputConfig();
+	fetch.useVertexLoaderJIT = prepareVertexLoader(vertexBase, fetch.bufferPointers);
 
 	if constexpr (!indexed) {
 		u32 offset = regs[PICA::InternalRegs::VertexOffsetReg];
@@ -183,69 +211,109 @@ void GPU::drawArrays() {
 		log("PICA::DrawElements(vertex count = %d, index buffer config = %08X)\n", vertexCount, indexBufferConfig);
 	}
 
-	// Total number of input attributes to shader. Differs between GS and VS. Currently stubbed to the VS one, as we don't have geometry shaders.
-	const u32 inputAttrCount = (regs[PICA::InternalRegs::VertexShaderInputBufferCfg] & 0xf) + 1;
-	const u64 inputAttrCfg = getVertexShaderInputConfig();
+	const u32 workerCount = getShaderWorkerCount(vertexCount);
 
-	// When doing indexed rendering, we have a cache of vertices to avoid processing attributes and shaders for a single vertex many times
-	constexpr bool vertexCacheEnabled = true;
-	constexpr size_t vertexCacheSize = 64;
+	if constexpr (indexed) {
+		const u32 indexBufferSize = vertexCount * (shortIndex ? sizeof(u16) : sizeof(u8));
+		const u8* indexBuffer = getPointerPhys<u8>(indexBufferPointer, indexBufferSize);
+		if (indexBuffer == nullptr) [[unlikely]] {
+			Helpers::warn("[PICA] Index buffer at %08X is out of bounds", indexBufferPointer);
+			return;
+		}
 
-	struct {
-		std::bitset<vertexCacheSize> validBits{0};         // Shows which tags are valid. If the corresponding bit is 1, then there's an entry
-		std::array<u32, vertexCacheSize> ids;              // IDs (ie indices of the cached vertices in the 3DS vertex buffer)
-		std::array<u32, vertexCacheSize> bufferPositions;  // Positions of the cached vertices in our own vertex buffer
-	} vertexCache;
+		// Shade every vertex the draw references exactly once, and let the renderer draw them with a host index buffer
+		// instead of expanding them to one vertex per index
+		mem.writeBackGPUOwned(indexBufferPointer, indexBufferSize);
+		const u32 uniqueCount = buildIndexBuffer(indexBuffer, vertexCount, shortIndex);
 
-	for (u32 i = 0; i < vertexCount; i++) {
-		u32 vertexIndex;  // Index of the vertex in the VBO for indexed rendering
+		if (uniqueCount != 0 && mem.hasGPUOwnedPages()) [[unlikely]] {
+			const auto [minimumIndex, maximumIndex] = std::minmax_element(uniqueIndices.begin(), uniqueIndices.end());
+			writeBackVertexBuffers(vertexBase, *minimumIndex, *maximumIndex);
+		}
 
-		if constexpr (!indexed) {
-			vertexIndex = i + regs[PICA::InternalRegs::VertexOffsetReg];
-		} else {
-			if (shortIndex) {
-				auto ptr = getPointerPhys<u16>(indexBufferPointer);
-				vertexIndex = *ptr;  // TODO: This is very unsafe
-				indexBufferPointer += 2;
-			} else {
-				auto ptr = getPointerPhys<u8>(indexBufferPointer);
-				vertexIndex = *ptr;  // TODO: This is also very unsafe
-				indexBufferPointer += 1;
-			}
+		shadeVertices<true, useShaderJIT>(fetch, uniqueCount, workerCount);
+		renderer->drawVerticesIndexed(primType, std::span(vertices).first(uniqueCount), std::span(hostIndices).first(vertexCount));
+	} else {
+		if (vertexCount != 0) {
+			const u32 vertexOffset = regs[PICA::InternalRegs::VertexOffsetReg];
+			writeBackVertexBuffers(vertexBase, vertexOffset, vertexOffset + vertexCount - 1);
 		}
+		shadeVertices<false, useShaderJIT>(fetch, vertexCount, workerCount);
+		renderer->drawVertices(primType, std::span(vertices).first(vertexCount));
+	}
+}
 
-		// Check if the vertex corresponding to the index is in cache
-		if constexpr (indexed && vertexCacheEnabled) {
-			auto& cache = vertexCache;
-			size_t tag = vertexIndex % vertexCacheSize;
-			// Cache hit
-			if (cache.validBits[tag] && cache.ids[tag] == vertexIndex) {
-				vertices[i] = vertices[cache.bufferPositions[tag]];
-				continue;
-			}
+u32 GPU::buildIndexBuffer(const u8* indexBuffer, u32 indexCount, bool shortIndex) {
+	if (indexSlots.empty()) {
+		indexSlots.resize(0x10000, 0);
+	}
 
-			// Cache miss. Set cache entry, fetch attributes and run shaders as normal
-			else {
-				cache.validBits[tag] = true;
-				cache.ids[tag] = vertexIndex;
-				cache.bufferPositions[tag] = i;
-			}
+	uniqueIndices.clear();
+	hostIndices.resize(indexCount);
+
+	for (u32 i = 0; i < indexCount; i++) {
+		const u32 vertexIndex = shortIndex ? reinterpret_cast<const u16*>(indexBuffer)[i] : indexBuffer[i];
+		u32& slot = indexSlots[vertexIndex];
+
+		if (slot == 0) {
+			uniqueIndices.push_back(vertexIndex);
+			slot = u32(uniqueIndices.size());
+		}
+
+		// There's at most one unique vertex per index of the draw, and draws are capped at 0x10000 vertices, so this always fits
+		hostIndices[i] = u16(slot - 1);
+	}
+
+	// Clear the slots we used so the table is ready for the next draw
+	for (u32 vertexIndex : uniqueIndices) {
+		indexSlots[vertexIndex] = 0;
+	}
+
+	return u32(uniqueIndices.size());
+}
+
+void GPU::writeBackVertexBuffers(u32 vertexBase, u32 minimumIndex, u32 maximumIndex) {
+	// A vertex reads at most 12 components of up to 16 bytes each from a buffer, padding included. This bounds what it reads when the
+	// buffer's stride is smaller than that, eg 0 for buffers where every vertex is the same
+	static constexpr u32 maxVertexBytes = 12 * 16;
+
+	if (!mem.hasGPUOwnedPages()) {
+		return;
+	}
+
+	for (const AttribInfo& attr : attributeInfo) {
+		if (attr.componentCount == 0) {
+			continue;
 		}
 
+		const u32 stride = u32(attr.size);
+		const u32 start = vertexBase + attr.offset + minimumIndex * stride;
+		mem.writeBackGPUOwned(start, (maximumIndex - minimumIndex) * stride + std::max(stride, maxVertexBytes));
+	}
+}
+
+template <bool useShaderJIT>
+void GPU::shadeVertex(PICAShader& shader, const VertexFetchState& fetch, u32 vertexIndex, PICA::Vertex& out) {
+	// The vertex loader JIT fetches the attributes and writes them to the shader input registers, already permuted
+	if (fetch.useVertexLoaderJIT) {
+		vertexLoaderJIT.loadVertex(shader.inputs.data(), fetch.bufferPointers.data(), vertexIndex, shader.fixedAttributes.data());
+	} else {
+		std::array<vec4f, 16> currentAttributes;  // Vertex attributes before being passed to the shader
+		const u64 vertexCfg = fetch.vertexCfg;
 		int attrCount = 0;
 		int buffer = 0;  // Vertex buffer index for non-fixed attributes
 
 		while (attrCount < totalAttribCount) {
 			// Check if attribute is fixed or not
-			if (fixedAttribMask & (1 << attrCount)) {                         // Fixed attribute
-				vec4f& fixedAttr = shaderUnit.vs.fixedAttributes[attrCount];  // TODO: Is this how it works?
+			if (fixedAttribMask & (1 << attrCount)) {                   // Fixed attribute
+				vec4f& fixedAttr = shader.fixedAttributes[attrCount];  // TODO: Is this how it works?
 				vec4f& inputAttr = currentAttributes[attrCount];
 				std::memcpy(&inputAttr, &fixedAttr, sizeof(vec4f));  // Copy fixed attr to input attr
 				attrCount++;
 			} else {                                 // Non-fixed attribute
 				auto& attr = attributeInfo[buffer];  // Get information for this attribute
 				u64 attrCfg = attr.getConfigFull();  // Get config1 | (config2 << 32)
-				u32 attrAddress = vertexBase + attr.offset + (vertexIndex * attr.size);
+				u32 attrAddress = fetch.vertexBase + attr.offset + (vertexIndex * attr.size);
 
 				for (int j = 0; j < attr.componentCount; j++) {
 					uint index = (attrCfg >> (j * 4)) & 0xf;  // Get index of attribute in vertexCfg
@@ -329,30 +397,207 @@ void GPU::drawArrays() {
 		// Based on the SH_ATTRIBUTES_PERMUTATION registers.
 		// Ie it might attribute #0 to v2, #1 to v7, etc
 		for (int j = 0; j < totalAttribCount; j++) {
-			const u32 mapping = (inputAttrCfg >> (j * 4)) & 0xf;
-			std::memcpy(&shaderUnit.vs.inputs[mapping], &currentAttributes[j], sizeof(vec4f));
+			const u32 mapping = (fetch.inputAttrCfg >> (j * 4)) & 0xf;
+			std::memcpy(&shader.inputs[mapping], &currentAttributes[j], sizeof(vec4f));
+		}
+	}
+
+	if constexpr (useShaderJIT) {
+		shaderJIT.run(shader);
+	} else {
+		shader.run();
+	}
+
+	// Map shader outputs to fixed function properties
+	const u32 totalShaderOutputs = regs[PICA::InternalRegs::ShaderOutputCount] & 7;
+	for (int i = 0; i < totalShaderOutputs; i++) {
+		const u32 config = regs[PICA::InternalRegs::ShaderOutmap0 + i];
+		const vec4f& output = shader.outputs[vsOutputRegisters[i]];
+
+		for (int j = 0; j < 4; j++) {  // pls unroll
+			const u32 mapping = (config >> (j * 8)) & 0x1F;
+			out.raw[mapping] = output[j];
+		}
+	}
+}
+
+u32 GPU::getShaderWorkerCount(u32 vertexCount) {
+	if (config.vertexShaderThreads == 1 || s64(vertexCount) < config.multithreadedShadingThreshold) {
+		return 1;
+	}
+
+	// By default, leave a core for the rest of the emulator and the frontend
+	u32 workerCount = config.vertexShaderThreads;
+	if (workerCount == 0) {
+		workerCount = std::max<u32>(std::thread::hardware_concurrency(), 2) - 1;
+	}
+	workerCount = std::clamp<u32>(workerCount, 1, ShaderWorkerPool::maxWorkerCount);
+
+	shaderWorkers.start(workerCount);
+	while (shaderClones.size() + 1 < workerCount) {
+		shaderClones.push_back(std::make_unique<PICAShader>(ShaderType::Vertex));
+	}
+
+	return workerCount;
+}
+
+template <bool indexed, bool useShaderJIT>
+void GPU::shadeVertices(const VertexFetchState& fetch, u32 count, u32 workerCount) {
+	// For indexed draws we shade the unique vertices gathered by buildIndexBuffer, otherwise the vertices are consecutive
+	const u32 vertexOffset = regs[PICA::InternalRegs::VertexOffsetReg];
+	auto getVertexIndex = [&](u32 i) { return indexed ? uniqueIndices[i] : i + vertexOffset; };
+
+	if (workerCount <= 1) {
+		for (u32 i = 0; i < count; i++) {
+			shadeVertex<useShaderJIT>(shaderUnit.vs, fetch, getVertexIndex(i), vertices[i]);
+		}
+		return;
+	}
+
+	// Shading writes to the input, output and temporary registers, so every worker needs its own copy of the shader unit
+	for (u32 i = 0; i < workerCount - 1; i++) {
+		*shaderClones[i] = shaderUnit.vs;
+	}
+
+	// Every worker writes its outputs straight to its own range of the vertex buffer, so the vertices end up in order
+	shaderWorkers.run(count, [&](u32 worker, u32 begin, u32 end) {
+		PICAShader& shader = (worker == 0) ? shaderUnit.vs : *shaderClones[worker - 1];
+		for (u32 i = begin; i < end; i++) {
+			shadeVertex<useShaderJIT>(shader, fetch, getVertexIndex(i), vertices[i]);
+		}
+	});
+}
+
+bool GPU::drawArraysAccelerated(bool indexed) {
+	using namespace PICA::InternalRegs;
+
+	const u32 vertexCount = regs[VertexCountReg];
+	const PICA::PrimType primType = static_cast<PICA::PrimType>(Helpers::getBits<8, 2>(regs[PrimitiveConfig]));
+	// Leave weird draws to the CPU path, which knows how to complain about them
+	if (vertexCount == 0 || vertexCount > Renderer::vertexBufferSize) [[unlikely]] {
+		return false;
+	}
+
+	if (!renderer->prepareForDraw(shaderUnit)) {
+		return false;
+	}
+
+	const u32 vertexBase = ((regs[VertexAttribLoc] >> 1) & 0xfffffff) * 16;
+	PICA::DrawAcceleration accel;
+
+	std::array<u32, VertexLoader::maxAttribCount> bufferAlignment;
+	for (int i = 0; i < maxAttribCount; i++) {
+		bufferAlignment[i] = (vertexBase + attributeInfo[i].offset) & 3;
+	}
+
+	if (!VertexLoader::buildLayout(accel.layout, regs, bufferAlignment)) {
+		return false;
+	}
+
+	accel.fixedAttributes = shaderUnit.vs.fixedAttributes.data();
+	accel.indexed = indexed;
+	accel.vertexCount = vertexCount;
+
+	if (indexed) {
+		const u32 indexBufferConfig = regs[IndexBufferConfig];
+		accel.shortIndices = Helpers::getBit<31>(indexBufferConfig);
+		const u32 indexBufferPointer = vertexBase + (indexBufferConfig & 0xfffffff);
+		const u32 indexBufferSize = vertexCount * (accel.shortIndices ? 2 : 1);
+		accel.indexBuffer = getPointerPhys<u8>(indexBufferPointer, indexBufferSize);
+		if (accel.indexBuffer == nullptr) {
+			return false;
 		}
+		mem.writeBackGPUOwned(indexBufferPointer, indexBufferSize);
+
+		// Find the range of vertices the draw uses, so that we only upload those
+		u32 minimumIndex = 0xffff;
+		u32 maximumIndex = 0;
+
+		for (u32 i = 0; i < vertexCount; i++) {
+			u32 index;
+			if (accel.shortIndices) {
+				u16 shortIndex;
+				std::memcpy(&shortIndex, &accel.indexBuffer[i * 2], sizeof(u16));
+				index = shortIndex;
+			} else {
+				index = accel.indexBuffer[i];
+			}
 
-		if constexpr (useShaderJIT) {
-			shaderJIT.run(shaderUnit.vs);
-		} else {
-			shaderUnit.vs.run();
+			minimumIndex = std::min(minimumIndex, index);
+			maximumIndex = std::max(maximumIndex, index);
 		}
 
-		PICA::Vertex& out = vertices[i];
-		// Map shader outputs to fixed function properties
-		const u32 totalShaderOutputs = regs[PICA::InternalRegs::ShaderOutputCount] & 7;
-		for (int i = 0; i < totalShaderOutputs; i++) {
-			const u32 config = regs[PICA::InternalRegs::ShaderOutmap0 + i];
+		accel.minimumIndex = minimumIndex;
+		accel.maximumIndex = maximumIndex;
+	} else {
+		accel.indexBuffer = nullptr;
+		accel.shortIndices = false;
+		accel.minimumIndex = regs[VertexOffsetReg];
+		accel.maximumIndex = accel.minimumIndex + vertexCount - 1;
+	}
+
+	for (u32 buffer = 0; buffer < accel.layout.bufferCount; buffer++) {
+		const u32 stride = accel.layout.strides[buffer];
+		// Number of bytes of each vertex that are actually read
+		u32 vertexSize = 0;
 
-			for (int j = 0; j < 4; j++) {  // pls unroll
-				const u32 mapping = (config >> (j * 8)) & 0x1F;
-				out.raw[mapping] = vsOutputRegisters[i][j];
+		for (u32 i = 0; i < accel.layout.attributeCount; i++) {
+			const auto& attr = accel.layout.attributes[i];
+			if (!attr.fixed && attr.buffer == buffer) {
+				vertexSize = std::max(vertexSize, attr.offset + attr.componentCount * VertexLoader::attribTypeSizes[attr.type]);
 			}
 		}
+
+		auto& vertexBuffer = accel.vertexBuffers[buffer];
+		if (vertexSize == 0) {  // Buffer with nothing but padding
+			vertexBuffer.data = nullptr;
+			vertexBuffer.size = 0;
+			continue;
+		}
+
+		// Host APIs treat a stride of 0 as tightly packed, rather than as every vertex being the same
+		if (stride == 0) {
+			return false;
+		}
+
+		const u32 vertexBufferPointer = vertexBase + attributeInfo[buffer].offset + accel.minimumIndex * stride;
+		vertexBuffer.size = (accel.maximumIndex - accel.minimumIndex) * stride + vertexSize;
+		vertexBuffer.data = getPointerPhys<u8>(vertexBufferPointer, vertexBuffer.size);
+		if (vertexBuffer.data == nullptr) {
+			return false;
+		}
+		mem.writeBackGPUOwned(vertexBufferPointer, vertexBuffer.size);
 	}
 
-	renderer->drawVertices(primType, std::span(vertices).first(vertexCount));
+	renderer->drawVerticesAccelerated(primType, accel);
+	return true;
+}
+
+bool GPU::prepareVertexLoader(u32 vertexBase, std::array<const u8*, VertexLoader::maxAttribCount>& bufferPointers) {
+	// The vertex loader JIT is opt-in until it's been verified against the interpreter on more hosts (see tests/vertex_loader.cpp)
+	if (!VertexLoaderJIT::isAvailable() || !config.shaderJitEnabled || !config.vertexLoaderJitEnabled) {
+		return false;
+	}
+
+	// Padding components depend on the alignment of each buffer, which the loader has to be compiled for
+	std::array<u32, VertexLoader::maxAttribCount> bufferAlignment;
+	for (int i = 0; i < maxAttribCount; i++) {
+		bufferAlignment[i] = (vertexBase + attributeInfo[i].offset) & 3;
+	}
+
+	if (!vertexLoaderJIT.prepare(regs, bufferAlignment)) {
+		return false;
+	}
+
+	for (u32 i = 0; i < vertexLoaderJIT.getLayout().bufferCount; i++) {
+		bufferPointers[i] = getPointerPhys<u8>(vertexBase + attributeInfo[i].offset);
+		// Let the interpreter deal with buffers outside of FCRAM and VRAM
+		if (bufferPointers[i] == nullptr) [[unlikely]] {
+			return false;
+		}
+	}
+
+	return true;
 }
 
 PICA::Vertex GPU::getImmediateModeVertex() {
@@ -376,7 +621,7 @@ PICA::Vertex GPU::getImmediateModeVertex() {
 
 		for (int j = 0; j < 4; j++) {  // pls unroll
 			const u32 mapping = (config >> (j * 8)) & 0x1F;
-			v.raw[mapping] = vsOutputRegisters[i][j];
+			v.raw[mapping] = shaderUnit.vs.outputs[vsOutputRegisters[i]][j];
 		}
 	}
 
@@ -406,8 +651,13 @@ void GPU::fireDMA(u32 dest, u32 source, u32 size) {
 
 	if (cpuToVRAM) [[likely]] {
 		// Valid, optimized FCRAM->VRAM DMA. TODO: Is VRAM->VRAM DMA allowed?
+		// The copy bypasses the Memory class, so write back any GPU surface data in the source and destination ourselves
+		mem.writeBackGPUOwned(source - fcramStart + PhysicalAddrs::FCRAM, size);
+		mem.writeBackGPUOwned(dest - vramStart + PhysicalAddrs::VRAM, size);
+
 		u8* fcram = mem.getFCRAM();
 		std::memcpy(&vram[dest - vramStart], &fcram[source - fcramStart], size);
+		mem.markPhysicalWrite(dest - vramStart + PhysicalAddrs::VRAM, size);
 	} else {
 		printf("Non-trivially optimizable GPU DMA. Falling back to byte-by-byte transfer\n");
 
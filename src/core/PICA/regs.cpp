@@ -79,7 +79,7 @@ u32 GPU::readInternalReg(u32 index) {
 void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 	using namespace PICA::InternalRegs;
 
-	if (index > regNum) [[unlikely]] {
+	if (index >= regNum) [[unlikely]] {
 		Helpers::panic("Tried to write to invalid GPU register. Index: %X, value: %08X\n", index, value);
 		return;
 	}
@@ -88,6 +88,11 @@ void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 	u32 newValue = (currentValue & ~mask) | (value & mask);  // Only overwrite the bits specified by "mask"
 	regs[index] = newValue;
 
+	// Games tend to rewrite all of their state before every draw, so only flag the registers that actually changed
+	if (newValue != currentValue) {
+		dirtyRegs |= dirtyGroups[index];
+	}
+
 	// TODO: Figure out if things like the shader index use the unmasked value or the masked one
 	// We currently use the unmasked value like Citra does
 	switch (index) {
@@ -135,6 +140,28 @@ void GPU::writeInternalReg(u32 index, u32 value, u32 mask) {
 			break;
 		}
 
+		// The size and type registers of a unit may not have been updated yet when its address is written, so wait for the type write
+		case Tex0Addr:
+			pendingTexturePrefetches |= 1 << 0;
+			break;
+
+		case Tex1Addr:
+			pendingTexturePrefetches |= 1 << 1;
+			break;
+
+		case Tex2Addr:
+			pendingTexturePrefetches |= 1 << 2;
+			break;
+
+		case Tex0Type:
+		case Tex1Type:
+		case Tex2Type: {
+			const u32 unit = index == Tex0Type ? 0 : (index == Tex1Type ? 1 : 2);
+			pendingTexturePrefetches &= ~(1u << unit);
+			renderer->prefetchTexture(unit);
+			break;
+		}
+
 		case FogLUTData0:
 		case FogLUTData1:
 		case FogLUTData2:
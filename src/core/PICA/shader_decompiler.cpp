@@ -32,14 +32,16 @@ ExitMode ControlFlow::analyzeFunction(const PICAShader& shader, u32 start, u32 e
 		const u32 opcode = instruction >> 26;
 
 		switch (opcode) {
-			case ShaderOpcodes::JMPC: Helpers::panic("Unimplemented control flow operation (JMPC)");
-			case ShaderOpcodes::JMPU: Helpers::panic("Unimplemented control flow operation (JMPU)");
-			case ShaderOpcodes::IFU: Helpers::panic("Unimplemented control flow operation (IFU)");
-			case ShaderOpcodes::IFC: Helpers::panic("Unimplemented control flow operation (IFC)");
-			case ShaderOpcodes::CALL: Helpers::panic("Unimplemented control flow operation (CALL)");
-			case ShaderOpcodes::CALLC: Helpers::panic("Unimplemented control flow operation (CALLC)");
-			case ShaderOpcodes::CALLU: Helpers::panic("Unimplemented control flow operation (CALLU)");
-			case ShaderOpcodes::LOOP: Helpers::panic("Unimplemented control flow operation (LOOP)");
+			// Control flow is not supported by the decompiler yet. Leave the exit mode as unknown so that we fall back to CPU shaders
+			case ShaderOpcodes::JMPC:
+			case ShaderOpcodes::JMPU:
+			case ShaderOpcodes::IFU:
+			case ShaderOpcodes::IFC:
+			case ShaderOpcodes::CALL:
+			case ShaderOpcodes::CALLC:
+			case ShaderOpcodes::CALLU:
+			case ShaderOpcodes::LOOP: return it->second;
+
 			case ShaderOpcodes::END: it->second = ExitMode::AlwaysEnd; return it->second;
 
 			default: break;
@@ -55,7 +57,7 @@ void ShaderDecompiler::compileRange(const AddressRange& range) {
 	const u32 end = range.end >= range.start ? range.end : PICAShader::maxInstructionCount;
 	bool finished = false;
 
-	while (pc < end && !finished) {
+	while (pc < end && !finished && !compilationError) {
 		compileInstruction(pc, finished);
 	}
 }
@@ -72,7 +74,7 @@ const Function* ShaderDecompiler::findFunction(const AddressRange& range) {
 
 void ShaderDecompiler::writeAttributes() {
 	decompiledShader += R"(
-		layout(location = 0) in vec4 inputs[8];
+		layout(location = 0) in vec4 inputs[16];
 
 		layout(std140) uniform PICAShaderUniforms {
 			vec4 uniform_float[96];
@@ -81,6 +83,7 @@ void ShaderDecompiler::writeAttributes() {
 		};
 	
 		vec4 temp_registers[16];
+		vec4 output_registers[16];
 		vec4 dummy_vec = vec4(0.0);
 )";
 
@@ -95,6 +98,7 @@ std::string ShaderDecompiler::decompile() {
 	}
 
 	decompiledShader = "";
+	compilationError = false;
 
 	switch (api) {
 		case API::GL: decompiledShader += "#version 410 core\n"; break;
@@ -107,9 +111,9 @@ std::string ShaderDecompiler::decompile() {
 	if (config.accurateShaderMul) {
 		// Safe multiplication handler from Citra: Handles the PICA's 0 * inf = 0 edge case
 		decompiledShader += R"(
-			vec4 safe_mul(vec4 a, vec4 b) {
-				vec4 res = a * b;
-				return mix(res, mix(mix(vec4(0.0), res, isnan(rhs)), product, isnan(lhs)), isnan(res));
+			vec4 safe_mul(vec4 lhs, vec4 rhs) {
+				vec4 product = lhs * rhs;
+				return mix(product, mix(mix(vec4(0.0), product, isnan(rhs)), product, isnan(lhs)), isnan(product));
 			}
 		)";
 	}
@@ -126,7 +130,7 @@ std::string ShaderDecompiler::decompile() {
 
 	for (auto& func : controlFlow.functions) {
 		if (func.outLabels.size() > 0) {
-			Helpers::panic("Function with out labels");
+			return "";
 		}
 
 		decompiledShader += "void " + func.getIdentifier() + "() {\n";
@@ -134,6 +138,11 @@ std::string ShaderDecompiler::decompile() {
 		decompiledShader += "}\n";
 	}
 
+	// We hit an instruction we can't decompile yet, so the shader needs to run on the CPU
+	if (compilationError) {
+		return "";
+	}
+
 	return decompiledShader;
 }
 
@@ -246,26 +255,37 @@ void ShaderDecompiler::compileInstruction(u32& pc, bool& finished) {
 
 		std::string dest = getDest(destIndex);
 
-		if (idx != 0) {
-			Helpers::panic("GLSL recompiler: Indexed instruction");
-		}
-
-		if (invertSources) {
-			Helpers::panic("GLSL recompiler: Inverted instruction");
+		if (idx != 0 || invertSources) {
+			compilationError = true;
+			return;
 		}
 
 		switch (opcode) {
 			case ShaderOpcodes::MOV: setDest(operandDescriptor, dest, src1); break;
 			case ShaderOpcodes::ADD: setDest(operandDescriptor, dest, src1 + " + " + src2); break;
-			case ShaderOpcodes::MUL: setDest(operandDescriptor, dest, src1 + " * " + src2); break;
+			case ShaderOpcodes::MUL:
+				if (config.accurateShaderMul) {
+					setDest(operandDescriptor, dest, "safe_mul(" + src1 + ", " + src2 + ")");
+				} else {
+					setDest(operandDescriptor, dest, src1 + " * " + src2);
+				}
+				break;
+
 			case ShaderOpcodes::MAX: setDest(operandDescriptor, dest, "max(" + src1 + ", " + src2 + ")"); break;
 			case ShaderOpcodes::MIN: setDest(operandDescriptor, dest, "min(" + src1 + ", " + src2 + ")"); break;
 
 			case ShaderOpcodes::DP3: setDest(operandDescriptor, dest, "vec4(dot(" + src1 + ".xyz, " + src2 + ".xyz))"); break;
 			case ShaderOpcodes::DP4: setDest(operandDescriptor, dest, "vec4(dot(" + src1 + ", " + src2 + "))"); break;
+			case ShaderOpcodes::DPH: setDest(operandDescriptor, dest, "vec4(dot(vec4(" + src1 + ".xyz, 1.0), " + src2 + "))"); break;
 			case ShaderOpcodes::RSQ: setDest(operandDescriptor, dest, "vec4(inversesqrt(" + src1 + ".x))"); break;
-
-			default: Helpers::panic("GLSL recompiler: Unknown common opcode: %X", opcode); break;
+			case ShaderOpcodes::RCP: setDest(operandDescriptor, dest, "vec4(1.0 / " + src1 + ".x)"); break;
+			case ShaderOpcodes::EX2: setDest(operandDescriptor, dest, "vec4(exp2(" + src1 + ".x))"); break;
+			case ShaderOpcodes::LG2: setDest(operandDescriptor, dest, "vec4(log2(" + src1 + ".x))"); break;
+			case ShaderOpcodes::FLR: setDest(operandDescriptor, dest, "floor(" + src1 + ")"); break;
+			case ShaderOpcodes::SLT: setDest(operandDescriptor, dest, "vec4(lessThan(" + src1 + ", " + src2 + "))"); break;
+			case ShaderOpcodes::SGE: setDest(operandDescriptor, dest, "vec4(greaterThanEqual(" + src1 + ", " + src2 + "))"); break;
+
+			default: compilationError = true; return;
 		}
 	} else if (opcode >= 0x30 && opcode <= 0x3F) { // MAD and MADI
 		const u32 operandDescriptor = shader.operandDescriptors[instruction & 0x1f];
@@ -301,14 +321,21 @@ void ShaderDecompiler::compileInstruction(u32& pc, bool& finished) {
 		std::string dest = getDest(destIndex);
 
 		if (idx != 0) {
-			Helpers::panic("GLSL recompiler: Indexed instruction");
+			compilationError = true;
+			return;
 		}
 
-		setDest(operandDescriptor, dest, src1 + " * " + src2 + " + " + src3);
+		// Like MUL, the product has to follow the PICA's 0 * inf = 0 rule when accurate multiplication is on
+		if (config.accurateShaderMul) {
+			setDest(operandDescriptor, dest, "safe_mul(" + src1 + ", " + src2 + ") + " + src3);
+		} else {
+			setDest(operandDescriptor, dest, src1 + " * " + src2 + " + " + src3);
+		}
 	} else {
 		switch (opcode) {
 			case ShaderOpcodes::END: finished = true; return;
-			default: Helpers::panic("GLSL recompiler: Unknown opcode: %X", opcode); break;
+			case ShaderOpcodes::NOP: break;
+			default: compilationError = true; return;
 		}
 	}
 
@@ -1,4 +1,5 @@
 #include "PICA/pica_frag_config.hpp"
+#include "PICA/pica_vert_config.hpp"
 #include "PICA/regs.hpp"
 #include "PICA/shader_gen.hpp"
 using namespace PICA;
@@ -32,6 +33,38 @@ static constexpr const char* uniformDefinition = R"(
 	};
 )";
 
+// Varyings passed from the vertex shader to the shadergen fragment shaders
+static constexpr const char* vertexShaderOutputs = R"(
+		out vec4 v_quaternion;
+		out vec4 v_colour;
+		out vec3 v_texcoord0;
+		out vec2 v_texcoord1;
+		out vec3 v_view;
+		out vec2 v_texcoord2;
+
+	#ifndef USING_GLES
+		out float gl_ClipDistance[2];
+	#endif
+)";
+
+// Computes the varyings from the fixed-function vertex attributes (a_coords, a_vertexColour, etc)
+static constexpr const char* vertexShaderFixedFunction = R"(
+			gl_Position = a_coords;
+			vec4 colourAbs = abs(a_vertexColour);
+			v_colour = min(colourAbs, vec4(1.f));
+
+			v_texcoord0 = vec3(a_texcoord0.x, 1.0 - a_texcoord0.y, a_texcoord0_w);
+			v_texcoord1 = vec2(a_texcoord1.x, 1.0 - a_texcoord1.y);
+			v_texcoord2 = vec2(a_texcoord2.x, 1.0 - a_texcoord2.y);
+			v_view = a_view;
+			v_quaternion = a_quaternion;
+
+		#ifndef USING_GLES
+			gl_ClipDistance[0] = -a_coords.z;
+			gl_ClipDistance[1] = dot(clipCoords, a_coords);
+		#endif
+)";
+
 std::string FragmentGenerator::getDefaultVertexShader() {
 	std::string ret = "";
 
@@ -61,36 +94,73 @@ std::string FragmentGenerator::getDefaultVertexShader() {
 		layout(location = 5) in float a_texcoord0_w;
 		layout(location = 6) in vec3 a_view;
 		layout(location = 7) in vec2 a_texcoord2;
+)";
 
-		out vec4 v_quaternion;
-		out vec4 v_colour;
-		out vec3 v_texcoord0;
-		out vec2 v_texcoord1;
-		out vec3 v_view;
-		out vec2 v_texcoord2;
+	ret += vertexShaderOutputs;
+	ret += "\n\t\tvoid main() {";
+	ret += vertexShaderFixedFunction;
+	ret += "\t\t}\n";
 
-	#ifndef USING_GLES
-		out float gl_ClipDistance[2];
-	#endif
+	return ret;
+}
+
+std::string FragmentGenerator::getVertexShaderAccelerated(const std::string& picaSource, const PICA::VertexConfig& vertConfig) {
+	// The decompiled PICA shader starts with the #version directive, so it goes first
+	std::string ret = picaSource;
+	ret += uniformDefinition;
+	ret += vertexShaderOutputs;
+
+	ret += R"(
+		// Fixed-function attributes as written by the PICA shader, laid out like PICA::Vertex
+		float out_attr[32];
 
 		void main() {
-			gl_Position = a_coords;
-			vec4 colourAbs = abs(a_vertexColour);
-			v_colour = min(colourAbs, vec4(1.f));
+			for (int i = 0; i < 32; i++) {
+				out_attr[i] = 0.0;
+			}
 
-			v_texcoord0 = vec3(a_texcoord0.x, 1.0 - a_texcoord0.y, a_texcoord0_w);
-			v_texcoord1 = vec2(a_texcoord1.x, 1.0 - a_texcoord1.y);
-			v_texcoord2 = vec2(a_texcoord2.x, 1.0 - a_texcoord2.y);
-			v_view = a_view;
-			v_quaternion = a_quaternion;
+			pica_shader_main();
+)";
 
-		#ifndef USING_GLES
-			gl_ClipDistance[0] = -a_coords.z;
-			gl_ClipDistance[1] = dot(clipCoords, a_coords);
-		#endif
+	// The outmap registers refer to the enabled output registers in order, same as GPU::setVsOutputMask
+	std::array<u32, 16> outputRegisters;
+	u32 count = 0;
+	for (u32 i = 0; i < 16; i++) {
+		if (vertConfig.outputMask & (1u << i)) {
+			outputRegisters[count++] = i;
 		}
+	}
+
+	for (; count < 16; count++) {
+		outputRegisters[count] = count;
+	}
+
+	// Map the shader outputs to fixed-function attributes
+	static constexpr std::array<char, 4> components = {'x', 'y', 'z', 'w'};
+	for (u32 i = 0; i < vertConfig.outputCount; i++) {
+		const u32 config = vertConfig.outmaps[i];
+
+		for (u32 j = 0; j < 4; j++) {
+			const u32 mapping = (config >> (j * 8)) & 0x1F;
+			ret += "\t\t\tout_attr[" + std::to_string(mapping) + "] = output_registers[" + std::to_string(outputRegisters[i]) + "]." +
+				   components[j] + ";\n";
+		}
+	}
+
+	ret += R"(
+			vec4 a_coords = vec4(out_attr[0], out_attr[1], out_attr[2], out_attr[3]);
+			vec4 a_quaternion = vec4(out_attr[4], out_attr[5], out_attr[6], out_attr[7]);
+			vec4 a_vertexColour = vec4(out_attr[8], out_attr[9], out_attr[10], out_attr[11]);
+			vec2 a_texcoord0 = vec2(out_attr[12], out_attr[13]);
+			vec2 a_texcoord1 = vec2(out_attr[14], out_attr[15]);
+			float a_texcoord0_w = out_attr[16];
+			vec3 a_view = vec3(out_attr[18], out_attr[19], out_attr[20]);
+			vec2 a_texcoord2 = vec2(out_attr[22], out_attr[23]);
 )";
 
+	ret += vertexShaderFixedFunction;
+	ret += "\t\t}\n";
+
 	return ret;
 }
 
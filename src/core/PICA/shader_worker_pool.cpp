@@ -0,0 +1,95 @@
+#include "PICA/shader_worker_pool.hpp"
+
+#include <algorithm>
+
+void ShaderWorkerPool::start(u32 workerCount) {
+	workerCount = std::clamp<u32>(workerCount, 1, maxWorkerCount);
+	if (getWorkerCount() == workerCount) {
+		return;
+	}
+
+	stop();
+	stopping = false;
+
+	for (u32 i = 1; i < workerCount; i++) {
+		threads.emplace_back(&ShaderWorkerPool::workerLoop, this, i, jobGeneration);
+	}
+}
+
+void ShaderWorkerPool::stop() {
+	if (threads.empty()) {
+		return;
+	}
+
+	{
+		std::unique_lock lock(mutex);
+		stopping = true;
+	}
+	startCondition.notify_all();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+void ShaderWorkerPool::runRange(const Job& job, u32 worker, u32 count) {
+	const u32 workerCount = getWorkerCount();
+	const u32 rangeSize = (count + workerCount - 1) / workerCount;
+	const u32 begin = std::min(worker * rangeSize, count);
+	const u32 end = std::min(begin + rangeSize, count);
+
+	if (begin != end) {
+		job(worker, begin, end);
+	}
+}
+
+void ShaderWorkerPool::run(u32 count, const Job& job) {
+	if (threads.empty()) {
+		job(0, 0, count);
+		return;
+	}
+
+	{
+		std::unique_lock lock(mutex);
+		currentJob = &job;
+		jobSize = count;
+		pendingWorkers = u32(threads.size());
+		jobGeneration++;
+	}
+	startCondition.notify_all();
+
+	// The calling thread takes the first range
+	runRange(job, 0, count);
+
+	std::unique_lock lock(mutex);
+	doneCondition.wait(lock, [this]() { return pendingWorkers == 0; });
+	currentJob = nullptr;
+}
+
+void ShaderWorkerPool::workerLoop(u32 worker, u64 lastGeneration) {
+	while (true) {
+		const Job* job;
+		u32 count;
+
+		{
+			std::unique_lock lock(mutex);
+			startCondition.wait(lock, [&]() { return stopping || jobGeneration != lastGeneration; });
+
+			if (stopping) {
+				return;
+			}
+
+			lastGeneration = jobGeneration;
+			job = currentJob;
+			count = jobSize;
+		}
+
+		runRange(*job, worker, count);
+
+		std::unique_lock lock(mutex);
+		if (--pendingWorkers == 0) {
+			doneCondition.notify_one();
+		}
+	}
+}
@@ -0,0 +1,129 @@
+#include "PICA/texture_decode_queue.hpp"
+
+#include <algorithm>
+
+#include "PICA/texture_decoder.hpp"
+
+void TextureDecodeQueue::start(u32 threadCount) {
+	stop();
+	stopping = false;
+
+	for (u32 i = 0; i < threadCount; i++) {
+		threads.emplace_back(&TextureDecodeQueue::workerLoop, this);
+	}
+}
+
+void TextureDecodeQueue::stop() {
+	if (threads.empty()) {
+		return;
+	}
+
+	{
+		std::unique_lock lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+
+	pendingJobs.clear();
+	jobs.clear();
+}
+
+void TextureDecodeQueue::decode(Job& job) {
+	job.hash = PICAHash::computeHash(reinterpret_cast<const char*>(job.data.data()), job.data.size());
+	job.decoded.resize(job.width * job.height);
+	PICA::TextureDecoder::decode(job.format, job.width, job.height, job.data, job.decoded);
+}
+
+bool TextureDecodeQueue::contains(u32 location, PICA::TextureFmt format, u32 width, u32 height) {
+	std::unique_lock lock(mutex);
+	return jobs.contains(getKey(location, format, width, height));
+}
+
+void TextureDecodeQueue::submit(u32 location, PICA::TextureFmt format, u32 width, u32 height, u64 writeStamp, std::span<const u8> data) {
+	const u64 key = getKey(location, format, width, height);
+	auto job = std::make_shared<Job>();
+	job->location = location;
+	job->format = format;
+	job->width = width;
+	job->height = height;
+	job->writeStamp = writeStamp;
+	job->data.assign(data.begin(), data.end());
+
+	{
+		std::unique_lock lock(mutex);
+		if (!jobs.try_emplace(key, job).second) {
+			return;
+		}
+		pendingJobs.push_back(std::move(job));
+	}
+	workAvailable.notify_one();
+}
+
+TextureDecodeQueue::JobPtr TextureDecodeQueue::take(u32 location, PICA::TextureFmt format, u32 width, u32 height) {
+	std::unique_lock lock(mutex);
+	auto it = jobs.find(getKey(location, format, width, height));
+	if (it == jobs.end()) {
+		return nullptr;
+	}
+
+	JobPtr job = std::move(it->second);
+	jobs.erase(it);
+
+	// If the job hasn't started yet, decoding it ourselves is faster than waiting for a worker to get to it
+	if (auto pending = std::find(pendingJobs.begin(), pendingJobs.end(), job); pending != pendingJobs.end()) {
+		pendingJobs.erase(pending);
+		lock.unlock();
+
+		decode(*job);
+		job->done = true;
+		return job;
+	}
+
+	jobDone.wait(lock, [&]() { return job->done; });
+	return job;
+}
+
+std::vector<TextureDecodeQueue::JobPtr> TextureDecodeQueue::takeAll() {
+	std::unique_lock lock(mutex);
+	std::vector<JobPtr> result;
+	result.reserve(jobs.size());
+
+	for (auto& [key, job] : jobs) {
+		result.push_back(std::move(job));
+	}
+
+	jobs.clear();
+	pendingJobs.clear();
+	return result;
+}
+
+void TextureDecodeQueue::workerLoop() {
+	while (true) {
+		JobPtr job;
+
+		{
+			std::unique_lock lock(mutex);
+			workAvailable.wait(lock, [this]() { return stopping || !pendingJobs.empty(); });
+
+			if (stopping) {
+				return;
+			}
+
+			job = std::move(pendingJobs.front());
+			pendingJobs.pop_front();
+		}
+
+		decode(*job);
+
+		{
+			std::unique_lock lock(mutex);
+			job->done = true;
+		}
+		jobDone.notify_all();
+	}
+}
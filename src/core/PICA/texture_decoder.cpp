@@ -0,0 +1,473 @@
+#include "PICA/texture_decoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "colour.hpp"
+
+// Pick the SIMD kernels based on what the compiler targets. SSE2 is always available on x64 and NEON is always available on arm64
+#if defined(__SSE2__) || defined(_M_X64)
+#define PICA_TEXTURE_DECODER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PICA_TEXTURE_DECODER_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace PICA;
+using namespace Helpers;
+
+namespace {
+	constexpr u32 tileTexels = 64;
+
+	constexpr u32 rgba(u32 r, u32 g, u32 b, u32 a) { return r | (g << 8) | (b << 16) | (a << 24); }
+
+	// Scalar conversion of a single 16-bit texel, used when there's no SIMD support
+	template <TextureFmt format>
+	u32 convertTexel16(u16 texel) {
+		if constexpr (format == TextureFmt::RGBA5551) {
+			const u8 r = Colour::convert5To8Bit(getBits<11, 5, u8>(texel));
+			const u8 g = Colour::convert5To8Bit(getBits<6, 5, u8>(texel));
+			const u8 b = Colour::convert5To8Bit(getBits<1, 5, u8>(texel));
+			return rgba(r, g, b, getBit<0>(texel) ? 0xff : 0);
+		} else if constexpr (format == TextureFmt::RGB565) {
+			const u8 r = Colour::convert5To8Bit(getBits<11, 5, u8>(texel));
+			const u8 g = Colour::convert6To8Bit(getBits<5, 6, u8>(texel));
+			const u8 b = Colour::convert5To8Bit(getBits<0, 5, u8>(texel));
+			return rgba(r, g, b, 0xff);
+		} else if constexpr (format == TextureFmt::RGBA4) {
+			const u8 r = Colour::convert4To8Bit(getBits<12, 4, u8>(texel));
+			const u8 g = Colour::convert4To8Bit(getBits<8, 4, u8>(texel));
+			const u8 b = Colour::convert4To8Bit(getBits<4, 4, u8>(texel));
+			const u8 a = Colour::convert4To8Bit(getBits<0, 4, u8>(texel));
+			return rgba(r, g, b, a);
+		} else if constexpr (format == TextureFmt::IA8) {
+			// Intensity formats copy the intensity to every colour channel
+			const u8 intensity = texel >> 8;
+			return rgba(intensity, intensity, intensity, texel & 0xff);
+		} else if constexpr (format == TextureFmt::RG8) {
+			return rgba(texel >> 8, texel & 0xff, 0, 0xff);
+		}
+	}
+
+	// Scalar conversion of a single 8-bit texel. 4-bit formats get their texels expanded to 8 bits first
+	template <TextureFmt format>
+	u32 convertTexel8(u8 texel) {
+		if constexpr (format == TextureFmt::I8 || format == TextureFmt::I4) {
+			return rgba(texel, texel, texel, 0xff);
+		} else if constexpr (format == TextureFmt::A8 || format == TextureFmt::A4) {
+			return rgba(0, 0, 0, texel);
+		} else if constexpr (format == TextureFmt::IA4) {
+			const u8 intensity = Colour::convert4To8Bit(texel >> 4);
+			return rgba(intensity, intensity, intensity, Colour::convert4To8Bit(texel & 0xf));
+		}
+	}
+
+#if defined(PICA_TEXTURE_DECODER_SSE2)
+	// r, g, b and a hold one 8-bit channel in each 16-bit lane. Interleave them into 8 RGBA8 texels
+	inline void storeChannels(u32* out, __m128i r, __m128i g, __m128i b, __m128i a) {
+		const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+		const __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(rg, ba));
+	}
+
+	inline __m128i expand4(__m128i c) { return _mm_or_si128(_mm_slli_epi16(c, 4), c); }
+	inline __m128i expand5(__m128i c) { return _mm_or_si128(_mm_slli_epi16(c, 3), _mm_srli_epi16(c, 2)); }
+	inline __m128i expand6(__m128i c) { return _mm_or_si128(_mm_slli_epi16(c, 2), _mm_srli_epi16(c, 4)); }
+
+	// Convert 8 texels of a 16-bit format
+	template <TextureFmt format>
+	inline void convert8Texels16(const u8* in, u32* out) {
+		const __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		const __m128i mask4 = _mm_set1_epi16(0xf);
+		const __m128i mask5 = _mm_set1_epi16(0x1f);
+		const __m128i mask6 = _mm_set1_epi16(0x3f);
+		const __m128i mask8 = _mm_set1_epi16(0xff);
+
+		if constexpr (format == TextureFmt::RGBA5551) {
+			const __m128i r = expand5(_mm_srli_epi16(texels, 11));
+			const __m128i g = expand5(_mm_and_si128(_mm_srli_epi16(texels, 6), mask5));
+			const __m128i b = expand5(_mm_and_si128(_mm_srli_epi16(texels, 1), mask5));
+			// 0 - 1 = 0xFFFF, so this turns the alpha bit into 0 or 0xFF
+			const __m128i a = _mm_and_si128(_mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(texels, _mm_set1_epi16(1))), mask8);
+			storeChannels(out, r, g, b, a);
+		} else if constexpr (format == TextureFmt::RGB565) {
+			const __m128i r = expand5(_mm_srli_epi16(texels, 11));
+			const __m128i g = expand6(_mm_and_si128(_mm_srli_epi16(texels, 5), mask6));
+			const __m128i b = expand5(_mm_and_si128(texels, mask5));
+			storeChannels(out, r, g, b, mask8);
+		} else if constexpr (format == TextureFmt::RGBA4) {
+			const __m128i r = expand4(_mm_srli_epi16(texels, 12));
+			const __m128i g = expand4(_mm_and_si128(_mm_srli_epi16(texels, 8), mask4));
+			const __m128i b = expand4(_mm_and_si128(_mm_srli_epi16(texels, 4), mask4));
+			const __m128i a = expand4(_mm_and_si128(texels, mask4));
+			storeChannels(out, r, g, b, a);
+		} else if constexpr (format == TextureFmt::IA8) {
+			const __m128i intensity = _mm_srli_epi16(texels, 8);
+			storeChannels(out, intensity, intensity, intensity, _mm_and_si128(texels, mask8));
+		} else if constexpr (format == TextureFmt::RG8) {
+			storeChannels(out, _mm_srli_epi16(texels, 8), _mm_and_si128(texels, mask8), _mm_setzero_si128(), mask8);
+		}
+	}
+
+	// Convert 16 texels of an 8-bit format, or of a 4-bit format that has been expanded to 8 bits per texel
+	template <TextureFmt format>
+	inline void convert16Texels8(__m128i texels, u32* out) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i opaque = _mm_set1_epi16(0xff);
+		const __m128i halves[2] = {_mm_unpacklo_epi8(texels, zero), _mm_unpackhi_epi8(texels, zero)};
+
+		for (int i = 0; i < 2; i++) {
+			const __m128i value = halves[i];
+
+			if constexpr (format == TextureFmt::I8 || format == TextureFmt::I4) {
+				storeChannels(out + i * 8, value, value, value, opaque);
+			} else if constexpr (format == TextureFmt::A8 || format == TextureFmt::A4) {
+				storeChannels(out + i * 8, zero, zero, zero, value);
+			} else if constexpr (format == TextureFmt::IA4) {
+				const __m128i intensity = expand4(_mm_srli_epi16(value, 4));
+				const __m128i alpha = expand4(_mm_and_si128(value, _mm_set1_epi16(0xf)));
+				storeChannels(out + i * 8, intensity, intensity, intensity, alpha);
+			}
+		}
+	}
+#elif defined(PICA_TEXTURE_DECODER_NEON)
+	// r, g, b and a hold one 8-bit channel in each 16-bit lane. Interleave them into 8 RGBA8 texels
+	inline void storeChannels(u32* out, uint16x8_t r, uint16x8_t g, uint16x8_t b, uint16x8_t a) {
+		const uint8x8x4_t texels = {{vmovn_u16(r), vmovn_u16(g), vmovn_u16(b), vmovn_u16(a)}};
+		vst4_u8(reinterpret_cast<u8*>(out), texels);
+	}
+
+	inline uint16x8_t expand4(uint16x8_t c) { return vorrq_u16(vshlq_n_u16(c, 4), c); }
+	inline uint16x8_t expand5(uint16x8_t c) { return vorrq_u16(vshlq_n_u16(c, 3), vshrq_n_u16(c, 2)); }
+	inline uint16x8_t expand6(uint16x8_t c) { return vorrq_u16(vshlq_n_u16(c, 2), vshrq_n_u16(c, 4)); }
+
+	// Convert 8 texels of a 16-bit format
+	template <TextureFmt format>
+	inline void convert8Texels16(const u8* in, u32* out) {
+		const uint16x8_t texels = vreinterpretq_u16_u8(vld1q_u8(in));
+		const uint16x8_t mask4 = vdupq_n_u16(0xf);
+		const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+		const uint16x8_t mask6 = vdupq_n_u16(0x3f);
+		const uint16x8_t mask8 = vdupq_n_u16(0xff);
+
+		if constexpr (format == TextureFmt::RGBA5551) {
+			const uint16x8_t r = expand5(vshrq_n_u16(texels, 11));
+			const uint16x8_t g = expand5(vandq_u16(vshrq_n_u16(texels, 6), mask5));
+			const uint16x8_t b = expand5(vandq_u16(vshrq_n_u16(texels, 1), mask5));
+			const uint16x8_t a = vtstq_u16(texels, vdupq_n_u16(1));  // All ones if the alpha bit is set, narrowed to 0xFF
+			storeChannels(out, r, g, b, a);
+		} else if constexpr (format == TextureFmt::RGB565) {
+			const uint16x8_t r = expand5(vshrq_n_u16(texels, 11));
+			const uint16x8_t g = expand6(vandq_u16(vshrq_n_u16(texels, 5), mask6));
+			const uint16x8_t b = expand5(vandq_u16(texels, mask5));
+			storeChannels(out, r, g, b, mask8);
+		} else if constexpr (format == TextureFmt::RGBA4) {
+			const uint16x8_t r = expand4(vshrq_n_u16(texels, 12));
+			const uint16x8_t g = expand4(vandq_u16(vshrq_n_u16(texels, 8), mask4));
+			const uint16x8_t b = expand4(vandq_u16(vshrq_n_u16(texels, 4), mask4));
+			const uint16x8_t a = expand4(vandq_u16(texels, mask4));
+			storeChannels(out, r, g, b, a);
+		} else if constexpr (format == TextureFmt::IA8) {
+			const uint16x8_t intensity = vshrq_n_u16(texels, 8);
+			storeChannels(out, intensity, intensity, intensity, vandq_u16(texels, mask8));
+		} else if constexpr (format == TextureFmt::RG8) {
+			storeChannels(out, vshrq_n_u16(texels, 8), vandq_u16(texels, mask8), vdupq_n_u16(0), mask8);
+		}
+	}
+
+	// Convert 16 texels of an 8-bit format, or of a 4-bit format that has been expanded to 8 bits per texel
+	template <TextureFmt format>
+	inline void convert16Texels8(uint8x16_t texels, u32* out) {
+		const uint8x16_t zero = vdupq_n_u8(0);
+		const uint8x16_t opaque = vdupq_n_u8(0xff);
+		uint8x16x4_t result;
+
+		if constexpr (format == TextureFmt::I8 || format == TextureFmt::I4) {
+			result = {{texels, texels, texels, opaque}};
+		} else if constexpr (format == TextureFmt::A8 || format == TextureFmt::A4) {
+			result = {{zero, zero, zero, texels}};
+		} else if constexpr (format == TextureFmt::IA4) {
+			const uint8x16_t low = vandq_u8(texels, vdupq_n_u8(0xf));
+			const uint8x16_t intensity = vorrq_u8(vshrq_n_u8(texels, 4), vandq_u8(texels, vdupq_n_u8(0xf0)));
+			const uint8x16_t alpha = vorrq_u8(vshlq_n_u8(low, 4), low);
+			result = {{intensity, intensity, intensity, alpha}};
+		}
+
+		vst4q_u8(reinterpret_cast<u8*>(out), result);
+	}
+#endif
+
+	// Convert the 64 texels of a tile to RGBA8, keeping them in Morton order
+	template <TextureFmt format>
+	void convertTile(const u8* in, u32* out) {
+		if constexpr (format == TextureFmt::RGBA8) {
+			// Texels are stored as ABGR, so we just need to reverse the bytes of each texel
+#if defined(PICA_TEXTURE_DECODER_SSE2)
+			const __m128i mask = _mm_set1_epi32(0x00ff00ff);
+			for (u32 i = 0; i < tileTexels; i += 4) {
+				__m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4));
+				// Swap the bytes of each 16-bit half, then swap the halves
+				texels = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(texels, 8), mask), _mm_slli_epi16(_mm_and_si128(texels, mask), 8));
+				texels = _mm_shufflelo_epi16(_mm_shufflehi_epi16(texels, 0xB1), 0xB1);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), texels);
+			}
+#elif defined(PICA_TEXTURE_DECODER_NEON)
+			for (u32 i = 0; i < tileTexels; i += 4) {
+				vst1q_u8(reinterpret_cast<u8*>(out + i), vrev32q_u8(vld1q_u8(in + i * 4)));
+			}
+#else
+			for (u32 i = 0; i < tileTexels; i++) {
+				const u8* texel = in + i * 4;
+				out[i] = rgba(texel[3], texel[2], texel[1], texel[0]);
+			}
+#endif
+		} else if constexpr (format == TextureFmt::RGB8) {
+			// Texels are stored as BGR
+#if defined(PICA_TEXTURE_DECODER_NEON)
+			for (u32 i = 0; i < tileTexels; i += 16) {
+				const uint8x16x3_t bgr = vld3q_u8(in + i * 3);
+				const uint8x16x4_t texels = {{bgr.val[2], bgr.val[1], bgr.val[0], vdupq_n_u8(0xff)}};
+				vst4q_u8(reinterpret_cast<u8*>(out + i), texels);
+			}
+#else
+			for (u32 i = 0; i < tileTexels; i++) {
+				const u8* texel = in + i * 3;
+				out[i] = rgba(texel[2], texel[1], texel[0], 0xff);
+			}
+#endif
+		} else if constexpr (
+			format == TextureFmt::RGBA5551 || format == TextureFmt::RGB565 || format == TextureFmt::RGBA4 || format == TextureFmt::IA8 ||
+			format == TextureFmt::RG8
+		) {
+#if defined(PICA_TEXTURE_DECODER_SSE2) || defined(PICA_TEXTURE_DECODER_NEON)
+			for (u32 i = 0; i < tileTexels; i += 8) {
+				convert8Texels16<format>(in + i * 2, out + i);
+			}
+#else
+			for (u32 i = 0; i < tileTexels; i++) {
+				out[i] = convertTexel16<format>(u16(in[i * 2]) | (u16(in[i * 2 + 1]) << 8));
+			}
+#endif
+		} else if constexpr (format == TextureFmt::I8 || format == TextureFmt::A8 || format == TextureFmt::IA4) {
+#if defined(PICA_TEXTURE_DECODER_SSE2)
+			for (u32 i = 0; i < tileTexels; i += 16) {
+				convert16Texels8<format>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), out + i);
+			}
+#elif defined(PICA_TEXTURE_DECODER_NEON)
+			for (u32 i = 0; i < tileTexels; i += 16) {
+				convert16Texels8<format>(vld1q_u8(in + i), out + i);
+			}
+#else
+			for (u32 i = 0; i < tileTexels; i++) {
+				out[i] = convertTexel8<format>(in[i]);
+			}
+#endif
+		} else if constexpr (format == TextureFmt::I4 || format == TextureFmt::A4) {
+			// Even texels are in the low nibble of each byte and odd texels in the high nibble. Expand them to 8 bits and reuse the 8-bit path
+#if defined(PICA_TEXTURE_DECODER_SSE2)
+			const __m128i mask = _mm_set1_epi8(0xf);
+			for (u32 i = 0; i < tileTexels; i += 32) {
+				const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i / 2));
+				const __m128i low = _mm_and_si128(bytes, mask);
+				const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+				// Nibbles are at most 0xF, so the 16-bit shifts can't carry into the neighbouring byte
+				const __m128i texels0 = _mm_unpacklo_epi8(low, high);
+				const __m128i texels1 = _mm_unpackhi_epi8(low, high);
+				convert16Texels8<format>(_mm_or_si128(_mm_slli_epi16(texels0, 4), texels0), out + i);
+				convert16Texels8<format>(_mm_or_si128(_mm_slli_epi16(texels1, 4), texels1), out + i + 16);
+			}
+#elif defined(PICA_TEXTURE_DECODER_NEON)
+			for (u32 i = 0; i < tileTexels; i += 32) {
+				const uint8x16_t bytes = vld1q_u8(in + i / 2);
+				const uint8x16x2_t texels = vzipq_u8(vandq_u8(bytes, vdupq_n_u8(0xf)), vshrq_n_u8(bytes, 4));
+				convert16Texels8<format>(vorrq_u8(vshlq_n_u8(texels.val[0], 4), texels.val[0]), out + i);
+				convert16Texels8<format>(vorrq_u8(vshlq_n_u8(texels.val[1], 4), texels.val[1]), out + i + 16);
+			}
+#else
+			for (u32 i = 0; i < tileTexels; i++) {
+				const u8 nibble = (in[i / 2] >> ((i & 1) * 4)) & 0xf;
+				out[i] = convertTexel8<format>(Colour::convert4To8Bit(nibble));
+			}
+#endif
+		}
+	}
+
+	// Write a tile that was converted in Morton order to the 8 rows it covers
+	// The 8 texels of a row are stored in pairs at Morton offsets 0, 4, 16 and 20 from the first texel of the row
+	void storeTile(const u32* tile, u32* out, u32 width) {
+		static constexpr std::array<u32, 8> rowOffsets = {0, 2, 8, 10, 32, 34, 40, 42};
+
+		for (u32 y = 0; y < 8; y++) {
+			const u32* row = tile + rowOffsets[y];
+			u32* dest = out + y * width;
+
+			std::memcpy(dest + 0, row + 0, 2 * sizeof(u32));
+			std::memcpy(dest + 2, row + 4, 2 * sizeof(u32));
+			std::memcpy(dest + 4, row + 16, 2 * sizeof(u32));
+			std::memcpy(dest + 6, row + 20, 2 * sizeof(u32));
+		}
+	}
+
+	constexpr u32 signExtend3To32(u32 val) { return (u32)(s32(val) << 29 >> 29); }
+
+	// Decode a 4x4 ETC1 block to the output. alphaData holds the 4-bit alpha of each texel for ETC1A4, and is all ones for ETC1
+	// Texels are numbered column by column in both the colour and alpha data
+	void decodeETCBlock(u64 colourData, u64 alphaData, u32* out, u32 width) {
+		static constexpr u32 modifiers[8][2] = {
+			{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183},
+		};
+
+		const u32 subindices = getBits<0, 16, u32>(colourData);
+		const u32 negationFlags = getBits<16, 16, u32>(colourData);
+		const bool flip = getBit<32>(colourData);
+		const bool diffMode = getBit<33>(colourData);
+		// Note: The table index of the first sub-block is indeed stored on the higher bits
+		const u32 tableIndices[2] = {getBits<37, 3, u32>(colourData), getBits<34, 3, u32>(colourData)};
+
+		// Base colours of the two sub-blocks, expanded to 8 bits per channel
+		std::array<std::array<s32, 3>, 2> baseColours;
+		if (diffMode) {
+			const s32 r = getBits<59, 5, s32>(colourData);
+			const s32 g = getBits<51, 5, s32>(colourData);
+			const s32 b = getBits<43, 5, s32>(colourData);
+			const s32 r2 = r + signExtend3To32(getBits<56, 3, u32>(colourData));
+			const s32 g2 = g + signExtend3To32(getBits<48, 3, u32>(colourData));
+			const s32 b2 = b + signExtend3To32(getBits<40, 3, u32>(colourData));
+
+			baseColours[0] = {Colour::convert5To8Bit(r), Colour::convert5To8Bit(g), Colour::convert5To8Bit(b)};
+			baseColours[1] = {Colour::convert5To8Bit(r2), Colour::convert5To8Bit(g2), Colour::convert5To8Bit(b2)};
+		} else {
+			baseColours[0] = {
+				Colour::convert4To8Bit(getBits<60, 4, u8>(colourData)), Colour::convert4To8Bit(getBits<52, 4, u8>(colourData)),
+				Colour::convert4To8Bit(getBits<44, 4, u8>(colourData)),
+			};
+			baseColours[1] = {
+				Colour::convert4To8Bit(getBits<56, 4, u8>(colourData)), Colour::convert4To8Bit(getBits<48, 4, u8>(colourData)),
+				Colour::convert4To8Bit(getBits<40, 4, u8>(colourData)),
+			};
+		}
+
+		// Each sub-block can only produce 4 colours, indexed by (negation bit << 1) | subindex bit. Compute them once per block
+		std::array<std::array<u32, 4>, 2> palettes;
+		for (int block = 0; block < 2; block++) {
+			for (int i = 0; i < 4; i++) {
+				const s32 modifier = (i & 2) ? -s32(modifiers[tableIndices[block]][i & 1]) : s32(modifiers[tableIndices[block]][i & 1]);
+				const auto& base = baseColours[block];
+				palettes[block][i] = rgba(
+					std::clamp(base[0] + modifier, 0, 255), std::clamp(base[1] + modifier, 0, 255), std::clamp(base[2] + modifier, 0, 255), 0
+				);
+			}
+		}
+
+		for (u32 v = 0; v < 4; v++) {
+			for (u32 u = 0; u < 4; u++) {
+				const u32 texelIndex = u * 4 + v;
+				// The block is split into 2 sub-blocks, either vertically (side by side) or horizontally if the flip bit is set
+				const u32 block = (flip ? v : u) >= 2 ? 1 : 0;
+				const u32 paletteIndex = ((subindices >> texelIndex) & 1) | (((negationFlags >> texelIndex) & 1) << 1);
+				const u32 alpha = Colour::convert4To8Bit((alphaData >> (texelIndex * 4)) & 0xf);
+
+				out[v * width + u] = palettes[block][paletteIndex] | (alpha << 24);
+			}
+		}
+	}
+
+	// ETC1(A4) tiles are made of 4 4x4 blocks, in the order top-left, top-right, bottom-left, bottom-right
+	// Each ETC1A4 block has 64 bits of alpha data before the 64 bits of colour data
+	template <bool hasAlpha>
+	void decodeETCTile(const u8* in, u32* out, u32 width) {
+		for (u32 block = 0; block < 4; block++) {
+			u64 alphaData = ~0ull;
+			u64 colourData;
+
+			if constexpr (hasAlpha) {
+				std::memcpy(&alphaData, in, sizeof(u64));
+				in += sizeof(u64);
+			}
+			std::memcpy(&colourData, in, sizeof(u64));
+			in += sizeof(u64);
+
+			const u32 blockX = (block & 1) * 4;
+			const u32 blockY = (block >> 1) * 4;
+			decodeETCBlock(colourData, alphaData, out + blockY * width + blockX, width);
+		}
+	}
+
+	template <TextureFmt format>
+	void decodeTiles(u32 width, u32 height, const u8* in, u32* out) {
+		alignas(16) std::array<u32, tileTexels> tile;
+		const u32 tileBytes = TextureDecoder::tileSize(format);
+
+		for (u32 y = 0; y + 8 <= height; y += 8) {
+			for (u32 x = 0; x + 8 <= width; x += 8) {
+				u32* dest = out + y * width + x;
+
+				if constexpr (format == TextureFmt::ETC1 || format == TextureFmt::ETC1A4) {
+					decodeETCTile<format == TextureFmt::ETC1A4>(in, dest, width);
+				} else {
+					convertTile<format>(in, tile.data());
+					storeTile(tile.data(), dest, width);
+				}
+
+				in += tileBytes;
+			}
+		}
+	}
+}  // namespace
+
+u32 TextureDecoder::tileSize(TextureFmt format) {
+	switch (format) {
+		case TextureFmt::RGBA8: return tileTexels * 4;
+		case TextureFmt::RGB8: return tileTexels * 3;
+
+		case TextureFmt::RGBA5551:
+		case TextureFmt::RGB565:
+		case TextureFmt::RGBA4:
+		case TextureFmt::IA8:
+		case TextureFmt::RG8: return tileTexels * 2;
+
+		case TextureFmt::I8:
+		case TextureFmt::A8:
+		case TextureFmt::IA4:
+		case TextureFmt::ETC1A4: return tileTexels;
+
+		case TextureFmt::I4:
+		case TextureFmt::A4:
+		case TextureFmt::ETC1: return tileTexels / 2;
+
+		default: Helpers::panic("[TextureDecoder] Invalid texture format %d", static_cast<int>(format));
+	}
+}
+
+void TextureDecoder::decode(TextureFmt format, u32 width, u32 height, std::span<const u8> input, std::span<u32> output) {
+	const u64 tileCount = u64(width / 8) * u64(height / 8);
+	if (input.size() < tileCount * tileSize(format) || output.size() < u64(width) * u64(height)) [[unlikely]] {
+		Helpers::warn("[TextureDecoder] Buffers are too small for a %dx%d %s texture", width, height, textureFormatToString(format));
+		return;
+	}
+
+	const u8* in = input.data();
+	u32* out = output.data();
+
+	switch (format) {
+		case TextureFmt::RGBA8: decodeTiles<TextureFmt::RGBA8>(width, height, in, out); break;
+		case TextureFmt::RGB8: decodeTiles<TextureFmt::RGB8>(width, height, in, out); break;
+		case TextureFmt::RGBA5551: decodeTiles<TextureFmt::RGBA5551>(width, height, in, out); break;
+		case TextureFmt::RGB565: decodeTiles<TextureFmt::RGB565>(width, height, in, out); break;
+		case TextureFmt::RGBA4: decodeTiles<TextureFmt::RGBA4>(width, height, in, out); break;
+		case TextureFmt::IA8: decodeTiles<TextureFmt::IA8>(width, height, in, out); break;
+		case TextureFmt::RG8: decodeTiles<TextureFmt::RG8>(width, height, in, out); break;
+		case TextureFmt::I8: decodeTiles<TextureFmt::I8>(width, height, in, out); break;
+		case TextureFmt::A8: decodeTiles<TextureFmt::A8>(width, height, in, out); break;
+		case TextureFmt::IA4: decodeTiles<TextureFmt::IA4>(width, height, in, out); break;
+		case TextureFmt::I4: decodeTiles<TextureFmt::I4>(width, height, in, out); break;
+		case TextureFmt::A4: decodeTiles<TextureFmt::A4>(width, height, in, out); break;
+		case TextureFmt::ETC1: decodeTiles<TextureFmt::ETC1>(width, height, in, out); break;
+		case TextureFmt::ETC1A4: decodeTiles<TextureFmt::ETC1A4>(width, height, in, out); break;
+
+		default: Helpers::panic("[TextureDecoder] Unimplemented format = %d", static_cast<int>(format));
+	}
+}
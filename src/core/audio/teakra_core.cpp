@@ -152,14 +152,9 @@ void TeakraDSP::writeProcessPipe(u32 channel, u32 size, u32 buffer) {
 	PipeStatus status = getPipeStatus(channel, PipeDirection::CPUtoDSP);
 	bool needUpdate = false;  // Do we need to update the pipe status and catch up Teakra?
 
-	std::vector<u8> data;
-	data.reserve(size);
-
 	// Read data to write
-	for (int i = 0; i < size; i++) {
-		const u8 byte = mem.read8(buffer + i);
-		data.push_back(byte);
-	}
+	std::vector<u8> data(size);
+	mem.copyFromGuest(data.data(), buffer, size);
 	u8* dataPointer = data.data();
 
 	while (size != 0) {
@@ -107,9 +107,7 @@ std::optional<u32> NCCHArchive::readFile(FileSession* file, u64 offset, u32 size
 
 		u32 availableBytes = u32(fileData.size() - offset); // How many bytes we can read from the file
 		u32 bytesRead = std::min<u32>(size, availableBytes); // Cap the amount of bytes to read if we're going to go out of bounds
-		for (u32 i = 0; i < bytesRead; i++) {
-			mem.write8(dataPointer + i, fileData[offset + i]);
-		}
+		mem.copyToGuest(dataPointer, &fileData[offset], bytesRead);
 
 		return bytesRead;
 	} else {
@@ -154,6 +152,11 @@ std::optional<u32> NCCHArchive::readFile(FileSession* file, u64 offset, u32 size
 			Helpers::panic("Unimplemented file path type for NCCH archive");
 	}
 
+	// If the ROM is memory mapped, copy the data straight from the mapping to guest memory
+	if (auto bytesRead = mem.CXIMapping.readToGuest(mem, dataPointer, cxi->romFS, offset, size); bytesRead.has_value()) {
+		return u32(bytesRead.value());
+	}
+
 	std::unique_ptr<u8[]> data(new u8[size]);
 	auto [success, bytesRead] = cxi->readFromFile(mem.CXIFile, cxi->romFS, &data[0], offset, size);
 
@@ -161,9 +164,7 @@ std::optional<u32> NCCHArchive::readFile(FileSession* file, u64 offset, u32 size
 		Helpers::panic("Failed to read from NCCH archive");
 	}
 
-	for (u64 i = 0; i < bytesRead; i++) {
-		mem.write8(u32(dataPointer + i), data[i]);
-	}
+	mem.copyToGuest(dataPointer, data.get(), bytesRead);
 
 	return u32(bytesRead);
 }
@@ -71,7 +71,7 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 
 	bool success = false;
 	std::size_t bytesRead = 0;
-	std::unique_ptr<u8[]> data(new u8[size]);
+	std::unique_ptr<u8[]> data;
 
 	if (auto cxi = mem.getCXI(); cxi != nullptr) {
 		IOFile& ioFile = mem.CXIFile;
@@ -122,6 +122,12 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 			default: Helpers::panic("Unimplemented file path type for SelfNCCH archive");
 		}
 
+		// If the ROM is memory mapped, copy the data straight from the mapping to guest memory
+		if (auto mappedBytes = mem.CXIMapping.readToGuest(mem, dataPointer, fsInfo, offset, size); mappedBytes.has_value()) {
+			return u32(mappedBytes.value());
+		}
+
+		data.reset(new u8[size]);
 		std::tie(success, bytesRead) = cxi->readFromFile(ioFile, fsInfo, &data[0], offset, size);
 	}
 
@@ -138,6 +144,7 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 			default: Helpers::panic("Unimplemented file path type for 3DSX SelfNCCH archive");
 		}
 
+		data.reset(new u8[size]);
 		std::tie(success, bytesRead) = hb3dsx->readRomFSBytes(&data[0], offset, size);
 	}
 
@@ -145,9 +152,7 @@ std::optional<u32> SelfNCCHArchive::readFile(FileSession* file, u64 offset, u32
 		Helpers::panic("Failed to read from SelfNCCH archive");
 	}
 
-	for (u64 i = 0; i < bytesRead; i++) {
-		mem.write8(u32(dataPointer + i), data[i]);
-	}
+	mem.copyToGuest(dataPointer, data.get(), bytesRead);
 
 	return u32(bytesRead);
 }
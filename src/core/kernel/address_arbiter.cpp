@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "kernel.hpp"
 #include "resource_limits.hpp"
 
@@ -95,15 +97,26 @@ void Kernel::signalArbiter(u32 waitingAddress, s32 threadCount) {
 	if (threadCount == 0) [[unlikely]] return;
 	s32 count = 0; // Number of threads we've woken up
 
-	// Wake threads with the highest priority threads being woken up first
-	for (auto index : threadIndices) {
-		Thread& t = threads[index];
+	// Find the threads waiting on this address
+	std::array<int, appResourceLimits.maxThreads> waitingThreads;
+	usize waitingCount = 0;
+	for (int index = 0; index < appResourceLimits.maxThreads; index++) {
+		const Thread& t = threads[index];
 		if (t.status == ThreadStatus::WaitArbiter && t.waitingAddress == waitingAddress) {
-			t.status = ThreadStatus::Ready;
-			count += 1;
-
-			// Check if we've reached the max number of. If count < 0 then all threads are released.
-			if (count == threadCount && threadCount > 0) break;
+			waitingThreads[waitingCount++] = index;
 		}
 	}
+
+	// Wake threads with the highest priority threads being woken up first
+	std::stable_sort(waitingThreads.begin(), waitingThreads.begin() + waitingCount, [&](int a, int b) {
+		return threads[a].priority < threads[b].priority;
+	});
+
+	for (usize i = 0; i < waitingCount; i++) {
+		setThreadReady(waitingThreads[i]);
+		count += 1;
+
+		// Check if we've reached the max number of. If count < 0 then all threads are released.
+		if (count == threadCount && threadCount > 0) break;
+	}
 }
\ No newline at end of file
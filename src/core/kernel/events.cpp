@@ -131,7 +131,7 @@ void Kernel::waitSynchronization1() {
 		auto& t = threads[currentThreadIndex];
 		t.waitList.resize(1);
 		t.status = ThreadStatus::WaitSync1;
-		t.wakeupTick = getWakeupTick(ns);
+		setWakeupTick(t, ns);
 		t.waitList[0] = handle;
 
 		// Add the current thread to the object's wait list
@@ -224,7 +224,7 @@ void Kernel::waitSynchronizationN() {
 		t.waitList.resize(handleCount);
 		t.status = ThreadStatus::WaitSyncAny;
 		t.outPointer = outPointer;
-		t.wakeupTick = getWakeupTick(ns);
+		setWakeupTick(t, ns);
 
 		for (s32 i = 0; i < handleCount; i++) {
 			t.waitList[i] = waitObjects[i].first; // Add object to this thread's waitlist
@@ -96,9 +96,7 @@ void Kernel::readFile(u32 messagePointer, Handle fileHandle) {
 			Helpers::panic("Kernel::ReadFile with file descriptor failed");
 		}
 		else {
-			for (size_t i = 0; i < bytesRead; i++) {
-				mem.write8(u32(dataPointer + i), data[i]);
-			}
+			mem.copyToGuest(dataPointer, data.get(), bytesRead);
 
 			mem.write32(messagePointer + 4, Result::Success);
 			mem.write32(messagePointer + 8, u32(bytesRead));
@@ -141,9 +139,7 @@ void Kernel::writeFile(u32 messagePointer, Handle fileHandle) {
 		Helpers::panic("[Kernel::File::WriteFile] Tried to write to file without a valid file descriptor");
 
 	std::unique_ptr<u8[]> data(new u8[size]);
-	for (size_t i = 0; i < size; i++) {
-		data[i] = mem.read8(u32(dataPointer + i));
-	}
+	mem.copyFromGuest(data.get(), dataPointer, size);
 
 	IOFile f(file->fd);
 	auto [success, bytesWritten] = f.writeBytes(data.get(), size);
@@ -1,10 +1,12 @@
 #include <cstring>
 #include "arm_defs.hpp"
+#include "cpu.hpp"
 #include "kernel.hpp"
 
 /*
 	This file sets up an idle thread that's meant to run when no other OS thread can run.
-	It simply idles and constantly yields to check if there's any other thread that can run
+	It simply idles and constantly yields to check if there's any other thread that can run.
+	In practice, the CPU asks the kernel to skip idle time via skipIdleTime before running, so this code only runs as a fallback
 	The code for our idle thread looks like this
 
 idle_thread_main:
@@ -46,14 +48,35 @@ void Kernel::setupIdleThread() {
 	t.gprs[15] = codeAddress;
 	t.cpsr = CPSR::UserMode;
 	t.fpscr = FPSCR::ThreadDefault;
+	t.fprs.fill(0);
+	t.fprVersion = VFPContext::zeroVersion;
 
 	// Our idle thread should have as low of a priority as possible, because, well, it's an idle thread.
 	// We handle this by giving it a priority of 0x40, which is lower than is actually allowed for user threads
 	// (High priority value = low priority). This is the same priority used in the retail kernel.
 	t.priority = 0x40;
+	// The idle thread is never put in the ready queue, as we only switch to it when the queue is empty
 	t.status = ThreadStatus::Ready;
+}
+
+bool Kernel::skipIdleTime() {
+	// Pick up any thread that became able to run while we were idling, eg because a scheduler event signalled it or its timeout expired
+	if (currentThreadIndex == idleThreadIndex) {
+		rescheduleThreads();
+	}
+
+	if (currentThreadIndex != idleThreadIndex) {
+		return false;
+	}
+
+	// Only the idle thread can run. Find the earliest point where something can happen: Either a scheduler event, or a thread waking up
+	Scheduler& scheduler = cpu.getScheduler();
+	const u64 timestamp = std::min<u64>(scheduler.nextTimestamp, sleepingThreads.nextWakeupTick());
+
+	if (timestamp > scheduler.currentTimestamp) {
+		scheduler.currentTimestamp = timestamp;
+	}
 
-	// Add idle thread to the list of thread indices
-	threadIndices.push_back(idleThreadIndex);
-	sortThreads();
+	idleSkipCount++;
+	return true;
 }
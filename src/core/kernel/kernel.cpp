@@ -8,7 +8,6 @@ Kernel::Kernel(CPU& cpu, Memory& mem, GPU& gpu, const EmulatorConfig& config)
 	objects.reserve(512); // Make room for a few objects to avoid further memory allocs later
 	mutexHandles.reserve(8);
 	portHandles.reserve(32);
-	threadIndices.reserve(appResourceLimits.maxThreads);
 
 	for (int i = 0; i < threads.size(); i++) {
 		Thread& t = threads[i];
@@ -150,12 +149,16 @@ void Kernel::reset() {
 	}
 	objects.clear();
 	mutexHandles.clear();
-	timerHandles.clear();
 	portHandles.clear();
-	threadIndices.clear();
+	readyThreads.clear();
+	sleepingThreads.clear();
 	serviceManager.reset();
 
 	needReschedule = false;
+	idleSkipCount = 0;
+	contextSwitches = 0;
+	contextSwitchesLastFrame = 0;
+	fprSwitcher.reset();
 
 	// Allocate handle #0 to a dummy object and make a main process object
 	makeObject(KernelObjectType::Dummy);
@@ -298,6 +301,7 @@ void Kernel::duplicateHandle() {
 }
 
 void Kernel::clearInstructionCache() { cpu.clearCache(); }
+void Kernel::invalidateInstructionCacheRange(u32 start, u32 size) { cpu.invalidateCacheRange(start, size); }
 
 namespace SystemInfoType {
 	enum : u32 {
@@ -82,7 +82,7 @@ s32 Kernel::getCurrentResourceValue(const KernelObject* limit, u32 resourceName)
 	const auto data = static_cast<ResourceLimits*>(limit->data);
 	switch (resourceName) {
 		case ResourceType::Commit: return mem.usedUserMemory;
-		case ResourceType::Thread: return threadIndices.size();
+		case ResourceType::Thread: return aliveThreadCount;
 		default: Helpers::panic("Attempted to get current value of unknown kernel resource: %d\n", resourceName);
 	}
 }
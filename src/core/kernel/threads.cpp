@@ -15,6 +15,7 @@ void Kernel::switchThread(int newThreadIndex) {
 	auto& oldThread = threads[currentThreadIndex];
 	auto& newThread = threads[newThreadIndex];
 	newThread.status = ThreadStatus::Running;
+	readyThreads.remove(newThreadIndex);
 	logThread("Switching from thread %d to %d\n", currentThreadIndex, newThreadIndex);
 
 	// Bail early if the new thread is actually the old thread
@@ -22,15 +23,19 @@ void Kernel::switchThread(int newThreadIndex) {
 		return;
 	}
 
+	contextSwitches++;
+
 	// Backup context
 	std::memcpy(oldThread.gprs.data(), cpu.regs().data(), cpu.regs().size_bytes());  // Backup the 16 GPRs
-	std::memcpy(oldThread.fprs.data(), cpu.fprs().data(), cpu.fprs().size_bytes());  // Backup the 32 FPRs
 	oldThread.cpsr = cpu.getCPSR();                                                  // Backup CPSR
 	oldThread.fpscr = cpu.getFPSCR();                                                // Backup FPSCR
 
+	// The 32 FPRs are only backed up if the old thread used the VFP, and only loaded if they don't hold the new thread's bank already
+	fprSwitcher.switchBanks(cpu.fprs(), cpu.vfpUsed(), oldThread.fprs, oldThread.fprVersion, newThread.fprs, newThread.fprVersion);
+	cpu.clearVFPUsed();
+
 	// Load new context
 	std::memcpy(cpu.regs().data(), newThread.gprs.data(), cpu.regs().size_bytes());  // Load 16 GPRs
-	std::memcpy(cpu.fprs().data(), newThread.fprs.data(), cpu.fprs().size_bytes());  // Load 32 FPRs
 	cpu.setCPSR(newThread.cpsr);                                                     // Load CPSR
 	cpu.setFPSCR(newThread.fpscr);                                                   // Load FPSCR
 	cpu.setTLSBase(newThread.tlsBase);  // Load CP15 thread-local-storage pointer register
@@ -38,42 +43,33 @@ void Kernel::switchThread(int newThreadIndex) {
 	currentThreadIndex = newThreadIndex;
 }
 
-// Sort the threadIndices vector based on the priority of each thread
-// The threads with higher priority (aka the ones with a lower priority value) should come first in the vector
-void Kernel::sortThreads() {
-	std::vector<int>& v = threadIndices;
-	std::sort(v.begin(), v.end(), [&](int a, int b) {
-		return threads[a].priority < threads[b].priority;
-	});
-}
+// Mark a thread as ready to run and put it at the back of the ready queue for its priority
+void Kernel::setThreadReady(int index) {
+	Thread& t = threads[index];
+	t.status = ThreadStatus::Ready;
+	sleepingThreads.remove(index);
 
-bool Kernel::canThreadRun(const Thread& t) {
-	if (t.status == ThreadStatus::Ready) {
-		return true;
-	} else if (t.status == ThreadStatus::WaitSleep || t.status == ThreadStatus::WaitSync1
-		|| t.status == ThreadStatus::WaitSyncAny || t.status == ThreadStatus::WaitSyncAll) {
-		// TODO: Set r0 to the correct error code on timeout for WaitSync{1/Any/All}
-		return cpu.getTicks() >= t.wakeupTick;
+	// The running thread gets queued when rescheduling instead, and the idle thread is only used as a fallback so it's never queued
+	if (index != currentThreadIndex && index != idleThreadIndex) {
+		readyThreads.pushBack(index, t.priority);
 	}
-
-	// Handle timeouts and stuff here
-	return false;
 }
 
-// Get the index of the next thread to run by iterating through the thread list and finding the free thread with the highest priority
-// Returns the thread index if a thread is found, or nullopt otherwise
-std::optional<int> Kernel::getNextThread() {
-	for (auto index : threadIndices) {
-		const Thread& t = threads[index];
+// Make threads whose wait timed out ready to run
+// TODO: Set r0 to the correct error code on timeout for WaitSync{1/Any/All}
+void Kernel::wakeupTimedOutThreads() {
+	const u64 ticks = cpu.getTicks();
 
-		// Thread is ready, return it
-		if (canThreadRun(t)) {
-			return index;
-		}
+	while (sleepingThreads.nextWakeupTick() <= ticks) {
+		setThreadReady(sleepingThreads.front());
 	}
+}
 
-	// No thread was found
-	return std::nullopt;
+// Get the index of the ready thread with the highest priority
+// Returns the thread index if a thread is found, or nullopt otherwise
+std::optional<int> Kernel::getNextThread() {
+	wakeupTimedOutThreads();
+	return readyThreads.front();
 }
 
 u64 Kernel::getWakeupTick(s64 ns) {
@@ -85,16 +81,29 @@ u64 Kernel::getWakeupTick(s64 ns) {
 	return cpu.getTicks() + Scheduler::nsToCycles(ns);
 }
 
+// Set the tick a waiting thread will time out on, and add it to the sleep queue if it ever times out
+void Kernel::setWakeupTick(Thread& t, s64 ns) {
+	t.wakeupTick = getWakeupTick(ns);
+
+	if (t.wakeupTick != std::numeric_limits<u64>::max()) {
+		sleepingThreads.push(t.index, t.wakeupTick);
+	}
+}
+
 // See if there is a higher priority, ready thread and switch to that
 void Kernel::rescheduleThreads() {
 	Thread& current = threads[currentThreadIndex];  // Current running thread
 
 	// If the current thread is running and hasn't gone to sleep or whatever, set it to Ready instead of Running
-	// So that getNextThread will evaluate it properly
+	// And put it at the front of its priority level so that getNextThread will evaluate it properly without making it lose its turn
 	if (current.status == ThreadStatus::Running) {
 		current.status = ThreadStatus::Ready;
 	}
-	ThreadStatus currentStatus = current.status;
+
+	if (current.status == ThreadStatus::Ready && currentThreadIndex != idleThreadIndex) {
+		readyThreads.pushFront(currentThreadIndex, current.priority);
+	}
+
 	std::optional<int> newThreadIndex = getNextThread();
 
 	// Case 1: A thread can run
@@ -127,7 +136,6 @@ HorizonHandle Kernel::makeThread(u32 entrypoint, u32 initialSP, u32 priority, Pr
 
 	aliveThreadCount++;
 
-	threadIndices.push_back(index);
 	Thread& t = threads[index]; // Reference to thread data
 	Handle ret = makeObject(KernelObjectType::Thread);
 	objects[ret].data = &t;
@@ -137,6 +145,7 @@ HorizonHandle Kernel::makeThread(u32 entrypoint, u32 initialSP, u32 priority, Pr
 	// Set up initial thread context
 	t.gprs.fill(0);
 	t.fprs.fill(0);
+	t.fprVersion = VFPContext::zeroVersion;
 
 	t.arg = arg;
 	t.initialSP = initialSP;
@@ -157,7 +166,9 @@ HorizonHandle Kernel::makeThread(u32 entrypoint, u32 initialSP, u32 priority, Pr
 	// Initial TLS base has already been set in Kernel::Kernel()
 	// TODO: Does svcCreateThread zero-set the TLS of the new thread?
 
-	sortThreads();
+	if (status == ThreadStatus::Ready) {
+		setThreadReady(index);
+	}
 	return ret;
 }
 
@@ -292,12 +303,12 @@ int Kernel::wakeupOneThread(u64 waitlist, Handle handle) {
 	Thread& t = threads[threadIndex];
 	switch (t.status) {
 		case ThreadStatus::WaitSync1:
-			t.status = ThreadStatus::Ready;
+			setThreadReady(threadIndex);
 			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
 			break;
 
 		case ThreadStatus::WaitSyncAny:
-			t.status = ThreadStatus::Ready;
+			setThreadReady(threadIndex);
 			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
 
 			// Get the index of the event in the object's waitlist, write it to r1
@@ -327,12 +338,12 @@ void Kernel::wakeupAllThreads(u64 waitlist, Handle handle) {
 		Thread& t = threads[index];
 		switch (t.status) {
 		case ThreadStatus::WaitSync1:
-			t.status = ThreadStatus::Ready;
+			setThreadReady(index);
 			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
 			break;
 
 		case ThreadStatus::WaitSyncAny:
-			t.status = ThreadStatus::Ready;
+			setThreadReady(index);
 			t.gprs[0] = Result::Success; // The thread did not timeout, so write success to r0
 
 			// Get the index of the event in the object's waitlist, write it to r1
@@ -356,33 +367,21 @@ void Kernel::sleepThread(s64 ns) {
 	if (ns < 0) {
 		Helpers::panic("Sleeping a thread for a negative amount of ns");
 	} else if (ns == 0) {
-		// TODO: This is garbage, but it works so eh we can keep it for now
 		Thread& t = threads[currentThreadIndex];
 
-		// See if a thread other than this and the idle thread is waiting to run by temp marking the current function as dead and searching
-		// If there is another thread to run, then run it. Otherwise, go back to this thread, not to the idle thread
-		t.status = ThreadStatus::Dead;
+		// See if a thread other than this and the idle thread is waiting to run. The current thread is never in the ready queue so it
+		// won't be picked. If there is another thread to run, then run it and send this thread to the back of its priority level.
+		// Otherwise, go back to this thread, not to the idle thread
 		auto nextThreadIndex = getNextThread();
-		t.status = ThreadStatus::Ready;
 
 		if (nextThreadIndex.has_value()) {
-			const auto index = nextThreadIndex.value();
-
-			if (index != idleThreadIndex) {
-				switchThread(index);
-			}
+			const int oldThreadIndex = currentThreadIndex;
+			switchThread(nextThreadIndex.value());
+			setThreadReady(oldThreadIndex);
 		} else {
 			if (currentThreadIndex == idleThreadIndex) {
 				const Scheduler& scheduler = cpu.getScheduler();
-				u64 timestamp = scheduler.nextTimestamp;
-
-				for (auto i : threadIndices) {
-					const Thread& t = threads[i];
-					if (t.status == ThreadStatus::WaitSleep || t.status == ThreadStatus::WaitSync1 || t.status == ThreadStatus::WaitSyncAny ||
-						t.status == ThreadStatus::WaitSyncAll) {
-						timestamp = std::min<u64>(timestamp, t.wakeupTick);
-					}
-				}
+				const u64 timestamp = std::min<u64>(scheduler.nextTimestamp, sleepingThreads.nextWakeupTick());
 
 				if (timestamp > scheduler.currentTimestamp) {
 					u64 idleCycles = timestamp - scheduler.currentTimestamp;
@@ -394,7 +393,7 @@ void Kernel::sleepThread(s64 ns) {
 		Thread& t = threads[currentThreadIndex];
 
 		t.status = ThreadStatus::WaitSleep;
-		t.wakeupTick = getWakeupTick(ns);
+		setWakeupTick(t, ns);
 
 		requireReschedule();
 	}
@@ -509,10 +508,15 @@ void Kernel::setThreadPriority() {
 			return;
 		} else {
 			regs[0] = Result::Success;
-			object->getData<Thread>()->priority = priority;
+			Thread* t = object->getData<Thread>();
+			t->priority = priority;
+
+			// Move the thread to the queue of its new priority level
+			if (readyThreads.contains(t->index)) {
+				readyThreads.pushBack(t->index, priority);
+			}
 		}
 	}
-	sortThreads();
 	requireReschedule();
 }
 
@@ -563,12 +567,6 @@ void Kernel::exitThread() {
 		}
 	}
 
-	// Remove the index of this thread from the thread indices vector
-	for (int i = 0; i < threadIndices.size(); i++) {
-		if (threadIndices[i] == currentThreadIndex)
-			threadIndices.erase(threadIndices.begin() + i);
-	}
-
 	Thread& t = threads[currentThreadIndex];
 	t.status = ThreadStatus::Dead;
 	aliveThreadCount--;
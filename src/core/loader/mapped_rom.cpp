@@ -0,0 +1,104 @@
+#include "loader/mapped_rom.hpp"
+
+#include <cryptopp/aes.h>
+#include <cryptopp/modes.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "memory.hpp"
+
+struct MappedROM::Decryptor {
+	CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption cipher;
+	Crypto::AESKey key;
+	Crypto::AESKey initialCounter;
+	bool keyed = false;
+};
+
+MappedROM::MappedROM() : decryptor(std::make_unique<Decryptor>()) {}
+MappedROM::~MappedROM() = default;
+
+bool MappedROM::open(const std::filesystem::path& path) {
+	close();
+	return file.openReadOnly(path);
+}
+
+void MappedROM::close() {
+	file.close();
+	decryptedPages.clear();
+	pageIndex.clear();
+	decryptor->keyed = false;
+}
+
+const u8* MappedROM::getDecryptedPage(const NCCH::FSInfo& info, u64 page) {
+	const u64 pageOffset = page * cachePageSize;  // Offset of the page inside the section
+	const u64 fileOffset = info.offset + pageOffset;
+
+	if (auto it = pageIndex.find(fileOffset); it != pageIndex.end()) {
+		decryptedPages.splice(decryptedPages.begin(), decryptedPages, it->second);
+		return it->second->data.get();
+	}
+
+	// Reuse the buffer of the least recently used page if the cache is full
+	std::unique_ptr<u8[]> data;
+	if (decryptedPages.size() >= maxCachedPages) {
+		DecryptedPage& oldest = decryptedPages.back();
+		pageIndex.erase(oldest.fileOffset);
+		data = std::move(oldest.data);
+		decryptedPages.pop_back();
+	} else {
+		data = std::make_unique<u8[]>(cachePageSize);
+	}
+
+	// The last page of a section can be partial. Zero the rest of it so we never expose uninitialized memory
+	const u64 pageSize = std::min<u64>({cachePageSize, info.size - pageOffset, file.size() - fileOffset});
+	std::memset(data.get() + pageSize, 0, cachePageSize - pageSize);
+
+	const auto& encryptionInfo = info.encryptionInfo.value();
+	Decryptor& d = *decryptor;
+	if (!d.keyed || d.key != encryptionInfo.normalKey || d.initialCounter != encryptionInfo.initialCounter) {
+		d.cipher.SetKeyWithIV(encryptionInfo.normalKey.data(), encryptionInfo.normalKey.size(), encryptionInfo.initialCounter.data());
+		d.key = encryptionInfo.normalKey;
+		d.initialCounter = encryptionInfo.initialCounter;
+		d.keyed = true;
+	}
+
+	// Seeking moves the counter to the page, so we don't need to set up the key schedule again for every page
+	d.cipher.Seek(pageOffset);
+	d.cipher.ProcessData(data.get(), file.data() + fileOffset, pageSize);
+
+	decryptedPages.push_front(DecryptedPage{.fileOffset = fileOffset, .data = std::move(data)});
+	pageIndex[fileOffset] = decryptedPages.begin();
+	return decryptedPages.front().data.get();
+}
+
+std::optional<u64> MappedROM::readToGuest(Memory& mem, u32 vaddr, const NCCH::FSInfo& info, u64 offset, u64 size) {
+	if (!isOpen() || offset > info.size) {
+		return std::nullopt;
+	}
+
+	size = std::min<u64>(size, info.size - offset);
+	if (info.offset + offset + size > file.size()) [[unlikely]] {
+		return std::nullopt;
+	}
+
+	// Unencrypted data can be copied straight from the mapping
+	if (!info.encryptionInfo.has_value()) {
+		mem.copyToGuest(vaddr, file.data() + info.offset + offset, size);
+		return size;
+	}
+
+	u64 remaining = size;
+	while (remaining > 0) {
+		const u64 page = offset / cachePageSize;
+		const u64 pageOffset = offset % cachePageSize;
+		const u64 chunkSize = std::min<u64>(remaining, cachePageSize - pageOffset);
+
+		mem.copyToGuest(vaddr, getDecryptedPage(info, page) + pageOffset, chunkSize);
+		vaddr += u32(chunkSize);
+		offset += chunkSize;
+		remaining -= chunkSize;
+	}
+
+	return size;
+}
@@ -153,6 +153,10 @@ std::optional<NCSD> Memory::loadNCSD(Crypto::AESEngine& aesEngine, const std::fi
 		return std::nullopt;
 	}
 
+	if (!CXIMapping.open(path)) {
+		Helpers::warn("Failed to memory map ROM, falling back to regular file reads");
+	}
+
 	return ncsd;
 }
 
@@ -203,5 +207,9 @@ std::optional<NCSD> Memory::loadCXI(Crypto::AESEngine& aesEngine, const std::fil
 		return std::nullopt;
 	}
 
+	if (!CXIMapping.open(path)) {
+		Helpers::warn("Failed to memory map ROM, falling back to regular file reads");
+	}
+
 	return ncsd;
 }
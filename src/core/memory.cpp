@@ -1,8 +1,10 @@
 #include "memory.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>  // For time since epoch
 #include <cmrc/cmrc.hpp>
+#include <cstring>
 #include <ctime>
 
 #include "config_mem.hpp"
@@ -18,6 +20,11 @@ Memory::Memory(u64& cpuTicks, const EmulatorConfig& config) : cpuTicks(cpuTicks)
 
 	readTable.resize(totalPageCount, 0);
 	writeTable.resize(totalPageCount, 0);
+	fastmemTable = std::make_unique<PageTable>();  // Value-initialized, so every entry starts out as nullptr
+	pageWriteStamps.resize(TRACKED_PAGE_COUNT, 0);
+	pageWatchCounts.resize(TRACKED_PAGE_COUNT, 0);
+	pageGPUOwned.resize(TRACKED_PAGE_COUNT, 0);
+	fcramPageMappings.resize(FCRAM_PAGE_COUNT);
 	memoryInfo.reserve(32);  // Pre-allocate some room for memory allocation info to avoid dynamic allocs
 }
 
@@ -32,6 +39,15 @@ void Memory::reset() {
 		readTable[i] = 0;
 		writeTable[i] = 0;
 	}
+	fastmemTable->fill(nullptr);
+
+	// The GPU drops its caches on reset, so nothing is watched anymore
+	std::fill(pageWatchCounts.begin(), pageWatchCounts.end(), 0);
+	std::fill(pageGPUOwned.begin(), pageGPUOwned.end(), 0);
+	gpuOwnedPageCount = 0;
+	for (auto& mappings : fcramPageMappings) {
+		mappings.clear();
+	}
 
 	// Map (32 * 4) KB of FCRAM before the stack for the TLS of each thread
 	std::optional<u32> tlsBaseOpt = findPaddr(32 * 4_KB);
@@ -67,6 +83,7 @@ void Memory::reset() {
 
 		readTable[i + initialPage] = pointer;
 		writeTable[i + initialPage] = pointer;
+		updateFastmemPage(i + initialPage);
 	}
 
 	// Later adjusted based on ROM header when possible
@@ -91,6 +108,7 @@ u8 Memory::read8(u32 vaddr) {
 
 	uintptr_t pointer = readTable[page];
 	if (pointer != 0) [[likely]] {
+		writeBackHostPage(pointer);
 		return *(u8*)(pointer + offset);
 	} else {
 		switch (vaddr) {
@@ -139,6 +157,7 @@ u16 Memory::read16(u32 vaddr) {
 
 	uintptr_t pointer = readTable[page];
 	if (pointer != 0) [[likely]] {
+		writeBackHostPage(pointer);
 		return *(u16*)(pointer + offset);
 	} else {
 		switch (vaddr) {
@@ -154,6 +173,7 @@ u32 Memory::read32(u32 vaddr) {
 
 	uintptr_t pointer = readTable[page];
 	if (pointer != 0) [[likely]] {
+		writeBackHostPage(pointer);
 		return *(u32*)(pointer + offset);
 	} else {
 		switch (vaddr) {
@@ -190,7 +210,7 @@ u32 Memory::read32(u32 vaddr) {
 						Helpers::warn("VRAM read!\n");
 					}
 
-					// TODO: Properly handle framebuffer readbacks and the like
+					writeBackVRAMPage(vaddr);
 					return *(u32*)&vram[vaddr - VirtualAddrs::VramStart];
 				}
 
@@ -212,12 +232,15 @@ void Memory::write8(u32 vaddr, u8 value) {
 
 	uintptr_t pointer = writeTable[page];
 	if (pointer != 0) [[likely]] {
+		writeBackHostPage(pointer);
 		*(u8*)(pointer + offset) = value;
+		stampHostPage(pointer);
 	} else {
 		// VRAM write
 		if (vaddr >= VirtualAddrs::VramStart && vaddr < VirtualAddrs::VramStart + VirtualAddrs::VramSize) {
-			// TODO: Invalidate renderer caches here
+			writeBackVRAMPage(vaddr);
 			vram[vaddr - VirtualAddrs::VramStart] = value;
+			stampPage((vaddr - VirtualAddrs::VramStart) >> pageShift);
 		}
 
 		else {
@@ -226,13 +249,180 @@ void Memory::write8(u32 vaddr, u8 value) {
 	}
 }
 
+void Memory::copyToGuest(u32 vaddr, const void* data, usize size) {
+	const u8* source = static_cast<const u8*>(data);
+
+	while (size > 0) {
+		const u32 offset = vaddr & pageMask;
+		const usize chunkSize = std::min<usize>(size, pageSize - offset);
+
+		uintptr_t pointer = writeTable[vaddr >> pageShift];
+		if (pointer != 0) [[likely]] {
+			writeBackHostPage(pointer);
+			std::memcpy((void*)(pointer + offset), source, chunkSize);
+			stampHostPage(pointer);
+		} else {
+			for (usize i = 0; i < chunkSize; i++) {
+				write8(vaddr + u32(i), source[i]);
+			}
+		}
+
+		vaddr += u32(chunkSize);
+		source += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+void Memory::copyFromGuest(void* data, u32 vaddr, usize size) {
+	u8* dest = static_cast<u8*>(data);
+
+	while (size > 0) {
+		const u32 offset = vaddr & pageMask;
+		const usize chunkSize = std::min<usize>(size, pageSize - offset);
+
+		uintptr_t pointer = readTable[vaddr >> pageShift];
+		if (pointer != 0) [[likely]] {
+			writeBackHostPage(pointer);
+			std::memcpy(dest, (const void*)(pointer + offset), chunkSize);
+		} else {
+			for (usize i = 0; i < chunkSize; i++) {
+				dest[i] = read8(vaddr + u32(i));
+			}
+		}
+
+		vaddr += u32(chunkSize);
+		dest += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+void Memory::fillGuest(u32 vaddr, u8 value, usize size) {
+	while (size > 0) {
+		const u32 offset = vaddr & pageMask;
+		const usize chunkSize = std::min<usize>(size, pageSize - offset);
+
+		uintptr_t pointer = writeTable[vaddr >> pageShift];
+		if (pointer != 0) [[likely]] {
+			writeBackHostPage(pointer);
+			std::memset((void*)(pointer + offset), value, chunkSize);
+			stampHostPage(pointer);
+		} else {
+			for (usize i = 0; i < chunkSize; i++) {
+				write8(vaddr + u32(i), value);
+			}
+		}
+
+		vaddr += u32(chunkSize);
+		size -= chunkSize;
+	}
+}
+
+void Memory::addFCRAMMapping(u32 page, uintptr_t pointer) {
+	const uintptr_t offset = pointer - uintptr_t(fcram);
+	if (offset >= FCRAM_SIZE) {
+		return;
+	}
+
+	auto& mappings = fcramPageMappings[offset >> pageShift];
+	if (std::find(mappings.begin(), mappings.end(), page) == mappings.end()) {
+		mappings.push_back(page);
+	}
+}
+
+void Memory::watchPhysicalRange(u32 paddr, u32 size) {
+	forEachTrackedPage(paddr, size, [&](u32 page) {
+		// The first watcher of an FCRAM page takes every virtual mapping of it out of the fastmem table
+		if (pageWatchCounts[page]++ == 0 && page >= VRAM_PAGE_COUNT) {
+			for (u32 virtualPage : fcramPageMappings[page - VRAM_PAGE_COUNT]) {
+				updateFastmemPage(virtualPage);
+			}
+		}
+	});
+}
+
+void Memory::unwatchPhysicalRange(u32 paddr, u32 size) {
+	forEachTrackedPage(paddr, size, [&](u32 page) {
+		// Watches are dropped on reset, so tolerate unwatching pages that aren't watched anymore
+		if (pageWatchCounts[page] == 0) {
+			return;
+		}
+
+		if (--pageWatchCounts[page] == 0 && page >= VRAM_PAGE_COUNT) {
+			for (u32 virtualPage : fcramPageMappings[page - VRAM_PAGE_COUNT]) {
+				updateFastmemPage(virtualPage);
+			}
+		}
+	});
+}
+
+void Memory::markPhysicalWrite(u32 paddr, u32 size) {
+	forEachTrackedPage(paddr, size, [&](u32 page) { stampPage(page); });
+}
+
+bool Memory::writtenSince(u32 paddr, u32 size, u64 stamp) {
+	bool written = false;
+	forEachTrackedPage(paddr, size, [&](u32 page) { written |= pageWriteStamps[page] > stamp; });
+
+	return written;
+}
+
+void Memory::markGPUOwned(u32 paddr, u32 size) {
+	forEachTrackedPage(paddr, size, [&](u32 page) {
+		if (pageGPUOwned[page] != 0) {
+			return;
+		}
+
+		pageGPUOwned[page] = 1;
+		gpuOwnedPageCount++;
+
+		// Take the page out of the fastmem table, so that CPU accesses to it go through our callbacks
+		if (page >= VRAM_PAGE_COUNT) {
+			for (u32 virtualPage : fcramPageMappings[page - VRAM_PAGE_COUNT]) {
+				updateFastmemPage(virtualPage);
+			}
+		}
+	});
+}
+
+void Memory::writeBackGPUOwned(u32 paddr, u32 size) {
+	if (gpuOwnedPageCount != 0) {
+		forEachTrackedPage(paddr, size, [&](u32 page) { writeBackTrackedPage(page); });
+	}
+}
+
+void Memory::writeBackTrackedPage(u32 page) {
+	if (pageGPUOwned[page] == 0) {
+		return;
+	}
+
+	// Hand the page back to the CPU before writing it back, so that the write-back itself doesn't recurse
+	pageGPUOwned[page] = 0;
+	gpuOwnedPageCount--;
+
+	u32 paddr;
+	if (page < VRAM_PAGE_COUNT) {
+		paddr = PhysicalAddrs::VRAM + (page << pageShift);
+	} else {
+		paddr = PhysicalAddrs::FCRAM + ((page - VRAM_PAGE_COUNT) << pageShift);
+		for (u32 virtualPage : fcramPageMappings[page - VRAM_PAGE_COUNT]) {
+			updateFastmemPage(virtualPage);
+		}
+	}
+
+	if (gpuWriteBack) {
+		gpuWriteBack(paddr, pageSize);
+	}
+}
+
 void Memory::write16(u32 vaddr, u16 value) {
 	const u32 page = vaddr >> pageShift;
 	const u32 offset = vaddr & pageMask;
 
 	uintptr_t pointer = writeTable[page];
 	if (pointer != 0) [[likely]] {
+		writeBackHostPage(pointer);
 		*(u16*)(pointer + offset) = value;
+		stampHostPage(pointer);
 	} else {
 		Helpers::panic("Unimplemented 16-bit write, addr: %08X, val: %08X", vaddr, value);
 	}
@@ -244,7 +434,9 @@ void Memory::write32(u32 vaddr, u32 value) {
 
 	uintptr_t pointer = writeTable[page];
 	if (pointer != 0) [[likely]] {
+		writeBackHostPage(pointer);
 		*(u32*)(pointer + offset) = value;
+		stampHostPage(pointer);
 	} else {
 		Helpers::panic("Unimplemented 32-bit write, addr: %08X, val: %08X", vaddr, value);
 	}
@@ -261,6 +453,7 @@ void* Memory::getReadPointer(u32 address) {
 
 	uintptr_t pointer = readTable[page];
 	if (pointer == 0) return nullptr;
+	writeBackHostPage(pointer);
 	return (void*)(pointer + offset);
 }
 
@@ -270,6 +463,7 @@ void* Memory::getWritePointer(u32 address) {
 
 	uintptr_t pointer = writeTable[page];
 	if (pointer == 0) return nullptr;
+	writeBackHostPage(pointer);
 	return (void*)(pointer + offset);
 }
 
@@ -353,6 +547,8 @@ std::optional<u32> Memory::allocateMemory(u32 vaddr, u32 paddr, u32 size, bool l
 		if (w) {
 			writeTable[virtualPage] = uintptr_t(&fcram[physPage * pageSize]);
 		}
+		addFCRAMMapping(virtualPage, uintptr_t(&fcram[physPage * pageSize]));
+		updateFastmemPage(virtualPage);
 
 		// Mark FCRAM page as allocated and go on
 		usedFCRAMPages[physPage] = true;
@@ -486,6 +682,8 @@ void Memory::mirrorMapping(u32 destAddress, u32 sourceAddress, u32 size) {
 
 		readTable[destPage] = readTable[sourcePage];
 		writeTable[destPage] = writeTable[sourcePage];
+		addFCRAMMapping(destPage, readTable[destPage]);
+		updateFastmemPage(destPage);
 
 		sourceAddress += pageSize;
 		destAddress += pageSize;
@@ -2,14 +2,21 @@
 
 #include <stb_image_write.h>
 
+#include <algorithm>
+#include <bit>
 #include <cmrc/cmrc.hpp>
+#include <thread>
 
 #include "config.hpp"
 #include "PICA/float_types.hpp"
 #include "PICA/pica_frag_uniforms.hpp"
 #include "PICA/gpu.hpp"
+#include "PICA/pixels.hpp"
 #include "PICA/regs.hpp"
+#include "PICA/shader_decompiler.hpp"
+#include "PICA/shader_unit.hpp"
 #include "math_util.hpp"
+#include "version.hpp"
 
 CMRC_DECLARE(RendererGL);
 
@@ -17,14 +24,46 @@ using namespace Floats;
 using namespace Helpers;
 using namespace PICA;
 
+RendererGL::RendererGL(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
+	: Renderer(gpu, internalRegs, externalRegs), fragShaderGen(PICA::ShaderGen::API::GL, PICA::ShaderGen::Language::GLSL) {
+	// Buffers the cache drops may hold the only copy of what the GPU rendered to them, so write it back to memory first. This also hands
+	// their pages back to the CPU, as no surface would be left to write them back on the next access
+	Memory& mem = gpu.getMemory();
+	colourBufferCache.setRemoveCallback([&mem](ColourBuffer& buffer) { mem.writeBackGPUOwned(buffer.location, u32(buffer.sizeInBytes())); });
+	depthBufferCache.setRemoveCallback([&mem](DepthBuffer& buffer) { mem.writeBackGPUOwned(buffer.location, u32(buffer.sizeInBytes())); });
+}
+
 RendererGL::~RendererGL() {}
 
+void RendererGL::setSurfaceCacheBudget() {
+	// Textures get half of the budget, and colour and depth buffers a quarter each
+	const usize budget = emulatorConfig != nullptr ? usize(emulatorConfig->surfaceCacheBudget) : 0;
+	textureCache.setBudget(budget / 2);
+	colourBufferCache.setBudget(budget / 4);
+	depthBufferCache.setBudget(budget / 4);
+}
+
 void RendererGL::reset() {
+	flushDraws();
+	picaDraws = 0;
+	hostDraws = 0;
+
 	depthBufferCache.reset();
 	colourBufferCache.reset();
 	textureCache.reset();
+	setSurfaceCacheBudget();
+	discardDecodeJobs();
 
 	clearShaderCache();
+	ubershaderFallbackDraws = 0;
+
+	// The fragment UBO is recreated along with the context, so upload everything again on the next draw
+	fragmentUniformsDirty = PICA::DirtyRegs::All;
+	fragmentConfigDirty = PICA::DirtyRegs::All;
+	fragmentConfig.reset();
+	// The shader disk cache is per title, so it gets reopened once the next ROM is loaded
+	shaderDiskCache.close();
+	preloadedShaders.clear();
 
 	// Init the colour/depth buffer settings to some random defaults on reset
 	colourBufferLoc = 0;
@@ -57,6 +96,17 @@ void RendererGL::reset() {
 void RendererGL::initGraphicsContextInternal() {
 	gl.reset();
 
+	// Program binaries are core in GL 4.1 and GLES 3.0, but drivers may still not support any binary format
+	GLint binaryFormatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormatCount);
+	programBinarySupported = binaryFormatCount > 0 && glProgramBinary != nullptr && glGetProgramBinary != nullptr;
+
+	parallelShaderCompileSupported = GLAD_GL_KHR_parallel_shader_compile != 0;
+	if (parallelShaderCompileSupported) {
+		// Let the driver pick how many threads to compile shaders with
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+
 	auto gl_resources = cmrc::RendererGL::get_filesystem();
 
 	auto vertexShaderSource = gl_resources.open("opengl_vertex_shader.vert");
@@ -82,8 +132,10 @@ void RendererGL::initGraphicsContextInternal() {
 	gl.bindUBO(shadergenFragmentUBO);
 	glBufferData(GL_UNIFORM_BUFFER, sizeof(PICA::FragmentUniforms), nullptr, GL_DYNAMIC_DRAW);
 
-	vbo.createFixedSize(sizeof(Vertex) * vertexBufferSize, GL_STREAM_DRAW);
-	gl.bindVBO(vbo);
+	// The streams are recreated along with the context, so drop any batch that points into the old ones
+	pendingBatch.reset();
+	vertexStream.create(GL_ARRAY_BUFFER, vertexStreamSize);
+	gl.bindVBO(vertexStream.handle());
 	vao.create();
 	gl.bindVAO(vao);
 
@@ -112,6 +164,20 @@ void RendererGL::initGraphicsContextInternal() {
 	vao.setAttributeFloat<float>(7, 2, sizeof(Vertex), offsetof(Vertex, s.texcoord2));
 	vao.enableAttribute(7);
 
+	// Index stream for indexed draws. Like the attributes, the index buffer binding is part of the VAO state
+	indexStream.create(GL_ELEMENT_ARRAY_BUFFER, indexStreamSize);
+
+	// Set up the buffers used for hardware vertex shading. The index buffer binding is part of the VAO state, so we only bind it once
+	glGenBuffers(1, &hwVertexBuffer);
+	glGenBuffers(1, &hwIndexBuffer);
+	hwShaderVAO.create();
+	gl.bindVAO(hwShaderVAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, hwIndexBuffer);
+
+	glGenBuffers(1, &hwShaderUniformUBO);
+	gl.bindUBO(hwShaderUniformUBO);
+	glBufferData(GL_UNIFORM_BUFFER, hwShaderUniformSize, nullptr, GL_DYNAMIC_DRAW);
+
 	dummyVBO.create();
 	dummyVAO.create();
 	gl.disableScissor();
@@ -294,7 +360,7 @@ void RendererGL::setupStencilTest(bool stencilEnable) {
 }
 
 void RendererGL::setupUbershaderTexEnv() {
-	// TODO: Only update uniforms when the TEV config changed. Use an UBO potentially.
+	// TODO: Use an UBO potentially.
 	static constexpr std::array<u32, 6> ioBases = {
 		PICA::InternalRegs::TexEnv0Source, PICA::InternalRegs::TexEnv1Source, PICA::InternalRegs::TexEnv2Source,
 		PICA::InternalRegs::TexEnv3Source, PICA::InternalRegs::TexEnv4Source, PICA::InternalRegs::TexEnv5Source,
@@ -323,32 +389,39 @@ void RendererGL::setupUbershaderTexEnv() {
 	glUniform1uiv(ubershaderData.textureEnvScaleLoc, 6, textureEnvScaleRegs);
 }
 
-void RendererGL::bindTexturesToSlots() {
+std::optional<Texture> RendererGL::getUnitTexture(u32 unit) {
 	static constexpr std::array<u32, 3> ioBases = {
 		PICA::InternalRegs::Tex0BorderColor,
 		PICA::InternalRegs::Tex1BorderColor,
 		PICA::InternalRegs::Tex2BorderColor,
 	};
 
+	const size_t ioBase = ioBases[unit];
+
+	const u32 dim = regs[ioBase + 1];
+	const u32 config = regs[ioBase + 2];
+	const u32 height = dim & 0x7ff;
+	const u32 width = getBits<16, 11>(dim);
+	const u32 addr = (regs[ioBase + 4] & 0x0FFFFFFF) << 3;
+	const u32 format = regs[ioBase + (unit == 0 ? 13 : 5)] & 0xF;
+
+	if (addr == 0 || format > static_cast<u32>(PICA::TextureFmt::ETC1A4)) {
+		return std::nullopt;
+	}
+
+	return Texture(addr, static_cast<PICA::TextureFmt>(format), width, height, config);
+}
+
+void RendererGL::bindTexturesToSlots() {
 	for (int i = 0; i < 3; i++) {
 		if ((regs[PICA::InternalRegs::TexUnitCfg] & (1 << i)) == 0) {
 			continue;
 		}
 
-		const size_t ioBase = ioBases[i];
-
-		const u32 dim = regs[ioBase + 1];
-		const u32 config = regs[ioBase + 2];
-		const u32 height = dim & 0x7ff;
-		const u32 width = getBits<16, 11>(dim);
-		const u32 addr = (regs[ioBase + 4] & 0x0FFFFFFF) << 3;
-		u32 format = regs[ioBase + (i == 0 ? 13 : 5)] & 0xF;
-
 		glActiveTexture(GL_TEXTURE0 + i);
 
-		if (addr != 0) [[likely]] {
-			Texture targetTex(addr, static_cast<PICA::TextureFmt>(format), width, height, config);
-			OpenGL::Texture tex = getTexture(targetTex);
+		if (auto targetTex = getUnitTexture(i); targetTex.has_value()) [[likely]] {
+			OpenGL::Texture tex = getTexture(targetTex.value());
 			tex.bind();
 		} else {
 			// Mapping a texture from NULL. PICA seems to read the last sampled colour, but for now we will display a black texture instead since it is far easier.
@@ -405,15 +478,15 @@ void RendererGL::updateFogLUT() {
 	glActiveTexture(GL_TEXTURE0);
 }
 
-void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> vertices) {
-	// The fourth type is meant to be "Geometry primitive". TODO: Find out what that is
-	static constexpr std::array<OpenGL::Primitives, 4> primTypes = {
-		OpenGL::Triangle,
-		OpenGL::TriangleStrip,
-		OpenGL::TriangleFan,
-		OpenGL::Triangle,
-	};
+// The fourth type is meant to be "Geometry primitive". TODO: Find out what that is
+static constexpr std::array<OpenGL::Primitives, 4> primTypes = {
+	OpenGL::Triangle,
+	OpenGL::TriangleStrip,
+	OpenGL::TriangleFan,
+	OpenGL::Triangle,
+};
 
+bool RendererGL::usingUbershader() {
 	bool usingUbershader = enableUbershader;
 	if (usingUbershader) {
 		const bool lightsEnabled = (regs[InternalRegs::LightingEnable] & 1) != 0;
@@ -425,18 +498,296 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 			usingUbershader = false;
 		}
 	}
-		
-	if (usingUbershader) {
-		gl.useProgram(triangleProgram);
+
+	return usingUbershader;
+}
+
+bool RendererGL::canMergeDraw(PICA::PrimType primType, usize vertexBytes, usize indexBytes, bool indexed) {
+	// Strips and fans can't be joined into one primitive, so only triangle lists are merged
+	if (!pendingBatch.has_value() || pendingBatch->indexed != indexed || primTypes[static_cast<usize>(primType)] != OpenGL::Triangle) {
+		return false;
+	}
+
+	// Any register, LUT or texture memory change since the batch started might change the state, so setupDrawState has to run again
+	// A draw that samples its own render target needs the target to be copied to the texture again before it, so it can't be merged either
+	if (gpu.dirtyRegs != 0 || gpu.lightingLUTDirty || gpu.fogLUTDirty || renderTargetFeedback) {
+		return false;
+	}
+
+	if (gpu.getMemory().getWriteStamp() != pendingBatch->writeStamp) {
+		return false;
+	}
+
+	// The batch has to stay contiguous, so the draw needs to fit without either stream wrapping around
+	return vertexStream.fits(vertexBytes, sizeof(Vertex)) && (!indexed || indexStream.fits(indexBytes, sizeof(u32)));
+}
+
+void RendererGL::flushDraws() {
+	if (!pendingBatch.has_value()) {
+		return;
+	}
+
+	const DrawBatch& batch = *pendingBatch;
+	if (batch.indexed) {
+		const auto offset = reinterpret_cast<const void*>(batch.first * sizeof(u32));
+		glDrawRangeElements(GL_TRIANGLES, batch.minVertex, batch.maxVertex, batch.count, GL_UNSIGNED_INT, offset);
 	} else {
-		OpenGL::Program& program = getSpecializedShader();
-		gl.useProgram(program);
+		glDrawArrays(GL_TRIANGLES, GLint(batch.first), batch.count);
+	}
+
+	hostDraws++;
+	pendingBatch.reset();
+	vertexStream.fence();
+	indexStream.fence();
+}
+
+void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> vertices) {
+	const GLenum prim = primTypes[static_cast<usize>(primType)];
+	// Vertices past the last full triangle of a list are ignored anyway, and leaving them out keeps the triangles of a batch aligned
+	const usize count = prim == OpenGL::Triangle ? vertices.size() - vertices.size() % 3 : vertices.size();
+	picaDraws++;
+
+	if (count == 0) {
+		return;
+	}
+
+	const bool merge = canMergeDraw(primType, count * sizeof(Vertex), 0, false);
+	if (!merge) {
+		flushDraws();
+		setupDrawState(false);
+		gl.bindVBO(vertexStream.handle());
+		gl.bindVAO(vao);
+	}
+
+	const StreamBuffer::Allocation allocation = vertexStream.map(count * sizeof(Vertex), sizeof(Vertex));
+	std::memcpy(allocation.pointer, vertices.data(), count * sizeof(Vertex));
+	vertexStream.commit(allocation, count * sizeof(Vertex));
+
+	if (merge) {
+		pendingBatch->count += GLsizei(count);
+	} else if (prim == OpenGL::Triangle) {
+		pendingBatch = DrawBatch{
+			.indexed = false,
+			.first = allocation.offset / sizeof(Vertex),
+			.count = GLsizei(count),
+			.writeStamp = gpu.getMemory().getWriteStamp(),
+		};
+	} else {
+		glDrawArrays(prim, GLint(allocation.offset / sizeof(Vertex)), GLsizei(count));
+		hostDraws++;
+		vertexStream.fence();
+	}
+}
+
+void RendererGL::drawVerticesIndexed(PICA::PrimType primType, std::span<const Vertex> vertices, std::span<const u16> indices) {
+	const GLenum prim = primTypes[static_cast<usize>(primType)];
+	const usize count = prim == OpenGL::Triangle ? indices.size() - indices.size() % 3 : indices.size();
+	picaDraws++;
+
+	if (count == 0 || vertices.empty()) {
+		return;
+	}
+
+	const bool merge = canMergeDraw(primType, vertices.size_bytes(), count * sizeof(u32), true);
+	if (!merge) {
+		flushDraws();
+		setupDrawState(false);
+		gl.bindVBO(vertexStream.handle());
+		gl.bindVAO(vao);
+	}
+
+	const StreamBuffer::Allocation vertexAllocation = vertexStream.map(vertices.size_bytes(), sizeof(Vertex));
+	std::memcpy(vertexAllocation.pointer, vertices.data(), vertices.size_bytes());
+	vertexStream.commit(vertexAllocation, vertices.size_bytes());
+
+	// Point the indices at where the vertices ended up in the vertex stream. The index stream is bound to the VAO, which is bound here
+	const GLuint baseVertex = GLuint(vertexAllocation.offset / sizeof(Vertex));
+	const StreamBuffer::Allocation indexAllocation = indexStream.map(count * sizeof(u32), sizeof(u32));
+	u32* rebasedIndices = reinterpret_cast<u32*>(indexAllocation.pointer);
+	for (usize i = 0; i < count; i++) {
+		rebasedIndices[i] = baseVertex + indices[i];
+	}
+	indexStream.commit(indexAllocation, count * sizeof(u32));
+
+	const GLuint minVertex = baseVertex;
+	const GLuint maxVertex = baseVertex + GLuint(vertices.size() - 1);
+
+	if (merge) {
+		pendingBatch->count += GLsizei(count);
+		pendingBatch->minVertex = std::min(pendingBatch->minVertex, minVertex);
+		pendingBatch->maxVertex = std::max(pendingBatch->maxVertex, maxVertex);
+	} else if (prim == OpenGL::Triangle) {
+		pendingBatch = DrawBatch{
+			.indexed = true,
+			.first = indexAllocation.offset / sizeof(u32),
+			.count = GLsizei(count),
+			.minVertex = minVertex,
+			.maxVertex = maxVertex,
+			.writeStamp = gpu.getMemory().getWriteStamp(),
+		};
+	} else {
+		const auto offset = reinterpret_cast<const void*>(indexAllocation.offset);
+		glDrawRangeElements(prim, minVertex, maxVertex, GLsizei(count), GL_UNSIGNED_INT, offset);
+		hostDraws++;
+		vertexStream.fence();
+		indexStream.fence();
+	}
+}
+
+bool RendererGL::prepareForDraw(ShaderUnit& shaderUnit) {
+#ifdef USING_GLES
+	// GLSL ES doesn't allow arrays of vertex attributes, and GLES 3.0 lacks base vertex draws
+	return false;
+#else
+	// Decompiled vertex shaders output the same varyings as the shadergen vertex shader, so they can't be used with the ubershader
+	if (usingUbershader()) {
+		return false;
+	}
+
+	PICA::VertexConfig vsConfig(regs, shaderUnit.vs, emulatorConfig->accurateShaderMul);
+	auto [it, inserted] = vertexShaderCache.try_emplace(vsConfig);
+	OpenGL::Shader& shader = it->second;
+
+	if (inserted) {
+		using namespace PICA::ShaderGen;
+		const std::string picaSource = decompileShader(shaderUnit.vs, *emulatorConfig, shaderUnit.vs.entrypoint, API::GL, Language::GLSL);
+
+		// Decompilation fails if the shader uses something the decompiler doesn't handle yet, eg control flow. Use the CPU for those
+		if (!picaSource.empty()) {
+			const std::string source = fragShaderGen.getVertexShaderAccelerated(picaSource, vsConfig);
+			shader.create({source.c_str(), source.size()}, OpenGL::Vertex);
+		}
+	}
+
+	if (!shader.exists()) {
+		return false;
+	}
+
+	hwVertexShader = &shader;
+	hwVertexShaderHash = std::hash<PICA::VertexConfig>()(vsConfig);
+
+	// The float, integer and boolean uniforms are laid out in PICAShader exactly like the std140 uniform block of the decompiled shader
+	constexpr usize uniformSize = offsetof(PICAShader, boolUniform) + sizeof(u32) - offsetof(PICAShader, floatUniforms);
+	gl.bindUBO(hwShaderUniformUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, uniformSize, &shaderUnit.vs.floatUniforms);
+	glBindBufferBase(GL_UNIFORM_BUFFER, hwShaderUniformBinding, hwShaderUniformUBO);
+
+	return true;
+#endif
+}
+
+void RendererGL::drawVerticesAccelerated(PICA::PrimType primType, const PICA::DrawAcceleration& accel) {
+	static constexpr std::array<GLenum, 4> attribTypes = {GL_BYTE, GL_UNSIGNED_BYTE, GL_SHORT, GL_FLOAT};
+	const auto& layout = accel.layout;
+
+	flushDraws();
+	setupDrawState(true);
+	gl.bindVAO(hwShaderVAO);
+	gl.bindVBO(hwVertexBuffer);
+
+	// Give each vertex buffer its own 16-byte aligned range of the stream buffer, and orphan the old storage before uploading
+	std::array<u32, VertexLoader::maxAttribCount> bufferOffsets;
+	u32 totalSize = 0;
+	for (u32 i = 0; i < layout.bufferCount; i++) {
+		bufferOffsets[i] = totalSize;
+		totalSize += (accel.vertexBuffers[i].size + 15) & ~15u;
+	}
+
+	glBufferData(GL_ARRAY_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+	for (u32 i = 0; i < layout.bufferCount; i++) {
+		if (accel.vertexBuffers[i].size != 0) {
+			glBufferSubData(GL_ARRAY_BUFFER, bufferOffsets[i], accel.vertexBuffers[i].size, accel.vertexBuffers[i].data);
+		}
+	}
+
+	// If several attributes go to the same input register, the last one wins, like in GPU::drawArrays
+	std::array<int, 16> registerAttributes;
+	registerAttributes.fill(-1);
+	for (u32 i = 0; i < layout.attributeCount; i++) {
+		registerAttributes[layout.attributes[i].inputRegister] = int(i);
+	}
+
+	for (u32 reg = 0; reg < 16; reg++) {
+		if (registerAttributes[reg] == -1) {
+			hwShaderVAO.disableAttribute(reg);
+			continue;
+		}
+
+		const auto& attr = layout.attributes[registerAttributes[reg]];
+		if (attr.fixed) {
+			// Fixed attributes use the current value of the generic vertex attribute instead of an array
+			hwShaderVAO.disableAttribute(reg);
+			glVertexAttrib4fv(reg, reinterpret_cast<const float*>(&accel.fixedAttributes[attr.fixedIndex]));
+		} else {
+			// The PICA converts integer attributes to float without normalizing them
+			const usize offset = bufferOffsets[attr.buffer] + attr.offset;
+			glVertexAttribPointer(
+				reg, attr.componentCount, attribTypes[attr.type], GL_FALSE, layout.strides[attr.buffer], reinterpret_cast<const void*>(offset)
+			);
+			hwShaderVAO.enableAttribute(reg);
+		}
 	}
 
 	const auto primitiveTopology = primTypes[static_cast<usize>(primType)];
+	if (accel.indexed) {
+		// Vertex buffers were uploaded starting from the minimum index, so rebase the indices with the base vertex
+		const GLenum indexType = accel.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+		const GLsizeiptr indexBufferSize = accel.vertexCount * (accel.shortIndices ? sizeof(u16) : sizeof(u8));
+
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, accel.indexBuffer, GL_STREAM_DRAW);
+		glDrawRangeElementsBaseVertex(
+			primitiveTopology, accel.minimumIndex, accel.maximumIndex, GLsizei(accel.vertexCount), indexType, nullptr, -GLint(accel.minimumIndex)
+		);
+	} else {
+		glDrawArrays(primitiveTopology, 0, GLsizei(accel.vertexCount));
+	}
+
+	hwVertexShader = nullptr;
+}
+
+void RendererGL::updateDirtyRegs() {
+	const u32 dirty = gpu.takeDirtyRegs();
+	ubershaderRegsDirty |= dirty;
+	fragmentUniformsDirty |= dirty;
+	fragmentConfigDirty |= dirty;
+}
+
+const PICA::FragmentConfig& RendererGL::getFragmentConfig() {
+	using namespace PICA::DirtyRegs;
+	static constexpr u32 configRegs = Rasterizer | TexUnitConfig | TexEnv | Fog | FragmentOps | Lighting;
+
+	if (!fragmentConfig || (fragmentConfigDirty & configRegs) != 0) {
+		fragmentConfig.emplace(regs);
+	}
+
+	fragmentConfigDirty = 0;
+	return *fragmentConfig;
+}
+
+void RendererGL::setupDrawState(bool hwVertexShading) {
+	updateDirtyRegs();
+	renderTargetFeedback = false;
+	bool useUbershader = !hwVertexShading && usingUbershader();
+
+	if (!useUbershader) {
+		// Draws that were only routed to shadergen because of forceShadergenForLights can still be rendered with the ubershader while their
+		// program compiles. Decompiled vertex shaders don't output what the ubershader expects, so those always wait for the compile
+		const bool allowAsync = !hwVertexShading && enableUbershader;
+		OpenGL::Program* program = getSpecializedShader(hwVertexShading, allowAsync);
+
+		if (program != nullptr) {
+			gl.useProgram(*program);
+		} else {
+			useUbershader = true;
+			ubershaderFallbackDraws++;
+		}
+	}
+
+	if (useUbershader) {
+		gl.useProgram(triangleProgram);
+	}
+
 	gl.disableScissor();
-	gl.bindVBO(vbo);
-	gl.bindVAO(vao);
 
 	gl.enableClipPlane(0);  // Clipping plane 0 is always enabled
 	if (regs[PICA::InternalRegs::ClipEnable] & 1) {
@@ -446,6 +797,9 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 	setupBlending();
 	auto poop = getColourBuffer(colourBufferLoc, colourBufferFormat, fbSize[0], fbSize[1]);
 	poop->fbo.bind(OpenGL::DrawAndReadFramebuffer);
+	if (ColourBuffer* renderTarget = markColourBufferWritten(colourBufferLoc); renderTarget != nullptr) {
+		renderTarget->linear = false;
+	}
 
 	const u32 depthControl = regs[PICA::InternalRegs::DepthAndColorMask];
 	const bool depthWrite = regs[PICA::InternalRegs::DepthBufferWrite];
@@ -458,7 +812,7 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 	static constexpr std::array<GLenum, 8> depthModes = {GL_NEVER, GL_ALWAYS, GL_EQUAL, GL_NOTEQUAL, GL_LESS, GL_LEQUAL, GL_GREATER, GL_GEQUAL};
 
 	// Update ubershader uniforms
-	if (usingUbershader) {
+	if (useUbershader) {
 		const float depthScale = f24::fromRaw(regs[PICA::InternalRegs::DepthScale] & 0xffffff).toFloat32();
 		const float depthOffset = f24::fromRaw(regs[PICA::InternalRegs::DepthOffset] & 0xffffff).toFloat32();
 		const bool depthMapEnable = regs[PICA::InternalRegs::DepthmapEnable] & 1;
@@ -480,8 +834,15 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 
 		// Upload PICA Registers as a single uniform. The shader needs access to the rasterizer registers (for depth, starting from index 0x48)
 		// The texturing and the fragment lighting registers. Therefore we upload them all in one go to avoid multiple slow uniform updates
-		glUniform1uiv(ubershaderData.picaRegLoc, 0x200 - 0x48, &regs[0x48]);
-		setupUbershaderTexEnv();
+		// Every tracked register group is in this range, so any change means we need to upload again
+		if (ubershaderRegsDirty != 0) {
+			glUniform1uiv(ubershaderData.picaRegLoc, 0x200 - 0x48, &regs[0x48]);
+		}
+
+		if ((ubershaderRegsDirty & PICA::DirtyRegs::TexEnv) != 0) {
+			setupUbershaderTexEnv();
+		}
+		ubershaderRegsDirty = 0;
 	}
 
 	bindTexturesToSlots();
@@ -527,12 +888,14 @@ void RendererGL::drawVertices(PICA::PrimType primType, std::span<const Vertex> v
 	}
 
 	setupStencilTest(stencilEnable);
-
-	vbo.bufferVertsSub(vertices);
-	OpenGL::draw(primitiveTopology, GLsizei(vertices.size()));
 }
 
 void RendererGL::display() {
+	flushDraws();
+	// Textures that were prefetched during the frame but never drawn with are not going to be used
+	discardDecodeJobs();
+	preloadShaders();
+
 	gl.disableScissor();
 	gl.disableBlend();
 	gl.disableDepth();
@@ -579,6 +942,7 @@ void RendererGL::display() {
 
 void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) {
 	log("GPU: Clear buffer\nStart: %08X End: %08X\nValue: %08X Control: %08X\n", startAddress, endAddress, value, control);
+	flushDraws();
 	gl.disableScissor();
 
 	const auto color = colourBufferCache.findFromAddress(startAddress);
@@ -592,6 +956,9 @@ void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 co
 		gl.setColourMask(true, true, true, true);
 		gl.setClearColour(r, g, b, a);
 		OpenGL::clearColor();
+		// Anything the CPU wrote to the buffer before the clear is gone, so there's nothing to load from memory anymore
+		color->get().writeStamp = gpu.getMemory().getWriteStamp();
+		markColourBufferWritten(startAddress);
 		return;
 	}
 
@@ -619,6 +986,8 @@ void RendererGL::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 co
 			OpenGL::clearDepth();
 		}
 
+		depth->get().writeStamp = gpu.getMemory().getWriteStamp();
+		markDepthBufferWritten(depth->get());
 		return;
 	}
 
@@ -632,9 +1001,10 @@ OpenGL::Framebuffer RendererGL::getColourFBO() {
 	auto buffer = colourBufferCache.find(sampleBuffer);
 
 	if (buffer.has_value()) {
+		syncColourBuffer(buffer.value().get());
 		return buffer.value().get().fbo;
 	} else {
-		return colourBufferCache.add(sampleBuffer).fbo;
+		return addColourBuffer(sampleBuffer).fbo;
 	}
 }
 
@@ -642,12 +1012,12 @@ void RendererGL::bindDepthBuffer() {
 	// Similar logic as the getColourFBO function
 	DepthBuffer sampleBuffer(depthBufferLoc, depthBufferFormat, fbSize[0], fbSize[1]);
 	auto buffer = depthBufferCache.find(sampleBuffer);
-	GLuint tex;
+	DepthBuffer& depthBuffer = buffer.has_value() ? buffer.value().get() : addDepthBuffer(sampleBuffer);
+	syncDepthBuffer(depthBuffer);
+	GLuint tex = depthBuffer.texture.m_handle;
 
-	if (buffer.has_value()) {
-		tex = buffer.value().get().texture.m_handle;
-	} else {
-		tex = depthBufferCache.add(sampleBuffer).texture.m_handle;
+	if (regs[PICA::InternalRegs::DepthBufferWrite] != 0) {
+		markDepthBufferWritten(depthBuffer);
 	}
 
 	if (PICA::DepthFmt::Depth24Stencil8 != depthBufferFormat) {
@@ -658,11 +1028,61 @@ void RendererGL::bindDepthBuffer() {
 }
 
 OpenGL::Texture RendererGL::getTexture(Texture& tex) {
+	// Render targets that are sampled as textures are copied on the GPU, instead of decoding the stale data in emulated memory
+	// Colour and texture formats 0-4 are the same formats, and the host copies of both are RGBA8, so only the layout needs to match
+	if (auto colourBuffer = colourBufferCache.probeAddress(tex.location); colourBuffer.has_value()) {
+		ColourBuffer& buffer = colourBuffer->get();
+		const bool compatible = buffer.location == tex.location && u32(buffer.format) == u32(tex.format) && buffer.size.x() == tex.size.x() &&
+								buffer.size.y() >= tex.size.y() && !buffer.linear;
+
+		if (buffer.renderStamp != 0 && compatible) {
+			// The CPU may have written to the buffer's memory since it was rendered to, eg to draw over it in software
+			syncColourBuffer(buffer);
+			return getTextureFromColourBuffer(tex, buffer);
+		}
+	}
+
+	// Anything else the GPU rendered to the texture's memory, such as a depth buffer or a colour buffer in another format, has to be
+	// written back to memory to be reinterpreted by the decoder
+	Memory& mem = gpu.getMemory();
+	mem.writeBackGPUOwned(tex.location, u32(tex.sizeInBytes()));
+
 	// Similar logic as the getColourFBO/bindDepthBuffer functions
 	auto buffer = textureCache.find(tex);
 
+	// If the texture was queued for decoding in the background when its registers were written, pick up the result
+	const TextureDecodeQueue::JobPtr job = takeDecodeJob(tex);
+
 	if (buffer.has_value()) {
-		return buffer.value().get().texture;
+		Texture& cachedTex = buffer.value().get();
+
+		// If the game wrote to the texture's memory since we last checked, re-hash it and only re-decode if its contents really changed
+		if (mem.writtenSince(cachedTex.location, u32(cachedTex.sizeInBytes()), cachedTex.writeStamp) || cachedTex.renderStamp != 0) {
+			cachedTex.writeStamp = mem.getWriteStamp();
+			if (cachedTex.renderStamp != 0) {
+				// The texture was copied from a render target, so its hash says nothing about its contents
+				cachedTex.renderStamp = 0;
+				cachedTex.hash = 0;
+			}
+
+			if (job) {
+				if (job->hash != cachedTex.hash) {
+					cachedTex.hash = job->hash;
+					cachedTex.upload(job->decoded);
+				}
+			} else {
+				const u8* startPointer = gpu.getPointerPhys<u8>(cachedTex.location);
+				const auto textureData = std::span{startPointer, cachedTex.sizeInBytes()};
+				const PICAHash::HashType hash = PICAHash::computeHash(reinterpret_cast<const char*>(textureData.data()), textureData.size());
+
+				if (hash != cachedTex.hash) {
+					cachedTex.hash = hash;
+					cachedTex.decodeTexture(textureData);
+				}
+			}
+		}
+
+		return cachedTex.texture;
 	} else {
 		const u8* startPointer = gpu.getPointerPhys<u8>(tex.location);
 		const usize sizeInBytes = tex.sizeInBytes();
@@ -674,12 +1094,121 @@ OpenGL::Texture RendererGL::getTexture(Texture& tex) {
 
 		const auto textureData = std::span{startPointer, tex.sizeInBytes()};  // Get pointer to the texture data in 3DS memory
 		Texture& newTex = textureCache.add(tex);
-		newTex.decodeTexture(textureData);
+		newTex.watch(mem);
+
+		if (job) {
+			newTex.hash = job->hash;
+			newTex.upload(job->decoded);
+		} else {
+			newTex.hash = PICAHash::computeHash(reinterpret_cast<const char*>(textureData.data()), textureData.size());
+			newTex.decodeTexture(textureData);
+		}
 
 		return newTex.texture;
 	}
 }
 
+OpenGL::Texture RendererGL::getTextureFromColourBuffer(Texture& tex, ColourBuffer& buffer) {
+	auto cached = textureCache.find(tex);
+	Texture* target;
+
+	if (cached.has_value()) {
+		target = &cached.value().get();
+	} else {
+		target = &textureCache.add(tex);
+		target->watch(gpu.getMemory());
+	}
+
+	// The render target of the current draw was just given the newest stamp
+	if (buffer.renderStamp == renderTargetWrites) {
+		renderTargetFeedback = true;
+	}
+
+	if (target->renderStamp != buffer.renderStamp) {
+		target->renderStamp = buffer.renderStamp;
+
+		// This can run in the middle of setting up a draw, so put the draw's framebuffers back afterwards
+		GLint oldDrawFramebuffer, oldReadFramebuffer;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &oldDrawFramebuffer);
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &oldReadFramebuffer);
+
+		textureCopyFramebuffer.createWithDrawTexture(target->texture);
+		buffer.fbo.bind(OpenGL::ReadFramebuffer);
+		gl.disableScissor();
+
+		// The texture is the first rows of the buffer in memory. Colour buffers keep their first row at the top in GL and textures at the
+		// bottom, so flip them while copying
+		const GLint width = GLint(tex.size.x());
+		const GLint height = GLint(tex.size.y());
+		const GLint bufferHeight = GLint(buffer.size.y());
+		glBlitFramebuffer(0, bufferHeight - height, width, bufferHeight, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oldDrawFramebuffer);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, oldReadFramebuffer);
+	}
+
+	return target->texture;
+}
+
+void RendererGL::prefetchTexture(u32 unit) {
+	if (!emulatorConfig->asyncTextureDecode) {
+		return;
+	}
+
+	auto tex = getUnitTexture(unit);
+	if (!tex.has_value()) {
+		return;
+	}
+
+	Memory& mem = gpu.getMemory();
+	const u32 location = tex->location;
+	const u32 sizeInBytes = u32(tex->sizeInBytes());
+
+	// Nothing to do if the texture is cached and up to date, or if it's already queued
+	if (auto cached = textureCache.probe(*tex); cached.has_value() && !mem.writtenSince(location, sizeInBytes, cached->get().writeStamp)) {
+		return;
+	}
+
+	if (textureDecodeQueue.contains(location, tex->format, tex->size.u(), tex->size.v())) {
+		return;
+	}
+
+	const u8* startPointer = gpu.getPointerPhys<u8>(location);
+	if (sizeInBytes == 0 || startPointer == nullptr || gpu.getPointerPhys<u8>(location + sizeInBytes - 1) == nullptr) {
+		return;
+	}
+
+	if (!textureDecodeQueue.isRunning()) {
+		textureDecodeQueue.start(std::clamp<u32>(std::thread::hardware_concurrency() / 2, 1, 4));
+	}
+
+	// Watch the texture's memory until the job is claimed or discarded, so that we can tell if its copy of the data went stale
+	textureDecodeQueue.submit(location, tex->format, tex->size.u(), tex->size.v(), mem.getWriteStamp(), std::span{startPointer, sizeInBytes});
+	mem.watchPhysicalRange(location, sizeInBytes);
+}
+
+TextureDecodeQueue::JobPtr RendererGL::takeDecodeJob(Texture& tex) {
+	TextureDecodeQueue::JobPtr job = textureDecodeQueue.take(tex.location, tex.format, tex.size.u(), tex.size.v());
+	if (!job) {
+		return nullptr;
+	}
+
+	Memory& mem = gpu.getMemory();
+	const u32 sizeInBytes = u32(job->data.size());
+	const bool stale = mem.writtenSince(job->location, sizeInBytes, job->writeStamp);
+	mem.unwatchPhysicalRange(job->location, sizeInBytes);
+
+	return stale ? nullptr : job;
+}
+
+void RendererGL::discardDecodeJobs() {
+	Memory& mem = gpu.getMemory();
+
+	for (const auto& job : textureDecodeQueue.takeAll()) {
+		mem.unwatchPhysicalRange(job->location, u32(job->data.size()));
+	}
+}
+
 // NOTE: The GPU format has RGB5551 and RGB655 swapped compared to internal regs format
 PICA::ColorFmt ToColorFmt(u32 format) {
 	switch (format) {
@@ -690,6 +1219,7 @@ PICA::ColorFmt ToColorFmt(u32 format) {
 }
 
 void RendererGL::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) {
+	flushDraws();
 	const u32 inputWidth = inputSize & 0xffff;
 	const u32 inputHeight = inputSize >> 16;
 	const auto inputFormat = ToColorFmt(Helpers::getBits<8, 3>(flags));
@@ -735,9 +1265,16 @@ void RendererGL::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u
 		srcRect.left, srcRect.bottom, srcRect.right, srcRect.top, destRect.left, destRect.bottom, destRect.right, destRect.top, GL_COLOR_BUFFER_BIT,
 		GL_LINEAR
 	);
+
+	// The output is linear unless the input is (linear to tiled), or unless neither is (tiled to tiled)
+	if (ColourBuffer* output = markColourBufferWritten(outputAddr); output != nullptr) {
+		output->linear = !Helpers::getBit<1>(flags) && !Helpers::getBit<5>(flags);
+		prefetchColourBuffer(*output);
+	}
 }
 
 void RendererGL::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {
+	flushDraws();
 	// Texture copy size is aligned to 16 byte units
 	const u32 copySize = totalBytes & ~0xf;
 	if (copySize == 0) {
@@ -815,6 +1352,12 @@ void RendererGL::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32
 		srcRect.left, srcRect.bottom, srcRect.right, srcRect.top, destRect.left, destRect.bottom, destRect.right, destRect.top, GL_COLOR_BUFFER_BIT,
 		GL_LINEAR
 	);
+
+	// Texture copies copy raw data, so the output has the same layout as the input
+	if (ColourBuffer* output = markColourBufferWritten(outputAddr); output != nullptr) {
+		output->linear = srcFramebuffer->linear;
+		prefetchColourBuffer(*output);
+	}
 }
 
 std::optional<ColourBuffer> RendererGL::getColourBuffer(u32 addr, PICA::ColorFmt format, u32 width, u32 height, bool createIfnotFound) {
@@ -823,6 +1366,7 @@ std::optional<ColourBuffer> RendererGL::getColourBuffer(u32 addr, PICA::ColorFmt
 	// subrect of a surface and in case of texcopy we don't know the format of the surface.
 	auto buffer = colourBufferCache.findFromAddress(addr);
 	if (buffer.has_value()) {
+		syncColourBuffer(buffer.value().get());
 		return buffer.value().get();
 	}
 
@@ -832,38 +1376,614 @@ std::optional<ColourBuffer> RendererGL::getColourBuffer(u32 addr, PICA::ColorFmt
 
 	// Otherwise create and cache a new buffer.
 	ColourBuffer sampleBuffer(addr, format, width, height);
-	return colourBufferCache.add(sampleBuffer);
+	return addColourBuffer(sampleBuffer);
+}
+
+ColourBuffer* RendererGL::markColourBufferWritten(u32 addr) {
+	auto buffer = colourBufferCache.probeAddress(addr);
+	if (!buffer.has_value()) {
+		return nullptr;
+	}
+
+	ColourBuffer& colourBuffer = buffer.value().get();
+	colourBuffer.renderStamp = ++renderTargetWrites;
+	gpu.getMemory().markGPUOwned(colourBuffer.location, u32(colourBuffer.sizeInBytes()));
+	return &colourBuffer;
+}
+
+void RendererGL::prefetchColourBuffer(ColourBuffer& buffer) {
+	// Buffers the CPU never looked at are only read back if it does, so that we don't read back every frame the GPU renders
+	if (!buffer.cpuAccessed) {
+		return;
+	}
+
+	// Stop once the CPU skips the output of a transfer, so that a buffer it only read once isn't read back for good
+	if (buffer.readbackStamp != 0 && !buffer.readbackUsed) {
+		buffer.cpuAccessed = false;
+		buffer.readbackStamp = 0;
+		return;
+	}
+
+	const u32 width = buffer.size.x();
+	const u32 height = buffer.size.y();
+
+	if (buffer.readbackBuffer == 0) {
+		glGenBuffers(1, &buffer.readbackBuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.readbackBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(width) * height * sizeof(u32), nullptr, GL_STREAM_READ);
+	} else {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.readbackBuffer);
+	}
+
+	if (buffer.readbackFence != nullptr) {
+		glDeleteSync(buffer.readbackFence);
+	}
+
+	// With a pixel pack buffer bound, glReadPixels only queues the copy instead of waiting for the GPU to finish rendering
+	GLint oldReadFramebuffer;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &oldReadFramebuffer);
+	buffer.fbo.bind(OpenGL::ReadFramebuffer);
+	glReadPixels(0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, oldReadFramebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	buffer.readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	buffer.readbackStamp = buffer.renderStamp;
+	buffer.readbackUsed = false;
 }
 
-OpenGL::Program& RendererGL::getSpecializedShader() {
-	constexpr uint uboBlockBinding = 2;
+void RendererGL::markDepthBufferWritten(DepthBuffer& buffer) {
+	buffer.gpuWritten = true;
+	gpu.getMemory().markGPUOwned(buffer.location, u32(buffer.sizeInBytes()));
+}
+
+void RendererGL::writeBackSurfaces(u32 paddr, u32 size) {
+	// The CPU is about to access memory the GPU renders to, so it has to see the draws we've held back too
+	flushDraws();
 
-	PICA::FragmentConfig fsConfig(regs);
+	// Where surfaces overlap, the most recently used one is written last so that its data wins
+	colourBufferCache.forEachOverlapping(paddr, size, [&](ColourBuffer& buffer) { writeBackColourBuffer(buffer, paddr, size); });
+	depthBufferCache.forEachOverlapping(paddr, size, [&](DepthBuffer& buffer) { writeBackDepthBuffer(buffer, paddr, size); });
+}
 
-	CachedProgram& programEntry = shaderCache[fsConfig];
+namespace {
+	// Surfaces are stored in memory as rows of 8x8 tiles, or as rows of pixels if they're linear. Finds the rows of pixels that hold
+	// [start, end) of a surface starting at "location" and returns the first row and the number of rows, counting from the start in memory
+	std::pair<u32, u32> getWriteBackRows(u32 location, u32 width, u32 height, u32 bytesPerPixel, bool linear, u32 start, u32 end) {
+		const u32 rowsPerBlock = linear ? 1 : 8;
+		const u32 blockSize = width * rowsPerBlock * bytesPerPixel;
+		const u32 firstRow = (start - location) / blockSize * rowsPerBlock;
+		const u32 lastRow = std::min((end - 1 - location) / blockSize * rowsPerBlock + rowsPerBlock, height);
+
+		return {firstRow, lastRow - firstRow};
+	}
+
+	// Offset of pixel (x, y) of a surface in memory, where y counts rows in memory order
+	u32 getPixelOffset(u32 x, u32 y, u32 width, u32 bytesPerPixel, bool linear) {
+		const u32 index = linear ? y * width + x : PICA::tiledPixelIndex(x, y, width);
+		return index * bytesPerPixel;
+	}
+}  // namespace
+
+void RendererGL::writeBackColourBuffer(ColourBuffer& buffer, u32 paddr, u32 size) {
+	// Surfaces the GPU never wrote to only hold garbage
+	if (buffer.renderStamp == 0) {
+		return;
+	}
+
+	const u32 start = std::max(paddr, buffer.location);
+	const u32 end = u32(std::min<u64>(u64(paddr) + size, u64(buffer.location) + buffer.sizeInBytes()));
+	u8* data = gpu.getPointerPhys<u8>(buffer.location);
+	if (start >= end || data == nullptr) {
+		return;
+	}
+
+	const u32 width = buffer.size.x();
+	const u32 height = buffer.size.y();
+	const u32 bytesPerPixel = PICA::sizePerPixel(buffer.format);
+	const auto [firstRow, rowCount] = getWriteBackRows(buffer.location, width, height, bytesPerPixel, buffer.linear, start, end);
+	if (rowCount == 0) {
+		return;
+	}
+
+	// We only need the rows that hold the range. Rows in memory start from the top of the buffer, and rows in GL from the bottom
+	const u32 firstGLRow = height - firstRow - rowCount;
+	const u32* pixels = nullptr;
+
+	// Use the data that was read back in the background if it's still current. The read was started when the buffer was last written, so
+	// it has usually completed by now
+	const bool prefetched = buffer.readbackBuffer != 0 && buffer.readbackStamp == buffer.renderStamp;
+	if (prefetched) {
+		while (glClientWaitSync(buffer.readbackFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED) {
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.readbackBuffer);
+		const GLintptr offset = GLintptr(firstGLRow) * width * sizeof(u32);
+		const GLsizeiptr length = GLsizeiptr(rowCount) * width * sizeof(u32);
+		pixels = static_cast<const u32*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, offset, length, GL_MAP_READ_BIT));
+
+		if (pixels != nullptr) {
+			buffer.readbackUsed = true;
+		} else {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+	}
+
+	if (pixels == nullptr) {
+		writeBackPixels.resize(usize(width) * rowCount);
+		GLint oldReadFramebuffer;
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &oldReadFramebuffer);
+		buffer.fbo.bind(OpenGL::ReadFramebuffer);
+		glReadPixels(0, GLint(firstGLRow), GLsizei(width), GLsizei(rowCount), GL_RGBA, GL_UNSIGNED_BYTE, writeBackPixels.data());
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, oldReadFramebuffer);
+		pixels = writeBackPixels.data();
+	}
+
+	for (u32 row = 0; row < rowCount; row++) {
+		const u32* rowPixels = &pixels[usize(rowCount - 1 - row) * width];
+
+		for (u32 x = 0; x < width; x++) {
+			const u32 offset = getPixelOffset(x, firstRow + row, width, bytesPerPixel, buffer.linear);
+			const u32 address = buffer.location + offset;
+
+			if (address >= start && address < end) {
+				const u32 pixel = rowPixels[x];
+				PICA::encodeColour(buffer.format, data + offset, {u8(pixel), u8(pixel >> 8), u8(pixel >> 16), u8(pixel >> 24)});
+			}
+		}
+	}
+
+	if (pixels != writeBackPixels.data()) {
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	// From now on, transfers to this buffer are read back ahead of time
+	buffer.cpuAccessed = true;
+
+	// The write-back makes memory match the texture, so it doesn't make the buffer out of date. Other surfaces there still see it as a write
+	Memory& mem = gpu.getMemory();
+	const bool upToDate = !mem.writtenSince(buffer.location, u32(buffer.sizeInBytes()), buffer.writeStamp);
+	mem.markPhysicalWrite(start, end - start);
+	if (upToDate) {
+		buffer.writeStamp = mem.getWriteStamp();
+	}
+}
+
+void RendererGL::writeBackDepthBuffer(DepthBuffer& buffer, u32 paddr, u32 size) {
+#ifdef USING_GLES
+	// GLES can't read back depth and stencil data
+	return;
+#endif
+	if (!buffer.gpuWritten) {
+		return;
+	}
+
+	const u32 start = std::max(paddr, buffer.location);
+	const u32 end = u32(std::min<u64>(u64(paddr) + size, u64(buffer.location) + buffer.sizeInBytes()));
+	u8* data = gpu.getPointerPhys<u8>(buffer.location);
+	if (start >= end || data == nullptr) {
+		return;
+	}
+
+	const u32 width = buffer.size.x();
+	const u32 height = buffer.size.y();
+	const u32 bytesPerPixel = PICA::sizePerPixel(buffer.format);
+	const auto [firstRow, rowCount] = getWriteBackRows(buffer.location, width, height, bytesPerPixel, false, start, end);
+	if (rowCount == 0) {
+		return;
+	}
+
+	// Depth is read back as 32-bit normalized values, or as 24 bits of depth above 8 bits of stencil for Depth24Stencil8
+	const bool hasStencil = buffer.format == PICA::DepthFmt::Depth24Stencil8;
+	writeBackPixels.resize(usize(width) * rowCount);
+	GLint oldReadFramebuffer;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &oldReadFramebuffer);
+	buffer.fbo.bind(OpenGL::ReadFramebuffer);
+	glReadPixels(
+		0, GLint(height - firstRow - rowCount), GLsizei(width), GLsizei(rowCount), hasStencil ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT,
+		hasStencil ? GL_UNSIGNED_INT_24_8 : GL_UNSIGNED_INT, writeBackPixels.data()
+	);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, oldReadFramebuffer);
+
+	for (u32 row = 0; row < rowCount; row++) {
+		const u32* pixels = &writeBackPixels[usize(rowCount - 1 - row) * width];
+
+		for (u32 x = 0; x < width; x++) {
+			const u32 offset = getPixelOffset(x, firstRow + row, width, bytesPerPixel, false);
+			const u32 address = buffer.location + offset;
+			if (address < start || address >= end) {
+				continue;
+			}
+
+			// Depth values are stored in memory as little endian, with the stencil value after the depth value
+			const u32 value = hasStencil ? (pixels[x] >> 8) | (pixels[x] << 24) : pixels[x] >> (32 - bytesPerPixel * 8);
+			for (u32 i = 0; i < bytesPerPixel; i++) {
+				data[offset + i] = u8(value >> (i * 8));
+			}
+		}
+	}
+
+	// Same as writeBackColourBuffer
+	Memory& mem = gpu.getMemory();
+	const bool upToDate = !mem.writtenSince(buffer.location, u32(buffer.sizeInBytes()), buffer.writeStamp);
+	mem.markPhysicalWrite(start, end - start);
+	if (upToDate) {
+		buffer.writeStamp = mem.getWriteStamp();
+	}
+}
+
+ColourBuffer& RendererGL::addColourBuffer(ColourBuffer sampleBuffer) {
+	Memory& mem = gpu.getMemory();
+	const u32 size = u32(sampleBuffer.sizeInBytes());
+
+	// The new buffer is loaded from memory, so what the GPU rendered to surfaces overlapping it has to make it to memory first
+	mem.writeBackGPUOwned(sampleBuffer.location, size);
+
+	ColourBuffer& buffer = colourBufferCache.add(sampleBuffer);
+	buffer.watchedMemory = &mem;
+	mem.watchPhysicalRange(buffer.location, size);
+	loadColourBufferRows(buffer, 0, buffer.size.y());
+	buffer.writeStamp = mem.getWriteStamp();
+
+	return buffer;
+}
+
+DepthBuffer& RendererGL::addDepthBuffer(DepthBuffer sampleBuffer) {
+	Memory& mem = gpu.getMemory();
+	const u32 size = u32(sampleBuffer.sizeInBytes());
+	mem.writeBackGPUOwned(sampleBuffer.location, size);
+
+	DepthBuffer& buffer = depthBufferCache.add(sampleBuffer);
+	buffer.watchedMemory = &mem;
+	mem.watchPhysicalRange(buffer.location, size);
+	loadDepthBufferRows(buffer, 0, buffer.size.y());
+	buffer.writeStamp = mem.getWriteStamp();
+
+	return buffer;
+}
+
+void RendererGL::syncColourBuffer(ColourBuffer& buffer) {
+	const u32 bytesPerPixel = PICA::sizePerPixel(buffer.format);
+	const auto [firstRow, rowCount] =
+		getRowsToLoad(buffer.location, buffer.size.x(), buffer.size.y(), bytesPerPixel, buffer.linear, buffer.writeStamp);
+	if (rowCount == 0) {
+		return;
+	}
+
+	loadColourBufferRows(buffer, firstRow, rowCount);
+	buffer.writeStamp = gpu.getMemory().getWriteStamp();
+
+	// Textures copied from the buffer have to be copied again
+	if (buffer.renderStamp != 0) {
+		buffer.renderStamp = ++renderTargetWrites;
+	}
+}
+
+void RendererGL::syncDepthBuffer(DepthBuffer& buffer) {
+	const u32 bytesPerPixel = PICA::sizePerPixel(buffer.format);
+	const auto [firstRow, rowCount] = getRowsToLoad(buffer.location, buffer.size.x(), buffer.size.y(), bytesPerPixel, false, buffer.writeStamp);
+	if (rowCount == 0) {
+		return;
+	}
+
+	loadDepthBufferRows(buffer, firstRow, rowCount);
+	buffer.writeStamp = gpu.getMemory().getWriteStamp();
+}
+
+std::pair<u32, u32> RendererGL::getRowsToLoad(u32 location, u32 width, u32 height, u32 bytesPerPixel, bool linear, u64 stamp) {
+	Memory& mem = gpu.getMemory();
+	const u32 end = location + width * height * bytesPerPixel;
+	if (!mem.writtenSince(location, end - location, stamp)) {
+		return {0, 0};
+	}
+
+	// Find the span of pages that were written to
+	u32 writtenStart = end;
+	u32 writtenEnd = location;
+	for (u32 page = location & ~Memory::pageMask; page < end; page += Memory::pageSize) {
+		if (mem.writtenSince(page, Memory::pageSize, stamp)) {
+			writtenStart = std::min(writtenStart, std::max(page, location));
+			writtenEnd = std::max(writtenEnd, std::min(page + Memory::pageSize, end));
+		}
+	}
+
+	const auto [firstRow, rowCount] = getWriteBackRows(location, width, height, bytesPerPixel, linear, writtenStart, writtenEnd);
+
+	// Rows are loaded whole, so the parts of them that weren't written to need the GPU's data in memory too
+	const u32 rowSize = width * bytesPerPixel;
+	mem.writeBackGPUOwned(location + firstRow * rowSize, rowCount * rowSize);
+	return {firstRow, rowCount};
+}
+
+void RendererGL::loadColourBufferRows(ColourBuffer& buffer, u32 firstRow, u32 rowCount) {
+	const u8* data = gpu.getPointerPhys<u8>(buffer.location, u32(buffer.sizeInBytes()));
+	if (data == nullptr || rowCount == 0) {
+		return;
+	}
+
+	const u32 width = buffer.size.x();
+	const u32 height = buffer.size.y();
+	const u32 bytesPerPixel = PICA::sizePerPixel(buffer.format);
+	writeBackPixels.resize(usize(width) * rowCount);
+
+	// Rows in memory start from the top of the buffer, and rows in GL from the bottom
+	for (u32 row = 0; row < rowCount; row++) {
+		u32* rowPixels = &writeBackPixels[usize(rowCount - 1 - row) * width];
+
+		for (u32 x = 0; x < width; x++) {
+			const u32 offset = getPixelOffset(x, firstRow + row, width, bytesPerPixel, buffer.linear);
+			const auto [r, g, b, a] = PICA::decodeColour(buffer.format, data + offset);
+			rowPixels[x] = u32(r) | (u32(g) << 8) | (u32(b) << 16) | (u32(a) << 24);
+		}
+	}
+
+	const auto oldTexture = OpenGL::getTex2D();
+	buffer.texture.bind();
+	glTexSubImage2D(
+		GL_TEXTURE_2D, 0, 0, GLint(height - firstRow - rowCount), GLsizei(width), GLsizei(rowCount), GL_RGBA, GL_UNSIGNED_BYTE, writeBackPixels.data()
+	);
+	glBindTexture(GL_TEXTURE_2D, oldTexture);
+}
+
+void RendererGL::loadDepthBufferRows(DepthBuffer& buffer, u32 firstRow, u32 rowCount) {
+	const u8* data = gpu.getPointerPhys<u8>(buffer.location, u32(buffer.sizeInBytes()));
+	if (data == nullptr || rowCount == 0 || buffer.format == PICA::DepthFmt::Unknown1) {
+		return;
+	}
+
+	const u32 width = buffer.size.x();
+	const u32 height = buffer.size.y();
+	const u32 bytesPerPixel = PICA::sizePerPixel(buffer.format);
+	const bool hasStencil = buffer.format == PICA::DepthFmt::Depth24Stencil8;
+	writeBackPixels.resize(usize(width) * rowCount);
+
+	for (u32 row = 0; row < rowCount; row++) {
+		u32* rowPixels = &writeBackPixels[usize(rowCount - 1 - row) * width];
+
+		for (u32 x = 0; x < width; x++) {
+			const u32 offset = getPixelOffset(x, firstRow + row, width, bytesPerPixel, false);
+			u32 value = 0;
+			for (u32 i = 0; i < bytesPerPixel; i++) {
+				value |= u32(data[offset + i]) << (i * 8);
+			}
+
+			// The reverse of writeBackDepthBuffer
+			rowPixels[x] = hasStencil ? (value << 8) | (value >> 24) : value << (32 - bytesPerPixel * 8);
+		}
+	}
+
+	const auto oldTexture = OpenGL::getTex2D();
+	buffer.texture.bind();
+	const GLenum format = hasStencil ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT;
+	const GLenum type = hasStencil ? GL_UNSIGNED_INT_24_8 : GL_UNSIGNED_INT;
+	glTexSubImage2D(
+		GL_TEXTURE_2D, 0, 0, GLint(height - firstRow - rowCount), GLsizei(width), GLsizei(rowCount), format, type, writeBackPixels.data()
+	);
+	glBindTexture(GL_TEXTURE_2D, oldTexture);
+}
+
+void RendererGL::initShadergenProgram(OpenGL::Program& program, bool hwVertexShading) {
+	gl.useProgram(program);
+
+	// Init sampler objects. Texture 0 goes in texture unit 0, texture 1 in TU 1, texture 2 in TU 2, and the light maps go in TU 3
+	glUniform1i(OpenGL::uniformLocation(program, "u_tex0"), 0);
+	glUniform1i(OpenGL::uniformLocation(program, "u_tex1"), 1);
+	glUniform1i(OpenGL::uniformLocation(program, "u_tex2"), 2);
+	glUniform1i(OpenGL::uniformLocation(program, "u_tex_luts"), 3);
+
+	// Set up the binding for our UBO. Sadly we can't specify it in the shader like normal people,
+	// As it's an OpenGL 4.2 feature that MacOS doesn't support...
+	uint uboIndex = glGetUniformBlockIndex(program.handle(), "FragmentUniforms");
+	glUniformBlockBinding(program.handle(), uboIndex, shadergenFragmentUBOBinding);
+
+	// The PICA shader uniforms are optimized out of decompiled shaders that don't read them
+	if (hwVertexShading) {
+		uboIndex = glGetUniformBlockIndex(program.handle(), "PICAShaderUniforms");
+		if (uboIndex != GL_INVALID_INDEX) {
+			glUniformBlockBinding(program.handle(), uboIndex, hwShaderUniformBinding);
+		}
+	}
+}
+
+void RendererGL::loadShaderCache(const std::filesystem::path& directory) {
+	preloadedShaders.clear();
+
+	// Program binaries are only valid for the driver that produced them, and the shaders we generate change between emulator versions
+	const auto getString = [](GLenum name) {
+		const char* string = reinterpret_cast<const char*>(glGetString(name));
+		return std::string(string != nullptr ? string : "");
+	};
+	const std::string driverID = getString(GL_VENDOR) + ";" + getString(GL_RENDERER) + ";" + getString(GL_VERSION) + ";" PANDA3DS_VERSION;
+
+	shaderDiskCache.open(directory / "opengl_programs.bin", driverID);
+}
+
+void RendererGL::preloadShaders() {
+	for (auto& entry : shaderDiskCache.takeLoadedEntries()) {
+		preloadedShaders.insert_or_assign(entry.getConfig(), std::move(entry));
+	}
+
+	// Link a few cached programs per frame, so that they're ready by the time the game uses them without stalling boot
+	static constexpr usize programsPerFrame = 8;
+	for (usize i = 0; i < programsPerFrame && !preloadedShaders.empty(); i++) {
+		auto it = preloadedShaders.begin();
+		OpenGL::Program& program = shaderCache[it->first].program;
+
+		if (!program.exists()) {
+			linkCachedProgram(program, it->first, it->second);
+		}
+
+		// Don't leave an empty entry in the shader cache if linking failed, so that the program gets compiled from scratch when it's used
+		if (!program.exists()) {
+			shaderCache.erase(it->first);
+		}
+		preloadedShaders.erase(it);
+	}
+}
+
+void RendererGL::linkCachedProgram(OpenGL::Program& program, const PICA::FragmentConfig& config, const ShaderDiskCache::Entry& entry) {
+	// If the shader generator changed since the program was cached, the program is stale
+	const std::string fs = fragShaderGen.generate(config);
+	if (fs != entry.source) {
+		return;
+	}
+
+	if (programBinarySupported && !entry.binary.empty()) {
+		const GLuint handle = glCreateProgram();
+		glProgramBinary(handle, entry.binaryFormat, entry.binary.data(), GLsizei(entry.binary.size()));
+
+		GLint success = GL_FALSE;
+		glGetProgramiv(handle, GL_LINK_STATUS, &success);
+
+		// The driver is allowed to reject binaries at any point, in which case we fall back to compiling the source
+		if (success == GL_TRUE) {
+			program.m_handle = handle;
+		} else {
+			glDeleteProgram(handle);
+		}
+	}
+
+	if (!program.exists()) {
+		OpenGL::Shader fragShader({fs.c_str(), fs.size()}, OpenGL::Fragment);
+		program.create({defaultShadergenVs, fragShader});
+		fragShader.free();
+	}
+
+	if (program.exists()) {
+		initShadergenProgram(program, false);
+	}
+}
+
+void RendererGL::saveProgramToDiskCache(OpenGL::Program& program, const PICA::FragmentConfig& config, const std::string& source) {
+	if (!shaderDiskCache.isOpen() || !program.exists()) {
+		return;
+	}
+
+	GLenum binaryFormat = 0;
+	std::vector<u8> binary;
+
+	if (programBinarySupported) {
+		GLint length = 0;
+		glGetProgramiv(program.handle(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+		if (length > 0) {
+			binary.resize(length);
+			glGetProgramBinary(program.handle(), length, nullptr, &binaryFormat, binary.data());
+		}
+	}
+
+	shaderDiskCache.append(config, source, binaryFormat, binary);
+}
+
+void RendererGL::startAsyncLink(CachedProgram& programEntry, std::string source) {
+	// We can't use OpenGL::Shader and OpenGL::Program here, as they check the compile and link status right away, which blocks until done
+	const GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+	const GLchar* const sources[1] = {source.c_str()};
+	glShaderSource(fragShader, 1, sources, nullptr);
+	glCompileShader(fragShader);
+
+	const GLuint handle = glCreateProgram();
+	glAttachShader(handle, defaultShadergenVs.handle());
+	glAttachShader(handle, fragShader);
+	glLinkProgram(handle);
+	// The shader is only deleted once it's detached from the program, so this doesn't interrupt the compile
+	glDeleteShader(fragShader);
+
+	programEntry.program.m_handle = handle;
+	programEntry.compiling = true;
+	programEntry.source = std::move(source);
+}
+
+bool RendererGL::pollAsyncLink(CachedProgram& programEntry, const PICA::FragmentConfig& config) {
+	OpenGL::Program& program = programEntry.program;
+	GLint done = GL_FALSE;
+	glGetProgramiv(program.handle(), GL_COMPLETION_STATUS_KHR, &done);
+
+	if (done == GL_FALSE) {
+		return false;
+	}
+
+	GLint success = GL_FALSE;
+	glGetProgramiv(program.handle(), GL_LINK_STATUS, &success);
+
+	if (success == GL_TRUE) {
+		initShadergenProgram(program, false);
+		saveProgramToDiskCache(program, config, programEntry.source);
+	} else {
+		char buf[4096];
+		glGetProgramInfoLog(program.handle(), 4096, nullptr, buf);
+		fprintf(stderr, "Failed to link program\nError: %s\n", buf);
+		program.free();
+	}
+
+	programEntry.compiling = false;
+	programEntry.source.clear();
+	return program.exists();
+}
+
+OpenGL::Program* RendererGL::getSpecializedShader(bool hwVertexShading, bool allowAsync) {
+	const PICA::FragmentConfig& fsConfig = getFragmentConfig();
+
+	// With hardware vertex shading, the fragment shader is linked with the decompiled vertex shader set up by prepareForDraw
+	CachedProgram& programEntry = hwVertexShading
+		? hwShaderProgramCache[std::rotl(hwVertexShaderHash, 1) ^ std::hash<PICA::FragmentConfig>()(fsConfig)]
+		: shaderCache[fsConfig];
 	OpenGL::Program& program = programEntry.program;
 
+	if (!program.exists()) {
+		// Programs using the default vertex shader may have been loaded from the disk cache but not linked yet
+		if (auto it = preloadedShaders.find(fsConfig); it != preloadedShaders.end() && !hwVertexShading) {
+			linkCachedProgram(program, fsConfig, it->second);
+			preloadedShaders.erase(it);
+		}
+	}
+
+	if (!program.exists() && allowAsync && parallelShaderCompileSupported) {
+		startAsyncLink(programEntry, fragShaderGen.generate(fsConfig));
+	}
+
+	if (programEntry.compiling) {
+		if (!allowAsync) {
+			// Wait for the driver to finish the program, as the caller has nothing else to draw with
+			GLint success = GL_FALSE;
+			glGetProgramiv(program.handle(), GL_LINK_STATUS, &success);
+		}
+
+		if (!pollAsyncLink(programEntry, fsConfig) && allowAsync) {
+			return nullptr;
+		}
+	}
+
 	if (!program.exists()) {
 		std::string fs = fragShaderGen.generate(fsConfig);
 
 		OpenGL::Shader fragShader({fs.c_str(), fs.size()}, OpenGL::Fragment);
-		program.create({defaultShadergenVs, fragShader});
-		gl.useProgram(program);
+		program.create({hwVertexShading ? *hwVertexShader : defaultShadergenVs, fragShader});
+		initShadergenProgram(program, hwVertexShading);
 
 		fragShader.free();
 
-		// Init sampler objects. Texture 0 goes in texture unit 0, texture 1 in TU 1, texture 2 in TU 2, and the light maps go in TU 3
-		glUniform1i(OpenGL::uniformLocation(program, "u_tex0"), 0);
-		glUniform1i(OpenGL::uniformLocation(program, "u_tex1"), 1);
-		glUniform1i(OpenGL::uniformLocation(program, "u_tex2"), 2);
-		glUniform1i(OpenGL::uniformLocation(program, "u_tex_luts"), 3);
+		// Decompiled vertex shaders aren't persisted, so only programs using the default vertex shader go to the disk cache
+		if (!hwVertexShading) {
+			saveProgramToDiskCache(program, fsConfig, fs);
+		}
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, shadergenFragmentUBOBinding, shadergenFragmentUBO);
+	uploadFragmentUniforms(fsConfig);
+
+	return &program;
+}
+
+void RendererGL::uploadFragmentUniforms(const PICA::FragmentConfig& fsConfig) {
+	using namespace PICA::DirtyRegs;
+	static constexpr u32 uniformRegs = Rasterizer | TexEnv | Fog | FragmentOps | Lighting;
 
-		// Set up the binding for our UBO. Sadly we can't specify it in the shader like normal people,
-		// As it's an OpenGL 4.2 feature that MacOS doesn't support...
-		uint uboIndex = glGetUniformBlockIndex(program.handle(), "FragmentUniforms");
-		glUniformBlockBinding(program.handle(), uboIndex, uboBlockBinding);
+	// The UBO is shared by all shadergen programs, so it only needs to be updated when the registers it's built from change
+	if ((fragmentUniformsDirty & uniformRegs) == 0) {
+		return;
 	}
-	glBindBufferBase(GL_UNIFORM_BUFFER, uboBlockBinding, shadergenFragmentUBO);
+	fragmentUniformsDirty = 0;
 
 	// Upload uniform data to our shader's UBO
 	PICA::FragmentUniforms uniforms;
@@ -949,11 +2069,10 @@ OpenGL::Program& RendererGL::getSpecializedShader() {
 
 	gl.bindUBO(shadergenFragmentUBO);
 	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PICA::FragmentUniforms), &uniforms);
-
-	return program;
 }
 
 void RendererGL::screenshot(const std::string& name) {
+	flushDraws();
 	constexpr uint width = 400;
 	constexpr uint height = 2 * 240;
 
@@ -979,15 +2098,36 @@ void RendererGL::screenshot(const std::string& name) {
 }
 
 void RendererGL::clearShaderCache() {
+	flushDraws();
+
 	for (auto& shader : shaderCache) {
 		CachedProgram& cachedProgram = shader.second;
 		cachedProgram.program.free();
 	}
 
+	for (auto& shader : hwShaderProgramCache) {
+		CachedProgram& cachedProgram = shader.second;
+		cachedProgram.program.free();
+	}
+
+	for (auto& shader : vertexShaderCache) {
+		shader.second.free();
+	}
+
 	shaderCache.clear();
+	hwShaderProgramCache.clear();
+	vertexShaderCache.clear();
+	hwVertexShader = nullptr;
 }
 
 void RendererGL::deinitGraphicsContext() {
+	flushDraws();
+
+	// Depth and colour buffers are lost along with the context, so write back what the GPU rendered to them first
+	Memory& mem = gpu.getMemory();
+	mem.writeBackGPUOwned(PhysicalAddrs::VRAM, PhysicalAddrs::VRAMEnd - PhysicalAddrs::VRAM + 1);
+	mem.writeBackGPUOwned(PhysicalAddrs::FCRAM, PhysicalAddrs::FCRAMEnd - PhysicalAddrs::FCRAM + 1);
+
 	// Invalidate all surface caches since they'll no longer be valid
 	textureCache.reset();
 	depthBufferCache.reset();
@@ -995,7 +2135,6 @@ void RendererGL::deinitGraphicsContext() {
 	clearShaderCache();
 
 	// All other GL objects should be invalidated automatically and be recreated by the next call to initGraphicsContext
-	// TODO: Make it so that depth and colour buffers get written back to 3DS memory
 	printf("RendererGL::DeinitGraphicsContext called\n");
 }
 
@@ -1007,6 +2146,8 @@ std::string RendererGL::getUbershader() {
 }
 
 void RendererGL::setUbershader(const std::string& shader) {
+	flushDraws();
+
 	auto gl_resources = cmrc::RendererGL::get_filesystem();
 	auto vertexShaderSource = gl_resources.open("opengl_vertex_shader.vert");
 
@@ -1023,6 +2164,8 @@ void RendererGL::setUbershader(const std::string& shader) {
 
 void RendererGL::initUbershader(OpenGL::Program& program) {
 	gl.useProgram(program);
+	// The uniforms of a new program need to be uploaded from scratch
+	ubershaderRegsDirty = PICA::DirtyRegs::All;
 
 	ubershaderData.textureEnvSourceLoc = OpenGL::uniformLocation(program, "u_textureEnvSource");
 	ubershaderData.textureEnvOperandLoc = OpenGL::uniformLocation(program, "u_textureEnvOperand");
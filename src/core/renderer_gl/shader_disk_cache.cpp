@@ -0,0 +1,180 @@
+#include "renderer_gl/shader_disk_cache.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <system_error>
+
+namespace {
+	bool readU32(IOFile& file, u32& value) {
+		const auto [success, count] = file.readBytes(&value, sizeof(u32));
+		return success && count == sizeof(u32);
+	}
+
+	bool readBytes(IOFile& file, void* data, usize size) {
+		if (size == 0) {
+			return true;
+		}
+
+		const auto [success, count] = file.readBytes(data, size);
+		return success && count == size;
+	}
+}  // namespace
+
+PICA::FragmentConfig ShaderDiskCache::Entry::getConfig() const {
+	// Fragment configs can only be constructed from registers, so build a dummy one and overwrite it
+	static const std::array<u32, 0x300> emptyRegs = {};
+	PICA::FragmentConfig result(emptyRegs);
+	std::memcpy(&result, config.data(), sizeof(result));
+
+	return result;
+}
+
+void ShaderDiskCache::open(const std::filesystem::path& path, const std::string& driverID) {
+	close();
+
+	this->path = path;
+	opened = true;
+	loader = std::async(std::launch::async, &ShaderDiskCache::load, path, driverID);
+}
+
+void ShaderDiskCache::close() {
+	if (loader.valid()) {
+		loader.get();
+		finishLoading();
+	}
+
+	file.close();
+	pendingWrites.clear();
+	opened = false;
+}
+
+std::vector<ShaderDiskCache::Entry> ShaderDiskCache::takeLoadedEntries() {
+	if (!loader.valid() || loader.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return {};
+	}
+
+	std::vector<Entry> entries = loader.get();
+	finishLoading();
+	return entries;
+}
+
+void ShaderDiskCache::finishLoading() {
+	// The loader has made sure the file ends with a complete record, so we can start appending to it
+	if (!file.open(path, "ab")) {
+		Helpers::warn("Failed to open shader cache %s for writing", path.string().c_str());
+		pendingWrites.clear();
+		return;
+	}
+
+	for (const auto& entry : pendingWrites) {
+		write(entry);
+	}
+
+	pendingWrites.clear();
+}
+
+void ShaderDiskCache::append(const PICA::FragmentConfig& config, const std::string& source, u32 binaryFormat, std::span<const u8> binary) {
+	if (!opened) {
+		return;
+	}
+
+	Entry entry;
+	std::memcpy(entry.config.data(), &config, sizeof(config));
+	entry.source = source;
+	entry.binaryFormat = binaryFormat;
+	entry.binary.assign(binary.begin(), binary.end());
+
+	if (loader.valid()) {
+		pendingWrites.push_back(std::move(entry));
+	} else {
+		write(entry);
+	}
+}
+
+void ShaderDiskCache::write(const Entry& entry) {
+	if (!file.isOpen()) {
+		return;
+	}
+
+	const u32 configSize = u32(entry.config.size());
+	const u32 sourceLength = u32(entry.source.size());
+	const u32 binaryLength = u32(entry.binary.size());
+
+	file.writeBytes(&configSize, sizeof(u32));
+	file.writeBytes(entry.config.data(), configSize);
+	file.writeBytes(&sourceLength, sizeof(u32));
+	file.writeBytes(entry.source.data(), sourceLength);
+	file.writeBytes(&entry.binaryFormat, sizeof(u32));
+	file.writeBytes(&binaryLength, sizeof(u32));
+	file.writeBytes(entry.binary.data(), binaryLength);
+	file.flush();
+}
+
+std::vector<ShaderDiskCache::Entry> ShaderDiskCache::load(const std::filesystem::path& path, const std::string& driverID) {
+	std::vector<Entry> entries;
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	IOFile file;
+	bool headerValid = false;
+	u64 fileSize = 0;
+	u64 validSize = 0;  // Size of the header and of all complete records
+
+	if (file.open(path, "rb")) {
+		fileSize = file.size().value_or(0);
+		u32 fileMagic, version, driverIDLength;
+
+		if (readU32(file, fileMagic) && readU32(file, version) && readU32(file, driverIDLength) && fileMagic == magic &&
+			version == formatVersion && driverIDLength == driverID.size()) {
+			std::string fileDriverID(driverIDLength, '\0');
+			headerValid = readBytes(file, fileDriverID.data(), driverIDLength) && fileDriverID == driverID;
+			validSize = 3 * sizeof(u32) + driverIDLength;
+		}
+
+		while (headerValid) {
+			Entry entry;
+			u32 configSize, sourceLength, binaryLength;
+
+			// The lengths are checked against the file size so that a corrupted length can't make us allocate a huge buffer
+			if (!readU32(file, configSize) || configSize != entry.config.size() || !readBytes(file, entry.config.data(), configSize)) {
+				break;
+			}
+
+			if (!readU32(file, sourceLength) || sourceLength > fileSize) {
+				break;
+			}
+			entry.source.resize(sourceLength);
+			if (!readBytes(file, entry.source.data(), sourceLength)) {
+				break;
+			}
+
+			if (!readU32(file, entry.binaryFormat) || !readU32(file, binaryLength) || binaryLength > fileSize) {
+				break;
+			}
+			entry.binary.resize(binaryLength);
+			if (!readBytes(file, entry.binary.data(), binaryLength)) {
+				break;
+			}
+
+			validSize += 4 * sizeof(u32) + configSize + sourceLength + binaryLength;
+			entries.push_back(std::move(entry));
+		}
+
+		file.close();
+	}
+
+	if (!headerValid) {
+		// Either there's no cache yet, or it was built with a different driver or emulator version. Start over with a fresh header
+		if (file.open(path, "wb")) {
+			const u32 header[3] = {magic, formatVersion, u32(driverID.size())};
+			file.writeBytes(header, sizeof(header));
+			file.writeBytes(driverID.data(), driverID.size());
+			file.close();
+		}
+	} else if (validSize != fileSize && file.open(path, "r+b")) {
+		file.setSize(validSize);
+		file.close();
+	}
+
+	return entries;
+}
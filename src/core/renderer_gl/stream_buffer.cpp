@@ -0,0 +1,153 @@
+#include "renderer_gl/stream_buffer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+void StreamBuffer::create(GLenum target, usize size) {
+	this->target = target;
+	this->size = size;
+	segmentSize = size / segmentCount;
+	position = 0;
+	mappedPointer = nullptr;
+	enteredSegments = 0;
+	unfencedSegments = 0;
+	fences.fill(nullptr);
+
+	glGenBuffers(1, &m_handle);
+	glBindBuffer(target, m_handle);
+
+	static constexpr GLbitfield storageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+#ifdef USING_GLES
+	const bool bufferStorageSupported = GLAD_GL_EXT_buffer_storage != 0;
+#else
+	const bool bufferStorageSupported = GLAD_GL_VERSION_4_4 != 0 || GLAD_GL_ARB_buffer_storage != 0;
+#endif
+
+	if (bufferStorageSupported) {
+#ifdef USING_GLES
+		glBufferStorageEXT(target, GLsizeiptr(size), nullptr, storageFlags);
+#else
+		glBufferStorage(target, GLsizeiptr(size), nullptr, storageFlags);
+#endif
+		mappedPointer = static_cast<u8*>(glMapBufferRange(target, 0, GLsizeiptr(size), storageFlags));
+
+		// Buffer storage is immutable, so if mapping failed we need a new buffer to fall back to glBufferData
+		if (mappedPointer == nullptr) {
+			glDeleteBuffers(1, &m_handle);
+			glGenBuffers(1, &m_handle);
+			glBindBuffer(target, m_handle);
+		}
+	}
+
+	if (mappedPointer == nullptr) {
+		glBufferData(target, GLsizeiptr(size), nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void StreamBuffer::free() {
+	for (usize i = 0; i < segmentCount; i++) {
+		releaseFence(i);
+	}
+
+	// Deleting a buffer unmaps it
+	if (m_handle != 0) {
+		glDeleteBuffers(1, &m_handle);
+		m_handle = 0;
+	}
+
+	mappedPointer = nullptr;
+	staging.clear();
+}
+
+void StreamBuffer::releaseFence(usize segment) {
+	GLsync fence = std::exchange(fences[segment], nullptr);
+	if (fence != nullptr && std::find(fences.begin(), fences.end(), fence) == fences.end()) {
+		glDeleteSync(fence);
+	}
+}
+
+void StreamBuffer::fenceSegments(u32 mask) {
+	if (mask == 0) {
+		return;
+	}
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	for (usize i = 0; i < segmentCount; i++) {
+		if (mask & (1u << i)) {
+			releaseFence(i);
+			fences[i] = fence;
+		}
+	}
+
+	unfencedSegments &= ~mask;
+}
+
+void StreamBuffer::fence() {
+	if (mappedPointer == nullptr || enteredSegments == 0) {
+		return;
+	}
+
+	// The segment we're writing to is fenced once we move past it, so that we don't create a fence for every draw
+	const u32 currentSegment = 1u << (enteredSegments - 1);
+	fenceSegments(unfencedSegments & ~currentSegment);
+}
+
+StreamBuffer::Allocation StreamBuffer::map(usize bytes, usize alignment) {
+	if (bytes > size) [[unlikely]] {
+		Helpers::panic("StreamBuffer: Tried to map %zu bytes from a %zu byte buffer", bytes, size);
+	}
+
+	usize offset = alignUp(position, alignment);
+	const bool wrap = offset + bytes > size;
+	if (wrap) {
+		offset = 0;
+	}
+
+	if (mappedPointer == nullptr) {
+		if (wrap) {
+			// Orphan the old storage instead of waiting for the GPU to be done with it
+			glBufferData(target, GLsizeiptr(size), nullptr, GL_STREAM_DRAW);
+		}
+
+		if (staging.size() < bytes) {
+			staging.resize(bytes);
+		}
+
+		return Allocation{.pointer = staging.data(), .offset = offset};
+	}
+
+	if (wrap) {
+		// The caller issued every draw reading the buffer before wrapping around, so the segments we haven't fenced yet can be fenced now
+		fenceSegments(unfencedSegments);
+		enteredSegments = 0;
+	}
+
+	// Wait until the GPU is done with the data we wrote to the segments we're entering on the previous lap
+	const usize firstSegment = std::min(offset / segmentSize, segmentCount - 1);
+	const usize lastSegment = std::min((offset + std::max<usize>(bytes, 1) - 1) / segmentSize, segmentCount - 1);
+	for (usize i = enteredSegments; i <= lastSegment; i++) {
+		if (fences[i] != nullptr) {
+			GLenum status;
+			do {
+				status = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+
+			releaseFence(i);
+		}
+	}
+
+	enteredSegments = std::max(enteredSegments, lastSegment + 1);
+	for (usize i = firstSegment; i <= lastSegment; i++) {
+		unfencedSegments |= 1u << i;
+	}
+
+	return Allocation{.pointer = mappedPointer + offset, .offset = offset};
+}
+
+void StreamBuffer::commit(const Allocation& allocation, usize bytes) {
+	if (mappedPointer == nullptr && bytes != 0) {
+		glBufferSubData(target, GLintptr(allocation.offset), GLsizeiptr(bytes), allocation.pointer);
+	}
+
+	position = allocation.offset + bytes;
+}
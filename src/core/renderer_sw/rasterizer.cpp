@@ -0,0 +1,856 @@
+#include "renderer_sw/rasterizer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "PICA/pixels.hpp"
+#include "colour.hpp"
+
+// Pick the SIMD coverage kernels based on what the compiler targets. SSE2 is always available on x64 and NEON is always available on arm64
+#if defined(__SSE2__) || defined(_M_X64)
+#define PICA_SW_RASTERIZER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PICA_SW_RASTERIZER_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace PICA;
+using namespace Helpers;
+
+namespace {
+	using vec4 = std::array<float, 4>;
+
+	// Vertices further than this from the origin are dropped, so that the 28.4 edge functions can't overflow 32 bits inside a bin
+	constexpr float guardBand = 1024.0f;
+
+	float f24ToFloat(u32 raw) { return Floats::f24::fromRaw(raw & 0xffffff).toFloat32(); }
+
+	// Colours in PICA registers have red in the lowest byte
+	vec4 unpackColour(u32 colour) {
+		return {
+			float(colour & 0xff) / 255.0f,
+			float((colour >> 8) & 0xff) / 255.0f,
+			float((colour >> 16) & 0xff) / 255.0f,
+			float(colour >> 24) / 255.0f,
+		};
+	}
+
+	u8 toUnorm8(float value) { return u8(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); }
+
+	template <typename T>
+	bool compare(u32 func, T a, T b) {
+		switch (func) {
+			case 0: return false;
+			case 1: return true;
+			case 2: return a == b;
+			case 3: return a != b;
+			case 4: return a < b;
+			case 5: return a <= b;
+			case 6: return a > b;
+			default: return a >= b;
+		}
+	}
+
+	// Returns the wrapped coordinate, or -1 if the texel is outside of the texture and the border colour should be used instead
+	s32 wrapCoordinate(s32 coord, s32 size, u32 mode) {
+		switch (mode) {
+			case 1:
+			case 5: return (coord < 0 || coord >= size) ? -1 : coord;  // Clamp to border
+
+			case 2:
+			case 6:
+			case 7: return ((coord % size) + size) % size;  // Repeat
+
+			case 3: {  // Mirrored repeat
+				const s32 period = ((coord % (size * 2)) + size * 2) % (size * 2);
+				return period < size ? period : size * 2 - 1 - period;
+			}
+
+			default: return std::clamp(coord, 0, size - 1);  // Clamp to edge
+		}
+	}
+
+	// Texture coordinates can be anything, including NaN and infinity, so clamp them before converting them to integers
+	s32 texelCoordinate(float coord) { return s32(std::floor(std::clamp(coord, -65536.0f, 65536.0f))); }
+
+	vec4 fetchTexel(const SoftwareRasterizer::Texture& texture, s32 x, s32 y, const vec4& border) {
+		if (x < 0 || y < 0) {
+			return border;
+		}
+
+		// Texture coordinates start from the bottom of the texture, while the decoded texels start from the top
+		return unpackColour(texture.texels[(texture.height - 1 - y) * texture.width + x]);
+	}
+
+	vec4 sampleTexture(const SoftwareRasterizer::Texture& texture, u32 params, u32 borderColour, float s, float t) {
+		// TODO: We don't compute derivatives, so the magnification filter is used for minified textures too
+		const bool linear = (params & 0x2) != 0;
+		const u32 wrapT = getBits<8, 3>(params);
+		const u32 wrapS = getBits<12, 3>(params);
+		const s32 width = s32(texture.width);
+		const s32 height = s32(texture.height);
+		const vec4 border = unpackColour(borderColour);
+
+		if (!linear) {
+			const s32 x = wrapCoordinate(texelCoordinate(s * width), width, wrapS);
+			const s32 y = wrapCoordinate(texelCoordinate(t * height), height, wrapT);
+			return fetchTexel(texture, x, y, border);
+		}
+
+		const float u = std::clamp(s * width - 0.5f, -65536.0f, 65536.0f);
+		const float v = std::clamp(t * height - 0.5f, -65536.0f, 65536.0f);
+		const s32 x0 = texelCoordinate(u);
+		const s32 y0 = texelCoordinate(v);
+		const float fracX = u - float(x0);
+		const float fracY = v - float(y0);
+
+		const s32 left = wrapCoordinate(x0, width, wrapS);
+		const s32 right = wrapCoordinate(x0 + 1, width, wrapS);
+		const s32 bottom = wrapCoordinate(y0, height, wrapT);
+		const s32 top = wrapCoordinate(y0 + 1, height, wrapT);
+
+		const vec4 texels[4] = {
+			fetchTexel(texture, left, bottom, border),
+			fetchTexel(texture, right, bottom, border),
+			fetchTexel(texture, left, top, border),
+			fetchTexel(texture, right, top, border),
+		};
+
+		vec4 result;
+		for (int i = 0; i < 4; i++) {
+			const float bottomValue = texels[0][i] + (texels[1][i] - texels[0][i]) * fracX;
+			const float topValue = texels[2][i] + (texels[3][i] - texels[2][i]) * fracX;
+			result[i] = bottomValue + (topValue - bottomValue) * fracY;
+		}
+		return result;
+	}
+
+	// Select the colour and alpha of TEV source "index" of a stage and apply its operands
+	vec4 getTevInput(const std::array<vec4, 16>& sources, u32 sourceReg, u32 operandReg, u32 index) {
+		const vec4& colourSource = sources[(sourceReg >> (index * 4)) & 0xf];
+		const vec4& alphaSource = sources[(sourceReg >> (index * 4 + 16)) & 0xf];
+		const u32 colourOperand = (operandReg >> (index * 4)) & 0xf;
+		const u32 alphaOperand = (operandReg >> (index * 4 + 12)) & 0x7;
+		vec4 result = {0.0f, 0.0f, 0.0f, 0.0f};
+
+		// Undocumented operands leave the input at 0, like the GL ubershader does
+		switch (colourOperand) {
+			case 0: std::copy_n(colourSource.begin(), 3, result.begin()); break;
+			case 1:
+				for (int i = 0; i < 3; i++) result[i] = 1.0f - colourSource[i];
+				break;
+			case 2: std::fill_n(result.begin(), 3, colourSource[3]); break;
+			case 3: std::fill_n(result.begin(), 3, 1.0f - colourSource[3]); break;
+			case 4: std::fill_n(result.begin(), 3, colourSource[0]); break;
+			case 5: std::fill_n(result.begin(), 3, 1.0f - colourSource[0]); break;
+			case 8: std::fill_n(result.begin(), 3, colourSource[1]); break;
+			case 9: std::fill_n(result.begin(), 3, 1.0f - colourSource[1]); break;
+			case 12: std::fill_n(result.begin(), 3, colourSource[2]); break;
+			case 13: std::fill_n(result.begin(), 3, 1.0f - colourSource[2]); break;
+			default: break;
+		}
+
+		// Alpha operands select alpha, red, green or blue, optionally inverted
+		static constexpr int alphaChannels[4] = {3, 0, 1, 2};
+		const float alpha = alphaSource[alphaChannels[alphaOperand >> 1]];
+		result[3] = (alphaOperand & 1) ? 1.0f - alpha : alpha;
+
+		return result;
+	}
+
+	float combine(u32 operation, float a, float b, float c) {
+		switch (operation) {
+			case 0: return a;                                     // Replace
+			case 1: return a * b;                                 // Modulate
+			case 2: return std::min(1.0f, a + b);                 // Add
+			case 3: return std::clamp(a + b - 0.5f, 0.0f, 1.0f);  // Add signed
+			case 4: return a * c + b * (1.0f - c);                // Interpolate
+			case 5: return std::max(0.0f, a - b);                 // Subtract
+			case 8: return std::min(1.0f, a * b + c);             // Multiply then add
+			case 9: return std::min(a + b, 1.0f) * c;             // Add then multiply
+			default: return 1.0f;
+		}
+	}
+
+	vec4 runTevStage(const std::array<vec4, 16>& sources, const std::array<u32, 5>& stage) {
+		const vec4 in0 = getTevInput(sources, stage[0], stage[1], 0);
+		const vec4 in1 = getTevInput(sources, stage[0], stage[1], 1);
+		const vec4 in2 = getTevInput(sources, stage[0], stage[1], 2);
+		const u32 colourOperation = stage[2] & 0xf;
+		const u32 alphaOperation = (stage[2] >> 16) & 0xf;
+		vec4 result;
+
+		if (colourOperation == 6 || colourOperation == 7) {
+			// Dot3. The RGBA variant writes the alpha channel as well
+			float dot = 0.0f;
+			for (int i = 0; i < 3; i++) dot += (in0[i] - 0.5f) * (in1[i] - 0.5f);
+			std::fill_n(result.begin(), 3, dot * 4.0f);
+		} else {
+			for (int i = 0; i < 3; i++) result[i] = combine(colourOperation, in0[i], in1[i], in2[i]);
+		}
+
+		result[3] = (colourOperation == 7) ? result[0] : combine(alphaOperation, in0[3], in1[3], in2[3]);
+
+		const float colourScale = float(1 << (stage[4] & 3));
+		const float alphaScale = float(1 << ((stage[4] >> 16) & 3));
+		for (int i = 0; i < 3; i++) result[i] = std::clamp(result[i] * colourScale, 0.0f, 1.0f);
+		result[3] = std::clamp(result[3] * alphaScale, 0.0f, 1.0f);
+
+		return result;
+	}
+
+	float blendFactor(u32 factor, int channel, const vec4& src, const vec4& dst, const vec4& constant) {
+		switch (factor) {
+			case 0: return 0.0f;
+			case 2: return src[channel];
+			case 3: return 1.0f - src[channel];
+			case 4: return dst[channel];
+			case 5: return 1.0f - dst[channel];
+			case 6: return src[3];
+			case 7: return 1.0f - src[3];
+			case 8: return dst[3];
+			case 9: return 1.0f - dst[3];
+			case 10: return constant[channel];
+			case 11: return 1.0f - constant[channel];
+			case 12: return constant[3];
+			case 13: return 1.0f - constant[3];
+			case 14: return channel == 3 ? 1.0f : std::min(src[3], 1.0f - dst[3]);  // Source alpha saturate
+			default: return 1.0f;  // Factor 15 is undocumented and stubbed to 1 like on the GL backend
+		}
+	}
+
+	float blendEquation(u32 equation, float src, float dst, float srcFactor, float dstFactor) {
+		switch (equation) {
+			case 1: return src * srcFactor - dst * dstFactor;
+			case 2: return dst * dstFactor - src * srcFactor;
+			case 3: return std::min(src, dst);
+			case 4: return std::max(src, dst);
+			default: return src * srcFactor + dst * dstFactor;
+		}
+	}
+
+	u8 logicOp(u32 op, u8 src, u8 dst) {
+		switch (op) {
+			case 0: return 0;
+			case 1: return src & dst;
+			case 2: return src & ~dst;
+			case 3: return src;
+			case 4: return 0xff;
+			case 5: return ~src;
+			case 6: return dst;
+			case 7: return ~dst;
+			case 8: return ~(src & dst);
+			case 9: return src | dst;
+			case 10: return ~(src | dst);
+			case 11: return src ^ dst;
+			case 12: return ~(src ^ dst);
+			case 13: return ~src & dst;
+			case 14: return src | ~dst;
+			default: return ~src | dst;
+		}
+	}
+
+	u8 stencilOp(u32 op, u8 value, u8 reference) {
+		switch (op) {
+			case 1: return 0;
+			case 2: return reference;
+			case 3: return value == 0xff ? value : value + 1;
+			case 4: return value == 0 ? value : value - 1;
+			case 5: return ~value;
+			case 6: return value + 1;
+			case 7: return value - 1;
+			default: return value;
+		}
+	}
+}  // namespace
+
+SoftwareRasterizer::DrawState SoftwareRasterizer::DrawState::fromRegs(const std::array<u32, 0x300>& regs) {
+	using namespace PICA::InternalRegs;
+	static constexpr std::array<u32, 6> texEnvBases = {
+		TexEnv0Source, TexEnv1Source, TexEnv2Source, TexEnv3Source, TexEnv4Source, TexEnv5Source,
+	};
+	static constexpr std::array<u32, 3> textureBases = {Tex0BorderColor, Tex1BorderColor, Tex2BorderColor};
+
+	DrawState state;
+	for (int i = 0; i < 6; i++) {
+		std::copy_n(regs.begin() + texEnvBases[i], 5, state.texEnv[i].begin());
+	}
+	state.texEnvBufferColour = regs[TexEnvBufferColor];
+	state.texEnvUpdateBuffer = regs[TexEnvUpdateBuffer];
+	state.texUnitConfig = regs[TexUnitCfg];
+
+	for (int i = 0; i < 3; i++) {
+		state.textureBorderColours[i] = regs[textureBases[i]];
+		state.textureParams[i] = regs[textureBases[i] + 2];
+	}
+
+	state.colourOperation = regs[ColourOperation];
+	state.blendFunc = regs[BlendFunc];
+	state.logicOp = regs[LogicOp];
+	state.blendColour = regs[BlendColour];
+	state.alphaTest = regs[AlphaTestConfig];
+	state.stencilTest = regs[StencilTest];
+	state.stencilOp = regs[StencilOp];
+	state.depthColourMask = regs[DepthAndColorMask];
+	state.depthStencilWrite = (regs[DepthBufferWrite] & 1) != 0;
+
+	state.depthScale = f24ToFloat(regs[DepthScale]);
+	state.depthOffset = f24ToFloat(regs[DepthOffset]);
+	state.wBuffer = (regs[DepthmapEnable] & 1) == 0;
+
+	state.viewportX = float(regs[ViewportXY] & 0x3ff);
+	state.viewportY = float((regs[ViewportXY] >> 16) & 0x3ff);
+	state.viewportHalfWidth = f24ToFloat(regs[ViewportWidth]);
+	state.viewportHalfHeight = f24ToFloat(regs[ViewportHeight]);
+
+	state.clipEnable = (regs[ClipEnable] & 1) != 0;
+	state.clipPlane = {f24ToFloat(regs[ClipData0]), f24ToFloat(regs[ClipData1]), f24ToFloat(regs[ClipData2]), f24ToFloat(regs[ClipData3])};
+
+	return state;
+}
+
+void SoftwareRasterizer::setFramebuffer(const Framebuffer& fb) {
+	if (fb == framebuffer) {
+		return;
+	}
+
+	flush();
+	framebuffer = fb;
+	binCountX = (fb.width + binSize - 1) >> binShift;
+	binCountY = (fb.height + binSize - 1) >> binShift;
+	bins.resize(usize(binCountX) * binCountY);
+}
+
+void SoftwareRasterizer::submitTriangles(const DrawState& state, PICA::PrimType primType, std::span<const PICA::Vertex> vertices) {
+	if (framebuffer.colour == nullptr || vertices.size() < 3) {
+		return;
+	}
+
+	if (triangles.size() >= maxPendingTriangles) {
+		flush();
+	}
+
+	const u32 drawIndex = u32(draws.size());
+	draws.push_back(state);
+
+	// Convert the vertices once, since strips and fans share them between triangles
+	auto& converted = convertedVertices;
+	converted.resize(vertices.size());
+
+	for (usize i = 0; i < vertices.size(); i++) {
+		const PICA::Vertex& in = vertices[i];
+		ClipVertex& out = converted[i];
+
+		for (int j = 0; j < 4; j++) {
+			out.position[j] = in.s.positions[j].toFloat32();
+			// Vertex colours are clamped the same way as in the GL vertex shader
+			out.attributes[j] = std::min(std::abs(in.s.colour[j].toFloat32()), 1.0f);
+		}
+
+		for (int j = 0; j < 2; j++) {
+			out.attributes[4 + j] = in.s.texcoord0[j].toFloat32();
+			out.attributes[6 + j] = in.s.texcoord1[j].toFloat32();
+			out.attributes[8 + j] = in.s.texcoord2[j].toFloat32();
+		}
+	}
+
+	// There's no face culling on the GL backend either, so the winding order of strips doesn't matter
+	switch (primType) {
+		case PrimType::TriangleStrip:
+			for (usize i = 2; i < converted.size(); i++) {
+				submitTriangle(drawIndex, converted[i - 2], converted[i - 1], converted[i]);
+			}
+			break;
+
+		case PrimType::TriangleFan:
+			for (usize i = 2; i < converted.size(); i++) {
+				submitTriangle(drawIndex, converted[0], converted[i - 1], converted[i]);
+			}
+			break;
+
+		default:
+			for (usize i = 0; i + 2 < converted.size(); i += 3) {
+				submitTriangle(drawIndex, converted[i], converted[i + 1], converted[i + 2]);
+			}
+			break;
+	}
+}
+
+void SoftwareRasterizer::submitTriangle(u32 drawIndex, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2) {
+	const DrawState& state = draws[drawIndex];
+
+	// Clip against -w <= x, y <= w, -w <= z <= 0, w > 0 and the user clip plane, which are all of the form dot(plane, position) >= 0
+	static constexpr float minW = 0.00001f;
+	std::array<std::array<float, 5>, 8> planes = {{
+		{-1, 0, 0, 1, 0},
+		{1, 0, 0, 1, 0},
+		{0, -1, 0, 1, 0},
+		{0, 1, 0, 1, 0},
+		{0, 0, -1, 0, 0},
+		{0, 0, 1, 1, 0},
+		{0, 0, 0, 1, -minW},
+	}};
+	usize planeCount = 7;
+	if (state.clipEnable) {
+		planes[planeCount++] = {state.clipPlane[0], state.clipPlane[1], state.clipPlane[2], state.clipPlane[3], 0};
+	}
+
+	auto distance = [](const std::array<float, 5>& plane, const ClipVertex& v) {
+		return plane[0] * v.position[0] + plane[1] * v.position[1] + plane[2] * v.position[2] + plane[3] * v.position[3] + plane[4];
+	};
+
+	// Most triangles are entirely inside the view volume, so check that before copying anything
+	bool inside = true;
+	for (usize i = 0; i < planeCount && inside; i++) {
+		inside = distance(planes[i], v0) >= 0.0f && distance(planes[i], v1) >= 0.0f && distance(planes[i], v2) >= 0.0f;
+	}
+
+	if (inside) {
+		setupTriangle(drawIndex, v0, v1, v2);
+		return;
+	}
+
+	// Every plane can add at most one vertex to the polygon
+	std::array<ClipVertex, 16> polygons[2];
+	usize count = 3;
+	polygons[0][0] = v0;
+	polygons[0][1] = v1;
+	polygons[0][2] = v2;
+
+	for (usize p = 0; p < planeCount; p++) {
+		const auto& in = polygons[p & 1];
+		auto& out = polygons[(p & 1) ^ 1];
+		usize outCount = 0;
+
+		for (usize i = 0; i < count; i++) {
+			const ClipVertex& current = in[i];
+			const ClipVertex& next = in[(i + 1) % count];
+			const float currentDistance = distance(planes[p], current);
+			const float nextDistance = distance(planes[p], next);
+
+			if (currentDistance >= 0.0f) {
+				out[outCount++] = current;
+			}
+
+			if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+				const float t = currentDistance / (currentDistance - nextDistance);
+				ClipVertex& v = out[outCount++];
+
+				for (int j = 0; j < 4; j++) {
+					v.position[j] = current.position[j] + (next.position[j] - current.position[j]) * t;
+				}
+				for (usize j = 0; j < attributeCount; j++) {
+					v.attributes[j] = current.attributes[j] + (next.attributes[j] - current.attributes[j]) * t;
+				}
+			}
+		}
+
+		count = outCount;
+		if (count < 3) {
+			return;
+		}
+	}
+
+	const auto& polygon = polygons[planeCount & 1];
+	for (usize i = 2; i < count; i++) {
+		setupTriangle(drawIndex, polygon[0], polygon[i - 1], polygon[i]);
+	}
+}
+
+void SoftwareRasterizer::setupTriangle(u32 drawIndex, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2) {
+	const DrawState& state = draws[drawIndex];
+	const ClipVertex* vertices[3] = {&v0, &v1, &v2};
+	std::array<s32, 3> x, y;
+	std::array<float, 3> invW, zOverW;
+
+	for (int i = 0; i < 3; i++) {
+		const auto& position = vertices[i]->position;
+		invW[i] = 1.0f / position[3];
+		zOverW[i] = position[2] * invW[i];
+
+		const float screenX = (position[0] * invW[i] + 1.0f) * state.viewportHalfWidth + state.viewportX;
+		const float screenY = (position[1] * invW[i] + 1.0f) * state.viewportHalfHeight + state.viewportY;
+		// This also rejects NaNs
+		if (!(std::abs(screenX) < guardBand && std::abs(screenY) < guardBand)) {
+			return;
+		}
+
+		x[i] = s32(std::lround(screenX * 16.0f));
+		y[i] = s32(std::lround(screenY * 16.0f));
+	}
+
+	s64 doubleArea = s64(x[1] - x[0]) * (y[2] - y[0]) - s64(x[2] - x[0]) * (y[1] - y[0]);
+	if (doubleArea == 0) {
+		return;
+	}
+
+	// Make the winding counter-clockwise so that the inside of the triangle is where every edge function is positive
+	std::array<int, 3> order = {0, 1, 2};
+	if (doubleArea < 0) {
+		std::swap(order[1], order[2]);
+		doubleArea = -doubleArea;
+	}
+
+	Triangle tri;
+	tri.drawIndex = drawIndex;
+	tri.invDoubleArea = 1.0f / float(doubleArea);
+
+	// Pixel centres are at (x + 0.5, y + 0.5)
+	const s32 minX = std::min({x[0], x[1], x[2]});
+	const s32 maxX = std::max({x[0], x[1], x[2]});
+	const s32 minY = std::min({y[0], y[1], y[2]});
+	const s32 maxY = std::max({y[0], y[1], y[2]});
+	tri.minX = std::max((minX - 8 + 15) >> 4, 0);
+	tri.minY = std::max((minY - 8 + 15) >> 4, 0);
+	tri.maxX = std::min((maxX - 8) >> 4, s32(framebuffer.width) - 1);
+	tri.maxY = std::min((maxY - 8) >> 4, s32(framebuffer.height) - 1);
+
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+		return;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		const int index = order[i];
+		tri.invW[i] = invW[index];
+		tri.zOverW[i] = zOverW[index];
+		tri.attributes[i] = vertices[index]->attributes;
+
+		// The edge opposite to vertex i goes from vertex i + 1 to vertex i + 2
+		const int a = order[(i + 1) % 3];
+		const int b = order[(i + 2) % 3];
+		tri.edgeA[i] = y[a] - y[b];
+		tri.edgeB[i] = x[b] - x[a];
+		tri.edgeC[i] = -(s64(tri.edgeA[i]) * x[a] + s64(tri.edgeB[i]) * y[a]);
+
+		// Top-left fill rule: Pixels exactly on an edge are only drawn if it's a left edge or a top edge
+		const bool topLeft = tri.edgeA[i] > 0 || (tri.edgeA[i] == 0 && tri.edgeB[i] < 0);
+		tri.edgeBias[i] = topLeft ? 0 : 1;
+	}
+
+	const u32 triangleIndex = u32(triangles.size());
+	triangles.push_back(tri);
+
+	for (u32 binY = u32(tri.minY) >> binShift; binY <= u32(tri.maxY) >> binShift; binY++) {
+		for (u32 binX = u32(tri.minX) >> binShift; binX <= u32(tri.maxX) >> binShift; binX++) {
+			bins[binY * binCountX + binX].push_back(triangleIndex);
+		}
+	}
+}
+
+void SoftwareRasterizer::flush() {
+	if (!triangles.empty()) {
+		// Bins take very different amounts of time, so workers grab them one at a time instead of splitting them in equal ranges
+		const u32 binCount = binCountX * binCountY;
+		nextBin = 0;
+
+		workers.run(workers.getWorkerCount(), [&](u32, u32, u32) {
+			for (u32 bin = nextBin++; bin < binCount; bin = nextBin++) {
+				rasterizeBin(bin);
+			}
+		});
+	}
+
+	discard();
+}
+
+void SoftwareRasterizer::discard() {
+	for (auto& bin : bins) {
+		bin.clear();
+	}
+
+	triangles.clear();
+	draws.clear();
+}
+
+void SoftwareRasterizer::rasterizeBin(u32 bin) {
+	const s32 binX0 = s32(bin % binCountX) << binShift;
+	const s32 binY0 = s32(bin / binCountX) << binShift;
+	const s32 binX1 = std::min(binX0 + s32(binSize), s32(framebuffer.width)) - 1;
+	const s32 binY1 = std::min(binY0 + s32(binSize), s32(framebuffer.height)) - 1;
+
+	alignas(16) float zOverW[4], w[4], weight1[4], weight2[4];
+
+	for (u32 triangleIndex : bins[bin]) {
+		const Triangle& tri = triangles[triangleIndex];
+		const s32 x0 = std::max(tri.minX, binX0);
+		const s32 x1 = std::min(tri.maxX, binX1);
+		const s32 y0 = std::max(tri.minY, binY0);
+		const s32 y1 = std::min(tri.maxY, binY1);
+
+		// Per-triangle constants for interpolating z / w and 1 / w linearly in screen space
+		const float dz1 = tri.zOverW[1] - tri.zOverW[0];
+		const float dz2 = tri.zOverW[2] - tri.zOverW[0];
+		const float dw1 = tri.invW[1] - tri.invW[0];
+		const float dw2 = tri.invW[2] - tri.invW[0];
+
+#if defined(PICA_SW_RASTERIZER_SSE2)
+		__m128i laneOffsets[3], thresholds[3];
+		for (int i = 0; i < 3; i++) {
+			const s32 step = tri.edgeA[i] * 16;
+			laneOffsets[i] = _mm_setr_epi32(0, step, step * 2, step * 3);
+			thresholds[i] = _mm_set1_epi32(tri.edgeBias[i] - 1);
+		}
+		const __m128 invArea = _mm_set1_ps(tri.invDoubleArea);
+#elif defined(PICA_SW_RASTERIZER_NEON)
+		int32x4_t laneOffsets[3], thresholds[3];
+		for (int i = 0; i < 3; i++) {
+			const s32 step = tri.edgeA[i] * 16;
+			const s32 offsets[4] = {0, step, step * 2, step * 3};
+			laneOffsets[i] = vld1q_s32(offsets);
+			thresholds[i] = vdupq_n_s32(tri.edgeBias[i] - 1);
+		}
+		const float32x4_t invArea = vdupq_n_f32(tri.invDoubleArea);
+		static constexpr u32 laneBits[4] = {1, 2, 4, 8};
+		const uint32x4_t laneMask = vld1q_u32(laneBits);
+#endif
+
+		for (s32 y = y0; y <= y1; y++) {
+			// Edge functions at the first pixel of the row. They fit in 32 bits anywhere near the triangle thanks to the guard band
+			std::array<s32, 3> rowEdges;
+			for (int i = 0; i < 3; i++) {
+				rowEdges[i] = s32(s64(tri.edgeA[i]) * (x0 * 16 + 8) + s64(tri.edgeB[i]) * (y * 16 + 8) + tri.edgeC[i]);
+			}
+
+			// Process pixels 4 at a time, computing coverage, depth and perspective-correct weights for all of them at once
+			for (s32 x = x0; x <= x1; x += 4) {
+				const u32 validLanes = (x1 - x >= 3) ? 0xf : (1u << (x1 - x + 1)) - 1;
+				u32 coverage;
+
+#if defined(PICA_SW_RASTERIZER_SSE2)
+				const __m128i e0 = _mm_add_epi32(_mm_set1_epi32(rowEdges[0]), laneOffsets[0]);
+				const __m128i e1 = _mm_add_epi32(_mm_set1_epi32(rowEdges[1]), laneOffsets[1]);
+				const __m128i e2 = _mm_add_epi32(_mm_set1_epi32(rowEdges[2]), laneOffsets[2]);
+				const __m128i inside = _mm_and_si128(
+					_mm_and_si128(_mm_cmpgt_epi32(e0, thresholds[0]), _mm_cmpgt_epi32(e1, thresholds[1])), _mm_cmpgt_epi32(e2, thresholds[2])
+				);
+				coverage = u32(_mm_movemask_ps(_mm_castsi128_ps(inside))) & validLanes;
+
+				if (coverage != 0) {
+					const __m128 l1 = _mm_mul_ps(_mm_cvtepi32_ps(e1), invArea);
+					const __m128 l2 = _mm_mul_ps(_mm_cvtepi32_ps(e2), invArea);
+					const __m128 z = _mm_add_ps(
+						_mm_set1_ps(tri.zOverW[0]), _mm_add_ps(_mm_mul_ps(l1, _mm_set1_ps(dz1)), _mm_mul_ps(l2, _mm_set1_ps(dz2)))
+					);
+					const __m128 iw =
+						_mm_add_ps(_mm_set1_ps(tri.invW[0]), _mm_add_ps(_mm_mul_ps(l1, _mm_set1_ps(dw1)), _mm_mul_ps(l2, _mm_set1_ps(dw2))));
+					const __m128 pixelW = _mm_div_ps(_mm_set1_ps(1.0f), iw);
+
+					_mm_store_ps(zOverW, z);
+					_mm_store_ps(w, pixelW);
+					_mm_store_ps(weight1, _mm_mul_ps(_mm_mul_ps(l1, _mm_set1_ps(tri.invW[1])), pixelW));
+					_mm_store_ps(weight2, _mm_mul_ps(_mm_mul_ps(l2, _mm_set1_ps(tri.invW[2])), pixelW));
+				}
+#elif defined(PICA_SW_RASTERIZER_NEON)
+				const int32x4_t e0 = vaddq_s32(vdupq_n_s32(rowEdges[0]), laneOffsets[0]);
+				const int32x4_t e1 = vaddq_s32(vdupq_n_s32(rowEdges[1]), laneOffsets[1]);
+				const int32x4_t e2 = vaddq_s32(vdupq_n_s32(rowEdges[2]), laneOffsets[2]);
+				const uint32x4_t inside =
+					vandq_u32(vandq_u32(vcgtq_s32(e0, thresholds[0]), vcgtq_s32(e1, thresholds[1])), vcgtq_s32(e2, thresholds[2]));
+				coverage = vaddvq_u32(vandq_u32(inside, laneMask)) & validLanes;
+
+				if (coverage != 0) {
+					const float32x4_t l1 = vmulq_f32(vcvtq_f32_s32(e1), invArea);
+					const float32x4_t l2 = vmulq_f32(vcvtq_f32_s32(e2), invArea);
+					const float32x4_t z = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(tri.zOverW[0]), l1, dz1), l2, dz2);
+					const float32x4_t iw = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(tri.invW[0]), l1, dw1), l2, dw2);
+					const float32x4_t pixelW = vdivq_f32(vdupq_n_f32(1.0f), iw);
+
+					vst1q_f32(zOverW, z);
+					vst1q_f32(w, pixelW);
+					vst1q_f32(weight1, vmulq_f32(vmulq_n_f32(l1, tri.invW[1]), pixelW));
+					vst1q_f32(weight2, vmulq_f32(vmulq_n_f32(l2, tri.invW[2]), pixelW));
+				}
+#else
+				coverage = 0;
+				for (int lane = 0; lane < 4; lane++) {
+					const s32 step = lane * 16;
+					const s32 e0 = rowEdges[0] + tri.edgeA[0] * step;
+					const s32 e1 = rowEdges[1] + tri.edgeA[1] * step;
+					const s32 e2 = rowEdges[2] + tri.edgeA[2] * step;
+
+					if (e0 >= tri.edgeBias[0] && e1 >= tri.edgeBias[1] && e2 >= tri.edgeBias[2]) {
+						coverage |= 1u << lane;
+					}
+
+					const float l1 = float(e1) * tri.invDoubleArea;
+					const float l2 = float(e2) * tri.invDoubleArea;
+					zOverW[lane] = tri.zOverW[0] + l1 * dz1 + l2 * dz2;
+					w[lane] = 1.0f / (tri.invW[0] + l1 * dw1 + l2 * dw2);
+					weight1[lane] = l1 * tri.invW[1] * w[lane];
+					weight2[lane] = l2 * tri.invW[2] * w[lane];
+				}
+				coverage &= validLanes;
+#endif
+
+				for (int i = 0; i < 3; i++) {
+					rowEdges[i] += tri.edgeA[i] * 64;
+				}
+
+				while (coverage != 0) {
+					const int lane = std::countr_zero(coverage);
+					coverage &= coverage - 1;
+					shadePixel(tri, x + lane, y, zOverW[lane], w[lane], weight1[lane], weight2[lane]);
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::shadePixel(const Triangle& tri, s32 x, s32 y, float zOverW, float w, float weight1, float weight2) {
+	const DrawState& state = draws[tri.drawIndex];
+	const float weight0 = 1.0f - weight1 - weight2;
+
+	std::array<float, attributeCount> attributes;
+	for (usize i = 0; i < attributeCount; i++) {
+		attributes[i] = tri.attributes[0][i] * weight0 + tri.attributes[1][i] * weight1 + tri.attributes[2][i] * weight2;
+	}
+
+	// TEV sources. Fragment lighting isn't implemented, so the primary and secondary fragment colours are 0 like with lighting disabled
+	std::array<vec4, 16> sources = {};
+	const vec4 vertexColour = {attributes[0], attributes[1], attributes[2], attributes[3]};
+	sources[0] = vertexColour;
+
+	const bool texture2UsesTexcoord1 = (state.texUnitConfig & (1 << 13)) != 0;
+	const std::array<std::array<float, 2>, 3> texcoords = {{
+		{attributes[4], attributes[5]},
+		{attributes[6], attributes[7]},
+		texture2UsesTexcoord1 ? std::array<float, 2>{attributes[6], attributes[7]} : std::array<float, 2>{attributes[8], attributes[9]},
+	}};
+
+	for (int i = 0; i < 3; i++) {
+		if ((state.texUnitConfig & (1 << i)) != 0 && state.textures[i]) {
+			const auto& [s, t] = texcoords[i];
+			sources[3 + i] = sampleTexture(*state.textures[i], state.textureParams[i], state.textureBorderColours[i], s, t);
+		}
+	}
+
+	// Like on the GL ubershader, the TEV buffer lags one stage behind: Stage i sees the buffer as stage i - 2 left it
+	sources[15] = vertexColour;
+	vec4 nextBuffer = unpackColour(state.texEnvBufferColour);
+
+	for (int i = 0; i < 6; i++) {
+		sources[14] = unpackColour(state.texEnv[i][3]);
+		sources[15] = runTevStage(sources, state.texEnv[i]);
+		sources[13] = nextBuffer;
+
+		if (i < 4) {
+			if ((state.texEnvUpdateBuffer & (0x100 << i)) != 0) {
+				std::copy_n(sources[15].begin(), 3, nextBuffer.begin());
+			}
+
+			if ((state.texEnvUpdateBuffer & (0x1000 << i)) != 0) {
+				nextBuffer[3] = sources[15][3];
+			}
+		}
+	}
+
+	const vec4& colour = sources[15];
+
+	// Alpha test
+	if ((state.alphaTest & 1) != 0) {
+		const u8 reference = getBits<8, 8>(state.alphaTest);
+		if (!compare(getBits<4, 3>(state.alphaTest), toUnorm8(colour[3]), reference)) {
+			return;
+		}
+	}
+
+	const u32 row = framebuffer.height - 1 - u32(y);
+	const u32 pixelIndex = tiledPixelIndex(u32(x), row, framebuffer.width);
+
+	if (framebuffer.depth != nullptr) {
+		u8* depthPixel = framebuffer.depth + pixelIndex * sizePerPixel(framebuffer.depthFormat);
+		const bool hasStencilBuffer = framebuffer.depthFormat == DepthFmt::Depth24Stencil8;
+		const u32 depthBits = framebuffer.depthFormat == DepthFmt::Depth16 ? 16 : 24;
+		const u32 depthMax = (1u << depthBits) - 1;
+
+		u32 storedDepth = depthPixel[0] | (u32(depthPixel[1]) << 8);
+		if (depthBits == 24) {
+			storedDepth |= u32(depthPixel[2]) << 16;
+		}
+		const u8 storedStencil = hasStencilBuffer ? depthPixel[3] : 0;
+
+		float depth = zOverW * state.depthScale + state.depthOffset;
+		if (state.wBuffer) {
+			depth *= w;
+		}
+		const u32 fragmentDepth = u32(std::clamp(depth, 0.0f, 1.0f) * float(depthMax));
+
+		const bool stencilEnable = hasStencilBuffer && (state.stencilTest & 1) != 0;
+		const u8 stencilWriteMask = state.depthStencilWrite ? getBits<8, 8, u8>(state.stencilTest) : 0;
+		const u8 stencilReference = getBits<16, 8, u8>(state.stencilTest);
+		const u8 stencilInputMask = getBits<24, 8, u8>(state.stencilTest);
+
+		auto updateStencil = [&](u32 op) {
+			const u8 value = stencilOp(op, storedStencil, stencilReference);
+			depthPixel[3] = u8((storedStencil & ~stencilWriteMask) | (value & stencilWriteMask));
+		};
+
+		const u32 stencilFunc = getBits<4, 3>(state.stencilTest);
+		if (stencilEnable && !compare(stencilFunc, u8(stencilReference & stencilInputMask), u8(storedStencil & stencilInputMask))) {
+			updateStencil(getBits<0, 3>(state.stencilOp));
+			return;
+		}
+
+		const bool depthTestEnable = (state.depthColourMask & 1) != 0;
+		if (depthTestEnable && !compare(getBits<4, 3>(state.depthColourMask), fragmentDepth, storedDepth)) {
+			if (stencilEnable) {
+				updateStencil(getBits<4, 3>(state.stencilOp));
+			}
+			return;
+		}
+
+		if (stencilEnable) {
+			updateStencil(getBits<8, 3>(state.stencilOp));
+		}
+
+		if ((state.depthColourMask & (1 << 12)) != 0 && state.depthStencilWrite) {
+			depthPixel[0] = u8(fragmentDepth);
+			depthPixel[1] = u8(fragmentDepth >> 8);
+			if (depthBits == 24) {
+				depthPixel[2] = u8(fragmentDepth >> 16);
+			}
+		}
+	}
+
+	const u32 colourMask = getBits<8, 4>(state.depthColourMask);
+	if (colourMask == 0) {
+		return;
+	}
+
+	u8* colourPixel = framebuffer.colour + pixelIndex * sizePerPixel(framebuffer.colourFormat);
+	const std::array<u8, 4> dst = decodeColour(framebuffer.colourFormat, colourPixel);
+	std::array<u8, 4> result;
+
+	if ((state.colourOperation & (1 << 8)) != 0) {
+		const vec4 dstColour = {dst[0] / 255.0f, dst[1] / 255.0f, dst[2] / 255.0f, dst[3] / 255.0f};
+		const vec4 constant = unpackColour(state.blendColour);
+
+		for (int i = 0; i < 4; i++) {
+			const bool alpha = i == 3;
+			const u32 equation = alpha ? getBits<8, 3>(state.blendFunc) : getBits<0, 3>(state.blendFunc);
+			const u32 srcFactor = alpha ? getBits<24, 4>(state.blendFunc) : getBits<16, 4>(state.blendFunc);
+			const u32 dstFactor = alpha ? getBits<28, 4>(state.blendFunc) : getBits<20, 4>(state.blendFunc);
+
+			result[i] = toUnorm8(blendEquation(
+				equation, colour[i], dstColour[i], blendFactor(srcFactor, i, colour, dstColour, constant),
+				blendFactor(dstFactor, i, colour, dstColour, constant)
+			));
+		}
+	} else {
+		const u32 op = getBits<0, 4>(state.logicOp);
+		for (int i = 0; i < 4; i++) {
+			result[i] = logicOp(op, toUnorm8(colour[i]), dst[i]);
+		}
+	}
+
+	for (int i = 0; i < 4; i++) {
+		if ((colourMask & (1 << i)) == 0) {
+			result[i] = dst[i];
+		}
+	}
+
+	encodeColour(framebuffer.colourFormat, colourPixel, result);
+}
@@ -1,26 +1,361 @@
 #include "renderer_sw/renderer_sw.hpp"
 
+#include <glad/gl.h>
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "PICA/gpu.hpp"
+#include "PICA/pixels.hpp"
+#include "PICA/texture_decoder.hpp"
+#include "renderer_sw/transfer_engine.hpp"
+
+using namespace Helpers;
+using namespace PICA;
+
+namespace {
+	bool rangesOverlap(u32 start1, u32 size1, u32 start2, u32 size2) { return start1 < start2 + size2 && start2 < start1 + size1; }
+
+	// Like GPU::getPointerPhys, but without warning about invalid addresses, since games often leave unused buffer addresses pointing to garbage
+	u8* getPhysicalRange(GPU& gpu, u32 paddr, u32 size) {
+		const bool valid = (paddr >= PhysicalAddrs::VRAM && paddr + size <= PhysicalAddrs::VRAMEnd) ||
+						   (paddr >= PhysicalAddrs::FCRAM && paddr + size <= PhysicalAddrs::FCRAMEnd);
+		return valid ? gpu.getPointerPhys<u8>(paddr, size) : nullptr;
+	}
+}  // namespace
+
 RendererSw::RendererSw(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
-	: Renderer(gpu, internalRegs, externalRegs) {}
-RendererSw::~RendererSw() {}
+	: Renderer(gpu, internalRegs, externalRegs), screenPixels(screenWidth * screenHeight, 0xff000000) {
+	rasterizer.start(std::clamp<u32>(std::thread::hardware_concurrency(), 1, ShaderWorkerPool::maxWorkerCount));
+}
+
+RendererSw::~RendererSw() {
+	rasterizer.stop();
+	clearTextureCache();
+	deinitGraphicsContext();
+}
+
+void RendererSw::reset() {
+	rasterizer.discard();
+	clearTextureCache();
+	std::fill(screenPixels.begin(), screenPixels.end(), 0xff000000);
+}
+
+void RendererSw::flushDraws() {
+	if (!rasterizer.hasPendingDraws()) {
+		return;
+	}
+
+	rasterizer.flush();
+
+	Memory& mem = gpu.getMemory();
+	mem.markPhysicalWrite(pendingColourLoc, pendingColourSize);
+	if (pendingDepthSize != 0) {
+		mem.markPhysicalWrite(pendingDepthLoc, pendingDepthSize);
+	}
+}
+
+void RendererSw::clearTextureCache() {
+	Memory& mem = gpu.getMemory();
+	for (auto& [key, cached] : textureCache) {
+		mem.unwatchPhysicalRange(cached.location, cached.size);
+	}
+
+	textureCache.clear();
+}
+
+SoftwareRasterizer::TexturePtr RendererSw::getTexture(u32 unit) {
+	static constexpr std::array<u32, 3> ioBases = {
+		InternalRegs::Tex0BorderColor,
+		InternalRegs::Tex1BorderColor,
+		InternalRegs::Tex2BorderColor,
+	};
+
+	const u32 ioBase = ioBases[unit];
+	const u32 dim = regs[ioBase + 1];
+	const u32 height = getBits<0, 11>(dim);
+	const u32 width = getBits<16, 11>(dim);
+	const u32 location = (regs[ioBase + 4] & 0x0FFFFFFF) << 3;
+	const auto format = static_cast<TextureFmt>(regs[ioBase + (unit == 0 ? 13 : 5)] & 0xF);
 
-void RendererSw::reset() { printf("RendererSW: Unimplemented reset call\n"); }
-void RendererSw::display() { printf("RendererSW: Unimplemented display call\n"); }
+	if (width < 8 || height < 8 || format > TextureFmt::ETC1A4) {
+		return nullptr;
+	}
+
+	const u32 size = (width / 8) * (height / 8) * TextureDecoder::tileSize(format);
+	const u8* data = getPhysicalRange(gpu, location, size);
+	if (data == nullptr) {
+		return nullptr;
+	}
+
+	// Render to texture: The pending draws have to land in memory before we can read them back
+	if (rasterizer.hasPendingDraws() &&
+		(rangesOverlap(location, size, pendingColourLoc, pendingColourSize) || rangesOverlap(location, size, pendingDepthLoc, pendingDepthSize))) {
+		flushDraws();
+	}
+
+	Memory& mem = gpu.getMemory();
+	// Texture dimensions are 11 bits each and the format is 4 bits, so all of them fit in the top half of the key
+	const u64 key = u64(location) | (u64(format) << 32) | (u64(width) << 36) | (u64(height) << 47);
+	auto it = textureCache.find(key);
+
+	if (it != textureCache.end() && !mem.writtenSince(location, size, it->second.writeStamp)) {
+		return it->second.texture;
+	}
+
+	// The texture is new or its memory was written to. Games often rewrite textures with the same data, so check the hash before decoding
+	const PICAHash::HashType hash = PICAHash::computeHash(reinterpret_cast<const char*>(data), size);
+
+	if (it == textureCache.end()) {
+		if (textureCache.size() >= maxCachedTextures) {
+			clearTextureCache();
+		}
+
+		it = textureCache.emplace(key, CachedTexture{.location = location, .size = size}).first;
+		mem.watchPhysicalRange(location, size);
+	} else if (it->second.hash == hash) {
+		it->second.writeStamp = mem.getWriteStamp();
+		return it->second.texture;
+	}
+
+	auto texture = std::make_shared<SoftwareRasterizer::Texture>();
+	texture->width = width;
+	texture->height = height;
+	texture->texels.resize(usize(width) * height);
+	TextureDecoder::decode(format, width, height, std::span{data, size}, texture->texels);
+
+	it->second.writeStamp = mem.getWriteStamp();
+	it->second.hash = hash;
+	it->second.texture = std::move(texture);
+	return it->second.texture;
+}
+
+void RendererSw::drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) {
+	using namespace PICA::InternalRegs;
+
+	const u32 width = fbSize[0];
+	const u32 height = fbSize[1];
+	const u32 colourSize = width * height * u32(sizePerPixel(colourBufferFormat));
+	const u32 depthSize = width * height * u32(sizePerPixel(depthBufferFormat));
+
+	SoftwareRasterizer::Framebuffer fb;
+	fb.colour = getPhysicalRange(gpu, colourBufferLoc, colourSize);
+	fb.colourFormat = colourBufferFormat;
+	fb.depth = getPhysicalRange(gpu, depthBufferLoc, depthSize);
+	fb.depthFormat = depthBufferFormat;
+	fb.width = width;
+	fb.height = height;
+
+	if (fb.colour == nullptr || width == 0 || height == 0) {
+		return;
+	}
+
+	SoftwareRasterizer::DrawState state = SoftwareRasterizer::DrawState::fromRegs(regs);
+	for (u32 unit = 0; unit < 3; unit++) {
+		if ((regs[TexUnitCfg] & (1 << unit)) != 0) {
+			state.textures[unit] = getTexture(unit);
+		}
+	}
+
+	if (fb != rasterizer.getFramebuffer()) {
+		flushDraws();
+		rasterizer.setFramebuffer(fb);
+	}
+
+	pendingColourLoc = colourBufferLoc;
+	pendingColourSize = colourSize;
+	pendingDepthLoc = depthBufferLoc;
+	pendingDepthSize = fb.depth != nullptr ? depthSize : 0;
+
+	rasterizer.submitTriangles(state, primType, vertices);
+}
 
-void RendererSw::initGraphicsContext(SDL_Window* window) { printf("RendererSW: Unimplemented initGraphicsContext call\n"); }
-void RendererSw::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) { printf("RendererSW: Unimplemented clearBuffer call\n"); }
+void RendererSw::clearBuffer(u32 startAddress, u32 endAddress, u32 value, u32 control) {
+	flushDraws();
+
+	if (endAddress <= startAddress) {
+		return;
+	}
+
+	const u32 size = endAddress - startAddress;
+	u8* data = getPhysicalRange(gpu, startAddress, size);
+	if (data == nullptr) {
+		Helpers::warn("[RendererSW] Clearing invalid buffer %08X-%08X", startAddress, endAddress);
+		return;
+	}
+
+	TransferEngine::fill(data, size, value, control);
+	gpu.getMemory().markPhysicalWrite(startAddress, size);
+}
 
 void RendererSw::displayTransfer(u32 inputAddr, u32 outputAddr, u32 inputSize, u32 outputSize, u32 flags) {
-	printf("RendererSW: Unimplemented displayTransfer call\n");
+	flushDraws();
+
+	const auto transfer = TransferEngine::DisplayTransfer::fromRegs(inputSize, outputSize, flags);
+	const u8* input = getPhysicalRange(gpu, inputAddr, transfer.inputBytes());
+	u8* output = getPhysicalRange(gpu, outputAddr, transfer.outputBytes());
+
+	if (input == nullptr || output == nullptr || transfer.outputWidth == 0 || transfer.outputHeight == 0) {
+		Helpers::warn("[RendererSW] Invalid display transfer from %08X to %08X", inputAddr, outputAddr);
+		return;
+	}
+
+	transfer.run(input, output);
+	gpu.getMemory().markPhysicalWrite(outputAddr, transfer.outputBytes());
 }
 
 void RendererSw::textureCopy(u32 inputAddr, u32 outputAddr, u32 totalBytes, u32 inputSize, u32 outputSize, u32 flags) {
-	printf("RendererSW: Unimplemented textureCopy call\n");
+	flushDraws();
+
+	// Texture copy size is aligned to 16 byte units
+	const u32 copySize = totalBytes & ~0xf;
+	if (copySize == 0) {
+		return;
+	}
+
+	// The width and gap are provided in 16-byte units. A width of 0 copies everything in one go
+	u32 inputWidth = (inputSize & 0xffff) << 4;
+	const u32 inputGap = (inputSize >> 16) << 4;
+	u32 outputWidth = (outputSize & 0xffff) << 4;
+	const u32 outputGap = (outputSize >> 16) << 4;
+	if (inputWidth == 0) inputWidth = copySize;
+	if (outputWidth == 0) outputWidth = copySize;
+
+	const u32 inputLines = (copySize + inputWidth - 1) / inputWidth;
+	const u32 outputLines = (copySize + outputWidth - 1) / outputWidth;
+	const u32 inputSpan = inputLines * (inputWidth + inputGap) - inputGap;
+	const u32 outputSpan = outputLines * (outputWidth + outputGap) - outputGap;
+
+	const u8* input = getPhysicalRange(gpu, inputAddr, inputSpan);
+	u8* output = getPhysicalRange(gpu, outputAddr, outputSpan);
+	if (input == nullptr || output == nullptr) {
+		Helpers::warn("[RendererSW] Invalid texture copy from %08X to %08X", inputAddr, outputAddr);
+		return;
+	}
+
+	// Copy the largest chunk that doesn't cross a line on either side, then skip the gap of whichever line ended
+	u32 remaining = copySize;
+	u32 inputRemaining = inputWidth;
+	u32 outputRemaining = outputWidth;
+
+	while (remaining > 0) {
+		const u32 chunk = std::min({remaining, inputRemaining, outputRemaining});
+		std::memmove(output, input, chunk);
+		input += chunk;
+		output += chunk;
+		remaining -= chunk;
+		inputRemaining -= chunk;
+		outputRemaining -= chunk;
+
+		if (inputRemaining == 0) {
+			inputRemaining = inputWidth;
+			input += inputGap;
+		}
+
+		if (outputRemaining == 0) {
+			outputRemaining = outputWidth;
+			output += outputGap;
+		}
+	}
+
+	gpu.getMemory().markPhysicalWrite(outputAddr, outputSpan);
 }
 
-void RendererSw::drawVertices(PICA::PrimType primType, std::span<const PICA::Vertex> vertices) {
-	printf("RendererSW: Unimplemented drawVertices call\n");
+void RendererSw::composeScreen(bool bottomScreen) {
+	using namespace PICA::ExternalRegs;
+
+	const u32 select = externalRegs[bottomScreen ? Framebuffer1Select : Framebuffer0Select] & 1;
+	const u32 address = bottomScreen ? externalRegs[select == 0 ? Framebuffer1AFirstAddr : Framebuffer1ASecondAddr]
+									 : externalRegs[select == 0 ? Framebuffer0AFirstAddr : Framebuffer0ASecondAddr];
+	const ColorFmt format = TransferEngine::toColorFmt(externalRegs[bottomScreen ? Framebuffer1Config : Framebuffer0Config] & 7);
+	const u32 bpp = u32(sizePerPixel(format));
+
+	// The LCDs are scanned out in portrait mode, so each line of the framebuffer is a column of the screen, starting from the bottom
+	constexpr u32 lineLength = 240;
+	const u32 width = bottomScreen ? 320 : 400;
+	u32 stride = externalRegs[bottomScreen ? Framebuffer1Stride : Framebuffer0Stride];
+	if (stride < lineLength * bpp) {
+		stride = lineLength * bpp;
+	}
+
+	const u8* data = getPhysicalRange(gpu, address, stride * width);
+	if (data == nullptr) {
+		return;
+	}
+
+	const u32 offsetX = bottomScreen ? 40 : 0;
+	const u32 offsetY = bottomScreen ? 240 : 0;
+
+	for (u32 x = 0; x < width; x++) {
+		const u8* line = data + x * stride;
+
+		for (u32 y = 0; y < lineLength; y++) {
+			const auto [r, g, b, a] = PICA::decodeColour(format, line + (lineLength - 1 - y) * bpp);
+			screenPixels[(offsetY + y) * screenWidth + offsetX + x] = r | (g << 8) | (b << 16) | 0xff000000;
+		}
+	}
+}
+
+void RendererSw::composeScreens() {
+	std::fill(screenPixels.begin(), screenPixels.end(), 0xff000000);
+	composeScreen(false);
+	composeScreen(true);
+}
+
+void RendererSw::display() {
+	flushDraws();
+	composeScreens();
+
+	if (!hasWindow) {
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, screenTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, screenWidth, screenHeight, GL_RGBA, GL_UNSIGNED_BYTE, screenPixels.data());
+
+	// Our image starts from the top row while GL starts from the bottom one, so flip it vertically while blitting
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, screenFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glClearColor(0.f, 0.f, 0.f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, outputWindowHeight, outputWindowWidth, 0, GL_COLOR_BUFFER_BIT, GL_LINEAR);
 }
 
-void RendererSw::screenshot(const std::string& name) { printf("RendererSW: Unimplemented screenshot call\n"); }
-void RendererSw::deinitGraphicsContext() { printf("RendererSW: Unimplemented DeinitGraphicsContext call\n"); }
\ No newline at end of file
+void RendererSw::initGraphicsContext(SDL_Window* window) {
+	deinitGraphicsContext();
+	if (window == nullptr) {
+		return;
+	}
+
+	glGenTextures(1, &screenTexture);
+	glBindTexture(GL_TEXTURE_2D, screenTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, screenWidth, screenHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glGenFramebuffers(1, &screenFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, screenFramebuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screenTexture, 0);
+
+	hasWindow = true;
+}
+
+void RendererSw::screenshot(const std::string& name) {
+	flushDraws();
+	composeScreens();
+	stbi_write_png(name.c_str(), screenWidth, screenHeight, 4, screenPixels.data(), 0);
+}
+
+void RendererSw::deinitGraphicsContext() {
+	if (!hasWindow) {
+		return;
+	}
+
+	glDeleteFramebuffers(1, &screenFramebuffer);
+	glDeleteTextures(1, &screenTexture);
+	screenFramebuffer = 0;
+	screenTexture = 0;
+	hasWindow = false;
+}
@@ -0,0 +1,97 @@
+#include "renderer_sw/transfer_engine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "PICA/pixels.hpp"
+
+using namespace Helpers;
+using namespace PICA;
+
+namespace TransferEngine {
+	ColorFmt toColorFmt(u32 format) {
+		switch (format) {
+			case 2: return ColorFmt::RGB565;
+			case 3: return ColorFmt::RGBA5551;
+			default: return static_cast<ColorFmt>(std::min<u32>(format, 4));
+		}
+	}
+
+	void fill(u8* data, u32 size, u32 value, u32 control) {
+		const u32 fillWidth = getBit<9>(control) ? 4 : (getBit<8>(control) ? 3 : 2);
+		u8 pattern[4];
+		for (int i = 0; i < 4; i++) {
+			pattern[i] = u8(value >> (i * 8));
+		}
+
+		for (u32 offset = 0; offset + fillWidth <= size; offset += fillWidth) {
+			std::memcpy(data + offset, pattern, fillWidth);
+		}
+	}
+
+	DisplayTransfer DisplayTransfer::fromRegs(u32 inputSize, u32 outputSize, u32 flags) {
+		DisplayTransfer transfer;
+		transfer.inputWidth = inputSize & 0xffff;
+		transfer.inputHeight = inputSize >> 16;
+		transfer.inputFormat = toColorFmt(getBits<8, 3>(flags));
+		transfer.outputFormat = toColorFmt(getBits<12, 3>(flags));
+		transfer.scaling = static_cast<Scaling>(getBits<24, 2>(flags));
+		transfer.verticalFlip = (flags & 1) != 0;
+		transfer.inputLinear = (flags & 2) != 0;
+		transfer.dontSwizzle = (flags & (1 << 5)) != 0;
+
+		// Downscaling averages 2 or 4 input pixels into each output pixel
+		const bool scaleX = transfer.scaling == Scaling::X || transfer.scaling == Scaling::XY;
+		const bool scaleY = transfer.scaling == Scaling::XY;
+		transfer.outputWidth = (outputSize & 0xffff) >> (scaleX ? 1 : 0);
+		transfer.outputHeight = (outputSize >> 16) >> (scaleY ? 1 : 0);
+		return transfer;
+	}
+
+	void DisplayTransfer::run(const u8* input, u8* output) const {
+		const u32 horizontalShift = (scaling == Scaling::X || scaling == Scaling::XY) ? 1 : 0;
+		const u32 verticalShift = scaling == Scaling::XY ? 1 : 0;
+		const u32 inputBpp = u32(sizePerPixel(inputFormat));
+		const u32 outputBpp = u32(sizePerPixel(outputFormat));
+
+		// The transfer converts between tiled and linear layouts, unless dontSwizzle is set in which case both sides keep the input's layout
+		const bool inputTiled = !inputLinear;
+		const bool outputTiled = inputLinear != dontSwizzle;
+		if (inputLinear && scaling != Scaling::None) {
+			Helpers::warn("[RendererSW] Display transfer scaling is only implemented for tiled input");
+		}
+
+		for (u32 y = 0; y < outputHeight; y++) {
+			const u32 inputY = y << verticalShift;
+			const u32 outputY = verticalFlip ? outputHeight - 1 - y : y;
+
+			for (u32 x = 0; x < outputWidth; x++) {
+				const u32 inputX = x << horizontalShift;
+				const u32 inputIndex = inputTiled ? tiledPixelIndex(inputX, inputY, inputWidth) : inputY * inputWidth + inputX;
+				const u32 outputIndex = outputTiled ? tiledPixelIndex(x, outputY, outputWidth) : outputY * outputWidth + x;
+				const u8* pixel = input + inputIndex * inputBpp;
+
+				std::array<u8, 4> colour = decodeColour(inputFormat, pixel);
+				if (horizontalShift != 0) {
+					// In a tiled surface, the pixels to the right of and above an even pixel come right after it, so the 2x2 block is contiguous
+					const u32 samples = verticalShift != 0 ? 4 : 2;
+					std::array<u32, 4> sum = {colour[0], colour[1], colour[2], colour[3]};
+
+					for (u32 i = 1; i < samples; i++) {
+						const auto sample = decodeColour(inputFormat, pixel + i * inputBpp);
+						for (int c = 0; c < 4; c++) {
+							sum[c] += sample[c];
+						}
+					}
+
+					for (int c = 0; c < 4; c++) {
+						colour[c] = u8(sum[c] / samples);
+					}
+				}
+
+				encodeColour(outputFormat, output + outputIndex * outputBpp, colour);
+			}
+		}
+	}
+}  // namespace TransferEngine
@@ -1,12 +1,14 @@
 #include "renderer_vk/renderer_vk.hpp"
 
 #include <cmrc/cmrc.hpp>
+#include <cstring>
 #include <limits>
 #include <span>
 #include <unordered_set>
 
 #include "SDL_vulkan.h"
 #include "helpers.hpp"
+#include "io_file.hpp"
 #include "renderer_vk/vk_debug.hpp"
 #include "renderer_vk/vk_memory.hpp"
 #include "renderer_vk/vk_pica.hpp"
@@ -59,7 +61,7 @@ static inline vk::UniqueShaderModule createShaderModule(vk::Device device, cmrc:
 std::tuple<vk::UniquePipeline, vk::UniquePipelineLayout> createGraphicsPipeline(
 	vk::Device device, std::span<const vk::PushConstantRange> pushConstants, std::span<const vk::DescriptorSetLayout> setLayouts,
 	vk::ShaderModule vertModule, vk::ShaderModule fragModule, std::span<const vk::VertexInputBindingDescription> vertexBindingDescriptions,
-	std::span<const vk::VertexInputAttributeDescription> vertexAttributeDescriptions, vk::RenderPass renderPass
+	std::span<const vk::VertexInputAttributeDescription> vertexAttributeDescriptions, vk::RenderPass renderPass, vk::PipelineCache pipelineCache
 ) {
 	// Create Pipeline Layout
 	vk::PipelineLayoutCreateInfo graphicsPipelineLayoutInfo = {};
@@ -196,7 +198,7 @@ std::tuple<vk::UniquePipeline, vk::UniquePipelineLayout> createGraphicsPipeline(
 	// Create Pipeline
 	vk::UniquePipeline pipeline = {};
 
-	if (auto createResult = device.createGraphicsPipelineUnique({}, renderPipelineInfo); createResult.result == vk::Result::eSuccess) {
+	if (auto createResult = device.createGraphicsPipelineUnique(pipelineCache, renderPipelineInfo); createResult.result == vk::Result::eSuccess) {
 		pipeline = std::move(createResult.value);
 	} else {
 		Helpers::panic("Error creating graphics pipeline: %s\n", vk::to_string(createResult.result).c_str());
@@ -627,9 +629,84 @@ vk::Result RendererVK::recreateSwapchain(vk::SurfaceKHR surface, vk::Extent2D sw
 RendererVK::RendererVK(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
 	: Renderer(gpu, internalRegs, externalRegs) {}
 
-RendererVK::~RendererVK() {}
+RendererVK::~RendererVK() { savePipelineCache(); }
 
-void RendererVK::reset() { renderPassCache.clear(); }
+void RendererVK::reset() {
+	renderPassCache.clear();
+
+	// The pipeline cache is per title, so save it before the next title is loaded
+	savePipelineCache();
+	pipelineCachePath.clear();
+}
+
+void RendererVK::loadShaderCache(const std::filesystem::path& directory) {
+	savePipelineCache();
+	pipelineCachePath = directory / "vulkan_pipelines.bin";
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	IOFile file(pipelineCachePath, "rb");
+	if (!pipelineCache || !file.isOpen()) {
+		return;
+	}
+
+	std::vector<u8> data(file.size().value_or(0));
+	const auto [success, bytesRead] = file.readBytes(data.data(), data.size());
+	file.close();
+
+	// Drivers are supposed to ignore caches built by a different device or driver version, but some of them crash on those instead,
+	// so check the header ourselves
+	const vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+	struct {
+		u32 headerSize;
+		u32 headerVersion;
+		u32 vendorID;
+		u32 deviceID;
+		u8 pipelineCacheUUID[VK_UUID_SIZE];
+	} header;
+
+	if (!success || bytesRead != data.size() || data.size() < sizeof(header)) {
+		return;
+	}
+
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.headerVersion != u32(vk::PipelineCacheHeaderVersion::eOne) || header.vendorID != properties.vendorID ||
+		header.deviceID != properties.deviceID || std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+		Helpers::warn("Discarding pipeline cache built for a different GPU or driver");
+		return;
+	}
+
+	vk::PipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.data();
+
+	if (auto createResult = device->createPipelineCacheUnique(cacheInfo); createResult.result == vk::Result::eSuccess) {
+		// Merge rather than replace the cache, so that pipelines that were created before the title was loaded stay cached
+		if (device->mergePipelineCaches(pipelineCache.get(), {createResult.value.get()}) != vk::Result::eSuccess) {
+			Helpers::warn("Failed to merge pipeline cache");
+		}
+	} else {
+		Helpers::warn("Error loading pipeline cache: %s", vk::to_string(createResult.result).c_str());
+	}
+}
+
+void RendererVK::savePipelineCache() {
+	if (!device || !pipelineCache || pipelineCachePath.empty()) {
+		return;
+	}
+
+	auto dataResult = device->getPipelineCacheData(pipelineCache.get());
+	if (dataResult.result != vk::Result::eSuccess) {
+		Helpers::warn("Error getting pipeline cache data: %s", vk::to_string(dataResult.result).c_str());
+		return;
+	}
+
+	IOFile file(pipelineCachePath, "wb");
+	if (file.isOpen()) {
+		file.writeBytes(dataResult.value.data(), dataResult.value.size());
+	}
+}
 
 void RendererVK::display() {
 	// Get the next available swapchain image, and signal the semaphore when it's ready
@@ -1098,6 +1175,13 @@ void RendererVK::initGraphicsContext(SDL_Window* window) {
 	// Initialize device-specific function pointers
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(device.get());
 
+	// Start with an empty pipeline cache. The cache of a title gets merged into it once the title is loaded
+	if (auto createResult = device->createPipelineCacheUnique({}); createResult.result == vk::Result::eSuccess) {
+		pipelineCache = std::move(createResult.value);
+	} else {
+		Helpers::panic("Error creating pipeline cache: %s\n", vk::to_string(createResult.result).c_str());
+	}
+
 	if (presentQueueFamily != VK_QUEUE_FAMILY_IGNORED) {
 		presentQueue = device->getQueue(presentQueueFamily, 0);
 	}
@@ -1313,7 +1397,7 @@ void RendererVK::initGraphicsContext(SDL_Window* window) {
 
 	std::tie(displayPipeline, displayPipelineLayout) = createGraphicsPipeline(
 		device.get(), {}, {{displayDescriptorHeap.get()->getDescriptorSetLayout()}}, displayVertexShaderModule.get(),
-		displayFragmentShaderModule.get(), {}, {}, screenTextureRenderPass
+		displayFragmentShaderModule.get(), {}, {}, screenTextureRenderPass, pipelineCache.get()
 	);
 }
 
@@ -1585,6 +1669,7 @@ void RendererVK::screenshot(const std::string& name) {}
 void RendererVK::deinitGraphicsContext() {
 	// Invalidate the entire texture cache since they'll no longer be valid
 	textureCache.clear();
+	savePipelineCache();
 
 	// TODO: Make it so that depth and colour buffers get written back to 3DS memory
 	printf("RendererVK::DeinitGraphicsContext called\n");
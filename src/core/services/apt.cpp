@@ -99,9 +99,7 @@ void APTService::appletUtility(u32 messagePointer) {
 	mem.write32(messagePointer + 4, Result::Success);
 	mem.write32(messagePointer + 8, Result::Success);
 
-	for (u32 i = 0; i < outputSize; i++) {
-		mem.write8(outputBuffer + i, out[i]);
-	}
+	mem.copyToGuest(outputBuffer, out.data(), outputSize);
 }
 
 void APTService::getAppletInfo(u32 messagePointer) {
@@ -157,12 +155,8 @@ void APTService::startLibraryApplet(u32 messagePointer) {
 		KernelObject* sharedMemObject = kernel.getObject(parameters);
 
 		const MemoryBlock* sharedMem = sharedMemObject ? sharedMemObject->getData<MemoryBlock>() : nullptr;
-		std::vector<u8> data;
-		data.reserve(bufferSize);
-
-		for (u32 i = 0; i < bufferSize; i++) {
-			data.push_back(mem.read8(buffer + i));
-		}
+		std::vector<u8> data(bufferSize);
+		mem.copyFromGuest(data.data(), buffer, bufferSize);
 
 		Result::HorizonResult result = destApplet->start(sharedMem, data, appID);
 		if (resumeEvent.has_value()) {
@@ -276,12 +270,8 @@ void APTService::sendParameter(u32 messagePointer) {
 		param.signal = cmd;
 
 		// Fetch parameter data buffer
-		param.data.reserve(paramSize);
-		u32 pointer = parameterPointer;
-
-		for (u32 i = 0; i < paramSize; i++) {
-			param.data.push_back(mem.read8(pointer++));
-		}
+		param.data.resize(paramSize);
+		mem.copyFromGuest(param.data.data(), parameterPointer, paramSize);
 
 		auto result = destApplet->receiveParameter(param);
 	}
@@ -314,9 +304,7 @@ void APTService::receiveParameter(u32 messagePointer) {
 	mem.write32(messagePointer + 28, 0);
 
 	const u32 transferSize = std::min<u32>(size, parameter.data.size());
-	for (u32 i = 0; i < transferSize; i++) {
-		mem.write8(buffer + i, parameter.data[i]);
-	}
+	mem.copyToGuest(buffer, parameter.data.data(), transferSize);
 }
 
 void APTService::glanceParameter(u32 messagePointer) {
@@ -343,9 +331,7 @@ void APTService::glanceParameter(u32 messagePointer) {
 	mem.write32(messagePointer + 28, 0);
 
 	const u32 transferSize = std::min<u32>(size, parameter.data.size());
-	for (u32 i = 0; i < transferSize; i++) {
-		mem.write8(buffer + i, parameter.data[i]);
-	}
+	mem.copyToGuest(buffer, parameter.data.data(), transferSize);
 }
 
 void APTService::replySleepQuery(u32 messagePointer) {
@@ -417,7 +403,5 @@ void APTService::getWirelessRebootInfo(u32 messagePointer) {
 
 	mem.write32(messagePointer, IPC::responseHeader(0x45, 1, 2));
 	mem.write32(messagePointer + 4, Result::Success);
-	for (u32 i = 0; i < size; i++) {
-		mem.write8(messagePointer + 0x104 + i, 0); // Temporarily stub this until we add SetWirelessRebootInfo
-	}
+	mem.fillGuest(messagePointer + 0x104, 0, size);  // Temporarily stub this until we add SetWirelessRebootInfo
 }
@@ -119,7 +119,7 @@ void CFGService::getConfigInfo(u32 output, u32 blockID, u32 size, u32 permission
 	} else if (size == 0x1C && blockID == 0xA0000) {  // Username
 		writeStringU16(output, u"Pander");
 	} else if (size == 0xC0 && blockID == 0xC0000) {  // Parental restrictions info
-		for (int i = 0; i < 0xC0; i++) mem.write8(output + i, 0);
+		mem.fillGuest(output, 0, 0xC0);
 	} else if (size == 4 && blockID == 0xD0000) {  // Agreed EULA version (first 2 bytes) and latest EULA version (next 2 bytes)
 		log("Read EULA info\n");
 		mem.write16(output, 0x0202);                   // Agreed EULA version = 2.2 (Random number. TODO: Check)
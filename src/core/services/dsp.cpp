@@ -85,9 +85,7 @@ void DSPService::loadComponent(u32 messagePointer) {
 
 	loadedComponent.resize(size);
 
-	for (u32 i = 0; i < size; i++) {
-		loadedComponent[i] = mem.read8(buffer + i);
-	}
+	mem.copyFromGuest(loadedComponent.data(), buffer, size);
 
 	log("DSP::LoadComponent (size = %08X, program mask = %X, data mask = %X\n", size, programMask, dataMask);
 	dsp->loadComponent(loadedComponent, programMask, dataMask);
@@ -116,9 +114,7 @@ void DSPService::readPipeIfPossible(u32 messagePointer) {
 	mem.write32(messagePointer, IPC::responseHeader(0x10, 2, 2));
 
 	std::vector<u8> data = dsp->readPipe(channel, peer, size, buffer);
-	for (uint i = 0; i < data.size(); i++) {
-		mem.write8(buffer + i, data[i]);
-	}
+	mem.copyToGuest(buffer, data.data(), data.size());
 
 	mem.write32(messagePointer + 4, Result::Success);
 	mem.write16(messagePointer + 8, u16(data.size())); // Number of bytes read
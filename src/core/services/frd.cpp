@@ -122,12 +122,7 @@ void FRDService::getFriendProfile(u32 messagePointer) {
 	mem.write32(messagePointer + 4, Result::Success);
 
 	// Clear all profiles
-	for (u32 i = 0; i < count; i++) {
-		const u32 pointer = profile + (i * sizeof(Profile));
-		for (u32 j = 0; j < sizeof(Profile); j++) {
-			mem.write8(pointer + j, 0);
-		}
-	}
+	mem.fillGuest(profile, 0, count * sizeof(Profile));
 }
 
 void FRDService::getFriendAttributeFlags(u32 messagePointer) {
@@ -141,9 +136,7 @@ void FRDService::getFriendAttributeFlags(u32 messagePointer) {
 	mem.write32(messagePointer + 4, Result::Success);
 
 	// Clear flags
-	for (u32 i = 0; i < count; i++) {
-		mem.write8(profile + i, 0);
-	}
+	mem.fillGuest(profile, 0, count);
 }
 
 void FRDService::getMyPresence(u32 messagePointer) {
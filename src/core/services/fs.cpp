@@ -157,8 +157,7 @@ FSPath FSService::readPath(u32 type, u32 pointer, u32 size) {
 	std::vector<u8> data;
 	data.resize(size);
 
-	for (u32 i = 0; i < size; i++)
-		data[i] = mem.read8(pointer + i);
+	mem.copyFromGuest(data.data(), pointer, size);
 
 	return FSPath(type, data);
 }
@@ -1248,7 +1248,8 @@ void LDRService::initialize(u32 messagePointer) {
 		Helpers::panic("Failed to rebase CRS");
 	}
 
-	kernel.clearInstructionCache();
+	// Rebasing the CRS only patches the CRS itself
+	kernel.invalidateInstructionCacheRange(mapVaddr, size);
 
 	loadedCRS = mapVaddr;
 
@@ -62,6 +62,7 @@ void Y2RService::reset() {
 
 	conversionCoefficients.fill(0);
 	isBusy = false;
+	conversionEvent = Scheduler::invalidHandle;
 }
 
 void Y2RService::handleSyncRequest(u32 messagePointer) {
@@ -159,7 +160,7 @@ void Y2RService::stopConversion(u32 messagePointer) {
 
 	if (isBusy) {
 		isBusy = false;
-		kernel.getScheduler().removeEvent(Scheduler::EventType::SignalY2R);
+		kernel.getScheduler().removeEvent(conversionEvent);
 	}
 
 	mem.write32(messagePointer, IPC::responseHeader(0x27, 1, 0));
@@ -445,10 +446,12 @@ void Y2RService::startConversion(u32 messagePointer) {
 	static constexpr u64 delayTicks = 1'350'000;
 	isBusy = true;
 
-	// Remove any potential pending Y2R event and schedule a new one
+	// Push back any pending Y2R event, or schedule a new one if there's none
 	Scheduler& scheduler = kernel.getScheduler();
-	scheduler.removeEvent(Scheduler::EventType::SignalY2R);
-	scheduler.addEvent(Scheduler::EventType::SignalY2R, scheduler.currentTimestamp + delayTicks);
+	const u64 timestamp = scheduler.currentTimestamp + delayTicks;
+	if (!scheduler.rescheduleEvent(conversionEvent, timestamp)) {
+		conversionEvent = scheduler.addEvent(Scheduler::EventType::SignalY2R, timestamp);
+	}
 }
 
 void Y2RService::isFinishedSendingYUV(u32 messagePointer) {
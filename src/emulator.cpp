@@ -26,6 +26,7 @@ Emulator::Emulator()
 	  httpServer(this)
 #endif
 {
+	registerSchedulerCallbacks();
 	DSPService& dspService = kernel.getServiceManager().getDSP();
 
 	dsp = Audio::makeDSPCore(config.dspType, memory, scheduler, dspService);
@@ -145,48 +146,32 @@ void Emulator::runFrame() {
 }
 
 void Emulator::pollScheduler() {
-	auto& events = scheduler.events;
-
 	// Pop events until there's none pending anymore
 	while (scheduler.currentTimestamp >= scheduler.nextTimestamp) {
-		// Read event timestamp and type, pop it from the scheduler and handle it
-		auto [time, eventType] = std::move(*events.begin());
-		events.erase(events.begin());
-
-		scheduler.updateNextTimestamp();
-
-		switch (eventType) {
-			case Scheduler::EventType::VBlank: [[likely]] {
-				// Signal that we've reached the end of a frame
-				frameDone = true;
-				lua.signalEvent(LuaEvent::Frame);
-
-				// Send VBlank interrupts
-				ServiceManager& srv = kernel.getServiceManager();
-				srv.sendGPUInterrupt(GPUInterrupt::VBlank0);
-				srv.sendGPUInterrupt(GPUInterrupt::VBlank1);
-
-				// Queue next VBlank event
-				scheduler.addEvent(Scheduler::EventType::VBlank, time + CPU::ticksPerSec / 60);
-				break;
-			}
-
-			case Scheduler::EventType::UpdateTimers: kernel.pollTimers(); break;
-			case Scheduler::EventType::RunDSP: {
-				dsp->runAudioFrame(time);
-				break;
-			}
-
-			case Scheduler::EventType::SignalY2R: kernel.getServiceManager().getY2R().signalConversionDone(); break;
-
-			default: {
-				Helpers::panic("Scheduler: Unimplemented event type received: %d\n", static_cast<int>(eventType));
-				break;
-			}
-		}
+		scheduler.runNextEvent();
 	}
 }
 
+void Emulator::registerSchedulerCallbacks() {
+	scheduler.setCallback(Scheduler::EventType::VBlank, [this](u64 time, u64) {
+		// Signal that we've reached the end of a frame
+		frameDone = true;
+		lua.signalEvent(LuaEvent::Frame);
+
+		// Send VBlank interrupts
+		ServiceManager& srv = kernel.getServiceManager();
+		srv.sendGPUInterrupt(GPUInterrupt::VBlank0);
+		srv.sendGPUInterrupt(GPUInterrupt::VBlank1);
+
+		// Queue next VBlank event
+		scheduler.addEvent(Scheduler::EventType::VBlank, time + CPU::ticksPerSec / 60);
+	});
+
+	scheduler.setCallback(Scheduler::EventType::UpdateTimers, [this](u64, u64 handle) { kernel.fireTimer(HorizonHandle(handle)); });
+	scheduler.setCallback(Scheduler::EventType::RunDSP, [this](u64 time, u64) { dsp->runAudioFrame(time); });
+	scheduler.setCallback(Scheduler::EventType::SignalY2R, [this](u64, u64) { kernel.getServiceManager().getY2R().signalConversionDone(); });
+}
+
 #ifndef __LIBRETRO__
 // Get path for saving files (AppData on Windows, /home/user/.local/share/ApplicationName on Linux, etc)
 // Inside that path, we be use a game-specific folder as well. Eg if we were loading a ROM called PenguinDemo.3ds, the savedata would be in
@@ -221,6 +206,7 @@ bool Emulator::loadROM(const std::filesystem::path& path) {
 
 	// Reset whatever state needs to be reset before loading a new ROM
 	memory.loadedCXI = std::nullopt;
+	memory.CXIMapping.close();
 	memory.loaded3DSX = std::nullopt;
 
 	const std::filesystem::path appDataPath = getAppDataRoot();
@@ -260,6 +246,12 @@ bool Emulator::loadROM(const std::filesystem::path& path) {
 
 	if (success) {
 		romPath = path;
+		cpu.setBusyWaitSkip(config.isBusyWaitSkipEnabled(memory.getProgramID()));
+
+		// Shader caches are per title. ROMs without a program ID (eg homebrew) are keyed by their file name instead
+		const auto programID = memory.getProgramID();
+		const std::string title = programID ? Helpers::format("%016llX", (unsigned long long)*programID) : path.filename().stem().string();
+		gpu.loadShaderCache(appDataPath / "shader_cache" / title);
 #ifdef PANDA3DS_ENABLE_DISCORD_RPC
 		updateDiscord();
 #endif
@@ -2,6 +2,7 @@
 #include "http_server.hpp"
 
 #include <fstream>
+#include <iomanip>
 #include <sstream>
 #include <string>
 #include <system_error>
@@ -12,6 +13,10 @@
 #include "helpers.hpp"
 #include "httplib.h"
 
+#ifdef PANDA3DS_ENABLE_OPENGL
+#include "renderer_gl/renderer_gl.hpp"
+#endif
+
 class HttpActionScreenshot : public HttpAction {
 	DeferredResponseWrapper& response;
 
@@ -67,6 +72,14 @@ class HttpActionStep : public HttpAction {
 	int getFrames() const { return frames; }
 };
 
+class HttpActionStatus : public HttpAction {
+	DeferredResponseWrapper& response;
+
+  public:
+	HttpActionStatus(DeferredResponseWrapper& response) : HttpAction(HttpActionType::Status), response(response) {}
+	DeferredResponseWrapper& getResponse() { return response; }
+};
+
 std::unique_ptr<HttpAction> HttpAction::createScreenshotAction(DeferredResponseWrapper& response) {
 	return std::make_unique<HttpActionScreenshot>(response);
 }
@@ -83,6 +96,10 @@ std::unique_ptr<HttpAction> HttpAction::createStepAction(DeferredResponseWrapper
 	return std::make_unique<HttpActionStep>(response, frames);
 }
 
+std::unique_ptr<HttpAction> HttpAction::createStatusAction(DeferredResponseWrapper& response) {
+	return std::make_unique<HttpActionStatus>(response);
+}
+
 HttpServer::HttpServer(Emulator* emulator)
 	: emulator(emulator), server(std::make_unique<httplib::Server>()), keyMap({
 																		   {"A", {HID::Keys::A}},
@@ -178,7 +195,13 @@ void HttpServer::startHttpServer() {
 		wrapper.cv.wait(lock, [&wrapper] { return wrapper.ready; });
 	});
 
-	server->Get("/status", [this](const httplib::Request&, httplib::Response& response) { response.set_content(status(), "text/plain"); });
+	// The status is put together by the emulator thread between frames, as it reads counters and caches that the emulator updates
+	server->Get("/status", [this](const httplib::Request&, httplib::Response& response) {
+		DeferredResponseWrapper wrapper(response);
+		std::unique_lock lock(wrapper.mutex);
+		pushAction(HttpAction::createStatusAction(wrapper));
+		wrapper.cv.wait(lock, [&wrapper] { return wrapper.ready; });
+	});
 
 	server->Get("/load_rom", [this](const httplib::Request& request, httplib::Response& response) {
 		auto it = request.params.find("path");
@@ -234,6 +257,35 @@ std::string HttpServer::status() {
 	stringStream << "Panda3DS\n";
 	stringStream << "Status: " << (paused ? "Paused" : "Running") << "\n";
 
+	// Per-frame profiling counters
+	stringStream << "Context switches/frame: " << emulator->kernel.getContextSwitchesPerFrame() << "\n";
+	stringStream << "Idle skips: " << emulator->kernel.getIdleSkipCount() << "\n";
+	stringStream << "Busy-wait cycles skipped: " << emulator->cpu.getSkippedBusyWaitCycles() << "\n";
+
+#ifdef PANDA3DS_ENABLE_OPENGL
+	if (emulator->getRendererType() == RendererType::OpenGL) {
+		RendererGL* renderer = static_cast<RendererGL*>(emulator->getRenderer());
+
+		auto printCache = [&](const char* name, const auto& cache) {
+			stringStream << name << " cache: " << cache.getSurfaceCount() << " surfaces, " << (cache.getUsedBytes() >> 20) << "/"
+						 << (cache.getBudget() >> 20) << " MB, hits: " << cache.getHits() << ", misses: " << cache.getMisses()
+						 << ", evictions: " << cache.getEvictions() << "\n";
+		};
+		printCache("Texture", renderer->getTextureCache());
+		printCache("Colour buffer", renderer->getColourBufferCache());
+		printCache("Depth buffer", renderer->getDepthBufferCache());
+
+		// Draws that used the ubershader because their specialized program was still being compiled in the background
+		stringStream << "Ubershader fallback draws: " << renderer->getUbershaderFallbackDraws() << "\n";
+
+		// Consecutive draws with the same state are merged into one host draw, so this is the average number of draws per batch
+		const u64 picaDraws = renderer->getPicaDraws();
+		const u64 hostDraws = renderer->getHostDraws();
+		stringStream << "Draws: " << picaDraws << " PICA, " << hostDraws << " host (merge ratio: " << std::fixed << std::setprecision(2)
+					 << (hostDraws != 0 ? double(picaDraws) / double(hostDraws) : 0.0) << ")\n";
+	}
+#endif
+
 	// TODO: This currently doesn't work for N3DS buttons
 	auto keyPressed = [](const HIDService& hid, u32 mask) { return (hid.getOldButtons() & mask) != 0; };
 	for (auto& [keyStr, value] : keyMap) {
@@ -340,6 +392,16 @@ void HttpServer::processActions() {
 				break;
 			}
 
+			case HttpActionType::Status: {
+				DeferredResponseWrapper& response = static_cast<HttpActionStatus*>(action.get())->getResponse();
+				response.inner_response.set_content(status(), "text/plain");
+
+				std::unique_lock<std::mutex> lock(response.mutex);
+				response.ready = true;
+				response.cv.notify_one();
+				break;
+			}
+
 			default: break;
 		}
 	}
@@ -16,7 +16,26 @@ bool MemoryMappedFile::open(const std::filesystem::path& path) {
 
 	filePath = path;
 	pointer = (u8*)map.data();
+	fileSize = map.size();
 	opened = true;
+	readOnly = false;
+	return true;
+}
+
+bool MemoryMappedFile::openReadOnly(const std::filesystem::path& path) {
+	std::error_code error;
+	readOnlyMap = mio::make_mmap_source(path.string(), 0, mio::map_entire_file, error);
+
+	if (error) {
+		opened = false;
+		return false;
+	}
+
+	filePath = path;
+	pointer = (u8*)readOnlyMap.data();
+	fileSize = readOnlyMap.size();
+	opened = true;
+	readOnly = true;
 	return true;
 }
 
@@ -24,8 +43,13 @@ void MemoryMappedFile::close() {
 	if (opened) {
 		opened = false;
 		pointer = nullptr; // Set the pointer to nullptr to avoid errors related to lingering pointers
+		fileSize = 0;
 
-		map.unmap();
+		if (readOnly) {
+			readOnlyMap.unmap();
+		} else {
+			map.unmap();
+		}
 	}
 }
 
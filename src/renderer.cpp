@@ -2,11 +2,21 @@
 
 #include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 Renderer::Renderer(GPU& gpu, const std::array<u32, regNum>& internalRegs, const std::array<u32, extRegNum>& externalRegs)
 	: gpu(gpu), regs(internalRegs), externalRegs(externalRegs) {}
 Renderer::~Renderer() {}
 
+void Renderer::drawVerticesIndexed(PICA::PrimType primType, std::span<const PICA::Vertex> vertices, std::span<const u16> indices) {
+	std::vector<PICA::Vertex> expanded(indices.size());
+	for (usize i = 0; i < indices.size(); i++) {
+		expanded[i] = vertices[indices[i]];
+	}
+
+	drawVertices(primType, expanded);
+}
+
 std::optional<RendererType> Renderer::typeFromString(std::string inString) {
 	// Transform to lower-case to make the setting case-insensitive
 	std::transform(inString.begin(), inString.end(), inString.begin(), [](unsigned char c) { return std::tolower(c); });
@@ -0,0 +1,197 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "busy_wait_loops.hpp"
+
+// A loop at 0x100000 closed by a BNE at 0x100008, such as
+//   ldr r1, [r0]
+//   cmp r1, #0
+//   bne 0x100000
+static constexpr u32 loopHead = 0x100000;
+static constexpr u32 loopExit = 0x10000C;
+static constexpr u32 conditionNE = 0x1;
+
+TEST_CASE("Busy-wait loops are skipped when the back-edge is taken", "[busy_wait]") {
+	BusyWaitLoops loops;
+	loops.add(loopHead, loopExit, conditionNE);
+
+	REQUIRE(loops.backEdgeTaken(loopHead, CPSR::UserMode));
+	REQUIRE(loops.backEdgeTaken(loopHead, CPSR::UserMode | CPSR::Carry));
+}
+
+TEST_CASE("Busy-wait loops aren't skipped when they exit", "[busy_wait]") {
+	BusyWaitLoops loops;
+	loops.add(loopHead, loopExit, conditionNE);
+
+	// The flag was already set, so the BNE fell through
+	REQUIRE_FALSE(loops.backEdgeTaken(loopExit, CPSR::UserMode | CPSR::Zero));
+	// Flags that fail the branch's condition mean it wasn't what brought us back to the head
+	REQUIRE_FALSE(loops.backEdgeTaken(loopHead, CPSR::UserMode | CPSR::Zero));
+	// Not a loop we know about
+	REQUIRE_FALSE(loops.backEdgeTaken(0x200000, CPSR::UserMode));
+
+	loops.clear();
+	REQUIRE_FALSE(loops.backEdgeTaken(loopHead, CPSR::UserMode));
+}
+
+TEST_CASE("Busy-wait loops ending where another one starts aren't skipped", "[busy_wait]") {
+	BusyWaitLoops loops;
+	loops.add(loopHead, loopExit, conditionNE);
+	loops.add(loopExit, loopExit + 0xC, 0xE);
+
+	// PC is at the head of the second loop, but the first loop exiting leaves it there too
+	REQUIRE_FALSE(loops.backEdgeTaken(loopExit, CPSR::UserMode));
+	REQUIRE(loops.backEdgeTaken(loopHead, CPSR::UserMode));
+}
+
+TEST_CASE("Busy-wait loop conditions follow the ARM condition codes", "[busy_wait]") {
+	struct Case {
+		u32 condition;
+		u32 flags;
+		bool passed;
+	};
+
+	static constexpr Case cases[] = {
+		{0x0, CPSR::Zero, true},                     // EQ
+		{0x2, 0, false},                             // CS
+		{0x4, CPSR::Sign, true},                     // MI
+		{0x8, CPSR::Carry | CPSR::Zero, false},      // HI
+		{0x9, CPSR::Zero, true},                     // LS
+		{0xA, CPSR::Sign | CPSR::Overflow, true},    // GE
+		{0xB, CPSR::Sign, true},                     // LT
+		{0xC, CPSR::Zero, false},                    // GT
+		{0xD, CPSR::Sign | CPSR::Overflow, false},   // LE
+		{0xE, CPSR::Zero, true},                     // AL
+	};
+
+	for (const Case& c : cases) {
+		BusyWaitLoops loops;
+		loops.add(loopHead, loopExit, c.condition);
+		REQUIRE(loops.backEdgeTaken(loopHead, c.flags) == c.passed);
+	}
+}
+
+TEST_CASE("Busy-wait loop instructions are decoded", "[busy_wait]") {
+	using Info = BusyWaitLoops::InstructionInfo;
+	auto check = [](Info info, u32 reads, u32 writes, bool isLoad) {
+		REQUIRE(info.valid);
+		REQUIRE(info.reads == reads);
+		REQUIRE(info.writes == writes);
+		REQUIRE(info.isLoad == isLoad);
+	};
+
+	check(BusyWaitLoops::decodeARM(0xE5901000), 1u << 0, 1u << 1, true);            // ldr r1, [r0]
+	check(BusyWaitLoops::decodeARM(0xE1D010B2), 1u << 0, 1u << 1, true);            // ldrh r1, [r0, #2]
+	check(BusyWaitLoops::decodeARM(0xE3510000), 1u << 1, 0, false);                 // cmp r1, #0
+	check(BusyWaitLoops::decodeARM(0xE0021003), (1u << 2) | (1u << 3), 1u << 1, false);  // and r1, r2, r3
+
+	check(BusyWaitLoops::decodeThumb(0x6801), 1u << 0, 1u << 1, true);  // ldr r1, [r0]
+	check(BusyWaitLoops::decodeThumb(0x2900), 1u << 1, 0, false);       // cmp r1, #0
+	check(BusyWaitLoops::decodeThumb(0x4011), (1u << 1) | (1u << 2), 1u << 1, false);  // ands r1, r2
+
+	// ldrne r1, [r0] / str r1, [r0] / ldr r1, [r0, #4]! / adc r2, r2, #1 / mul r1, r2, r3
+	for (u32 instruction : {0x15901000u, 0xE5801000u, 0xE5B01004u, 0xE2A22001u, 0xE0010392u}) {
+		REQUIRE_FALSE(BusyWaitLoops::decodeARM(instruction).valid);
+	}
+
+	// str r1, [r0] / adcs r1, r2 / bx lr / push {r4, lr}
+	for (u16 instruction : {u16(0x6001), u16(0x4151), u16(0x4770), u16(0xB510)}) {
+		REQUIRE_FALSE(BusyWaitLoops::decodeThumb(instruction).valid);
+	}
+}
+
+namespace {
+	// Guest code at loopHead, as read by BusyWaitLoops::detect
+	template <typename T>
+	BusyWaitLoops::CodeReader codeAt(const std::vector<T>& code) {
+		return [&code](u32 address) -> const void* {
+			const u32 index = (address - loopHead) / sizeof(T);
+			return (address >= loopHead && index < code.size()) ? &code[index] : nullptr;
+		};
+	}
+}  // namespace
+
+TEST_CASE("Busy-wait loops are detected in ARM code", "[busy_wait]") {
+	BusyWaitLoops loops;
+
+	SECTION("Polling loop") {
+		// ldr r1, [r0] / cmp r1, #0 / bne loopHead
+		const std::vector<u32> code = {0xE5901000, 0xE3510000, 0x1AFFFFFC};
+		REQUIRE(loops.detect(false, loopHead + 8, code[2], codeAt(code)));
+		REQUIRE(loops.backEdgeTaken(loopHead, CPSR::UserMode));
+	}
+
+	SECTION("Loops that carry a value between iterations") {
+		// ldr r1, [r0] / add r2, r2, #1 / cmp r1, #0 / bne loopHead
+		const std::vector<u32> code = {0xE5901000, 0xE2822001, 0xE3510000, 0x1AFFFFFB};
+		REQUIRE_FALSE(loops.detect(false, loopHead + 12, code[3], codeAt(code)));
+	}
+
+	SECTION("Loops without a load") {
+		// cmp r0, #0 / bne loopHead
+		const std::vector<u32> code = {0xE3500000, 0x1AFFFFFD};
+		REQUIRE_FALSE(loops.detect(false, loopHead + 4, code[1], codeAt(code)));
+	}
+
+	SECTION("Loops that store") {
+		// str r1, [r0] / cmp r1, #0 / bne loopHead
+		const std::vector<u32> code = {0xE5801000, 0xE3510000, 0x1AFFFFFC};
+		REQUIRE_FALSE(loops.detect(false, loopHead + 8, code[2], codeAt(code)));
+	}
+
+	SECTION("Branches that don't close a loop") {
+		const std::vector<u32> code = {0xE5901000, 0xE3510000, 0x1AFFFFFC};
+		REQUIRE_FALSE(loops.detect(false, loopHead + 8, 0x1A000000, codeAt(code)));  // bne forwards
+		REQUIRE_FALSE(loops.detect(false, loopHead + 8, 0x1BFFFFFC, codeAt(code)));  // blne loopHead
+		REQUIRE_FALSE(loops.detect(false, loopHead + 8, 0xE3510000, codeAt(code)));  // Not a branch
+	}
+
+	REQUIRE_FALSE(loops.backEdgeTaken(loopHead + 0x100, CPSR::UserMode));
+}
+
+TEST_CASE("Busy-wait loops are detected in Thumb code", "[busy_wait]") {
+	BusyWaitLoops loops;
+
+	SECTION("Polling loop") {
+		// ldr r1, [r0] / cmp r1, #0 / bne loopHead
+		const std::vector<u16> code = {0x6801, 0x2900, 0xD1FC};
+		REQUIRE(loops.detect(true, loopHead + 4, code[2], codeAt(code)));
+		REQUIRE(loops.backEdgeTaken(loopHead, CPSR::UserMode | CPSR::Thumb));
+		REQUIRE_FALSE(loops.backEdgeTaken(loopHead + 6, CPSR::UserMode | CPSR::Thumb | CPSR::Zero));
+	}
+
+	SECTION("Loops that carry a value between iterations") {
+		// ldr r1, [r0] / adds r2, #1 / cmp r1, #0 / bne loopHead
+		const std::vector<u16> code = {0x6801, 0x3201, 0x2900, 0xD1FB};
+		REQUIRE_FALSE(loops.detect(true, loopHead + 6, code[3], codeAt(code)));
+	}
+
+	SECTION("Loops that store") {
+		// str r1, [r0] / cmp r1, #0 / bne loopHead
+		const std::vector<u16> code = {0x6001, 0x2900, 0xD1FC};
+		REQUIRE_FALSE(loops.detect(true, loopHead + 4, code[2], codeAt(code)));
+	}
+
+	SECTION("Code that can't be read") {
+		const std::vector<u16> code = {};
+		REQUIRE_FALSE(loops.detect(true, loopHead + 4, 0xD1FC, codeAt(code)));
+	}
+}
+
+TEST_CASE("Busy-wait loops are forgotten when their code is invalidated", "[busy_wait]") {
+	BusyWaitLoops loops;
+	loops.add(loopHead, loopExit, conditionNE);
+	loops.add(0x200000, 0x20000C, conditionNE);
+
+	loops.invalidate(loopHead + 4, 4);
+	REQUIRE_FALSE(loops.backEdgeTaken(loopHead, CPSR::UserMode));
+	REQUIRE(loops.backEdgeTaken(0x200000, CPSR::UserMode));
+
+	// Ranges right before or after the loop don't touch it
+	loops.invalidate(0x1FF000, 0x1000);
+	loops.invalidate(0x20000C, 0x10);
+	REQUIRE(loops.backEdgeTaken(0x200000, CPSR::UserMode));
+
+	loops.invalidate(0x1FF000, 0x1001);
+	REQUIRE_FALSE(loops.backEdgeTaken(0x200000, CPSR::UserMode));
+}
@@ -0,0 +1,153 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include "memory.hpp"
+#include "scheduler.hpp"
+
+using EventType = Scheduler::EventType;
+
+// Pops every event that is due by "timestamp" and returns the user data of each in the order they fired
+static std::vector<u64> runUntil(Scheduler& scheduler, u64 timestamp) {
+	std::vector<u64> fired;
+	for (int i = 0; i < Scheduler::totalNumberOfEvents; i++) {
+		scheduler.setCallback(static_cast<EventType>(i), [&](u64, u64 data) { fired.push_back(data); });
+	}
+
+	scheduler.currentTimestamp = timestamp;
+	while (scheduler.currentTimestamp >= scheduler.nextTimestamp) {
+		scheduler.runNextEvent();
+	}
+
+	return fired;
+}
+
+TEST_CASE("Scheduler fires events in timestamp order", "[scheduler]") {
+	Scheduler scheduler;
+	scheduler.reset();
+	scheduler.removeEvent(EventType::VBlank);
+
+	scheduler.addEvent(EventType::RunDSP, 300, 3);
+	scheduler.addEvent(EventType::RunDSP, 100, 1);
+	scheduler.addEvent(EventType::SignalY2R, 200, 2);
+	scheduler.addEvent(EventType::UpdateTimers, 200, 4);  // Same timestamp as an earlier event, so it should fire after it
+
+	REQUIRE(scheduler.nextTimestamp == 100);
+	REQUIRE(runUntil(scheduler, 1000) == std::vector<u64>{1, 2, 4, 3});
+	REQUIRE(scheduler.pendingEventCount() == 1);  // Only the panic event is left
+}
+
+TEST_CASE("Scheduler cancels and reschedules events by handle", "[scheduler]") {
+	Scheduler scheduler;
+	scheduler.reset();
+	scheduler.removeEvent(EventType::VBlank);
+
+	const auto first = scheduler.addEvent(EventType::RunDSP, 100, 1);
+	const auto second = scheduler.addEvent(EventType::RunDSP, 200, 2);
+	const auto third = scheduler.addEvent(EventType::RunDSP, 300, 3);
+
+	REQUIRE(scheduler.removeEvent(first));
+	REQUIRE_FALSE(scheduler.removeEvent(first));
+	REQUIRE(scheduler.nextTimestamp == 200);
+
+	REQUIRE(scheduler.rescheduleEvent(third, 50));
+	REQUIRE(scheduler.nextTimestamp == 50);
+	REQUIRE(runUntil(scheduler, 1000) == std::vector<u64>{3, 2});
+
+	// Handles to events that already fired are stale, even if their slot gets reused
+	const auto reused = scheduler.addEvent(EventType::RunDSP, 2000, 5);
+	REQUIRE_FALSE(scheduler.isPending(second));
+	REQUIRE_FALSE(scheduler.rescheduleEvent(second, 1500));
+	REQUIRE(scheduler.isPending(reused));
+}
+
+TEST_CASE("Scheduler throughput", "[scheduler][!benchmark]") {
+	static constexpr int eventCount = 1024;
+	std::mt19937_64 rng(0x3D5);
+	std::vector<u64> timestamps(eventCount);
+	for (auto& timestamp : timestamps) {
+		timestamp = rng() % 1'000'000;
+	}
+
+	Scheduler scheduler;
+	scheduler.reset();
+	scheduler.setCallback(EventType::RunDSP, [](u64, u64) {});
+
+	BENCHMARK("Add + pop") {
+		for (u64 timestamp : timestamps) {
+			scheduler.addEvent(EventType::RunDSP, timestamp);
+		}
+
+		for (int i = 0; i < eventCount; i++) {
+			scheduler.runNextEvent();
+		}
+		return scheduler.nextTimestamp;
+	};
+
+	BENCHMARK("Add + cancel") {
+		std::vector<Scheduler::EventHandle> handles;
+		handles.reserve(eventCount);
+		for (u64 timestamp : timestamps) {
+			handles.push_back(scheduler.addEvent(EventType::RunDSP, timestamp));
+		}
+
+		for (auto handle : handles) {
+			scheduler.removeEvent(handle);
+		}
+		return scheduler.nextTimestamp;
+	};
+
+	BENCHMARK("Reschedule") {
+		std::vector<Scheduler::EventHandle> handles;
+		handles.reserve(eventCount);
+		for (u64 timestamp : timestamps) {
+			handles.push_back(scheduler.addEvent(EventType::RunDSP, timestamp));
+		}
+
+		for (int i = 0; i < eventCount; i++) {
+			scheduler.rescheduleEvent(handles[i], timestamps[eventCount - 1 - i]);
+		}
+
+		for (auto handle : handles) {
+			scheduler.removeEvent(handle);
+		}
+		return scheduler.nextTimestamp;
+	};
+}
+
+// Guest exclusive writes, as a compare-exchange on the memory backing the address versus the read, compare and write through the memory
+// handlers that MemoryWriteExclusive32 used to do
+TEST_CASE("Exclusive write throughput", "[memory][!benchmark]") {
+	static constexpr int writeCount = 1024;
+	static constexpr u32 vaddr = VirtualAddrs::TLSBase;
+
+	u64 ticks = 0;
+	EmulatorConfig config(std::filesystem::temp_directory_path() / "AlberTests.toml");
+	Memory mem(ticks, config);
+	mem.reset();
+
+	mem.write32(vaddr, 0);
+	REQUIRE(mem.exclusiveWrite<u32>(vaddr, 1, 0));
+	REQUIRE_FALSE(mem.exclusiveWrite<u32>(vaddr, 2, 0));
+	REQUIRE(mem.read32(vaddr) == 1);
+
+	BENCHMARK("Compare-exchange") {
+		mem.write32(vaddr, 0);
+		for (u32 i = 0; i < writeCount; i++) {
+			mem.exclusiveWrite<u32>(vaddr, i + 1, i);
+		}
+		return mem.read32(vaddr);
+	};
+
+	BENCHMARK("Memory handlers") {
+		mem.write32(vaddr, 0);
+		for (u32 i = 0; i < writeCount; i++) {
+			if (mem.read32(vaddr) == i) {
+				mem.write32(vaddr, i + 1);
+			}
+		}
+		return mem.read32(vaddr);
+	};
+}
@@ -0,0 +1,51 @@
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "PICA/shader_worker_pool.hpp"
+
+// Runs a job over [0, count) and returns how many times each element was visited
+static std::vector<int> visitAll(ShaderWorkerPool& pool, u32 count) {
+	std::vector<std::atomic<int>> visits(count);
+	pool.run(count, [&](u32 worker, u32 begin, u32 end) {
+		REQUIRE(worker < pool.getWorkerCount());
+		for (u32 i = begin; i < end; i++) {
+			visits[i]++;
+		}
+	});
+
+	std::vector<int> result;
+	for (auto& v : visits) {
+		result.push_back(v.load());
+	}
+	return result;
+}
+
+TEST_CASE("Shader worker pool visits every element exactly once", "[shader_worker_pool]") {
+	ShaderWorkerPool pool;
+	pool.start(4);
+	REQUIRE(pool.getWorkerCount() == 4);
+
+	// Include counts smaller than the worker count and counts that don't divide evenly between workers
+	for (u32 count : {0u, 1u, 3u, 4u, 1001u, 30000u}) {
+		REQUIRE(visitAll(pool, count) == std::vector<int>(count, 1));
+	}
+}
+
+TEST_CASE("Shader worker pool can be restarted with a different worker count", "[shader_worker_pool]") {
+	ShaderWorkerPool pool;
+	REQUIRE(visitAll(pool, 100) == std::vector<int>(100, 1));  // A pool with no threads runs everything on the caller
+
+	pool.start(3);
+	REQUIRE(visitAll(pool, 100) == std::vector<int>(100, 1));
+
+	pool.start(8);
+	REQUIRE(pool.getWorkerCount() == 8);
+	for (int i = 0; i < 50; i++) {
+		REQUIRE(visitAll(pool, 257) == std::vector<int>(257, 1));
+	}
+
+	pool.stop();
+	REQUIRE_FALSE(pool.isRunning());
+	REQUIRE(visitAll(pool, 10) == std::vector<int>(10, 1));
+}
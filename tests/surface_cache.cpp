@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "renderer_gl/surface_cache.hpp"
+
+namespace {
+	// A surface with one byte per pixel, whose contents stand in for what the GPU rendered to it. Like the GL texture of a real surface,
+	// they're lost when the surface is freed
+	struct TestSurface {
+		u32 location;
+		std::array<u32, 2> size;
+		bool valid;
+		Interval<u32> range;
+		std::vector<u8> contents;
+
+		TestSurface(u32 location, u32 width, u32 height, u8 value)
+			: location(location), size({width, height}), valid(true), range(location, location + width * height), contents(width * height, value) {}
+
+		void allocate() {}
+		void free() {
+			valid = false;
+			contents.clear();
+		}
+
+		bool matches(TestSurface& other) { return location == other.location && size == other.size; }
+	};
+
+	// Host memory the cache charges for a surface
+	constexpr usize hostSize(u32 width, u32 height) { return usize(width) * height * 4; }
+}  // namespace
+
+TEST_CASE("Surface cache hands surfaces to the remove callback before dropping them", "[surface_cache]") {
+	std::vector<u8> memory(0x4000, 0);
+	std::vector<u32> removed;
+
+	SurfaceCache<TestSurface> cache;
+	cache.setRemoveCallback([&](TestSurface& surface) {
+		REQUIRE(surface.valid);
+		std::copy(surface.contents.begin(), surface.contents.end(), memory.begin() + surface.location);
+		removed.push_back(surface.location);
+	});
+
+	SECTION("Evicted surfaces") {
+		cache.setBudget(hostSize(32, 32) * 2);
+		cache.add(TestSurface(0x0000, 32, 32, 0x11));
+		cache.add(TestSurface(0x1000, 32, 32, 0x22));
+
+		// Use the first surface so that the second one is the least recently used
+		REQUIRE(cache.findFromAddress(0x0000).has_value());
+		cache.add(TestSurface(0x2000, 32, 32, 0x33));
+
+		REQUIRE(cache.getEvictions() == 1);
+		REQUIRE(removed == std::vector<u32>{0x1000});
+		REQUIRE(std::all_of(memory.begin() + 0x1000, memory.begin() + 0x1400, [](u8 value) { return value == 0x22; }));
+		REQUIRE(std::all_of(memory.begin(), memory.begin() + 0x400, [](u8 value) { return value == 0; }));
+		REQUIRE(!cache.probeAddress(0x1000).has_value());
+
+		cache.add(TestSurface(0x3000, 32, 32, 0x44));
+		REQUIRE(removed == std::vector<u32>{0x1000, 0x0000});
+		REQUIRE(std::all_of(memory.begin(), memory.begin() + 0x400, [](u8 value) { return value == 0x11; }));
+	}
+
+	SECTION("Surfaces covered by a new one") {
+		cache.add(TestSurface(0x1100, 16, 16, 0x55));
+		cache.add(TestSurface(0x3000, 16, 16, 0x66));
+		cache.add(TestSurface(0x1000, 32, 32, 0x77));
+
+		REQUIRE(cache.getEvictions() == 0);
+		REQUIRE(removed == std::vector<u32>{0x1100});
+		REQUIRE(std::all_of(memory.begin() + 0x1100, memory.begin() + 0x1200, [](u8 value) { return value == 0x55; }));
+		REQUIRE(cache.getSurfaceCount() == 2);
+	}
+
+	SECTION("Not on reset") {
+		cache.add(TestSurface(0x0000, 16, 16, 0x11));
+		cache.reset();
+		REQUIRE(removed.empty());
+	}
+}
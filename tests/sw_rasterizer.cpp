@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <vector>
+
+#include "PICA/pixels.hpp"
+#include "renderer_sw/rasterizer.hpp"
+#include "renderer_sw/transfer_engine.hpp"
+
+using PICA::PrimType;
+using Pixel = std::array<u8, 4>;
+
+static constexpr u32 fbWidth = 64;
+static constexpr u32 fbHeight = 64;
+
+// The position is given in normalized device coordinates and multiplied by w
+static PICA::Vertex makeVertex(float x, float y, float z, std::array<float, 4> colour, float w = 1.0f) {
+	PICA::Vertex vertex = {};
+	const float position[4] = {x * w, y * w, z * w, w};
+
+	for (int i = 0; i < 4; i++) {
+		vertex.s.positions[i] = Floats::f24::fromFloat32(position[i]);
+		vertex.s.colour[i] = Floats::f24::fromFloat32(colour[i]);
+	}
+	return vertex;
+}
+
+// State that draws the vertex colour over the whole framebuffer, with every register we don't set left at 0
+static SoftwareRasterizer::DrawState makeState() {
+	static const std::array<u32, 0x300> emptyRegs = {};
+	SoftwareRasterizer::DrawState state = SoftwareRasterizer::DrawState::fromRegs(emptyRegs);
+	state.viewportHalfWidth = fbWidth / 2.0f;
+	state.viewportHalfHeight = fbHeight / 2.0f;
+	state.depthScale = -1.0f;
+	state.depthColourMask = 0xf00;  // Write every colour channel, with the depth test disabled
+	state.logicOp = 3;              // Copy the fragment colour
+	return state;
+}
+
+// Triangle strip covering the framebuffer from "left" to "right" in normalized device coordinates, over its whole height
+static std::vector<PICA::Vertex> makeRect(float left, float right, float z, std::array<float, 4> colour) {
+	return {
+		makeVertex(left, -1, z, colour),
+		makeVertex(right, -1, z, colour),
+		makeVertex(left, 1, z, colour),
+		makeVertex(right, 1, z, colour),
+	};
+}
+
+// Read back pixel (x, y) of an RGBA8 colour buffer, where y = 0 is the bottom row like in the rasterizer's window coordinates
+static Pixel readPixel(const std::vector<u8>& colour, u32 x, u32 y) {
+	return PICA::decodeColour(PICA::ColorFmt::RGBA8, &colour[PICA::tiledPixelIndex(x, fbHeight - 1 - y, fbWidth) * 4]);
+}
+
+static u32 readDepth24(const std::vector<u8>& depth, u32 x, u32 y) {
+	const u8* pixel = &depth[PICA::tiledPixelIndex(x, fbHeight - 1 - y, fbWidth) * 4];
+	return pixel[0] | (u32(pixel[1]) << 8) | (u32(pixel[2]) << 16);
+}
+
+static u8 readStencil(const std::vector<u8>& depth, u32 x, u32 y) { return depth[PICA::tiledPixelIndex(x, fbHeight - 1 - y, fbWidth) * 4 + 3]; }
+
+TEST_CASE("Software rasterizer covers shared edges exactly once", "[sw_rasterizer]") {
+	std::vector<u8> colour(fbWidth * fbHeight * 4, 0);
+	SoftwareRasterizer rasterizer;
+	rasterizer.setFramebuffer({.colour = colour.data(), .width = fbWidth, .height = fbHeight});
+
+	// Invert the destination, so that any pixel drawn twice goes back to 0
+	SoftwareRasterizer::DrawState state = makeState();
+	state.logicOp = 7;
+	const std::array<float, 4> white = {1.0f, 1.0f, 1.0f, 1.0f};
+
+	SECTION("Quad") {
+		const std::vector<PICA::Vertex> quad = {
+			makeVertex(-1, -1, -0.5f, white),
+			makeVertex(1, -1, -0.5f, white),
+			makeVertex(-1, 1, -0.5f, white),
+			makeVertex(1, 1, -0.5f, white),
+		};
+		rasterizer.submitTriangles(state, PrimType::TriangleStrip, quad);
+	}
+
+	SECTION("Clipped triangle") {
+		// Clipping turns the triangle into a polygon, which is split back into triangles that share edges
+		const std::vector<PICA::Vertex> triangle = {
+			makeVertex(-3, -3, -0.5f, white),
+			makeVertex(5, -3, -0.5f, white),
+			makeVertex(-3, 5, -0.5f, white),
+		};
+		rasterizer.submitTriangles(state, PrimType::TriangleList, triangle);
+	}
+
+	rasterizer.flush();
+	REQUIRE(std::all_of(colour.begin(), colour.end(), [](u8 value) { return value == 0xff; }));
+}
+
+TEST_CASE("Software rasterizer output doesn't depend on the worker count", "[sw_rasterizer]") {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coordinate(-1.5f, 1.5f);
+	std::uniform_real_distribution<float> depth(-1.0f, 0.0f);
+	std::uniform_real_distribution<float> channel(0.0f, 1.0f);
+
+	std::vector<PICA::Vertex> vertices;
+	for (int i = 0; i < 300 * 3; i++) {
+		vertices.push_back(makeVertex(coordinate(rng), coordinate(rng), depth(rng), {channel(rng), channel(rng), channel(rng), channel(rng)}));
+	}
+
+	// Overlapping triangles with a depth test and alpha blending, so that the result depends on the order they're drawn in
+	SoftwareRasterizer::DrawState state = makeState();
+	state.depthColourMask = 0x1f41;  // Depth test with "less than", depth writes and colour writes
+	state.depthStencilWrite = true;
+	state.colourOperation = 1 << 8;
+	state.blendFunc = (7 << 20) | (6 << 16) | (1 << 24);  // Source alpha and one minus source alpha for RGB, source only for alpha
+
+	auto render = [&](u32 workerCount) {
+		std::vector<u8> colour(fbWidth * fbHeight * 4, 0);
+		std::vector<u8> depthBuffer(fbWidth * fbHeight * 4, 0xff);
+		SoftwareRasterizer rasterizer;
+		rasterizer.start(workerCount);
+		rasterizer.setFramebuffer({
+			.colour = colour.data(),
+			.depth = depthBuffer.data(),
+			.depthFormat = PICA::DepthFmt::Depth24Stencil8,
+			.width = fbWidth,
+			.height = fbHeight,
+		});
+
+		rasterizer.submitTriangles(state, PrimType::TriangleList, vertices);
+		rasterizer.flush();
+
+		colour.insert(colour.end(), depthBuffer.begin(), depthBuffer.end());
+		return colour;
+	};
+
+	const auto reference = render(1);
+	REQUIRE(std::any_of(reference.begin(), reference.end(), [](u8 value) { return value != 0 && value != 0xff; }));
+	REQUIRE(render(4) == reference);
+}
+
+TEST_CASE("Software rasterizer interpolates attributes with perspective correction", "[sw_rasterizer]") {
+	std::vector<u8> colour(fbWidth * fbHeight * 4, 0);
+	SoftwareRasterizer rasterizer;
+	rasterizer.setFramebuffer({.colour = colour.data(), .width = fbWidth, .height = fbHeight});
+
+	// Red goes from 0 on the left edge, where w = 1, to 1 on the right edge, where w = 3
+	const std::array<float, 4> black = {0.0f, 0.0f, 0.0f, 1.0f};
+	const std::array<float, 4> red = {1.0f, 0.0f, 0.0f, 1.0f};
+	const std::vector<PICA::Vertex> quad = {
+		makeVertex(-1, -1, -0.5f, black, 1.0f),
+		makeVertex(1, -1, -0.5f, red, 3.0f),
+		makeVertex(-1, 1, -0.5f, black, 1.0f),
+		makeVertex(1, 1, -0.5f, red, 3.0f),
+	};
+	rasterizer.submitTriangles(makeState(), PrimType::TriangleStrip, quad);
+	rasterizer.flush();
+
+	// At a fraction s of the way across the screen, red is s / (3 - 2s). Interpolating in screen space would give 130 in the middle
+	for (u32 y : {0u, 31u, 63u}) {
+		REQUIRE(readPixel(colour, 0, y) == Pixel{1, 0, 0, 255});
+		REQUIRE(readPixel(colour, 16, y) == Pixel{26, 0, 0, 255});
+		REQUIRE(readPixel(colour, 32, y) == Pixel{65, 0, 0, 255});
+		REQUIRE(readPixel(colour, 48, y) == Pixel{130, 0, 0, 255});
+		REQUIRE(readPixel(colour, 63, y) == Pixel{249, 0, 0, 255});
+	}
+}
+
+TEST_CASE("Software rasterizer runs TEV combiners", "[sw_rasterizer]") {
+	std::vector<u8> colour(fbWidth * fbHeight * 4, 0);
+	SoftwareRasterizer rasterizer;
+	rasterizer.setFramebuffer({.colour = colour.data(), .width = fbWidth, .height = fbHeight});
+
+	// Stage 0 multiplies the constant colour by one minus the vertex colour, then doubles the RGB result. Alpha is multiplied without inverting
+	SoftwareRasterizer::DrawState state = makeState();
+	state.texEnv[0] = {
+		0x000E000E,  // Constant colour and primary colour, for both RGB and alpha
+		0x10,        // The primary colour's RGB is inverted
+		0x10001,     // Modulate
+		0x80FF4020,  // R = 0x20, G = 0x40, B = 0xFF, A = 0x80
+		0x1,         // Scale RGB by 2
+	};
+	// The other stages pass the previous stage's output through
+	for (int i = 1; i < 6; i++) {
+		state.texEnv[i] = {0x000F000F, 0, 0, 0, 0};
+	}
+
+	rasterizer.submitTriangles(state, PrimType::TriangleStrip, makeRect(-1, 1, -0.5f, {0.5f, 0.75f, 0.25f, 0.5f}));
+	rasterizer.flush();
+
+	// R = 0x20 * 0.5 * 2, G = 0x40 * 0.25 * 2, B = 0xFF * 0.75 * 2 clamped to 0xFF, A = 0x80 * 0.5
+	REQUIRE(readPixel(colour, 0, 0) == Pixel{0x20, 0x20, 0xFF, 0x40});
+	REQUIRE(readPixel(colour, 40, 20) == Pixel{0x20, 0x20, 0xFF, 0x40});
+	REQUIRE(readPixel(colour, 63, 63) == Pixel{0x20, 0x20, 0xFF, 0x40});
+}
+
+TEST_CASE("Software rasterizer applies depth and stencil operations", "[sw_rasterizer]") {
+	std::vector<u8> colour(fbWidth * fbHeight * 4, 0);
+	// Depth cleared to the far plane and stencil cleared to 0
+	std::vector<u8> depth(fbWidth * fbHeight * 4, 0);
+	for (usize i = 0; i < depth.size(); i += 4) {
+		depth[i] = depth[i + 1] = depth[i + 2] = 0xff;
+	}
+
+	SoftwareRasterizer rasterizer;
+	rasterizer.setFramebuffer({
+		.colour = colour.data(),
+		.depth = depth.data(),
+		.depthFormat = PICA::DepthFmt::Depth24Stencil8,
+		.width = fbWidth,
+		.height = fbHeight,
+	});
+
+	SoftwareRasterizer::DrawState state = makeState();
+	state.depthColourMask = 0x1f41;  // Depth test with "less than", depth writes and colour writes
+	state.depthStencilWrite = true;
+
+	// The left half passes both tests and replaces the stencil with 1
+	state.stencilTest = 0xff01ff11;  // Always pass, reference 1
+	state.stencilOp = 2 << 8;
+	rasterizer.submitTriangles(state, PrimType::TriangleStrip, makeRect(-1, 0, -0.25f, {1.0f, 0.0f, 0.0f, 1.0f}));
+
+	// Fails the stencil test on the left half, where the stencil is incremented. The right half passes and is drawn
+	state.stencilTest = 0xff01ff31;  // Pass if not equal to 1
+	state.stencilOp = 3;
+	rasterizer.submitTriangles(state, PrimType::TriangleStrip, makeRect(-1, 1, -0.5f, {0.0f, 1.0f, 0.0f, 1.0f}));
+
+	// Behind everything, so it fails the depth test everywhere and inverts the stencil
+	state.stencilTest = 0xff00ff11;
+	state.stencilOp = 5 << 4;
+	rasterizer.submitTriangles(state, PrimType::TriangleStrip, makeRect(-1, 1, -0.75f, {0.0f, 0.0f, 1.0f, 1.0f}));
+	rasterizer.flush();
+
+	for (u32 y : {0u, 40u}) {
+		REQUIRE(readPixel(colour, 8, y) == Pixel{255, 0, 0, 255});
+		REQUIRE(readDepth24(depth, 8, y) == 0x3fffff);  // 0.25 * 0xffffff
+		REQUIRE(readStencil(depth, 8, y) == 0xfd);      // ~(1 + 1)
+
+		REQUIRE(readPixel(colour, 48, y) == Pixel{0, 255, 0, 255});
+		REQUIRE(readDepth24(depth, 48, y) == 0x7fffff);  // 0.5 * 0xffffff
+		REQUIRE(readStencil(depth, 48, y) == 0xff);      // ~0
+	}
+}
+
+TEST_CASE("Software rasterizer blends with the colour buffer", "[sw_rasterizer]") {
+	std::vector<u8> colour(fbWidth * fbHeight * 4);
+	for (usize i = 0; i < colour.size(); i += 4) {
+		PICA::encodeColour(PICA::ColorFmt::RGBA8, &colour[i], {200, 100, 0, 255});
+	}
+
+	SoftwareRasterizer rasterizer;
+	rasterizer.setFramebuffer({.colour = colour.data(), .width = fbWidth, .height = fbHeight});
+	SoftwareRasterizer::DrawState state = makeState();
+	const std::array<float, 4> source = {1.0f, 0.0f, 0.5f, 0.25f};
+	Pixel expected;
+
+	SECTION("Alpha blending") {
+		state.colourOperation = 1 << 8;
+		state.blendFunc = (1 << 24) | (7 << 20) | (6 << 16);  // Source alpha and one minus source alpha for RGB, source only for alpha
+		// R = 255 * 0.25 + 200 * 0.75, G = 100 * 0.75, B = 128 * 0.25, A = 64
+		expected = {214, 75, 32, 64};
+	}
+
+	SECTION("Logic op") {
+		state.logicOp = 11;  // XOR
+		expected = {255 ^ 200, 0 ^ 100, 128 ^ 0, 64 ^ 255};
+	}
+
+	rasterizer.submitTriangles(state, PrimType::TriangleStrip, makeRect(-1, 1, -0.5f, source));
+	rasterizer.flush();
+
+	REQUIRE(readPixel(colour, 0, 0) == expected);
+	REQUIRE(readPixel(colour, 33, 17) == expected);
+}
+
+TEST_CASE("Memory fills repeat the value with the selected width", "[sw_rasterizer]") {
+	std::vector<u8> buffer(11, 0xEE);
+
+	SECTION("16-bit") {
+		TransferEngine::fill(buffer.data(), 10, 0x11223344, 0);
+		REQUIRE(buffer == std::vector<u8>{0x44, 0x33, 0x44, 0x33, 0x44, 0x33, 0x44, 0x33, 0x44, 0x33, 0xEE});
+	}
+
+	SECTION("24-bit") {
+		// 10 bytes don't fit a whole number of 24-bit values, and the leftover byte isn't written
+		TransferEngine::fill(buffer.data(), 10, 0x11223344, 1 << 8);
+		REQUIRE(buffer == std::vector<u8>{0x44, 0x33, 0x22, 0x44, 0x33, 0x22, 0x44, 0x33, 0x22, 0xEE, 0xEE});
+	}
+
+	SECTION("32-bit") {
+		TransferEngine::fill(buffer.data(), 8, 0x11223344, 1 << 9);
+		REQUIRE(buffer == std::vector<u8>{0x44, 0x33, 0x22, 0x11, 0x44, 0x33, 0x22, 0x11, 0xEE, 0xEE, 0xEE});
+	}
+}
+
+TEST_CASE("Display transfers convert layout, format and scale", "[sw_rasterizer]") {
+	// A tiled 16x8 RGBA8 surface where each pixel holds its own coordinates
+	static constexpr u32 width = 16;
+	static constexpr u32 height = 8;
+	std::vector<u8> input(width * height * 4);
+	for (u32 y = 0; y < height; y++) {
+		for (u32 x = 0; x < width; x++) {
+			PICA::encodeColour(PICA::ColorFmt::RGBA8, &input[PICA::tiledPixelIndex(x, y, width) * 4], {u8(x * 16), u8(y * 16), 0x80, 0xff});
+		}
+	}
+
+	SECTION("Tiled RGBA8 to linear RGB8") {
+		const auto transfer = TransferEngine::DisplayTransfer::fromRegs((height << 16) | width, (height << 16) | width, 1 << 12);
+		REQUIRE(transfer.outputBytes() == width * height * 3);
+
+		std::vector<u8> output(transfer.outputBytes());
+		transfer.run(input.data(), output.data());
+
+		// RGB8 is stored as B, G, R
+		REQUIRE(output[(5 * width + 3) * 3 + 0] == 0x80);
+		REQUIRE(output[(5 * width + 3) * 3 + 1] == 0x50);
+		REQUIRE(output[(5 * width + 3) * 3 + 2] == 0x30);
+		REQUIRE(output[(7 * width + 15) * 3 + 2] == 0xf0);
+	}
+
+	SECTION("Flipped and downscaled in both directions") {
+		const auto transfer = TransferEngine::DisplayTransfer::fromRegs((height << 16) | width, (height << 16) | width, (2 << 24) | 1);
+		REQUIRE(transfer.outputWidth == width / 2);
+		REQUIRE(transfer.outputHeight == height / 2);
+
+		std::vector<u8> output(transfer.outputBytes());
+		transfer.run(input.data(), output.data());
+
+		// Each output pixel averages a 2x2 block, so its red is (32x + 32x + 16) / 2 and its green is (32y + 32y + 16) / 2
+		for (u32 y = 0; y < height / 2; y++) {
+			for (u32 x = 0; x < width / 2; x++) {
+				const u32 flippedY = height / 2 - 1 - y;
+				const Pixel pixel = PICA::decodeColour(PICA::ColorFmt::RGBA8, &output[(flippedY * width / 2 + x) * 4]);
+				REQUIRE(pixel == Pixel{u8(x * 32 + 8), u8(y * 32 + 8), 0x80, 0xff});
+			}
+		}
+	}
+}
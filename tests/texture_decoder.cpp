@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <array>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PICA/texture_decode_queue.hpp"
+#include "PICA/texture_decoder.hpp"
+#include "colour.hpp"
+
+using namespace Helpers;
+using PICA::TextureFmt;
+
+static constexpr std::array<TextureFmt, 14> allFormats = {
+	TextureFmt::RGBA8, TextureFmt::RGB8, TextureFmt::RGBA5551, TextureFmt::RGB565, TextureFmt::RGBA4, TextureFmt::IA8,  TextureFmt::RG8,
+	TextureFmt::I8,    TextureFmt::A8,   TextureFmt::IA4,      TextureFmt::I4,     TextureFmt::A4,    TextureFmt::ETC1, TextureFmt::ETC1A4,
+};
+
+// Straightforward per-texel decoder, used as a reference for the tile decoder
+namespace Reference {
+	static u32 rgba(u32 r, u32 g, u32 b, u32 a) { return r | (g << 8) | (b << 16) | (a << 24); }
+
+	// Index of texel (u, v) in the texture, counting in texels
+	static u32 swizzledIndex(u32 u, u32 v, u32 width) {
+		static constexpr u32 xOffsets[] = {0, 1, 4, 5, 16, 17, 20, 21};
+		static constexpr u32 yOffsets[] = {0, 2, 8, 10, 32, 34, 40, 42};
+		return (u & ~7) * 8 + (v & ~7) * width + xOffsets[u & 7] + yOffsets[v & 7];
+	}
+
+	static u32 decodeETC(u32 u, u32 v, u32 width, bool hasAlpha, const u8* data) {
+		static constexpr u32 modifiers[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+		const u32 blockSize = hasAlpha ? 16 : 8;
+		const u32 tileOffset = ((u & ~7) * 8 + (v & ~7) * width) * blockSize / 16;
+		const u32 blockIndex = ((u & 7) / 4) + 2 * ((v & 7) / 4);
+		const u8* block = data + tileOffset + blockIndex * blockSize;
+		u &= 3;
+		v &= 3;
+
+		u64 alphaData = ~0ull;
+		u64 colourData;
+		if (hasAlpha) {
+			std::memcpy(&alphaData, block, sizeof(u64));
+			block += sizeof(u64);
+		}
+		std::memcpy(&colourData, block, sizeof(u64));
+
+		const u32 texelIndex = u * 4 + v;
+		const u32 alpha = Colour::convert4To8Bit((alphaData >> (4 * texelIndex)) & 0xf);
+		const bool secondBlock = (getBit<32>(colourData) ? v : u) >= 2;
+
+		s32 r, g, b;
+		if (getBit<33>(colourData)) {
+			r = getBits<59, 5, s32>(colourData);
+			g = getBits<51, 5, s32>(colourData);
+			b = getBits<43, 5, s32>(colourData);
+			if (secondBlock) {
+				r += s32(getBits<56, 3, u32>(colourData) << 29) >> 29;
+				g += s32(getBits<48, 3, u32>(colourData) << 29) >> 29;
+				b += s32(getBits<40, 3, u32>(colourData) << 29) >> 29;
+			}
+			r = Colour::convert5To8Bit(r);
+			g = Colour::convert5To8Bit(g);
+			b = Colour::convert5To8Bit(b);
+		} else {
+			r = Colour::convert4To8Bit(secondBlock ? getBits<56, 4, u8>(colourData) : getBits<60, 4, u8>(colourData));
+			g = Colour::convert4To8Bit(secondBlock ? getBits<48, 4, u8>(colourData) : getBits<52, 4, u8>(colourData));
+			b = Colour::convert4To8Bit(secondBlock ? getBits<40, 4, u8>(colourData) : getBits<44, 4, u8>(colourData));
+		}
+
+		const u32 table = secondBlock ? getBits<34, 3, u32>(colourData) : getBits<37, 3, u32>(colourData);
+		s32 modifier = modifiers[table][(colourData >> texelIndex) & 1];
+		if ((colourData >> (16 + texelIndex)) & 1) {
+			modifier = -modifier;
+		}
+
+		return rgba(std::clamp(r + modifier, 0, 255), std::clamp(g + modifier, 0, 255), std::clamp(b + modifier, 0, 255), alpha);
+	}
+
+	static u32 decodeTexel(TextureFmt format, u32 u, u32 v, u32 width, const u8* data) {
+		const u32 index = swizzledIndex(u, v, width);
+		const u8* texel8 = data + index;
+		const u8* texel16 = data + index * 2;
+		// Only read the texel with the size of the format, so that we don't read out of bounds
+		const auto read16 = [&]() { return u16(texel16[0]) | (u16(texel16[1]) << 8); };
+		const auto readNibble = [&]() { return Colour::convert4To8Bit((data[index / 2] >> ((u & 1) * 4)) & 0xf); };
+
+		switch (format) {
+			case TextureFmt::RGBA8: {
+				const u8* p = data + index * 4;
+				return rgba(p[3], p[2], p[1], p[0]);
+			}
+			case TextureFmt::RGB8: {
+				const u8* p = data + index * 3;
+				return rgba(p[2], p[1], p[0], 0xff);
+			}
+			case TextureFmt::RGBA5551: {
+				const u16 texel = read16();
+				return rgba(
+					Colour::convert5To8Bit(getBits<11, 5, u8>(texel)), Colour::convert5To8Bit(getBits<6, 5, u8>(texel)),
+					Colour::convert5To8Bit(getBits<1, 5, u8>(texel)), getBit<0>(texel) ? 0xff : 0
+				);
+			}
+			case TextureFmt::RGB565: {
+				const u16 texel = read16();
+				return rgba(
+					Colour::convert5To8Bit(getBits<11, 5, u8>(texel)), Colour::convert6To8Bit(getBits<5, 6, u8>(texel)),
+					Colour::convert5To8Bit(getBits<0, 5, u8>(texel)), 0xff
+				);
+			}
+			case TextureFmt::RGBA4: {
+				const u16 texel = read16();
+				return rgba(
+					Colour::convert4To8Bit(getBits<12, 4, u8>(texel)), Colour::convert4To8Bit(getBits<8, 4, u8>(texel)),
+					Colour::convert4To8Bit(getBits<4, 4, u8>(texel)), Colour::convert4To8Bit(getBits<0, 4, u8>(texel))
+				);
+			}
+			case TextureFmt::IA8: return rgba(texel16[1], texel16[1], texel16[1], texel16[0]);
+			case TextureFmt::RG8: return rgba(texel16[1], texel16[0], 0, 0xff);
+			case TextureFmt::I8: return rgba(*texel8, *texel8, *texel8, 0xff);
+			case TextureFmt::A8: return rgba(0, 0, 0, *texel8);
+			case TextureFmt::IA4: {
+				const u8 intensity = Colour::convert4To8Bit(*texel8 >> 4);
+				return rgba(intensity, intensity, intensity, Colour::convert4To8Bit(*texel8 & 0xf));
+			}
+			case TextureFmt::I4: {
+				const u8 intensity = readNibble();
+				return rgba(intensity, intensity, intensity, 0xff);
+			}
+			case TextureFmt::A4: return rgba(0, 0, 0, readNibble());
+			case TextureFmt::ETC1: return decodeETC(u, v, width, false, data);
+			case TextureFmt::ETC1A4: return decodeETC(u, v, width, true, data);
+			default: return 0;
+		}
+	}
+}  // namespace Reference
+
+static std::vector<u8> randomTexture(TextureFmt format, u32 width, u32 height) {
+	std::mt19937 rng(static_cast<u32>(format) * 1234 + width);
+	std::vector<u8> data((width / 8) * (height / 8) * PICA::TextureDecoder::tileSize(format));
+	std::generate(data.begin(), data.end(), [&]() { return u8(rng()); });
+	return data;
+}
+
+TEST_CASE("Texture decoder matches the per-texel reference", "[texture_decoder]") {
+	// Use a non-square texture so that mixing up the width and height shows up
+	constexpr u32 width = 64;
+	constexpr u32 height = 24;
+
+	for (TextureFmt format : allFormats) {
+		INFO("Format: " << PICA::textureFormatToString(format));
+		const std::vector<u8> data = randomTexture(format, width, height);
+		std::vector<u32> decoded(width * height);
+		PICA::TextureDecoder::decode(format, width, height, data, decoded);
+
+		for (u32 v = 0; v < height; v++) {
+			for (u32 u = 0; u < width; u++) {
+				if (decoded[v * width + u] != Reference::decodeTexel(format, u, v, width, data.data())) {
+					FAIL("Mismatch at texel (" << u << ", " << v << ")");
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("Texture decoder benchmarks", "[texture_decoder][.benchmark]") {
+	constexpr u32 width = 256;
+	constexpr u32 height = 256;
+	std::vector<u32> decoded(width * height);
+
+	for (TextureFmt format : allFormats) {
+		const std::vector<u8> data = randomTexture(format, width, height);
+
+		BENCHMARK(std::string("Decode 256x256 ") + PICA::textureFormatToString(format)) {
+			PICA::TextureDecoder::decode(format, width, height, data, decoded);
+			return decoded[0];
+		};
+	}
+}
+
+TEST_CASE("Texture decode queue returns the decoded texture", "[texture_decoder]") {
+	constexpr u32 width = 32;
+	constexpr u32 height = 16;
+	const std::vector<u8> data = randomTexture(TextureFmt::RGB565, width, height);
+	std::vector<u32> expected(width * height);
+	PICA::TextureDecoder::decode(TextureFmt::RGB565, width, height, data, expected);
+
+	TextureDecodeQueue queue;
+	REQUIRE(queue.take(0x1000, TextureFmt::RGB565, width, height) == nullptr);
+
+	// Check both with and without worker threads, in which case take() decodes the texture itself
+	for (u32 threadCount : {0u, 2u}) {
+		queue.start(threadCount);
+		queue.submit(0x1000, TextureFmt::RGB565, width, height, 42, data);
+		queue.submit(0x1000, TextureFmt::RGB565, width, height, 43, data);  // Duplicates of a queued texture are ignored
+		queue.submit(0x2000, TextureFmt::RGB565, width, height, 44, data);
+		REQUIRE(queue.contains(0x1000, TextureFmt::RGB565, width, height));
+		REQUIRE_FALSE(queue.contains(0x1000, TextureFmt::RGBA4, width, height));
+
+		auto job = queue.take(0x1000, TextureFmt::RGB565, width, height);
+		REQUIRE(job != nullptr);
+		REQUIRE(job->writeStamp == 42);
+		REQUIRE(job->decoded == expected);
+		REQUIRE(job->hash == PICAHash::computeHash(reinterpret_cast<const char*>(data.data()), data.size()));
+		REQUIRE_FALSE(queue.contains(0x1000, TextureFmt::RGB565, width, height));
+
+		REQUIRE(queue.takeAll().size() == 1);
+		REQUIRE(queue.take(0x2000, TextureFmt::RGB565, width, height) == nullptr);
+	}
+}
@@ -0,0 +1,230 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <random>
+
+#include "PICA/dynapica/vertex_loader_rec.hpp"
+#include "PICA/regs.hpp"
+
+#ifdef PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
+using namespace VertexLoader;
+using Regs = std::array<u32, 0x300>;
+
+namespace {
+	struct BufferConfig {
+		u32 offset;
+		u32 stride;
+		std::vector<u32> components;  // Attribute index of each component, or 12-15 for padding
+	};
+
+	struct DrawConfig {
+		std::vector<u32> attributeFormats;  // Type in bits 0-1 and component count - 1 in bits 2-3, for each attribute index
+		std::vector<BufferConfig> buffers;
+		u32 totalAttributes;
+		u32 fixedMask = 0;
+		std::array<u32, 16> permutation = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+	};
+
+	Regs makeRegs(const DrawConfig& config) {
+		using namespace PICA::InternalRegs;
+		Regs regs = {};
+
+		u64 vertexCfg = 0;
+		for (u32 i = 0; i < config.attributeFormats.size(); i++) {
+			vertexCfg |= u64(config.attributeFormats[i]) << (i * 4);
+		}
+
+		regs[AttribFormatLow] = u32(vertexCfg);
+		regs[AttribFormatHigh] = u32(vertexCfg >> 32) | (config.fixedMask << 16) | ((config.totalAttributes - 1) << 28);
+
+		for (u32 i = 0; i < config.buffers.size(); i++) {
+			const BufferConfig& buffer = config.buffers[i];
+			u64 attrCfg = 0;
+			for (u32 j = 0; j < buffer.components.size(); j++) {
+				attrCfg |= u64(buffer.components[j]) << (j * 4);
+			}
+
+			regs[Attrib0Offset + i * 3] = buffer.offset;
+			regs[Attrib0Offset + i * 3 + 1] = u32(attrCfg);
+			regs[Attrib0Offset + i * 3 + 2] = u32(attrCfg >> 32) | (buffer.stride << 16) | (u32(buffer.components.size()) << 28);
+		}
+
+		u64 inputCfg = 0;
+		for (u32 i = 0; i < 16; i++) {
+			inputCfg |= u64(config.permutation[i]) << (i * 4);
+		}
+
+		regs[VertexShaderInputCfgLow] = u32(inputCfg);
+		regs[VertexShaderInputCfgHigh] = u32(inputCfg >> 32);
+		return regs;
+	}
+
+	// The interpreted vertex fetch from GPU::shadeVertex, reading from "memory" instead of physical addresses
+	void interpretVertex(const Regs& regs, const u8* memory, u32 vertexIndex, const vec4f* fixedAttributes, vec4f* inputs) {
+		using namespace PICA::InternalRegs;
+		const u64 vertexCfg = u64(regs[AttribFormatLow]) | (u64(regs[AttribFormatHigh]) << 32);
+		const u64 inputCfg = u64(regs[VertexShaderInputCfgLow]) | (u64(regs[VertexShaderInputCfgHigh]) << 32);
+		const u32 totalAttribCount = (regs[AttribFormatHigh] >> 28) + 1;
+		const u32 fixedAttribMask = Helpers::getBits<16, 12>(regs[AttribFormatHigh]);
+
+		std::array<vec4f, 16> currentAttributes;
+		u32 attrCount = 0;
+		u32 buffer = 0;
+
+		while (attrCount < totalAttribCount) {
+			if (fixedAttribMask & (1 << attrCount)) {
+				currentAttributes[attrCount] = fixedAttributes[attrCount];
+				attrCount++;
+				continue;
+			}
+
+			const u32 config2 = regs[Attrib0Offset + buffer * 3 + 2];
+			const u64 attrCfg = u64(regs[Attrib0Offset + buffer * 3 + 1]) | (u64(config2) << 32);
+			u32 address = regs[Attrib0Offset + buffer * 3] + vertexIndex * Helpers::getBits<16, 8>(config2);
+
+			for (u32 j = 0; j < (config2 >> 28); j++) {
+				const u32 index = (attrCfg >> (j * 4)) & 0xf;
+				if (index >= 12) {
+					address = (address + 3) & ~3u;
+					address += (index - 11) << 2;
+					continue;
+				}
+
+				const u32 attribInfo = (vertexCfg >> (index * 4)) & 0xf;
+				const u32 type = attribInfo & 0x3;
+				const u32 size = (attribInfo >> 2) + 1;
+				vec4f& attribute = currentAttributes[attrCount];
+				const u8* data = memory + address;
+
+				for (u32 component = 0; component < 4; component++) {
+					float value;
+					if (component >= size) {
+						value = component == 3 ? 1.0f : 0.0f;
+					} else {
+						switch (type) {
+							case 0: value = float(s8(data[component])); break;
+							case 1: value = float(data[component]); break;
+							case 2: {
+								s16 raw;
+								std::memcpy(&raw, data + component * sizeof(s16), sizeof(s16));
+								value = float(raw);
+								break;
+							}
+							default: std::memcpy(&value, data + component * sizeof(float), sizeof(float)); break;
+						}
+					}
+
+					attribute[component] = Floats::f24::fromFloat32(value);
+				}
+
+				address += size * attribTypeSizes[type];
+				attrCount++;
+			}
+
+			buffer++;
+		}
+
+		for (u32 j = 0; j < totalAttribCount; j++) {
+			inputs[(inputCfg >> (j * 4)) & 0xf] = currentAttributes[j];
+		}
+	}
+
+	// Fill memory with random bytes. Floats are made from small integers so that no component is a NaN, which wouldn't compare equal
+	void fillMemory(std::vector<u8>& memory, std::mt19937& rng) {
+		for (usize i = 0; i + 4 <= memory.size(); i += 4) {
+			if (rng() & 1) {
+				const float value = float(s32(rng() % 2001) - 1000) / 8.0f;
+				std::memcpy(&memory[i], &value, sizeof(float));
+			} else {
+				const u32 value = rng();
+				std::memcpy(&memory[i], &value, sizeof(u32));
+			}
+		}
+	}
+
+	void compareLoaders(const DrawConfig& config, u32 vertexCount) {
+		if (!VertexLoaderEmitter::isHostSupported()) {
+			WARN("The vertex loader JIT isn't supported on this CPU");
+			return;
+		}
+
+		const Regs regs = makeRegs(config);
+		std::mt19937 rng(1234);
+		std::vector<u8> memory(0x1000);
+		fillMemory(memory, rng);
+
+		alignas(16) std::array<vec4f, 16> fixedAttributes;
+		for (u32 i = 0; i < 16; i++) {
+			for (u32 j = 0; j < 4; j++) {
+				fixedAttributes[i][j] = Floats::f24::fromFloat32(float(i * 4 + j));
+			}
+		}
+
+		// The memory vector starts at "address" 0, which is aligned to anything the loader cares about
+		std::array<u32, maxAttribCount> bufferAlignment = {};
+		std::array<const u8*, maxAttribCount> bufferPointers = {};
+		for (u32 i = 0; i < config.buffers.size(); i++) {
+			bufferAlignment[i] = config.buffers[i].offset & 3;
+			bufferPointers[i] = memory.data() + config.buffers[i].offset;
+		}
+
+		VertexLoaderJIT jit;
+		REQUIRE(jit.prepare(regs, bufferAlignment));
+
+		for (u32 vertex = 0; vertex < vertexCount; vertex++) {
+			// Registers the loader doesn't write keep their old value, so start both from the same garbage
+			alignas(16) std::array<vec4f, 16> expected;
+			alignas(16) std::array<vec4f, 16> actual;
+			for (u32 i = 0; i < 16; i++) {
+				expected[i].fill(Floats::f24::fromFloat32(-12345.0f));
+			}
+			actual = expected;
+
+			interpretVertex(regs, memory.data(), vertex, fixedAttributes.data(), expected.data());
+			jit.loadVertex(actual.data(), bufferPointers.data(), vertex, fixedAttributes.data());
+
+			for (u32 i = 0; i < 16; i++) {
+				for (u32 j = 0; j < 4; j++) {
+					INFO("vertex " << vertex << ", input register " << i << ", component " << j);
+					REQUIRE(actual[i][j].toFloat32() == expected[i][j].toFloat32());
+				}
+			}
+		}
+	}
+}  // namespace
+
+TEST_CASE("Vertex loader JIT matches the interpreter for every attribute type and size", "[vertex_loader]") {
+	static constexpr const char* typeNames[] = {"s8", "u8", "s16", "float"};
+
+	for (u32 type = 0; type < 4; type++) {
+		for (u32 size = 1; size <= 4; size++) {
+			DYNAMIC_SECTION(typeNames[type] << " x" << size) {
+				// One attribute, preceded by a u8x3 attribute so that it doesn't start at the beginning of the vertex
+				DrawConfig config;
+				config.attributeFormats = {(2 << 2) | 1, ((size - 1) << 2) | type};
+				config.buffers = {BufferConfig{.offset = 0x40, .stride = 3 + 16 + 1, .components = {0, 1}}};
+				config.totalAttributes = 2;
+				config.permutation = {7, 2};
+
+				compareLoaders(config, 8);
+			}
+		}
+	}
+}
+
+TEST_CASE("Vertex loader JIT matches the interpreter for mixed layouts", "[vertex_loader]") {
+	DrawConfig config;
+	// 0: float x3, 1: u8 x4, 2: s16 x2, 3: fixed, 4: s8 x1, 5: float x4
+	config.attributeFormats = {(2 << 2) | 3, (3 << 2) | 1, (1 << 2) | 2, 0, 0, (3 << 2) | 3};
+	config.buffers = {
+		// Interleaved position and colour, then a texture coordinate after 4 bytes of padding
+		BufferConfig{.offset = 0x100, .stride = 32, .components = {0, 1, 12, 2}},
+		// A misaligned buffer with a byte attribute, padded up to the float after it
+		BufferConfig{.offset = 0x203, .stride = 24, .components = {4, 12, 5}},
+	};
+	config.totalAttributes = 6;
+	config.fixedMask = 1 << 3;
+	config.permutation = {3, 0, 5, 1, 2, 4};
+
+	compareLoaders(config, 16);
+}
+#endif  // PANDA3DS_VERTEX_LOADER_JIT_SUPPORTED
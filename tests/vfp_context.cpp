@@ -0,0 +1,74 @@
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+
+#include "kernel/vfp_context.hpp"
+
+TEST_CASE("VFP instructions are recognized", "[vfp_context]") {
+	using VFPContext::isVFPInstruction;
+
+	// vadd.f32 s0, s0, s1 / vldr s0, [r0] / vmrs r0, fpscr / vmov s0, r0
+	for (u32 instruction : {0xEE300A20u, 0xED900A00u, 0xEEF10A10u, 0xEE000A10u}) {
+		REQUIRE(isVFPInstruction(false, instruction));
+		REQUIRE(isVFPInstruction(true, instruction));
+	}
+
+	// vldr d0, [r0] / vmul.f64 d0, d0, d1, which use coprocessor 11
+	REQUIRE(isVFPInstruction(false, 0xED900B00));
+	REQUIRE(isVFPInstruction(false, 0xEE200B01));
+}
+
+TEST_CASE("Other instructions aren't VFP instructions", "[vfp_context]") {
+	using VFPContext::isVFPInstruction;
+
+	// ARM: add r0, r0, r1 / svc #0xA00 / mcr p15, 0, r0, c7, c10, 5 / ldr r0, [r1, #0xA00]
+	for (u32 instruction : {0xE0800001u, 0xEF000A00u, 0xEE070FBAu, 0xE5910A00u}) {
+		REQUIRE_FALSE(isVFPInstruction(false, instruction));
+	}
+
+	// Thumb: cmp r2, #0 / bl with an offset that has the coprocessor bits set / mcr p15, 0, r0, c7, c10, 5
+	for (u32 instruction : {0x00002A00u, 0xF000FA00u, 0xEE070FBAu}) {
+		REQUIRE_FALSE(isVFPInstruction(true, instruction));
+	}
+}
+
+TEST_CASE("VFP banks are only switched when needed", "[vfp_context]") {
+	struct Thread {
+		std::array<u32, 32> fprs{};
+		u64 fprVersion = VFPContext::zeroVersion;
+	};
+
+	std::array<u32, 32> live{};
+	Thread a, b, c;
+	VFPContext::BankSwitcher switcher;
+
+	// A is running when the emulator starts and writes s0
+	live[0] = 1;
+	REQUIRE(switcher.switchBanks(live, true, a.fprs, a.fprVersion, b.fprs, b.fprVersion));
+	REQUIRE(a.fprs[0] == 1);
+	REQUIRE(live[0] == 0);
+
+	// B leaves the VFP alone, so A's bank gets loaded back and B's isn't saved
+	REQUIRE(switcher.switchBanks(live, false, b.fprs, b.fprVersion, a.fprs, a.fprVersion));
+	REQUIRE(live[0] == 1);
+
+	// Neither A nor C touch the VFP. C and B both have the all-zero bank, so switching from C to B needs no load
+	REQUIRE(switcher.switchBanks(live, false, a.fprs, a.fprVersion, c.fprs, c.fprVersion));
+	REQUIRE(live[0] == 0);
+	REQUIRE_FALSE(switcher.switchBanks(live, false, c.fprs, c.fprVersion, b.fprs, b.fprVersion));
+
+	// B writes s1, which has to survive a round trip through A
+	live[1] = 2;
+	REQUIRE(switcher.switchBanks(live, true, b.fprs, b.fprVersion, a.fprs, a.fprVersion));
+	REQUIRE(live[0] == 1);
+	REQUIRE(live[1] == 0);
+	REQUIRE(switcher.switchBanks(live, false, a.fprs, a.fprVersion, b.fprs, b.fprVersion));
+	REQUIRE(live[0] == 0);
+	REQUIRE(live[1] == 2);
+	REQUIRE(c.fprs == std::array<u32, 32>{});
+
+	// After a reset the live registers are loaded on the next switch, even for a thread with the all-zero bank
+	switcher.reset();
+	live.fill(0xFF);
+	REQUIRE(switcher.switchBanks(live, false, b.fprs, b.fprVersion, c.fprs, c.fprVersion));
+	REQUIRE(live == std::array<u32, 32>{});
+}